@@ -0,0 +1,104 @@
+#
+# $Id$
+#
+# The helpers for the bench scripts (see hub.cmake). HUB4COM should
+# be set to the path of hub4com and DURATION to the duration of each
+# run in seconds.
+#
+
+if(NOT HUB4COM)
+  message(FATAL_ERROR "HUB4COM is not set")
+endif()
+
+if(NOT DURATION)
+  set(DURATION 2)
+endif()
+
+math(EXPR BENCH_TIMEOUT "${DURATION} + 30")
+
+#
+# bench_run(<var> <command> [<arg>...])
+#
+# Runs the command (hub4com or a wrapper running it) and sets <var> to
+# the list of the total lines reported by the sinks.
+#
+function(bench_run var)
+  execute_process(
+    COMMAND ${ARGN}
+    OUTPUT_VARIABLE out
+    ERROR_VARIABLE err
+    RESULT_VARIABLE res
+    TIMEOUT ${BENCH_TIMEOUT}
+  )
+
+  if(NOT res EQUAL 0)
+    message(FATAL_ERROR "${ARGV1} failed (${res})\n${err}")
+  endif()
+
+  string(REGEX MATCHALL "[^\n]* Total [^\n]*" totals "${out}")
+
+  if(NOT totals)
+    message(FATAL_ERROR "${ARGV1} did not report the totals\n${out}\n${err}")
+  endif()
+
+  set(${var} "${totals}" PARENT_SCOPE)
+endfunction()
+
+#
+# bench(<title> <hub4com arg>...)
+#
+# Runs hub4com and prints all the total lines.
+#
+function(bench title)
+  bench_run(totals ${HUB4COM} ${ARGN})
+
+  message("${title}:")
+
+  foreach(total ${totals})
+    message("  ${total}")
+  endforeach()
+endfunction()
+
+#
+# bench_sum(<title> <totals>)
+#
+# Prints the number of the sinks, the throughput of the slowest one
+# and the throughput of all of them together.
+#
+function(bench_sum title totals)
+  set(num 0)
+  set(sumBytes 0)
+  set(sumMsgs 0)
+  set(maxMs 1)
+  set(minLine)
+  set(minBytes -1)
+
+  foreach(total ${totals})
+    if(NOT total MATCHES " ([0-9]+) bytes, ([0-9]+) msgs in ([0-9]+)\\.([0-9]+) s")
+      continue()
+    endif()
+
+    math(EXPR num "${num} + 1")
+    math(EXPR sumBytes "${sumBytes} + ${CMAKE_MATCH_1}")
+    math(EXPR sumMsgs "${sumMsgs} + ${CMAKE_MATCH_2}")
+    math(EXPR ms "${CMAKE_MATCH_3} * 1000 + 1${CMAKE_MATCH_4} - 1000")
+
+    if(ms GREATER maxMs)
+      set(maxMs ${ms})
+    endif()
+
+    if(minBytes LESS 0 OR CMAKE_MATCH_1 LESS minBytes)
+      set(minBytes ${CMAKE_MATCH_1})
+      string(REGEX REPLACE ".* s: " "" minLine "${total}")
+    endif()
+  endforeach()
+
+  # in hundredths of MB/s like the bench ports
+  math(EXPR mbps "${sumBytes} * 100 / ${maxMs} * 1000 / 1048576")
+  math(EXPR mbpsInt "${mbps} / 100")
+  math(EXPR mbpsFrac "${mbps} % 100 + 100")
+  string(SUBSTRING "${mbpsFrac}" 1 2 mbpsFrac)
+  math(EXPR msgps "${sumMsgs} * 1000 / ${maxMs}")
+
+  message("${title}: ${num} sink(s), slowest ${minLine}; all ${mbpsInt}.${mbpsFrac} MB/s, ${msgps} msgs/s")
+endfunction()
@@ -0,0 +1,97 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#ifndef _BENCHUTILS_H
+#define _BENCHUTILS_H
+
+#ifndef _WIN32
+  #include <time.h>
+#endif
+
+///////////////////////////////////////////////////////////////
+//
+// The helpers for the microbenchmarks (see bench/CMakeLists.txt).
+//
+///////////////////////////////////////////////////////////////
+inline ULONGLONG BenchNow()
+{
+#ifdef _WIN32
+  LARGE_INTEGER freq, counter;
+
+  ::QueryPerformanceFrequency(&freq);
+  ::QueryPerformanceCounter(&counter);
+
+  return (ULONGLONG)(counter.QuadPart / freq.QuadPart) * 1000000000
+       + (ULONGLONG)(counter.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ULONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+///////////////////////////////////////////////////////////////
+//
+// Prints "<title>: <n> ops in <s> s: <x> Mops/s, <y> ns/op" for
+// the ops done since the start time (see BenchNow()).
+//
+///////////////////////////////////////////////////////////////
+inline void BenchReport(const string &title, ULONGLONG ops, ULONGLONG start)
+{
+  ULONGLONG ns = BenchNow() - start;
+
+  if (!ns)
+    ns = 1;
+
+  // in hundredths
+  ULONGLONG mops = (ULONGLONG)((double)ops * 100000 / ns);
+  ULONGLONG nsop = ops ? (ULONGLONG)((double)ns * 100 / ops) : 0;
+
+  cout << title << ": " << ops << " ops in "
+       << (ns / 1000000000) << "." << setfill('0') << setw(3) << (ns / 1000000 % 1000) << " s: "
+       << (mops / 100) << "." << setw(2) << (mops % 100) << " Mops/s, "
+       << (nsop / 100) << "." << setw(2) << (nsop % 100) << setfill(' ') << " ns/op" << endl;
+}
+///////////////////////////////////////////////////////////////
+//
+// Prints "<title>: <n> bytes in <s> s: <x> MB/s" for the bytes
+// processed since the start time (see BenchNow()).
+//
+///////////////////////////////////////////////////////////////
+inline void BenchReportBytes(const string &title, ULONGLONG bytes, ULONGLONG start)
+{
+  ULONGLONG ns = BenchNow() - start;
+
+  if (!ns)
+    ns = 1;
+
+  // in hundredths of MB/s
+  ULONGLONG mbps = (ULONGLONG)((double)bytes * 100 * 1000000000 / ns / (1024*1024));
+
+  cout << title << ": " << bytes << " bytes in "
+       << (ns / 1000000000) << "." << setfill('0') << setw(3) << (ns / 1000000 % 1000) << " s: "
+       << (mbps / 100) << "." << setw(2) << (mbps % 100) << setfill(' ') << " MB/s" << endl;
+}
+///////////////////////////////////////////////////////////////
+
+#endif  // _BENCHUTILS_H
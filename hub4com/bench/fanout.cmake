@@ -0,0 +1,27 @@
+#
+# $Id$
+#
+# Runs hub4com with one bench source routed to 1, 2, 4, ... 32 bench
+# sinks (4096 bytes per message). The routed messages share the data
+# buffer, so the cost of the fan-out should grow by the number of the
+# messages, not by the number of the copied bytes.
+#
+# Usage: cmake -DHUB4COM=<path> [-DDURATION=<s>] -P fanout.cmake
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/bench.cmake)
+
+foreach(num 1 2 4 8 16 32)
+  set(sinks)
+
+  foreach(i RANGE 1 ${num})
+    list(APPEND sinks sink)
+  endforeach()
+
+  bench_run(totals ${HUB4COM}
+    --use-driver=bench --duration=${DURATION} --size=4096
+    --route=0:All
+    source ${sinks})
+
+  bench_sum("1:${num}" "${totals}")
+endforeach()
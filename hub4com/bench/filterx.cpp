@@ -0,0 +1,131 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include <iomanip>
+
+#include "plugins/serial/filterx.h"
+#include "benchutils.h"
+
+using namespace PortSerial;
+
+///////////////////////////////////////////////////////////////
+//
+// Runs the XON/XOFF stripping kernels of the serial port (see
+// plugins/serial/filterx.h) on the 1 MB buffer of
+//
+//   clean  - random bytes w/o XON and XOFF (found none, not copied)
+//   random - random bytes (XON or XOFF is 1/128 of them)
+//   dense  - random bytes with every 8th one XON
+//
+// The stripped buffer is restored after each round and it is counted.
+//
+///////////////////////////////////////////////////////////////
+#define BUF_SIZE    (1024*1024)
+#define NUM_ROUNDS  200
+#define XON         0x11
+#define XOFF        0x13
+///////////////////////////////////////////////////////////////
+static DWORD Filter(BYTE *pBuf, DWORD len, BOOL sse2)
+{
+#ifdef FILTERX_SSE2
+  if (sse2) {
+    DWORD i = FindXSse2(pBuf, len, XON, XOFF);
+
+    return i < len ? i + StripXSse2(pBuf + i, len - i, XON, XOFF) : len;
+  }
+#else
+  _ASSERTE(!sse2);
+#endif  /* FILTERX_SSE2 */
+
+  DWORD i = FindXScalar(pBuf, len, XON, XOFF);
+
+  return i < len ? i + StripXScalar(pBuf + i, len - i, XON, XOFF) : len;
+}
+///////////////////////////////////////////////////////////////
+static void Bench(
+    const string &title,
+    const vector<BYTE> &data,
+    BOOL sse2)
+{
+  vector<BYTE> buf(data);
+  DWORD len = 0;
+  ULONGLONG bytes = 0;
+  ULONGLONG start = BenchNow();
+
+  for (int n = 0 ; n < NUM_ROUNDS ; n++) {
+    len = Filter(&buf[0], (DWORD)data.size(), sse2);
+
+    if (len < data.size())
+      memcpy(&buf[0], &data[0], data.size());
+
+    bytes += data.size();
+  }
+
+  BenchReportBytes(title, bytes, start);
+
+  // keep the result used
+  if (len > data.size())
+    cout << len << endl;
+}
+///////////////////////////////////////////////////////////////
+int main(int /*argc*/, char* /*argv*/[])
+{
+  vector<BYTE> clean(BUF_SIZE);
+  vector<BYTE> random(BUF_SIZE);
+  vector<BYTE> dense(BUF_SIZE);
+
+  srand(1);
+
+  for (DWORD i = 0 ; i < BUF_SIZE ; i++) {
+    BYTE b = (BYTE)rand();
+
+    random[i] = b;
+    dense[i] = (i % 8) ? b : XON;
+
+    while (b == XON || b == XOFF)
+      b = (BYTE)rand();
+
+    clean[i] = b;
+  }
+
+  const struct {
+    const char *pName;
+    const vector<BYTE> *pData;
+  } sets[] = {
+    { "clean", &clean },
+    { "random", &random },
+    { "dense", &dense },
+  };
+
+  for (size_t i = 0 ; i < sizeof(sets)/sizeof(sets[0]) ; i++) {
+    Bench(string(sets[i].pName) + " scalar", *sets[i].pData, FALSE);
+#ifdef FILTERX_SSE2
+    Bench(string(sets[i].pName) + " sse2", *sets[i].pData, TRUE);
+#endif  /* FILTERX_SSE2 */
+  }
+
+  return 0;
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,48 @@
+#
+# $Id$
+#
+# Runs hub4com with the bench ports (see --help=bench) in the typical
+# topologies and prints the totals reported by the sinks:
+#
+#   1:1       - one source to one sink
+#   1:N       - one source to 4 sinks (fan-out)
+#   N:1       - 4 sources to one sink (fan-in)
+#   chain <n> - one source to one sink via <n> filters (0 to 8)
+#
+# Usage: cmake -DHUB4COM=<path> [-DDURATION=<s>] -P hub.cmake
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/bench.cmake)
+
+bench("1:1"
+  --use-driver=bench --duration=${DURATION}
+  --route=0:1
+  source sink)
+
+bench("1:N"
+  --use-driver=bench --duration=${DURATION}
+  --route=0:All
+  source sink sink sink sink)
+
+bench("N:1"
+  --use-driver=bench --duration=${DURATION}
+  --route=0,1,2,3:4
+  source source source source sink)
+
+foreach(depth RANGE 0 8)
+  set(filters)
+
+  if(depth GREATER 0)
+    foreach(i RANGE 1 ${depth})
+      list(APPEND filters --create-filter=escparse,chain,p${i})
+    endforeach()
+
+    list(APPEND filters --add-filters=0:chain)
+  endif()
+
+  bench("chain ${depth}"
+    ${filters}
+    --use-driver=bench --duration=${DURATION} --pattern=text
+    --route=0:1
+    source sink)
+endforeach()
@@ -0,0 +1,133 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include <iomanip>
+
+#include "hubmsg.h"
+#include "pool.h"
+#include "bufutils.h"
+#include "benchutils.h"
+
+///////////////////////////////////////////////////////////////
+//
+// Compares the pools (see pool.h) with the heap:
+//
+//   BUF <size>   - BufAlloc()/BufFree() vs new/delete []
+//   MSG          - new/delete HubMsg vs malloc()/free()
+//
+// Each case allocates a batch of blocks and frees them (like the
+// messages queued and then written) so the heap can't reuse the
+// only block.
+//
+///////////////////////////////////////////////////////////////
+#define NUM_OPS   (2*1024*1024)
+#define BATCH     64
+///////////////////////////////////////////////////////////////
+static void *blocks[BATCH];
+///////////////////////////////////////////////////////////////
+static void BenchBuf(DWORD size)
+{
+  stringstream title;
+
+  title << "BUF " << size;
+
+  ULONGLONG start = BenchNow();
+
+  for (int n = 0 ; n < NUM_OPS ; n += BATCH) {
+    for (int i = 0 ; i < BATCH ; i++) {
+      BYTE *pBuf = BufAlloc(size);
+
+      pBuf[0] = (BYTE)i;
+      blocks[i] = pBuf;
+    }
+
+    for (int i = 0 ; i < BATCH ; i++)
+      BufFree((BYTE *)blocks[i]);
+  }
+
+  BenchReport(title.str() + " pool", NUM_OPS, start);
+
+  start = BenchNow();
+
+  for (int n = 0 ; n < NUM_OPS ; n += BATCH) {
+    for (int i = 0 ; i < BATCH ; i++) {
+      BYTE *pBuf = new BYTE[size + 16 + BUF_HDR_LEN];
+
+      pBuf[0] = (BYTE)i;
+      blocks[i] = pBuf;
+    }
+
+    for (int i = 0 ; i < BATCH ; i++)
+      delete [] (BYTE *)blocks[i];
+  }
+
+  BenchReport(title.str() + " heap", NUM_OPS, start);
+}
+///////////////////////////////////////////////////////////////
+static void BenchMsg()
+{
+  ULONGLONG start = BenchNow();
+
+  for (int n = 0 ; n < NUM_OPS ; n += BATCH) {
+    for (int i = 0 ; i < BATCH ; i++)
+      blocks[i] = new HubMsg();
+
+    for (int i = 0 ; i < BATCH ; i++)
+      delete (HubMsg *)blocks[i];
+  }
+
+  BenchReport("MSG pool", NUM_OPS, start);
+
+  start = BenchNow();
+
+  for (int n = 0 ; n < NUM_OPS ; n += BATCH) {
+    for (int i = 0 ; i < BATCH ; i++) {
+      HubMsg *pMsg = (HubMsg *)malloc(sizeof(HubMsg));
+
+      pMsg->time = 0;
+      blocks[i] = pMsg;
+    }
+
+    for (int i = 0 ; i < BATCH ; i++)
+      free(blocks[i]);
+  }
+
+  BenchReport("MSG heap", NUM_OPS, start);
+}
+///////////////////////////////////////////////////////////////
+int main(int /*argc*/, char* /*argv*/[])
+{
+  static const DWORD sizes[] = {16, 256, 1024, 4096, 16384};
+
+  for (size_t i = 0 ; i < sizeof(sizes)/sizeof(sizes[0]) ; i++)
+    BenchBuf(sizes[i]);
+
+  BenchMsg();
+
+  PoolReport(cout);
+
+  return 0;
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,35 @@
+#
+# $Id$
+#
+# Runs hub4com routing the data between two serial ports of the pty
+# pairs (see ptyloop.cpp) with the default serial options and the
+# different sizes of the data chunks written to the ports. The last
+# runs add the pinmap filter so the modem status is polled too (the
+# ptys do not support TIOCMIWAIT).
+#
+# Usage: cmake -DHUB4COM=<path> -DPTYLOOP=<path> [-DDURATION=<s>] -P pty.cmake
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/bench.cmake)
+
+if(NOT PTYLOOP)
+  message(FATAL_ERROR "PTYLOOP is not set")
+endif()
+
+foreach(chunk 16 256 4096)
+  bench_run(totals ${PTYLOOP} ${DURATION} ${chunk} ${HUB4COM}
+    --octs=off
+    @0 @1)
+
+  message("chunk ${chunk}: ${totals}")
+endforeach()
+
+foreach(chunk 16 4096)
+  bench_run(totals ${PTYLOOP} ${DURATION} ${chunk} ${HUB4COM}
+    --octs=off
+    --create-filter=pinmap
+    --add-filters=0,1:pinmap
+    @0 @1)
+
+  message("chunk ${chunk}, pinmap: ${totals}")
+endforeach()
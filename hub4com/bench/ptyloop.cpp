@@ -0,0 +1,244 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include <iomanip>
+
+#include <pty.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "benchutils.h"
+
+///////////////////////////////////////////////////////////////
+//
+// A stand-in for a com0com loopback on Linux:
+//
+//   ptyloop <s> <chunk> <hub4com> [<arg>...]
+//
+// Opens two pty pairs and runs hub4com with @0 and @1 args replaced
+// by the paths of the slaves, so the hub uses them as the serial ports
+// of two com0com pairs. Then for <s> seconds writes the counted data
+// by <chunk> bytes to the master of @0 and checks the data read from
+// the master of @1, so the hub should route @0 to @1. At the end
+// prints
+//
+//   PTY Total <n> bytes in <s> s: <x> MB/s, errors <e>, hub cpu <c> ms, <y> ns/KB
+//
+///////////////////////////////////////////////////////////////
+#define WARMUP_TIME   500
+#define SETTLE_TIME   100
+///////////////////////////////////////////////////////////////
+static BOOL OpenPair(int &master, string &path)
+{
+  int slave;
+  char name[256];
+
+  if (openpty(&master, &slave, name, NULL, NULL) < 0) {
+    perror("openpty()");
+    return FALSE;
+  }
+
+  struct termios tios;
+
+  // the slave is not closed till the end so the master does not get
+  // EIO while the hub reopens it
+  if (tcgetattr(slave, &tios) == 0) {
+    cfmakeraw(&tios);
+    tcsetattr(slave, TCSANOW, &tios);
+  }
+
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+  path = name;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+  if (argc < 4) {
+    cerr << "Usage: " << argv[0] << " <s> <chunk> <hub4com> [<arg>...]" << endl;
+    return 1;
+  }
+
+  ULONGLONG duration = (ULONGLONG)atoi(argv[1]) * 1000000000;
+  size_t chunk = (size_t)atoi(argv[2]);
+
+  if (!chunk)
+    chunk = 1;
+
+  int masters[2];
+  string paths[2];
+
+  for (int i = 0 ; i < 2 ; i++) {
+    if (!OpenPair(masters[i], paths[i]))
+      return 1;
+  }
+
+  vector<string> args;
+
+  for (int i = 3 ; i < argc ; i++) {
+    if (strcmp(argv[i], "@0") == 0)
+      args.push_back(paths[0]);
+    else
+    if (strcmp(argv[i], "@1") == 0)
+      args.push_back(paths[1]);
+    else
+      args.push_back(argv[i]);
+  }
+
+  vector<char *> execArgs;
+
+  for (vector<string>::iterator i = args.begin() ; i != args.end() ; i++)
+    execArgs.push_back((char *)i->c_str());
+
+  execArgs.push_back(NULL);
+
+  pid_t pid = fork();
+
+  if (pid < 0) {
+    perror("fork()");
+    return 1;
+  }
+
+  if (pid == 0) {
+    close(masters[0]);
+    close(masters[1]);
+
+    execv(execArgs[0], &execArgs[0]);
+    perror(execArgs[0]);
+    _exit(127);
+  }
+
+  // let the hub open and set up the ports
+  usleep(WARMUP_TIME * 1000);
+
+  vector<BYTE> outBuf(chunk);
+  vector<BYTE> inBuf(65536);
+  ULONGLONG sent = 0;
+  ULONGLONG received = 0;
+  ULONGLONG errors = 0;
+  BYTE expected = 0;
+  ULONGLONG start = BenchNow();
+  ULONGLONG last = start;
+  BOOL exited = FALSE;
+
+  for (;;) {
+    ULONGLONG now = BenchNow();
+    BOOL sending = (now - start < duration);
+
+    if (!sending && now - last >= (ULONGLONG)SETTLE_TIME * 1000000)
+      break;
+
+    struct pollfd fds[2];
+
+    fds[0].fd = masters[0];
+    fds[0].events = sending ? POLLOUT : 0;
+    fds[1].fd = masters[1];
+    fds[1].events = POLLIN;
+
+    if (poll(fds, 2, 10) < 0) {
+      if (errno == EINTR)
+        continue;
+
+      perror("poll()");
+      break;
+    }
+
+    if (fds[0].revents & POLLOUT) {
+      for (size_t i = 0 ; i < chunk ; i++)
+        outBuf[i] = (BYTE)(sent + i);
+
+      ssize_t done = write(masters[0], &outBuf[0], chunk);
+
+      if (done > 0)
+        sent += done;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      ssize_t done = read(masters[1], &inBuf[0], inBuf.size());
+
+      for (ssize_t i = 0 ; i < done ; i++) {
+        if (inBuf[i] != expected)
+          errors++;
+
+        expected = (BYTE)(inBuf[i] + 1);
+      }
+
+      if (done > 0) {
+        received += done;
+        last = BenchNow();
+      }
+    }
+
+    if (waitpid(pid, NULL, WNOHANG) == pid) {
+      exited = TRUE;
+      break;
+    }
+  }
+
+  struct rusage usage;
+
+  memset(&usage, 0, sizeof(usage));
+
+  if (!exited) {
+    kill(pid, SIGTERM);
+    wait4(pid, NULL, 0, &usage);
+  }
+
+  close(masters[0]);
+  close(masters[1]);
+
+  if (exited) {
+    cerr << execArgs[0] << " exited" << endl;
+    return 1;
+  }
+
+  ULONGLONG ns = last - start;
+
+  if (!ns)
+    ns = 1;
+
+  ULONGLONG cpu = (ULONGLONG)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+                + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+
+  // in hundredths of MB/s
+  ULONGLONG mbps = (ULONGLONG)((double)received * 100 * 1000000000 / ns / (1024*1024));
+
+  cout << "PTY Total " << received << " bytes in "
+       << (ns / 1000000000) << "." << setfill('0') << setw(3) << (ns / 1000000 % 1000) << " s: "
+       << (mbps / 100) << "." << setw(2) << (mbps % 100) << setfill(' ') << " MB/s"
+       << ", errors " << errors
+       << ", hub cpu " << cpu / 1000 << " ms"
+       << ", " << (received ? cpu * 1000 * 1024 / received : 0) << " ns/KB" << endl;
+
+  return 0;
+}
+///////////////////////////////////////////////////////////////
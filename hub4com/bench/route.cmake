@@ -0,0 +1,52 @@
+#
+# $Id$
+#
+# Runs hub4com with 64 and 256 bench ports to see the cost of the
+# routing by the number of the ports:
+#
+#   <n> pairs - <n>/2 sources each routed to its own sink
+#   <n>:1     - <n>-1 sources routed to one sink
+#
+# Usage: cmake -DHUB4COM=<path> [-DDURATION=<s>] -P route.cmake
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/bench.cmake)
+
+foreach(num 64 256)
+  math(EXPR half "${num} / 2")
+  math(EXPR last "${half} - 1")
+
+  set(routes)
+  set(sources)
+  set(sinks)
+
+  foreach(i RANGE 0 ${last})
+    math(EXPR sink "${half} + ${i}")
+    list(APPEND routes --route=${i}:${sink})
+    list(APPEND sources source)
+    list(APPEND sinks sink)
+  endforeach()
+
+  bench_run(totals ${HUB4COM}
+    --use-driver=bench --duration=${DURATION}
+    ${routes}
+    ${sources} ${sinks})
+
+  bench_sum("${num} ports, ${half} pairs" "${totals}")
+
+  math(EXPR last "${num} - 2")
+  math(EXPR sink "${num} - 1")
+
+  set(sources)
+
+  foreach(i RANGE 0 ${last})
+    list(APPEND sources source)
+  endforeach()
+
+  bench_run(totals ${HUB4COM}
+    --use-driver=bench --duration=${DURATION}
+    --route=All:${sink}
+    ${sources} sink)
+
+  bench_sum("${num} ports, ${sink}:1" "${totals}")
+endforeach()
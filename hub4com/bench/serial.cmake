@@ -0,0 +1,27 @@
+#
+# $Id$
+#
+# Runs hub4com routing the data between two serial ports of the pty
+# pairs (a stand-in for com0com pairs, see ptyloop.cpp) with the
+# different read sizes and numbers of the outstanding reads. The larger
+# reads should take less hub's CPU per KB. The write queue limit is
+# enough for all the outstanding reads so no data is dropped.
+#
+# Usage: cmake -DHUB4COM=<path> -DPTYLOOP=<path> [-DDURATION=<s>] -P serial.cmake
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/bench.cmake)
+
+if(NOT PTYLOOP)
+  message(FATAL_ERROR "PTYLOOP is not set")
+endif()
+
+foreach(reads 1 4)
+  foreach(size 64 4096 65536)
+    bench_run(totals ${PTYLOOP} ${DURATION} 4096 ${HUB4COM}
+      --octs=off --write-limit=262144 --read-size=${size} --reads=${reads}
+      @0 @1)
+
+    message("read-size ${size}, reads ${reads}: ${totals}")
+  endforeach()
+endforeach()
@@ -0,0 +1,32 @@
+#
+# $Id$
+#
+# Runs hub4com with one bench source routed to a fast sink and to a
+# slow one (100000 bytes per second) with the different flow control:
+#
+#   xoff     - the sinks send XOFF/XON to the source
+#   credit   - the source generates data by the credit of the sinks
+#   drop     - the source is controlled by the fast sink only and the
+#              slow sink drops the data it can't write
+#
+# The max gap of the sinks shows how smooth the data is.
+#
+# Usage: cmake -DHUB4COM=<path> [-DDURATION=<s>] -P slowsink.cmake
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/bench.cmake)
+
+bench("xoff"
+  --use-driver=bench --duration=${DURATION}
+  --route=0:All --fc-route=All:0
+  source sink --rate=100000 sink)
+
+bench("credit"
+  --use-driver=bench --duration=${DURATION}
+  --route=0:All --fc-route=All:0 --credit-fc
+  source sink --rate=100000 sink)
+
+bench("drop"
+  --use-driver=bench --duration=${DURATION}
+  --route=0:All --fc-route=1:0
+  source sink --rate=100000 sink)
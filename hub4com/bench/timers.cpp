@@ -0,0 +1,146 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include <iomanip>
+
+#include "reactor.h"
+#include "benchutils.h"
+
+///////////////////////////////////////////////////////////////
+//
+// Arms NUM_TIMERS timers of the reactor (see reactor.h):
+//
+//   set      - set the timers due in 1 ms to 60 s
+//   reset    - set them again with other due times
+//   cancel   - cancel them
+//   fire     - fire the timers due in 1 ms to 1 s
+//   periodic - fire the 10 ms periodic timers for 1 s
+//
+// The timers are fired by the virtual clock (see --virtual-clock)
+// so only the cost of the wheel is counted.
+//
+///////////////////////////////////////////////////////////////
+#define NUM_TIMERS  100000
+///////////////////////////////////////////////////////////////
+static ULONGLONG numFired = 0;
+
+static void FireProc(void * /*pParam*/)
+{
+  numFired++;
+}
+
+static BOOL done = FALSE;
+
+static void DoneProc(void * /*pParam*/)
+{
+  done = TRUE;
+}
+///////////////////////////////////////////////////////////////
+static void SetAll(Reactor &reactor, vector<ReactorTimer *> &timers, DWORD maxDue, LONG period)
+{
+  for (vector<ReactorTimer *>::iterator i = timers.begin() ; i != timers.end() ; i++) {
+    LARGE_INTEGER dueTime;
+
+    dueTime.QuadPart = -10000LL * (1 + (rand() * (RAND_MAX + 1LL) + rand()) % maxDue);
+
+    (*i)->Set(reactor, &dueTime, period);
+  }
+}
+
+static void RunFor(Reactor &reactor, DWORD ms)
+{
+  ReactorTimer doneTimer(DoneProc, NULL);
+  LARGE_INTEGER dueTime;
+
+  dueTime.QuadPart = -10000LL * ms;
+
+  done = FALSE;
+  doneTimer.Set(reactor, &dueTime, 0);
+
+  while (!done)
+    reactor.RunOnce(INFINITE);
+}
+///////////////////////////////////////////////////////////////
+int main(int /*argc*/, char* /*argv*/[])
+{
+  Reactor::SetVirtualClock();
+
+  Reactor reactor;
+  vector<ReactorTimer *> timers;
+
+  for (int i = 0 ; i < NUM_TIMERS ; i++) {
+    ReactorTimer *pTimer = new ReactorTimer(FireProc, NULL);
+
+    if (!pTimer) {
+      cerr << "No enough memory." << endl;
+      return 2;
+    }
+
+    timers.push_back(pTimer);
+  }
+
+  srand(1);
+
+  ULONGLONG start = BenchNow();
+
+  SetAll(reactor, timers, 60000, 0);
+  BenchReport("set", NUM_TIMERS, start);
+
+  start = BenchNow();
+
+  SetAll(reactor, timers, 60000, 0);
+  BenchReport("reset", NUM_TIMERS, start);
+
+  start = BenchNow();
+
+  for (vector<ReactorTimer *>::iterator i = timers.begin() ; i != timers.end() ; i++)
+    (*i)->Cancel();
+
+  BenchReport("cancel", NUM_TIMERS, start);
+
+  SetAll(reactor, timers, 1000, 0);
+
+  numFired = 0;
+  start = BenchNow();
+
+  RunFor(reactor, 1001);
+  BenchReport("fire", numFired, start);
+
+  SetAll(reactor, timers, 10, 10);
+
+  numFired = 0;
+  start = BenchNow();
+
+  RunFor(reactor, 1000);
+  BenchReport("periodic", numFired, start);
+
+  cout << "armed " << reactor.NumTimers() << endl;
+
+  for (vector<ReactorTimer *>::iterator i = timers.begin() ; i != timers.end() ; i++)
+    delete *i;
+
+  return 0;
+}
+///////////////////////////////////////////////////////////////
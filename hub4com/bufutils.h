@@ -28,29 +28,50 @@
 ///////////////////////////////////////////////////////////////
 #define BUF_SIGNATURE 'h4cB'
 ///////////////////////////////////////////////////////////////
+//
+// The buffer is prefixed by a header:
+//
+//   [signature (_DEBUG only)] [reference counter] [size]
+//
+// The buffer can be shared by several messages (see BufAddRef()).
+// It should be unshared (see BufUnshare()) before modifying in place.
+//
+// The buffer is allocated from the pool (see PoolBufAlloc()) so the
+// size can be rounded up to the pool's block size.
+//
+///////////////////////////////////////////////////////////////
+#define BUF_HDR_SIZE(pBuf)      (*((DWORD *)(pBuf) - 1))
+#define BUF_HDR_REFS(pBuf)      (*((LONG *)(pBuf) - 2))
+#define BUF_HDR_SIGNATURE(pBuf) (*((DWORD *)(pBuf) - 3))
+
+#ifdef _DEBUG
+  #define BUF_HDR_LEN (sizeof(DWORD) + sizeof(LONG) + sizeof(DWORD))
+#else
+  #define BUF_HDR_LEN (sizeof(LONG) + sizeof(DWORD))
+#endif
+///////////////////////////////////////////////////////////////
 inline BYTE *BufAlloc(DWORD size)
 {
   if (!size)
     return NULL;
 
-  size += 16;
+  // fits POOL_BUF_EXTRA so a 2^n bytes buffer gets the 2^n pool
+  size += 16 + BUF_HDR_LEN;
 
-  BYTE *pBuf = new BYTE[size
-#ifdef _DEBUG
-                        + sizeof(DWORD)
-#endif
-                        + sizeof(DWORD)];
+  BYTE *pBuf = (BYTE *)PoolBufAlloc(&size);
 
   if (!pBuf)
     return NULL;
 
+  pBuf += BUF_HDR_LEN;
+  size -= BUF_HDR_LEN;
+
 #ifdef _DEBUG
-  *(DWORD *)pBuf = BUF_SIGNATURE;
-  pBuf += sizeof(DWORD);
+  BUF_HDR_SIGNATURE(pBuf) = BUF_SIGNATURE;
 #endif
 
-  *(DWORD *)pBuf = size;
-  pBuf += sizeof(DWORD);
+  BUF_HDR_REFS(pBuf) = 1;
+  BUF_HDR_SIZE(pBuf) = size;
 
   return pBuf;
 }
@@ -58,30 +79,74 @@ inline BYTE *BufAlloc(DWORD size)
 inline VOID BufFree(BYTE *pBuf)
 {
   if (pBuf) {
-    _ASSERTE(*(DWORD *)(pBuf - sizeof(DWORD) - sizeof(DWORD)) == BUF_SIGNATURE);
+    _ASSERTE(BUF_HDR_SIGNATURE(pBuf) == BUF_SIGNATURE);
+    _ASSERTE(BUF_HDR_REFS(pBuf) > 0);
 
-#ifdef _DEBUG
-    *(DWORD *)(pBuf - sizeof(DWORD) - sizeof(DWORD)) = 0;
-#endif
+    if (--BUF_HDR_REFS(pBuf) > 0)
+      return;
 
-    delete [] (pBuf
 #ifdef _DEBUG
-               - sizeof(DWORD)
+    BUF_HDR_SIGNATURE(pBuf) = 0;
 #endif
-               - sizeof(DWORD));
+
+    PoolBufFree(pBuf - BUF_HDR_LEN, BUF_HDR_SIZE(pBuf) + BUF_HDR_LEN);
   }
 }
 ///////////////////////////////////////////////////////////////
+inline BYTE *BufAddRef(BYTE *pBuf)
+{
+  if (pBuf) {
+    _ASSERTE(BUF_HDR_SIGNATURE(pBuf) == BUF_SIGNATURE);
+    _ASSERTE(BUF_HDR_REFS(pBuf) > 0);
+
+    BUF_HDR_REFS(pBuf)++;
+  }
+
+  return pBuf;
+}
+///////////////////////////////////////////////////////////////
+inline BOOL BufIsShared(const BYTE *pBuf)
+{
+  if (!pBuf)
+    return FALSE;
+
+  _ASSERTE(BUF_HDR_SIGNATURE(pBuf) == BUF_SIGNATURE);
+  _ASSERTE(BUF_HDR_REFS(pBuf) > 0);
+
+  return BUF_HDR_REFS(pBuf) > 1;
+}
+///////////////////////////////////////////////////////////////
+inline BOOL BufUnshare(BYTE **ppBuf, DWORD size)
+{
+  BYTE *pBuf = *ppBuf;
+
+  if (!BufIsShared(pBuf))
+    return TRUE;
+
+  BYTE *pNewBuf = BufAlloc(size);
+
+  if (!pNewBuf && size)
+    return FALSE;
+
+  if (size)
+    memcpy(pNewBuf, pBuf, size);
+
+  BufFree(pBuf);
+  *ppBuf = pNewBuf;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
 inline void BufAppend(BYTE **ppBuf, DWORD offset, const BYTE *pSrc, DWORD sizeSrc)
 {
   BYTE *pBuf = *ppBuf;
 
-  _ASSERTE(!pBuf || (*(DWORD *)(pBuf - sizeof(DWORD) - sizeof(DWORD)) == BUF_SIGNATURE));
+  _ASSERTE(!pBuf || BUF_HDR_SIGNATURE(pBuf) == BUF_SIGNATURE);
 
-  DWORD sizeOld = pBuf ? *(DWORD *)(pBuf - sizeof(DWORD)) : 0;
+  DWORD sizeOld = pBuf ? BUF_HDR_SIZE(pBuf) : 0;
   DWORD sizeNew = offset + sizeSrc;
 
-  if (sizeOld < sizeNew) {
+  if (sizeOld < sizeNew || BufIsShared(pBuf)) {
     *ppBuf = BufAlloc(sizeNew);
 
     if (sizeOld > offset)
@@ -0,0 +1,246 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include "reactor.h"
+#include "stats.h"
+#include "capture.h"
+
+///////////////////////////////////////////////////////////////
+#define CAPTURE_BUF_SIZE        (64*1024)
+#define CAPTURE_FLUSH_PERIOD    1000
+///////////////////////////////////////////////////////////////
+// the hub does not return from the loop so the capture is flushed
+// by exit() (e.g. see --duration of the bench driver)
+static Capture *pCaptureAtExit = NULL;
+
+static void FlushAtExit()
+{
+  if (pCaptureAtExit)
+    pCaptureAtExit->Flush();
+}
+///////////////////////////////////////////////////////////////
+Capture::Capture()
+  : pBuf(NULL),
+    len(0),
+    lastTime(0),
+    timer(FlushProc, this)
+{
+#ifdef _WIN32
+  ::InitializeCriticalSection(&lock);
+#else
+  pthread_mutex_init(&lock, NULL);
+#endif
+}
+///////////////////////////////////////////////////////////////
+Capture::~Capture()
+{
+  if (pCaptureAtExit == this)
+    pCaptureAtExit = NULL;
+
+  timer.Cancel();
+
+  Flush();
+
+  if (pBuf)
+    delete [] pBuf;
+
+#ifdef _WIN32
+  ::DeleteCriticalSection(&lock);
+#else
+  pthread_mutex_destroy(&lock);
+#endif
+}
+///////////////////////////////////////////////////////////////
+BOOL Capture::Open(const char *pPath)
+{
+  _ASSERTE(pPath != NULL);
+
+  pBuf = new BYTE[CAPTURE_BUF_SIZE];
+
+  if (!pBuf) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
+  path = pPath;
+  file.open(pPath, ios::out | ios::binary | ios::trunc);
+
+  if (!file.is_open()) {
+    cerr << "Can't create capture file " << path << endl;
+    return FALSE;
+  }
+
+  static const BYTE header[] = { 'h', '4', 'c', 'C', CAPTURE_VERSION };
+
+  Put(header, sizeof(header));
+
+  lastTime = LatencyNow();
+
+  if (!pCaptureAtExit) {
+    pCaptureAtExit = this;
+    atexit(FlushAtExit);
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+void Capture::Start(Reactor &reactor)
+{
+  LARGE_INTEGER dueTime;
+
+  dueTime.QuadPart = -10000LL * CAPTURE_FLUSH_PERIOD;
+
+  timer.Set(reactor, &dueTime, CAPTURE_FLUSH_PERIOD);
+}
+///////////////////////////////////////////////////////////////
+void Capture::FlushProc(void *pParam)
+{
+  ((Capture *)pParam)->Flush();
+}
+///////////////////////////////////////////////////////////////
+void Capture::PutNumber(ULONGLONG num)
+{
+  BYTE buf[10];
+  DWORD i = 0;
+
+  do {
+    buf[i] = (BYTE)(num & 0x7F);
+    num >>= 7;
+
+    if (num)
+      buf[i] |= 0x80;
+
+    i++;
+  } while (num);
+
+  Put(buf, i);
+}
+///////////////////////////////////////////////////////////////
+void Capture::Put(const BYTE *pData, DWORD size)
+{
+  while (size) {
+    if (len == CAPTURE_BUF_SIZE)
+      FlushBuf();
+
+    DWORD n = CAPTURE_BUF_SIZE - len;
+
+    if (n > size)
+      n = size;
+
+    memcpy(pBuf + len, pData, n);
+    len += n;
+    pData += n;
+    size -= n;
+  }
+}
+///////////////////////////////////////////////////////////////
+void Capture::FlushBuf()
+{
+  if (!len)
+    return;
+
+  if (file.is_open()) {
+    file.write((const char *)pBuf, len);
+
+    if (!file) {
+      cerr << "Can't write capture file " << path << ", capturing stopped" << endl;
+      file.close();
+    }
+  }
+
+  len = 0;
+}
+///////////////////////////////////////////////////////////////
+void Capture::Write(int port, const HUB_MSG *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+
+  DWORD unionType = pMsg->type & HUB_MSG_UNION_TYPES_MASK;
+
+  switch (unionType) {
+    case HUB_MSG_UNION_TYPE_NONE:
+    case HUB_MSG_UNION_TYPE_BUF:
+    case HUB_MSG_UNION_TYPE_VAL:
+      break;
+    default:
+      return;
+  }
+
+#ifdef _WIN32
+  ::EnterCriticalSection(&lock);
+#else
+  pthread_mutex_lock(&lock);
+#endif
+
+  if (file.is_open()) {
+    ULONGLONG time = LatencyNow();
+
+    PutNumber((ULONGLONG)port);
+    PutNumber(time > lastTime ? time - lastTime : 0);
+    PutNumber(pMsg->type);
+
+    if (unionType == HUB_MSG_UNION_TYPE_BUF) {
+      DWORD size = pMsg->u.buf.pBuf ? pMsg->u.buf.size : 0;
+
+      PutNumber(size);
+      Put(pMsg->u.buf.pBuf, size);
+    }
+    else
+    if (unionType == HUB_MSG_UNION_TYPE_VAL) {
+      PutNumber(pMsg->u.val);
+    }
+
+    if (time > lastTime)
+      lastTime = time;
+  }
+
+#ifdef _WIN32
+  ::LeaveCriticalSection(&lock);
+#else
+  pthread_mutex_unlock(&lock);
+#endif
+}
+///////////////////////////////////////////////////////////////
+void Capture::Flush()
+{
+#ifdef _WIN32
+  ::EnterCriticalSection(&lock);
+#else
+  pthread_mutex_lock(&lock);
+#endif
+
+  FlushBuf();
+
+  if (file.is_open())
+    file.flush();
+
+#ifdef _WIN32
+  ::LeaveCriticalSection(&lock);
+#else
+  pthread_mutex_unlock(&lock);
+#endif
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,93 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+///////////////////////////////////////////////////////////////
+//
+// The capture file (see --capture option) is
+//
+//   'h', '4', 'c', 'C', <version>
+//
+// followed by the records
+//
+//   <port> <time> <type> [<payload>]
+//
+// where the numbers are unsigned LEB128 (7 bits per byte, the
+// least significant first, the high bit is set if more bytes
+// follow), <port> is the zero based number of the port read
+// the message, <time> is microseconds since the previous
+// record and <payload> is
+//
+//   <size> <data>  - for HUB_MSG_UNION_TYPE_BUF
+//   <val>          - for HUB_MSG_UNION_TYPE_VAL
+//
+// The messages with pointers or handles are not captured. The
+// capture can be replayed by the replay driver.
+//
+///////////////////////////////////////////////////////////////
+#define CAPTURE_VERSION     1
+///////////////////////////////////////////////////////////////
+class Reactor;
+///////////////////////////////////////////////////////////////
+class Capture
+{
+  public:
+    Capture();
+    ~Capture();
+
+    BOOL Open(const char *pPath);
+
+    // flush the buffer periodically by the loop of the main thread
+    void Start(Reactor &reactor);
+
+    // can be called by any thread
+    void Write(int port, const HUB_MSG *pMsg);
+    void Flush();
+
+  private:
+    static void FlushProc(void *pParam);
+
+    void PutNumber(ULONGLONG num);
+    void Put(const BYTE *pData, DWORD len);
+    void FlushBuf();
+
+    ofstream file;
+    string path;
+
+    BYTE *pBuf;
+    DWORD len;
+    ULONGLONG lastTime;
+
+    ReactorTimer timer;
+
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _CAPTURE_H
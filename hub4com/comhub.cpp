@@ -79,11 +79,20 @@
 #include "precomp.h"
 #include "plugins/plugins_api.h"
 
+#include "reactor.h"
+#include "stats.h"
+#include "shaper.h"
+#include "capture.h"
 #include "comhub.h"
 #include "port.h"
 #include "filters.h"
 #include "hubmsg.h"
+#include "shard.h"
+#include "pool.h"
 
+///////////////////////////////////////////////////////////////
+// the maximal number of data messages written at once
+#define WRITE_V_MAX 16
 ///////////////////////////////////////////////////////////////
 void ComHub::Add()
 {
@@ -106,8 +115,10 @@ BOOL ComHub::InitPort(
   return ports[n]->Init(pPortRoutines, hConfig, pPath);
 }
 
-BOOL ComHub::StartAll() const
+BOOL ComHub::StartAll()
 {
+  SetShards();
+
   for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++) {
     HubMsg msg;
 
@@ -174,6 +185,20 @@ BOOL ComHub::StartAll() const
     }
   }
 
+  // the main thread flushes the capture for all threads
+  if (pCapture)
+    pCapture->Start(reactor);
+
+  if (!shards.empty()) {
+    // the ports will be started by their threads
+    for (Shards::const_iterator i = shards.begin() ; i != shards.end() ; i++) {
+      if (!(*i)->Start())
+        return FALSE;
+    }
+
+    return TRUE;
+  }
+
   for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++) {
     if (!(*i)->Start())
       return FALSE;
@@ -181,8 +206,128 @@ BOOL ComHub::StartAll() const
 
   return TRUE;
 }
+///////////////////////////////////////////////////////////////
+static unsigned FindGroup(vector<unsigned> &groups, unsigned n)
+{
+  while (groups[n] != n) {
+    groups[n] = groups[groups[n]];
+    n = groups[n];
+  }
+
+  return n;
+}
+
+static void JoinGroups(vector<unsigned> &groups, const PortMap &map)
+{
+  for (PortMap::const_iterator i = map.begin() ; i != map.end() ; i++) {
+    unsigned n1 = FindGroup(groups, (unsigned)i->first->Num());
+    unsigned n2 = FindGroup(groups, (unsigned)i->second->Num());
+
+    if (n1 < n2)
+      groups[n2] = n1;
+    else
+    if (n2 < n1)
+      groups[n1] = n2;
+  }
+}
+
+static bool IsLarger(const Ports &ports1, const Ports &ports2)
+{
+  return ports1.size() > ports2.size();
+}
 
-BOOL ComHub::OnFakeRead(Port *pFromPort, HubMsg *pMsg) const
+void ComHub::SetShards()
+{
+  if (numThreads < 2)
+    return;
+
+  if (Reactor::IsVirtualClock()) {
+    cout << "The virtual clock is used so all ports will be handled by one thread" << endl;
+    return;
+  }
+
+  // find the groups of ports joined by routes, filters or drivers
+
+  vector<unsigned> groups(NumPorts());
+
+  for (unsigned n = 0 ; n < NumPorts() ; n++)
+    groups[n] = n;
+
+  JoinGroups(groups, routeDataMap);
+  JoinGroups(groups, routeFlowControlMap);
+  JoinGroups(groups, joinMap);
+
+  if (pFilters) {
+    PortMap filtersMap;
+
+    pFilters->JoinPorts(filtersMap);
+    JoinGroups(groups, filtersMap);
+  }
+
+  vector<Ports> groupPorts;
+  vector<unsigned> groupIndexes(NumPorts(), NumPorts());
+
+  for (unsigned n = 0 ; n < NumPorts() ; n++) {
+    unsigned group = FindGroup(groups, n);
+
+    if (groupIndexes[group] == NumPorts()) {
+      groupIndexes[group] = (unsigned)groupPorts.size();
+      groupPorts.push_back(Ports());
+    }
+
+    groupPorts[groupIndexes[group]].push_back(ports[n]);
+  }
+
+  if (groupPorts.size() < 2) {
+    cout << "All ports are joined so they will be handled by one thread" << endl;
+    return;
+  }
+
+  // put the largest groups first to the least loaded threads
+
+  stable_sort(groupPorts.begin(), groupPorts.end(), IsLarger);
+
+  unsigned numShards = numThreads < groupPorts.size() ? numThreads : (unsigned)groupPorts.size();
+
+  for (unsigned n = 0 ; n < numShards ; n++) {
+    Shard *pShard = new Shard(*this, n);
+
+    if (!pShard) {
+      cerr << "No enough memory." << endl;
+      exit(2);
+    }
+
+    shards.push_back(pShard);
+  }
+
+  for (vector<Ports>::const_iterator iGroup = groupPorts.begin() ; iGroup != groupPorts.end() ; iGroup++) {
+    Shard *pShard = shards.front();
+
+    for (Shards::const_iterator i = shards.begin() ; i != shards.end() ; i++) {
+      if ((*i)->NumPorts() < pShard->NumPorts())
+        pShard = *i;
+    }
+
+    for (Ports::const_iterator i = iGroup->begin() ; i != iGroup->end() ; i++)
+      pShard->Add(*i);
+  }
+
+  // the thread 0 is the main thread
+  PoolSetThreads(numShards + 1);
+
+  for (Shards::const_iterator i = shards.begin() ; i != shards.end() ; i++)
+    (*i)->Report();
+}
+
+void ComHub::JoinPorts(Port *pPort1, Port *pPort2)
+{
+  _ASSERTE(pPort1 != NULL);
+  _ASSERTE(pPort2 != NULL);
+
+  joinMap.insert(pair<Port *, Port *>(pPort1, pPort2));
+}
+
+BOOL ComHub::OnFakeRead(Port *pFromPort, HubMsg *pMsg)
 {
   if (!pFromPort->FakeReadFilter(pMsg))
     return FALSE;
@@ -192,13 +337,19 @@ BOOL ComHub::OnFakeRead(Port *pFromPort, HubMsg *pMsg) const
   return TRUE;
 }
 
-void ComHub::OnRead(Port *pFromPort, HubMsg *pMsg) const
+void ComHub::OnRead(Port *pFromPort, HubMsg *pMsg)
 {
   _ASSERTE(pFromPort != NULL);
   _ASSERTE(pMsg != NULL);
 
+  pFromPort->CountRead(pMsg);
+
+  // the messages w/o time are not measured (see --latency-stats)
+  ULONGLONG time = pMsg->time;
+
   if (pFilters) {
     HubMsg *pEchoMsg = NULL;
+    ULONGLONG start = time ? LatencyNow() : 0;
 
     if (!pFilters->InMethod(pFromPort, pMsg, &pEchoMsg)) {
       if (pEchoMsg) {
@@ -207,6 +358,9 @@ void ComHub::OnRead(Port *pFromPort, HubMsg *pMsg) const
       }
     }
 
+    if (start)
+      pFromPort->AddInLatency(start);
+
     for (HubMsg *pCurMsg = pEchoMsg ; pCurMsg ; pCurMsg = pCurMsg->Next())
       pFromPort->Write(pCurMsg);
 
@@ -214,30 +368,86 @@ void ComHub::OnRead(Port *pFromPort, HubMsg *pMsg) const
       delete pEchoMsg;
   }
 
-  const PortMap &routeMap = (pMsg->type & HUB_MSG_ROUTE_FLOW_CONTROL) ? routeFlowControlMap : routeDataMap;
+  PortRoutes &routes = (pMsg->type & HUB_MSG_ROUTE_FLOW_CONTROL) ? routeFlowControl : routeData;
 
-  for (PortMap::const_iterator i = routeMap.find(pFromPort) ; i != routeMap.end() ; i++) {
-    if (i->first != pFromPort)
-      break;
+  if ((unsigned)pFromPort->Num() >= routes.size())
+    return;
+
+  RoutesTo &routeTo = routes[pFromPort->Num()];
+
+  // the credit aware ports are flow controlled by credit each other
+  BOOL skipCredit = (creditFc && pMsg->type == HUB_MSG_TYPE_ADD_XOFF_XON && pFromPort->HasWriteCredit());
+
+  for (RoutesTo::iterator i = routeTo.begin() ; i != routeTo.end() ; i++) {
+    Port *pToPort = i->pPort;
+
+    if (skipCredit && pToPort->HasWriteCredit())
+      continue;
 
     HubMsg *pOutMsg = pMsg->Clone();
 
     if (pFilters && pOutMsg) {
-      if (!pFilters->OutMethod(pFromPort, i->second, pOutMsg)) {
+      ULONGLONG start = time ? LatencyNow() : 0;
+
+      if (!pFilters->OutMethod(pFromPort, pToPort, pOutMsg)) {
         if (pOutMsg) {
           delete pOutMsg;
           pOutMsg = NULL;
         }
       }
+
+      if (start && i->pLatency)
+        i->pLatency->outLatency.AddSince(start);
     }
 
+    // the adjacent data messages are written at once
+    HubMsg *lineData[WRITE_V_MAX];
+    DWORD numLineData = 0;
+
     for (HubMsg *pCurMsg = pOutMsg ; pCurMsg ; pCurMsg = pCurMsg->Next()) {
-      i->second->Write(pCurMsg);
+      // counted before writing since the port can take the buffer
+      if (pCurMsg->type == HUB_MSG_TYPE_LINE_DATA) {
+        i->bytes += pCurMsg->u.buf.size;
+        i->msgs++;
+
+        if (time && i->pLatency)
+          i->pLatency->latency.AddSince(time);
+
+        if (i->pShaper) {
+          i->pShaper->Write(pCurMsg);
+          continue;
+        }
+
+        // the urgent data is written alone to go ahead of the queued one
+        if (!pCurMsg->urgent) {
+          lineData[numLineData++] = pCurMsg;
+
+          if (numLineData >= WRITE_V_MAX) {
+            pToPort->WriteV(lineData, numLineData);
+            numLineData = 0;
+          }
+
+          continue;
+        }
+      }
+
+      if (numLineData) {
+        pToPort->WriteV(lineData, numLineData);
+        numLineData = 0;
+      }
+
+      if (i->pShaper) {
+        // the queued message is empty now
+        if (!i->pShaper->Write(pCurMsg))
+          continue;
+      } else {
+        pToPort->Write(pCurMsg);
+      }
 
       switch (HUB_MSG_T2N(pCurMsg->type)) {
         case HUB_MSG_T2N(HUB_MSG_TYPE_SET_OUT_OPTS):
           if (pCurMsg->u.val) {
-            cerr << i->second->Name() << " WARNING: Requested output option(s) SO_0x"
+            cerr << pToPort->Name() << " WARNING: Requested output option(s) SO_0x"
                  << hex << pCurMsg->u.val << dec
                  << " not supported" << endl;
           }
@@ -245,18 +455,325 @@ void ComHub::OnRead(Port *pFromPort, HubMsg *pMsg) const
       }
     }
 
+    if (numLineData)
+      pToPort->WriteV(lineData, numLineData);
+
     if (pOutMsg)
       delete pOutMsg;
   }
 }
 
-void ComHub::LostReport() const
+static void CompileRoute(const PortMap &map, PortRoutes &routes, unsigned numPorts)
+{
+  routes.clear();
+  routes.resize(numPorts);
+
+  for (PortMap::const_iterator i = map.begin() ; i != map.end() ; i++) {
+    _ASSERTE(i->first->Num() >= 0 && (unsigned)i->first->Num() < numPorts);
+
+    routes[i->first->Num()].push_back(RouteTo(i->second));
+  }
+}
+
+void ComHub::SetDataRoute(const PortMap &map, const RouteRates &rates)
+{
+  PortRoutes routes;
+
+  CompileRoute(map, routes, NumPorts());
+
+  // the remaining routes take the counters and the shapers of the old ones
+  for (PortRoutes::iterator i = routes.begin() ; i != routes.end() ; i++) {
+    unsigned n = unsigned(i - routes.begin());
+
+    if (n >= routeData.size())
+      continue;
+
+    RoutesTo &oldRouteTo = routeData[n];
+
+    for (RoutesTo::iterator j = i->begin() ; j != i->end() ; j++) {
+      for (RoutesTo::iterator k = oldRouteTo.begin() ; k != oldRouteTo.end() ; k++) {
+        if (k->pPort != j->pPort)
+          continue;
+
+        *j = *k;
+        k->pShaper = NULL;
+        k->pLatency = NULL;
+        break;
+      }
+    }
+  }
+
+  // the histograms are allocated only if they are used
+  if (latencyStats) {
+    for (PortRoutes::iterator i = routes.begin() ; i != routes.end() ; i++) {
+      for (RoutesTo::iterator j = i->begin() ; j != i->end() ; j++) {
+        if (j->pLatency)
+          continue;
+
+        j->pLatency = new RouteLatency;
+
+        if (!j->pLatency) {
+          cerr << "No enough memory." << endl;
+          exit(2);
+        }
+      }
+    }
+  }
+
+  routeDataMap = map;
+  routeRates = rates;
+  routeData.swap(routes);
+
+  for (PortRoutes::iterator i = routes.begin() ; i != routes.end() ; i++) {
+    for (RoutesTo::iterator j = i->begin() ; j != i->end() ; j++)
+      delete j->pLatency;
+  }
+
+  SetShapers(routes);
+}
+
+void ComHub::SetShapers(PortRoutes &oldRoutes)
+{
+  // the queued data of the removed routes is not lost
+  for (PortRoutes::iterator i = oldRoutes.begin() ; i != oldRoutes.end() ; i++) {
+    for (RoutesTo::iterator j = i->begin() ; j != i->end() ; j++) {
+      if (j->pShaper) {
+        j->pShaper->Flush();
+        delete j->pShaper;
+        j->pShaper = NULL;
+      }
+    }
+  }
+
+  shapers.clear();
+
+  for (PortRoutes::iterator i = routeData.begin() ; i != routeData.end() ; i++) {
+    for (RoutesTo::iterator j = i->begin() ; j != i->end() ; j++) {
+      Port *pFrom = ports[i - routeData.begin()];
+      RouteRates::const_iterator iRate = routeRates.find(pair<Port*, Port*>(pFrom, j->pPort));
+
+      if (iRate == routeRates.end()) {
+        if (j->pShaper) {
+          j->pShaper->Flush();
+          delete j->pShaper;
+          j->pShaper = NULL;
+        }
+
+        continue;
+      }
+
+      if (j->pShaper) {
+        if (j->pShaper->Rate() != iRate->second)
+          j->pShaper->SetRate(iRate->second);
+      } else {
+        j->pShaper = new RouteShaper(*pFrom, *j->pPort, iRate->second);
+
+        if (!j->pShaper) {
+          cerr << "No enough memory." << endl;
+          exit(2);
+        }
+      }
+
+      shapers.push_back(j->pShaper);
+    }
+  }
+}
+
+void ComHub::SetFlowControlRoute(const PortMap &map)
 {
+  routeFlowControlMap = map;
+  CompileRoute(routeFlowControlMap, routeFlowControl, NumPorts());
+
+  creditFrom.clear();
+  creditFrom.resize(NumPorts());
+
+  for (PortMap::const_iterator i = routeFlowControlMap.begin() ; i != routeFlowControlMap.end() ; i++) {
+    _ASSERTE(i->second->Num() >= 0 && (unsigned)i->second->Num() < NumPorts());
+
+    creditFrom[i->second->Num()].push_back(i->first);
+  }
+}
+
+DWORD ComHub::GetReadCredit(const Port *pPort) const
+{
+  _ASSERTE(pPort != NULL);
+
+  DWORD credit = HUB_CREDIT_UNLIMITED;
+
+  if (!creditFc || (unsigned)pPort->Num() >= creditFrom.size())
+    return credit;
+
+  const Ports &from = creditFrom[pPort->Num()];
+
+  for (Ports::const_iterator i = from.begin() ; i != from.end() ; i++) {
+    // the XOFF/XON is used for the ports w/o credit
+    if (!(*i)->HasWriteCredit())
+      continue;
+
+    DWORD c = (*i)->GetWriteCredit();
+
+    if (c < credit)
+      credit = c;
+  }
+
+  return credit;
+}
+
+BOOL ComHub::ForEachPort(
+    PortProc *pPortProc,
+    void *pParam,
+    ReactorProc *pDoneProc,
+    void *pDoneParam)
+{
+  _ASSERTE(pPortProc != NULL);
+
+  if (shards.empty()) {
+    for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++)
+      pPortProc(*i, pParam);
+
+    if (pDoneProc)
+      pDoneProc(pDoneParam);
+
+    return TRUE;
+  }
+
+  // the previous pass is not finished yet
+  if (forEachPortBusy)
+    return FALSE;
+
+  forEachPortBusy = TRUE;
+  pForEachPortProc = pPortProc;
+  pForEachPortParam = pParam;
+  pForEachPortDone = pDoneProc;
+  pForEachPortDoneParam = pDoneParam;
+
+  // the ports are passed by their threads one thread after another
+  shards.front()->reactor.Post(ForEachPortProc, shards.front());
+
+  return TRUE;
+}
+
+void ComHub::ForEachPortProc(void *pArg)
+{
+  Shard *pShard = (Shard *)pArg;
+  ComHub &hub = pShard->hub;
+
+  pShard->ForEachPort(hub.pForEachPortProc, hub.pForEachPortParam);
+
+  unsigned next = pShard->Num() + 1;
+
+  if (next < hub.shards.size())
+    hub.shards[next]->reactor.Post(ForEachPortProc, hub.shards[next]);
+  else
+    hub.reactor.Post(ForEachPortDoneProc, &hub);
+}
+
+void ComHub::ForEachPortDoneProc(void *pArg)
+{
+  ComHub *pHub = (ComHub *)pArg;
+
+  pHub->forEachPortBusy = FALSE;
+
+  if (pHub->pForEachPortDone)
+    pHub->pForEachPortDone(pHub->pForEachPortDoneParam);
+}
+
+void ComHub::InitStats(StatsSnapshot &snapshot) const
+{
+  snapshot.time = 0;
+  snapshot.names.clear();
+  snapshot.ports.clear();
+  snapshot.filters.clear();
+  snapshot.routes.clear();
+  snapshot.portRoutes.clear();
+
   for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++)
-    (*i)->LostReport();
+    snapshot.names.push_back((*i)->Name());
+
+  snapshot.ports.resize(NumPorts());
+  snapshot.filters.resize(NumPorts());
+  snapshot.timers.assign(shards.size() + 1, 0);
+
+  // the filters are not changed by the threads
+  if (pFilters) {
+    for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++)
+      pFilters->GetChain(*i, snapshot.filters[(*i)->Num()]);
+  }
+
+  for (unsigned n = 0 ; n < NumPorts() ; n++) {
+    snapshot.portRoutes.push_back(snapshot.routes.size());
+
+    if (n >= routeData.size())
+      continue;
+
+    const RoutesTo &routeTo = routeData[n];
+
+    for (RoutesTo::const_iterator j = routeTo.begin() ; j != routeTo.end() ; j++)
+      snapshot.routes.push_back(RouteStats(int(n), j->pPort->Num()));
+  }
+
+  snapshot.portRoutes.push_back(snapshot.routes.size());
 }
 
-static void RouteReport(const PortMap &map, const char *pMapName)
+void ComHub::GetStats(const Port *pPort, StatsSnapshot &snapshot) const
+{
+  _ASSERTE(pPort != NULL);
+  _ASSERTE(snapshot.ports.size() == NumPorts());
+
+  pPort->GetStats(snapshot.ports[pPort->Num()]);
+
+  for (Shards::const_iterator i = shards.begin() ; i != shards.end() ; i++) {
+    if (&(*i)->reactor == &pPort->GetReactor()) {
+      snapshot.timers[(*i)->Num() + 1] = pPort->GetReactor().NumTimers();
+      break;
+    }
+  }
+
+  if ((unsigned)pPort->Num() >= routeData.size())
+    return;
+
+  const RoutesTo &routeTo = routeData[pPort->Num()];
+  size_t begin = snapshot.portRoutes[pPort->Num()];
+  size_t end = snapshot.portRoutes[pPort->Num() + 1];
+
+  for (size_t n = begin ; n < end ; n++) {
+    RouteStats &stats = snapshot.routes[n];
+
+    // the routes are in the same order if not changed since InitStats()
+    size_t k = n - begin;
+
+    if (k >= routeTo.size() || routeTo[k].pPort->Num() != stats.to) {
+      for (k = 0 ; k < routeTo.size() ; k++) {
+        if (routeTo[k].pPort->Num() == stats.to)
+          break;
+      }
+
+      if (k >= routeTo.size())
+        continue;
+    }
+
+    const RouteTo &route = routeTo[k];
+
+    stats.bytes = route.bytes;
+    stats.msgs = route.msgs;
+
+    if (route.pLatency) {
+      stats.outLatency = route.pLatency->outLatency;
+      stats.latency = route.pLatency->latency;
+    }
+
+    if (route.pShaper)
+      route.pShaper->GetStats(stats);
+  }
+}
+
+void ComHub::FinishStats(StatsSnapshot &snapshot) const
+{
+  snapshot.time = Reactor::Now();
+  snapshot.timers[0] = reactor.NumTimers();
+}
+
+static void RouteReport(const PortMap &map, const char *pMapName, const RouteRates *pRates = NULL)
 {
   if (!map.size()) {
     cout << "No route for " << pMapName << endl;
@@ -276,6 +793,13 @@ static void RouteReport(const PortMap &map, const char *pMapName)
     }
 
     cout << " " << i->second->Name();
+
+    if (pRates) {
+      RouteRates::const_iterator iRate = pRates->find(*i);
+
+      if (iRate != pRates->end())
+        cout << "@" << iRate->second << "B/s";
+    }
   }
 
   if (pLastPort)
@@ -284,7 +808,7 @@ static void RouteReport(const PortMap &map, const char *pMapName)
 
 void ComHub::RouteReport() const
 {
-  ::RouteReport(routeDataMap, "data");
+  ::RouteReport(routeDataMap, "data", &routeRates);
   ::RouteReport(routeFlowControlMap, "flow control");
 }
 ///////////////////////////////////////////////////////////////
@@ -58,16 +58,50 @@
 class Port;
 class Filters;
 class HubMsg;
+class Shard;
+class StatsSnapshot;
+class RouteShaper;
+class Capture;
 ///////////////////////////////////////////////////////////////
 typedef vector<Port*> Ports;
+typedef void PortProc(Port *pPort, void *pParam);
+///////////////////////////////////////////////////////////////
+struct RouteLatency
+{
+  LatencyHistogram outLatency;    // in the OUT filters
+  LatencyHistogram latency;       // from reading to writing to the port
+};
+///////////////////////////////////////////////////////////////
+struct RouteTo
+{
+  RouteTo(Port *_pPort) : pPort(_pPort), pShaper(NULL), pLatency(NULL), bytes(0), msgs(0) {}
+
+  Port *pPort;
+
+  // the rate limiter or NULL
+  RouteShaper *pShaper;
+
+  // the data route histograms (see --latency-stats) or NULL
+  RouteLatency *pLatency;
+
+  // LINE_DATA routed after the filters (updated by the thread
+  // handling the ports)
+  ULONGLONG bytes;
+  ULONGLONG msgs;
+};
+///////////////////////////////////////////////////////////////
+typedef vector<RouteTo> RoutesTo;
+typedef vector<RoutesTo> PortRoutes;
 typedef multimap<Port*, Port*> PortMap;
+typedef map<pair<Port*, Port*>, DWORD> RouteRates;
+typedef vector<Shard*> Shards;
 ///////////////////////////////////////////////////////////////
 #define HUB_SIGNATURE 'h4cH'
 ///////////////////////////////////////////////////////////////
 class ComHub
 {
   public:
-    ComHub() : pFilters(NULL) {
+    ComHub() : pFilters(NULL), pCapture(NULL), numThreads(1), creditFc(FALSE), forEachPortBusy(FALSE) {
 #ifdef _DEBUG
       signature = HUB_SIGNATURE;
 #endif
@@ -86,34 +120,106 @@ class ComHub
         const PORT_ROUTINES_A *pPortRoutines,
         HCONFIG hConfig,
         const char *pPath);
-    BOOL StartAll() const;
-    BOOL OnFakeRead(Port *pFromPort, HubMsg *pMsg) const;
-    void OnRead(Port *pFromPort, HubMsg *pMsg) const;
-    void LostReport() const;
-    void SetDataRoute(const PortMap &map) { routeDataMap = map; }
-    void SetFlowControlRoute(const PortMap &map) { routeFlowControlMap = map; }
+    BOOL StartAll();
+    BOOL OnFakeRead(Port *pFromPort, HubMsg *pMsg);
+    void OnRead(Port *pFromPort, HubMsg *pMsg);
+
+    // call pPortProc(pPort, pParam) for each port by the thread handling
+    // the port and then pDoneProc(pDoneParam) by the main thread, returns
+    // FALSE if the previous call is not finished yet
+    BOOL ForEachPort(
+        PortProc *pPortProc,
+        void *pParam,
+        ReactorProc *pDoneProc,
+        void *pDoneParam);
+
+    // prepare the snapshot and fill it for a port (should be called
+    // by the thread handling the port, see ForEachPort())
+    void InitStats(StatsSnapshot &snapshot) const;
+    void GetStats(const Port *pPort, StatsSnapshot &snapshot) const;
+
+    // finish the snapshot by the main thread
+    void FinishStats(StatsSnapshot &snapshot) const;
+
+    // the route tables are compiled and swapped in at once so they
+    // can be changed between messages (see --control), the counters
+    // and the queued data of the remaining routes are kept
+    void SetDataRoute(const PortMap &map, const RouteRates &rates);
+    void SetFlowControlRoute(const PortMap &map);
     void RouteReport() const;
     unsigned NumPorts() const { return (unsigned)ports.size(); }
 
+    void JoinPorts(Port *pPort1, Port *pPort2);
+    void SetThreads(unsigned num) { numThreads = num; }
+
+    // the ports are handled by several threads (see --threads)
+    BOOL IsSharded() const { return !shards.empty(); }
+
+    // see --credit-fc
+    void SetCreditFc(BOOL enable) { creditFc = enable; }
+    DWORD GetReadCredit(const Port *pPort) const;
+
+    Filters *GetFilters() const { return pFilters; }
     Filters *SetFilters(Filters *_pFilters) {
       Filters *pFiltersOld = pFilters;
       pFilters = _pFilters;
       return pFiltersOld;
     }
 
-    Port *ComHub::GetPort(unsigned n) const {
+    // see --capture
+    void SetCapture(Capture *_pCapture) { pCapture = _pCapture; }
+    Capture *GetCapture() const { return pCapture; }
+
+    Port *GetPort(unsigned n) const {
       _ASSERTE(n < NumPorts());
       return ports.at(n);
     }
 
     const char *FilterName(HFILTER hFilter) const;
 
+  public:
+    Reactor reactor;
+
   private:
+    void SetShards();
+
+    static void ForEachPortProc(void *pArg);
+    static void ForEachPortDoneProc(void *pArg);
+
+    void SetShapers(PortRoutes &oldRoutes);
+
     Ports ports;
     PortMap routeDataMap;
     PortMap routeFlowControlMap;
 
+    // the routes indexed by source port number
+    PortRoutes routeData;
+    PortRoutes routeFlowControl;
+
+    // the ports having the flow control route to the port (indexed
+    // by port number)
+    vector<Ports> creditFrom;
+
+    // the data routes rates (bytes per second)
+    RouteRates routeRates;
+    vector<RouteShaper *> shapers;
+
     Filters *pFilters;
+    Capture *pCapture;
+
+    // the ports sharing the driver's data
+    PortMap joinMap;
+
+    unsigned numThreads;
+    Shards shards;
+
+    BOOL creditFc;
+
+    BOOL forEachPortBusy;
+    PortProc *pForEachPortProc;
+    void *pForEachPortParam;
+    ReactorProc *pForEachPortDone;
+    void *pForEachPortDoneParam;
 
 #ifdef _DEBUG
   private:
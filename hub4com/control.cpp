@@ -0,0 +1,582 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include "reactor.h"
+#include "control.h"
+
+#ifndef _WIN32
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <fcntl.h>
+#endif
+
+///////////////////////////////////////////////////////////////
+#define CONTROL_BUF_SIZE 4096
+
+// the client is dropped if it sends more not handled data or
+// does not read more answers
+#define CONTROL_IN_MAX   (64*1024)
+#define CONTROL_OUT_MAX  (1024*1024)
+///////////////////////////////////////////////////////////////
+#ifndef _WIN32
+class ControlConnection;
+#endif
+///////////////////////////////////////////////////////////////
+class ControlQuery
+{
+  public:
+#ifdef _WIN32
+    ControlQuery(Control *_pControl) : pControl(_pControl) {}
+
+    Control *pControl;
+#else
+    ControlQuery(ControlConnection *_pConn) : pConn(_pConn) {}
+
+    ControlConnection *pConn;   // NULL if disconnected
+#endif
+};
+///////////////////////////////////////////////////////////////
+Control::Control(
+    Reactor &_reactor,
+    ControlProc *_pProc,
+    ControlStatsProc *_pStatsProc,
+    void *_pParam)
+  : reactor(_reactor),
+    pProc(_pProc),
+    pStatsProc(_pStatsProc),
+    pParam(_pParam),
+#ifdef _WIN32
+    hPipe(INVALID_HANDLE_VALUE),
+    hDone(NULL)
+#else
+    fd(-1),
+    pWatch(NULL)
+#endif
+{
+  _ASSERTE(pProc != NULL);
+  _ASSERTE(pStatsProc != NULL);
+}
+///////////////////////////////////////////////////////////////
+BOOL Control::OnLine(vector<string> &options, const string &line, string &answer)
+{
+  answer.clear();
+
+  string::size_type end = line.find_last_not_of(" \t\r");
+
+  if (end == line.npos || line[0] == '#')
+    return TRUE;
+
+  string option(line, 0, end + 1);
+
+  if (option == "stats")
+    return FALSE;
+
+  if (option == "commit") {
+    BOOL ok = pProc(pParam, options);
+
+    options.clear();
+    answer = ok ? "OK" : "FAILED";
+
+    return TRUE;
+  }
+
+  if (option == "abort") {
+    options.clear();
+    answer = "OK";
+
+    return TRUE;
+  }
+
+  options.push_back(option);
+
+  return TRUE;
+}
+
+void Control::Query(ControlQuery *pQuery)
+{
+  _ASSERTE(pQuery != NULL);
+
+  pStatsProc(pParam, pQuery);
+}
+///////////////////////////////////////////////////////////////
+#ifdef _WIN32
+///////////////////////////////////////////////////////////////
+Control::~Control()
+{
+  // the thread is not stopped so the handles are not closed
+}
+
+BOOL Control::Open(const char *pPath)
+{
+  _ASSERTE(pPath != NULL);
+
+  path = pPath;
+
+  hPipe = ::CreateNamedPipe(pPath,
+                            PIPE_ACCESS_DUPLEX,
+                            PIPE_TYPE_BYTE|PIPE_READMODE_BYTE|PIPE_WAIT,
+                            1,
+                            CONTROL_BUF_SIZE,
+                            CONTROL_BUF_SIZE,
+                            0,
+                            NULL);
+
+  if (hPipe == INVALID_HANDLE_VALUE) {
+    DWORD err = GetLastError();
+
+    cerr << "Can't create control pipe " << path << " - error=" << err << endl;
+    return FALSE;
+  }
+
+  hDone = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+
+  if (!hDone) {
+    DWORD err = GetLastError();
+
+    cerr << "CreateEvent() - error=" << err << endl;
+    return FALSE;
+  }
+
+  HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, this, 0, NULL);
+
+  if (!hThread) {
+    cerr << "Can't create control thread" << endl;
+    return FALSE;
+  }
+
+  ::CloseHandle(hThread);
+
+  cout << "Control " << path << endl;
+
+  return TRUE;
+}
+
+unsigned __stdcall Control::ThreadProc(void *pArg)
+{
+  ((Control *)pArg)->Run();
+
+  return 0;
+}
+
+void Control::OnLineProc(void *pArg)
+{
+  Control *pControl = (Control *)pArg;
+  string answer;
+
+  if (pControl->OnLine(pControl->options, pControl->line, answer)) {
+    pControl->OnAnswer(answer);
+    return;
+  }
+
+  ControlQuery *pQuery = new ControlQuery(pControl);
+
+  if (!pQuery) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
+  pControl->Query(pQuery);
+}
+
+void Control::OnAnswer(const string &_answer)
+{
+  answer = _answer;
+
+  ::SetEvent(hDone);
+}
+
+void Control::Answer(ControlQuery *pQuery, const string &answer)
+{
+  _ASSERTE(pQuery != NULL);
+
+  // the control thread is waiting for it
+  pQuery->pControl->OnAnswer(answer);
+
+  delete pQuery;
+}
+
+void Control::Run()
+{
+  // the clients are served one by one by blocking I/O, the lines
+  // are handled by the main thread
+
+  for (;;) {
+    if (!::ConnectNamedPipe(hPipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+      DWORD err = GetLastError();
+
+      cerr << "Control " << path << " ConnectNamedPipe() - error=" << err << endl;
+      return;
+    }
+
+    string buf;
+
+    for (;;) {
+      char chunk[CONTROL_BUF_SIZE];
+      DWORD done;
+
+      if (!::ReadFile(hPipe, chunk, sizeof(chunk), &done, NULL) || !done)
+        break;
+
+      buf.append(chunk, done);
+
+      string::size_type eol;
+
+      while ((eol = buf.find('\n')) != buf.npos) {
+        line = buf.substr(0, eol);
+        buf.erase(0, eol + 1);
+
+        reactor.Post(OnLineProc, this);
+        ::WaitForSingleObject(hDone, INFINITE);
+
+        if (!answer.empty()) {
+          answer += "\r\n";
+
+          if (!::WriteFile(hPipe, answer.data(), (DWORD)answer.size(), &done, NULL))
+            break;
+        }
+      }
+
+      // too long line (the answers are written by blocking I/O)
+      if (buf.size() > CONTROL_IN_MAX) {
+        cerr << "Control client dropped - too much input" << endl;
+        break;
+      }
+    }
+
+    // the not committed change is dropped
+    options.clear();
+
+    ::FlushFileBuffers(hPipe);
+    ::DisconnectNamedPipe(hPipe);
+  }
+}
+///////////////////////////////////////////////////////////////
+#else  /* _WIN32 */
+///////////////////////////////////////////////////////////////
+class ControlConnection
+{
+  public:
+    ControlConnection(Control &_control, int _fd);
+    ~ControlConnection();
+
+    BOOL Start();
+    void OnAnswer(const string &answer);
+
+  private:
+    static void CALLBACK OnEvents(HWATCHPARAM hWatchParam, DWORD events);
+
+    void OnLines();
+    void Send(const string &answer);
+    void Flush();
+    void Drop(const char *pReason);
+
+    Control &control;
+    int fd;
+    ReactorWatch *pWatch;
+
+    // shut down and waiting for deleting by OnEvents()
+    BOOL dropped;
+
+    string buf;
+    vector<string> options;
+
+    // the answers not sent yet
+    string out;
+
+    // the lines are not handled while waiting for the answer
+    ControlQuery *pQuery;
+};
+///////////////////////////////////////////////////////////////
+ControlConnection::ControlConnection(Control &_control, int _fd)
+  : control(_control),
+    fd(_fd),
+    pWatch(NULL),
+    dropped(FALSE),
+    pQuery(NULL)
+{
+}
+
+ControlConnection::~ControlConnection()
+{
+  // the answer will be dropped
+  if (pQuery)
+    pQuery->pConn = NULL;
+
+  if (pWatch)
+    control.reactor.WatchDelete(pWatch);
+
+  close(fd);
+}
+
+BOOL ControlConnection::Start()
+{
+  pWatch = control.reactor.WatchCreate(fd, OnEvents, (HWATCHPARAM)this);
+
+  if (!pWatch)
+    return FALSE;
+
+  return control.reactor.WatchSet(pWatch, WATCH_EVENT_READ);
+}
+
+void CALLBACK ControlConnection::OnEvents(HWATCHPARAM hWatchParam, DWORD events)
+{
+  ControlConnection *pConn = (ControlConnection *)hWatchParam;
+
+  if (pConn->dropped) {
+    delete pConn;
+    return;
+  }
+
+  if (events & WATCH_EVENT_WRITE)
+    pConn->Flush();
+
+  if (!(events & ~WATCH_EVENT_WRITE))
+    return;
+
+  char chunk[CONTROL_BUF_SIZE];
+
+  ssize_t done = recv(pConn->fd, chunk, sizeof(chunk), 0);
+
+  if (done < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+
+  if (done <= 0) {
+    // the not committed change is dropped
+    delete pConn;
+    return;
+  }
+
+  pConn->buf.append(chunk, (size_t)done);
+  pConn->OnLines();
+
+  // too long line or too many lines waiting for the answer
+  if (!pConn->dropped && pConn->buf.size() > CONTROL_IN_MAX)
+    pConn->Drop("too much input");
+}
+
+void ControlConnection::OnLines()
+{
+  string::size_type eol;
+
+  while (!dropped && !pQuery && (eol = buf.find('\n')) != buf.npos) {
+    string line(buf, 0, eol);
+    string answer;
+
+    buf.erase(0, eol + 1);
+
+    if (control.OnLine(options, line, answer)) {
+      Send(answer);
+      continue;
+    }
+
+    pQuery = new ControlQuery(this);
+
+    if (!pQuery) {
+      cerr << "No enough memory." << endl;
+      exit(2);
+    }
+
+    // can be answered at once
+    control.Query(pQuery);
+  }
+}
+
+void ControlConnection::OnAnswer(const string &answer)
+{
+  pQuery = NULL;
+
+  Send(answer);
+  OnLines();
+}
+
+void ControlConnection::Send(const string &answer)
+{
+  if (answer.empty() || dropped)
+    return;
+
+  // the client does not read the answers
+  if (out.size() > CONTROL_OUT_MAX) {
+    Drop("too much output");
+    return;
+  }
+
+  BOOL idle = out.empty();
+
+  out += answer;
+  out += "\n";
+
+  if (idle)
+    Flush();
+}
+
+void ControlConnection::Flush()
+{
+  while (!out.empty()) {
+    ssize_t done = send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+
+    if (done < 0) {
+      if (errno == EINTR)
+        continue;
+
+      // the disconnection is detected by reading
+      if (errno != EAGAIN)
+        out.clear();
+
+      break;
+    }
+
+    out.erase(0, (size_t)done);
+  }
+
+  // the loop is not blocked by a slow client
+  control.reactor.WatchSet(pWatch, out.empty() ? WATCH_EVENT_READ : WATCH_EVENT_READ|WATCH_EVENT_WRITE);
+}
+
+void ControlConnection::Drop(const char *pReason)
+{
+  cerr << "Control client dropped - " << pReason << endl;
+
+  // it can be called by the answer to the query started by OnLines()
+  // so it's deleted later by the reading of the shut down socket
+  dropped = TRUE;
+  buf.clear();
+  out.clear();
+  options.clear();
+
+  shutdown(fd, SHUT_RDWR);
+  control.reactor.WatchSet(pWatch, WATCH_EVENT_READ);
+}
+///////////////////////////////////////////////////////////////
+void Control::Answer(ControlQuery *pQuery, const string &answer)
+{
+  _ASSERTE(pQuery != NULL);
+
+  if (pQuery->pConn)
+    pQuery->pConn->OnAnswer(answer);
+
+  delete pQuery;
+}
+///////////////////////////////////////////////////////////////
+Control::~Control()
+{
+  if (pWatch)
+    reactor.WatchDelete(pWatch);
+
+  if (fd >= 0) {
+    close(fd);
+    unlink(path.c_str());
+  }
+}
+
+BOOL Control::Open(const char *pPath)
+{
+  _ASSERTE(pPath != NULL);
+
+  path = pPath;
+
+  struct sockaddr_un addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof(addr.sun_path)) {
+    cerr << "Too long control path " << path << endl;
+    return FALSE;
+  }
+
+  strcpy(addr.sun_path, pPath);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0) {
+    DWORD err = GetLastError();
+
+    cerr << "socket() - error=" << err << endl;
+    return FALSE;
+  }
+
+  // remove the socket left by the previous run (but not a file)
+  struct stat st;
+
+  if (lstat(pPath, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      cerr << "Can't use control path " << path << " - it exists and it's not a socket" << endl;
+      close(fd);
+      fd = -1;
+      return FALSE;
+    }
+
+    unlink(pPath);
+  }
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+    DWORD err = GetLastError();
+
+    cerr << "Can't listen control socket " << path << " - error=" << err << endl;
+    close(fd);
+    fd = -1;
+    return FALSE;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  pWatch = reactor.WatchCreate(fd, OnListen, (HWATCHPARAM)this);
+
+  if (!pWatch || !reactor.WatchSet(pWatch, WATCH_EVENT_READ))
+    return FALSE;
+
+  cout << "Control " << path << endl;
+
+  return TRUE;
+}
+
+void CALLBACK Control::OnListen(HWATCHPARAM hWatchParam, DWORD /*events*/)
+{
+  Control *pControl = (Control *)hWatchParam;
+
+  for (;;) {
+    int connFd = accept(pControl->fd, NULL, NULL);
+
+    if (connFd < 0)
+      return;
+
+    fcntl(connFd, F_SETFL, fcntl(connFd, F_GETFL) | O_NONBLOCK);
+
+    ControlConnection *pConn = new ControlConnection(*pControl, connFd);
+
+    if (!pConn) {
+      cerr << "No enough memory." << endl;
+      exit(2);
+    }
+
+    if (!pConn->Start())
+      delete pConn;
+  }
+}
+///////////////////////////////////////////////////////////////
+#endif  /* _WIN32 */
+///////////////////////////////////////////////////////////////
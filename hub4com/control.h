@@ -0,0 +1,104 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _CONTROL_H
+#define _CONTROL_H
+
+///////////////////////////////////////////////////////////////
+//
+// The local control channel (see --control option) is a UNIX
+// domain socket (a named pipe on Windows) accepting the lines
+//
+//   <option>   - add the route or filter option to the change
+//   commit     - apply the change at once
+//   abort      - drop the change
+//   stats      - get the statistics snapshot
+//
+// The empty lines and the lines begining with '#' are ignored.
+// The commit and abort lines are answered by OK or FAILED line
+// (see the hub's log for the reason). The change is applied by
+// the loop of the main thread between the messages. The stats
+// line is answered by one line JSON object (see StatsSnapshot)
+// as soon as the threads handling the ports fill the snapshot,
+// the following lines of the client wait for it.
+//
+///////////////////////////////////////////////////////////////
+class Reactor;
+class ControlQuery;
+///////////////////////////////////////////////////////////////
+typedef BOOL ControlProc(void *pParam, const vector<string> &options);
+typedef void ControlStatsProc(void *pParam, ControlQuery *pQuery);
+///////////////////////////////////////////////////////////////
+class Control
+{
+  public:
+    Control(
+        Reactor &_reactor,
+        ControlProc *_pProc,
+        ControlStatsProc *_pStatsProc,
+        void *_pParam);
+    ~Control();
+
+    BOOL Open(const char *pPath);
+
+    // returns FALSE if the line is a query (the answer will be passed
+    // to Answer()), otherwise the answer is an answer line or empty
+    BOOL OnLine(vector<string> &options, const string &line, string &answer);
+    void Query(ControlQuery *pQuery);
+
+    // should be called by the loop of the main thread, pQuery is freed
+    static void Answer(ControlQuery *pQuery, const string &answer);
+
+  public:
+    Reactor &reactor;
+
+  private:
+    ControlProc *pProc;
+    ControlStatsProc *pStatsProc;
+    void *pParam;
+    string path;
+
+#ifdef _WIN32
+    static unsigned __stdcall ThreadProc(void *pArg);
+    static void OnLineProc(void *pArg);
+
+    void Run();
+    void OnAnswer(const string &_answer);
+
+    HANDLE hPipe;
+    HANDLE hDone;
+
+    // passed to the main thread
+    vector<string> options;
+    string line;
+    string answer;
+#else
+    static void CALLBACK OnListen(HWATCHPARAM hWatchParam, DWORD events);
+
+    int fd;
+    ReactorWatch *pWatch;
+#endif
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _CONTROL_H
@@ -67,12 +67,16 @@
 #include "plugins/plugins_api.h"
 
 #include "export.h"
+#include "stats.h"
 #include "port.h"
+#include "reactor.h"
 #include "comhub.h"
+#include "pool.h"
 #include "bufutils.h"
 #include "hubmsg.h"
 #include "filter.h"
 #include "timer.h"
+#include "capture.h"
 #include "utils.h"
 
 ///////////////////////////////////////////////////////////////
@@ -91,6 +95,11 @@ static VOID CALLBACK buf_append(BYTE **ppBuf, DWORD offset, const BYTE *pSrc, DW
   BufAppend(ppBuf, offset, pSrc, sizeSrc);
 }
 ///////////////////////////////////////////////////////////////
+static BOOL CALLBACK buf_unshare(BYTE **ppBuf, DWORD size)
+{
+  return BufUnshare(ppBuf, size);
+}
+///////////////////////////////////////////////////////////////
 static BOOL CALLBACK msg_replace_buf(HUB_MSG *pMsg, DWORD type, const BYTE *pSrc, DWORD sizeSrc)
 {
   _ASSERTE((type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_BUF);
@@ -114,11 +123,43 @@ static BOOL CALLBACK msg_replace_buf(HUB_MSG *pMsg, DWORD type, const BYTE *pSrc
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
+static BYTE *CALLBACK msg_buf_reserve(HUB_MSG *pMsg, DWORD sizeMax)
+{
+  _ASSERTE(pMsg != NULL);
+  _ASSERTE((pMsg->type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_BUF);
+  _ASSERTE(sizeMax != 0);
+
+  // the transformed data is not longer so it can be written in place
+  if (sizeMax <= pMsg->u.buf.size) {
+    if (!BufUnshare(&pMsg->u.buf.pBuf, pMsg->u.buf.size))
+      return NULL;
+
+    return pMsg->u.buf.pBuf;
+  }
+
+  return BufAlloc(sizeMax);
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK msg_buf_commit(HUB_MSG *pMsg, BYTE *pBuf, DWORD size)
+{
+  _ASSERTE(pMsg != NULL);
+  _ASSERTE((pMsg->type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_BUF);
+  _ASSERTE(pBuf != NULL);
+  _ASSERTE(size <= BUF_HDR_SIZE(pBuf));
+
+  if (pBuf != pMsg->u.buf.pBuf) {
+    BufFree(pMsg->u.buf.pBuf);
+    pMsg->u.buf.pBuf = pBuf;
+  }
+
+  pMsg->u.buf.size = size;
+}
+///////////////////////////////////////////////////////////////
 static HUB_MSG *CALLBACK msg_insert_buf(HUB_MSG *pPrevMsg, DWORD type, const BYTE *pSrc, DWORD sizeSrc)
 {
   _ASSERTE((type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_BUF);
 
-  if (pPrevMsg && pPrevMsg->type == type) {
+  if (pPrevMsg && pPrevMsg->type == type && !((HubMsg *)pPrevMsg)->urgent) {
     BufAppend(&pPrevMsg->u.buf.pBuf, pPrevMsg->u.buf.size, pSrc, sizeSrc);
     pPrevMsg->u.buf.size += sizeSrc;
     return pPrevMsg;
@@ -149,6 +190,34 @@ static HUB_MSG *CALLBACK msg_insert_buf(HUB_MSG *pPrevMsg, DWORD type, const BYT
   return pMsg;
 }
 ///////////////////////////////////////////////////////////////
+static HUB_MSG *CALLBACK msg_insert_urgent(HUB_MSG *pPrevMsg, const BYTE *pSrc, DWORD sizeSrc)
+{
+  if (pPrevMsg && pPrevMsg->type == HUB_MSG_TYPE_LINE_DATA && ((HubMsg *)pPrevMsg)->urgent) {
+    BufAppend(&pPrevMsg->u.buf.pBuf, pPrevMsg->u.buf.size, pSrc, sizeSrc);
+    pPrevMsg->u.buf.size += sizeSrc;
+    return pPrevMsg;
+  }
+
+  HubMsg *pMsg = (HubMsg *)msg_insert_buf(NULL, HUB_MSG_TYPE_LINE_DATA, pSrc, sizeSrc);
+
+  if (!pMsg)
+    return NULL;
+
+  pMsg->urgent = TRUE;
+
+  if (pPrevMsg)
+    pMsg->Insert((HubMsg *)pPrevMsg);
+
+  return pMsg;
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK msg_is_urgent(const HUB_MSG *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+
+  return pMsg->type == HUB_MSG_TYPE_LINE_DATA && ((const HubMsg *)pMsg)->urgent;
+}
+///////////////////////////////////////////////////////////////
 static BOOL CALLBACK msg_replace_val(HUB_MSG *pMsg, DWORD type, DWORD val)
 {
   _ASSERTE((type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_VAL);
@@ -238,11 +307,19 @@ static void CALLBACK on_read(HMASTERPORT hMasterPort, HUB_MSG *pMsg)
   _ASSERTE(hMasterPort != NULL);
   _ASSERTE(((Port *)hMasterPort)->IsValid());
 
+  Capture *pCapture = ((Port *)hMasterPort)->hub.GetCapture();
+
+  if (pCapture)
+    pCapture->Write(((Port *)hMasterPort)->Num(), pMsg);
+
   HubMsg msg;
 
   *(HUB_MSG *)&msg = *pMsg;
   ::memset(pMsg, 0, sizeof(*pMsg));
 
+  if (latencyStats)
+    msg.time = LatencyNow();
+
   ((Port *)hMasterPort)->hub.OnRead((Port *)hMasterPort, &msg);
 }
 ///////////////////////////////////////////////////////////////
@@ -308,6 +385,84 @@ static const ARG_INFO_A * CALLBACK get_arg_info(const char *pArg)
   return Arg::GetArgInfo(pArg);
 }
 ///////////////////////////////////////////////////////////////
+static HMASTERWATCH CALLBACK watch_create(
+  HMASTERPORT hMasterPort,
+  int fd,
+  WATCH_PROC *pWatchProc,
+  HWATCHPARAM hWatchParam)
+{
+  _ASSERTE(hMasterPort != NULL);
+  _ASSERTE(((Port *)hMasterPort)->IsValid());
+
+  return (HMASTERWATCH)((Port *)hMasterPort)->GetReactor().WatchCreate(fd, pWatchProc, hWatchParam);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK watch_set(HMASTERWATCH hMasterWatch, DWORD events)
+{
+  _ASSERTE(hMasterWatch != NULL);
+
+  return ((ReactorWatch *)hMasterWatch)->reactor.WatchSet((ReactorWatch *)hMasterWatch, events);
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK watch_delete(HMASTERWATCH hMasterWatch)
+{
+  _ASSERTE(hMasterWatch != NULL);
+
+  ((ReactorWatch *)hMasterWatch)->reactor.WatchDelete((ReactorWatch *)hMasterWatch);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK defer(
+  HMASTERPORT hMasterPort,
+  DEFER_PROC *pDeferProc,
+  HDEFERPARAM hDeferParam)
+{
+  _ASSERTE(hMasterPort != NULL);
+  _ASSERTE(((Port *)hMasterPort)->IsValid());
+
+  return ((Port *)hMasterPort)->GetReactor().Defer(pDeferProc, hDeferParam);
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK join_ports(
+  HMASTERPORT hMasterPort1,
+  HMASTERPORT hMasterPort2)
+{
+  _ASSERTE(hMasterPort1 != NULL);
+  _ASSERTE(((Port *)hMasterPort1)->IsValid());
+  _ASSERTE(hMasterPort2 != NULL);
+  _ASSERTE(((Port *)hMasterPort2)->IsValid());
+
+  ((Port *)hMasterPort1)->hub.JoinPorts((Port *)hMasterPort1, (Port *)hMasterPort2);
+}
+///////////////////////////////////////////////////////////////
+static ULONGLONG CALLBACK latency_now()
+{
+  return latencyStats ? LatencyNow() : 0;
+}
+
+static void CALLBACK add_queue_latency(
+  HMASTERPORT hMasterPort,
+  ULONGLONG start)
+{
+  _ASSERTE(hMasterPort != NULL);
+  _ASSERTE(((Port *)hMasterPort)->IsValid());
+
+  ((Port *)hMasterPort)->AddQueueLatency(start);
+}
+
+static DWORD CALLBACK get_read_credit(
+  HMASTERPORT hMasterPort)
+{
+  _ASSERTE(hMasterPort != NULL);
+  _ASSERTE(((Port *)hMasterPort)->IsValid());
+
+  return ((Port *)hMasterPort)->hub.GetReadCredit((Port *)hMasterPort);
+}
+
+static DWORD CALLBACK tick_count()
+{
+  return (DWORD)Reactor::Now();
+}
+///////////////////////////////////////////////////////////////
 HUB_ROUTINES_A hubRoutines = {
   sizeof(HUB_ROUTINES_A),
   buf_alloc,
@@ -329,5 +484,19 @@ HUB_ROUTINES_A hubRoutines = {
   filter_port,
   get_filter,
   get_arg_info,
+  buf_unshare,
+  watch_create,
+  watch_set,
+  watch_delete,
+  defer,
+  join_ports,
+  latency_now,
+  add_queue_latency,
+  get_read_credit,
+  tick_count,
+  msg_buf_reserve,
+  msg_buf_commit,
+  msg_insert_urgent,
+  msg_is_urgent,
 };
 ///////////////////////////////////////////////////////////////
@@ -47,6 +47,8 @@ class Filter
         pCreateInstance(_pCreateInstance),
         pInMethod(_pInMethod),
         pOutMethod(_pOutMethod),
+        inMsgTypes(HUB_MSG_TYPES_ALL),
+        outMsgTypes(HUB_MSG_TYPES_ALL),
         hFilter(NULL)
     {
 #ifdef _DEBUG
@@ -69,6 +71,7 @@ class Filter
   protected:
     friend class Filters;
     friend class FilterInstance;
+    friend class FilterMethod;
 
     const string group;
     const string name;
@@ -76,6 +79,9 @@ class Filter
     FILTER_IN_METHOD *const pInMethod;
     FILTER_OUT_METHOD *const pOutMethod;
 
+    DWORD inMsgTypes;
+    DWORD outMsgTypes;
+
     HFILTER hFilter;
 
 #ifdef _DEBUG
@@ -129,10 +135,12 @@ class FilterInstance {
 
   protected:
     friend class Filters;
+    friend class FilterMethod;
 
-    FILTER_IN_METHOD *const pInMethod;
-    FILTER_OUT_METHOD *const pOutMethod;
-    const set<Port *> *const pSrcPorts;
+    // can be changed by Filters::EndUpdate()
+    FILTER_IN_METHOD *pInMethod;
+    FILTER_OUT_METHOD *pOutMethod;
+    const set<Port *> *pSrcPorts;
 
     HFILTERINSTANCE hFilterInstance;
 
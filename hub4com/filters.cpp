@@ -51,10 +51,13 @@
 #include "precomp.h"
 #include "plugins/plugins_api.h"
 
+#include "stats.h"
 #include "port.h"
+#include "reactor.h"
 #include "comhub.h"
 #include "filters.h"
 #include "filter.h"
+#include "pool.h"
 #include "bufutils.h"
 #include "hubmsg.h"
 #include "utils.h"
@@ -62,6 +65,30 @@
 ///////////////////////////////////////////////////////////////
 typedef pair<Port *, FilterInstanceArray*> PortFilters;
 ///////////////////////////////////////////////////////////////
+FilterMethod::FilterMethod(const FilterInstance &filterInstance, BOOL withIn, BOOL withOut)
+  : pInMethod(withIn ? filterInstance.pInMethod : NULL),
+    pOutMethod(withOut ? filterInstance.pOutMethod : NULL),
+    inMsgTypes(pInMethod ? filterInstance.filter.inMsgTypes : 0),
+    outMsgTypes(pOutMethod ? filterInstance.filter.outMsgTypes : 0),
+    hFilter(filterInstance.filter.hFilter),
+    hFilterInstance(filterInstance.hFilterInstance)
+{
+  if (!filterInstance.pSrcPorts)
+    return;
+
+  for (set<Port *>::const_iterator i = filterInstance.pSrcPorts->begin() ;
+       i != filterInstance.pSrcPorts->end() ;
+       i++)
+  {
+    unsigned num = (unsigned)(*i)->Num();
+
+    if (num/32 >= srcPorts.size())
+      srcPorts.resize(num/32 + 1, 0);
+
+    srcPorts[num/32] |= (DWORD)1 << (num%32);
+  }
+}
+///////////////////////////////////////////////////////////////
 Filters::~Filters()
 {
   for (PortFiltersMap::const_iterator iPort = portFilters.begin() ; iPort != portFilters.end() ; iPort++) {
@@ -74,6 +101,9 @@ Filters::~Filters()
     }
   }
 
+  for (FilterInstanceArray::const_iterator i = spareInstances.begin() ; i != spareInstances.end() ; i++)
+    delete *i;
+
   for (FilterArray::const_iterator i = allFilters.begin() ; i != allFilters.end() ; i++) {
     if (*i)
       delete *i;
@@ -118,11 +148,63 @@ BOOL Filters::CreateFilter(
     pFilter->hFilter = hFilter;
   }
 
+  if (ROUTINE_IS_VALID(pFltRoutines, pGetInMsgTypes))
+    pFilter->inMsgTypes = pFltRoutines->pGetInMsgTypes(pFilter->hFilter);
+
+  if (ROUTINE_IS_VALID(pFltRoutines, pGetOutMsgTypes))
+    pFilter->outMsgTypes = pFltRoutines->pGetOutMsgTypes(pFilter->hFilter);
+
   allFilters.push_back(pFilter);
 
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
+FilterInstance *Filters::CreateInstance(
+    Filter &filter,
+    Port &port,
+    BOOL addInMethod,
+    BOOL addOutMethod,
+    const set<Port *> *pOutMethodSrcPorts) const
+{
+  const set<Port *> *pSrcPorts;
+
+  if (pOutMethodSrcPorts) {
+    pSrcPorts = new set<Port *>(*pOutMethodSrcPorts);
+
+    if (!pSrcPorts) {
+      cerr << "No enough memory." << endl;
+      return NULL;
+    }
+  } else {
+    pSrcPorts = NULL;
+  }
+
+  FilterInstance *pFilterInstance = new FilterInstance(filter, port, addInMethod, addOutMethod, pSrcPorts);
+
+  if (!pFilterInstance) {
+    cerr << "No enough memory." << endl;
+
+    if (pSrcPorts)
+      delete pSrcPorts;
+
+    return NULL;
+  }
+
+  if (filter.pCreateInstance) {
+    HFILTERINSTANCE hFilterInstance = filter.pCreateInstance((HMASTERFILTERINSTANCE)pFilterInstance);
+
+    if (!hFilterInstance) {
+      cerr << "Can't create instance of filter " << filter.name << " for port " << port.Name() << endl;
+      delete pFilterInstance;
+      return NULL;
+    }
+
+    pFilterInstance->hFilterInstance = hFilterInstance;
+  }
+
+  return pFilterInstance;
+}
+///////////////////////////////////////////////////////////////
 BOOL Filters::AddFilter(
     Port *pPort,
     const char *pGroup,
@@ -133,6 +215,55 @@ BOOL Filters::AddFilter(
   _ASSERTE(pPort != NULL);
   _ASSERTE(pGroup != NULL);
 
+  if (updating) {
+    PendingFilterInstanceArray &pending = updates[pPort];
+    BOOL found = FALSE;
+
+    for (FilterArray::const_iterator i = allFilters.begin() ; i != allFilters.end() ; i++) {
+      if (*i && (*i)->group == pGroup) {
+        if ((addInMethod && (*i)->pInMethod) || (addOutMethod && (*i)->pOutMethod)) {
+          const set<Port *> *pSrcPorts = NULL;
+
+          if (pOutMethodSrcPorts) {
+            pSrcPorts = new set<Port *>(*pOutMethodSrcPorts);
+
+            if (!pSrcPorts) {
+              cerr << "No enough memory." << endl;
+              return FALSE;
+            }
+          }
+
+          BOOL created = FALSE;
+          FilterInstance *pFilterInstance = FindSpareInstance(*(*i), pPort, pending);
+
+          if (!pFilterInstance) {
+            pFilterInstance = CreateInstance(*(*i), *pPort, FALSE, FALSE, NULL);
+
+            if (!pFilterInstance) {
+              if (pSrcPorts)
+                delete pSrcPorts;
+
+              return FALSE;
+            }
+
+            created = TRUE;
+          }
+
+          pending.push_back(PendingFilterInstance(pFilterInstance, created, addInMethod, addOutMethod, pSrcPorts));
+        }
+
+        found = TRUE;
+      }
+    }
+
+    if (!found) {
+      cerr << "Can't find any filter for group " << pGroup << endl;
+      return FALSE;
+    }
+
+    return TRUE;
+  }
+
   PortFiltersMap::iterator iPair = portFilters.find(pPort);
 
   if (iPair == portFilters.end()) {
@@ -160,55 +291,162 @@ BOOL Filters::AddFilter(
   for (FilterArray::const_iterator i = allFilters.begin() ; i != allFilters.end() ; i++) {
     if (*i && (*i)->group == pGroup) {
       if ((addInMethod && (*i)->pInMethod) || (addOutMethod && (*i)->pOutMethod)) {
-        const set<Port *> *pSrcPorts;
+        FilterInstance *pFilterInstance = CreateInstance(*(*i), *pPort, addInMethod, addOutMethod, pOutMethodSrcPorts);
 
-        if (pOutMethodSrcPorts) {
-          pSrcPorts = new set<Port *>(*pOutMethodSrcPorts);
+        if (!pFilterInstance)
+          return FALSE;
 
-          if (!pSrcPorts) {
-            cerr << "No enough memory." << endl;
-            return FALSE;
-          }
-        } else {
-          pSrcPorts = NULL;
-        }
+        iPair->second->push_back(pFilterInstance);
+        AddToPipeline(pipelines, *pPort, *pFilterInstance);
+      }
 
-        FilterInstance *pFilterInstance = new FilterInstance(*(*i), *pPort, addInMethod, addOutMethod, pSrcPorts);
+      found = TRUE;
+    }
+  }
 
-        if (!pFilterInstance) {
-          cerr << "No enough memory." << endl;
+  if (!found) {
+    cerr << "Can't find any filter for group " << pGroup << endl;
+    return FALSE;
+  }
 
-          if (pSrcPorts)
-            delete pSrcPorts;
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static BOOL IsPending(const PendingFilterInstanceArray &pending, const FilterInstance *pFilterInstance)
+{
+  for (PendingFilterInstanceArray::const_iterator i = pending.begin() ; i != pending.end() ; i++) {
+    if (i->pInstance == pFilterInstance)
+      return TRUE;
+  }
 
-          return FALSE;
-        }
+  return FALSE;
+}
 
-        if ((*i)->pCreateInstance) {
-          HFILTERINSTANCE hFilterInstance = (*i)->pCreateInstance((HMASTERFILTERINSTANCE)pFilterInstance);
+FilterInstance *Filters::FindSpareInstance(
+    const Filter &filter,
+    Port *pPort,
+    const PendingFilterInstanceArray &pending) const
+{
+  // the attached instances first in adding order
 
-          if (!hFilterInstance) {
-            cerr << "Can't create instance of filter " << (*i)->name << " for port " << pPort->Name() << endl;
-            delete pFilterInstance;
-            return FALSE;
-          }
+  PortFiltersMap::const_iterator iPair = portFilters.find(pPort);
 
-          pFilterInstance->hFilterInstance = hFilterInstance;
-        }
+  if (iPair != portFilters.end() && iPair->second) {
+    for (FilterInstanceArray::const_iterator i = iPair->second->begin() ; i != iPair->second->end() ; i++) {
+      if (&(*i)->filter == &filter && !IsPending(pending, *i))
+        return *i;
+    }
+  }
 
-        iPair->second->push_back(pFilterInstance);
+  for (FilterInstanceArray::const_iterator i = spareInstances.begin() ; i != spareInstances.end() ; i++) {
+    if (&(*i)->filter == &filter && &(*i)->port == pPort && !IsPending(pending, *i))
+      return *i;
+  }
+
+  return NULL;
+}
+///////////////////////////////////////////////////////////////
+static void ReleasePending(PendingFilterInstanceArray &pending, FilterInstanceArray &spareInstances)
+{
+  for (PendingFilterInstanceArray::const_iterator i = pending.begin() ; i != pending.end() ; i++) {
+    if (i->created)
+      spareInstances.push_back(i->pInstance);
+
+    if (i->pSrcPorts)
+      delete i->pSrcPorts;
+  }
+
+  pending.clear();
+}
+
+void Filters::BeginUpdate()
+{
+  _ASSERTE(!updating);
+  _ASSERTE(updates.empty());
+
+  updating = TRUE;
+}
+
+void Filters::ClearFilters(Port *pPort)
+{
+  _ASSERTE(updating);
+  _ASSERTE(pPort != NULL);
+
+  ReleasePending(updates[pPort], spareInstances);
+}
+
+void Filters::EndUpdate(BOOL commit)
+{
+  _ASSERTE(updating);
+
+  updating = FALSE;
+
+  if (!commit) {
+    for (PendingPortFiltersMap::iterator iPort = updates.begin() ; iPort != updates.end() ; iPort++)
+      ReleasePending(iPort->second, spareInstances);
+
+    updates.clear();
+    return;
+  }
+
+  for (PendingPortFiltersMap::iterator iPort = updates.begin() ; iPort != updates.end() ; iPort++) {
+    FilterInstanceArray *&pFilters = portFilters[iPort->first];
+
+    if (!pFilters) {
+      pFilters = new FilterInstanceArray;
+
+      if (!pFilters) {
+        cerr << "No enough memory." << endl;
+        exit(2);
       }
+    }
 
-      found = TRUE;
+    const PendingFilterInstanceArray &pending = iPort->second;
+
+    // detach the not reused instances
+
+    for (FilterInstanceArray::const_iterator i = pFilters->begin() ; i != pFilters->end() ; i++) {
+      if (!IsPending(pending, *i))
+        spareInstances.push_back(*i);
+    }
+
+    pFilters->clear();
+
+    for (PendingFilterInstanceArray::const_iterator i = pending.begin() ; i != pending.end() ; i++) {
+      FilterInstance *pFilterInstance = i->pInstance;
+
+      FilterInstanceArray::iterator iSpare = find(spareInstances.begin(), spareInstances.end(), pFilterInstance);
+
+      if (iSpare != spareInstances.end())
+        spareInstances.erase(iSpare);
+
+      pFilterInstance->pInMethod = i->addInMethod ? pFilterInstance->filter.pInMethod : NULL;
+      pFilterInstance->pOutMethod = i->addOutMethod ? pFilterInstance->filter.pOutMethod : NULL;
+
+      if (pFilterInstance->pSrcPorts)
+        delete pFilterInstance->pSrcPorts;
+
+      pFilterInstance->pSrcPorts = i->pSrcPorts;
+
+      pFilters->push_back(pFilterInstance);
     }
   }
 
-  if (!found) {
-    cerr << "Can't find any filter for group " << pGroup << endl;
-    return FALSE;
+  updates.clear();
+
+  // swap in the new pipelines
+
+  FilterPipelines newPipelines;
+
+  for (PortFiltersMap::const_iterator iPort = portFilters.begin() ; iPort != portFilters.end() ; iPort++) {
+    if (!iPort->second)
+      continue;
+
+    for (FilterInstanceArray::const_iterator i = iPort->second->begin() ; i != iPort->second->end() ; i++)
+      AddToPipeline(newPipelines, *iPort->first, *(*i));
   }
 
-  return TRUE;
+  pipelines.swap(newPipelines);
 }
 ///////////////////////////////////////////////////////////////
 void Filters::Report() const
@@ -311,142 +549,237 @@ void Filters::Report() const
   }
 }
 ///////////////////////////////////////////////////////////////
+void Filters::AddToPipeline(
+    FilterPipelines &pipelines,
+    const Port &port,
+    const FilterInstance &filterInstance)
+{
+  _ASSERTE(port.Num() >= 0);
+
+  if ((unsigned)port.Num() >= pipelines.size())
+    pipelines.resize(port.Num() + 1);
+
+  FilterPipeline &pipeline = pipelines[port.Num()];
+
+  const FilterMethod method(filterInstance, TRUE, TRUE);
+
+  pipeline.inChain.push_back(method);
+  pipeline.inMsgTypes |= method.inMsgTypes;
+
+  if (method.pOutMethod) {
+    pipeline.outChain.insert(pipeline.outChain.begin(), FilterMethod(filterInstance, FALSE, TRUE));
+    pipeline.outMsgTypes |= method.outMsgTypes;
+  }
+}
+///////////////////////////////////////////////////////////////
+static BOOL IsAnyMsgType(DWORD msgTypes, HubMsg *pMsg)
+{
+  for ( ; pMsg ; pMsg = pMsg->Next()) {
+    if (IsMsgType(msgTypes, pMsg->type))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+///////////////////////////////////////////////////////////////
+//
+// The IN methods are called in adding order. The echo messages
+// produced by IN method of a filter are handled by OUT methods
+// of all preceding filters in reverse order and are placed
+// before the echo messages produced by the following filters.
+//
+///////////////////////////////////////////////////////////////
+#define ECHO_PARTS_MAX 16
+
 BOOL Filters::InMethod(
     Port *pFromPort,
-    const FilterInstanceArray::const_iterator &i,
-    const FilterInstanceArray::const_iterator &iEnd,
     HubMsg *pInMsg,
-    HubMsg **ppEchoMsg)
+    HubMsg **ppEchoMsg) const
 {
   _ASSERTE(*ppEchoMsg == NULL);
 
-  HubMsg *pEchoMsg = NULL;
-  HFILTER hFilter = (*i)->filter.hFilter;
-  HFILTERINSTANCE hFilterInstance = (*i)->hFilterInstance;
+  if ((unsigned)pFromPort->Num() >= pipelines.size())
+    return TRUE;
 
-  if ((*i)->pInMethod) {
-    FILTER_IN_METHOD *pInMethod = (*i)->pInMethod;
-    HubMsg *pNextMsg = pInMsg;
+  const FilterPipeline &pipeline = pipelines[pFromPort->Num()];
 
-    for (HubMsg *pCurMsg = pNextMsg ; pCurMsg ; pCurMsg = pNextMsg) {
-      pNextMsg = pNextMsg->Next();
+  // no echo messages w/o handling by IN methods
+  if (!IsAnyMsgType(pipeline.inMsgTypes, pInMsg))
+    return TRUE;
 
-      HUB_MSG *pEchoMsgPart = NULL;
+  const FilterMethodArray &chain = pipeline.inChain;
+  FilterMethodArray::size_type num = chain.size();
 
-      if (!pInMethod(hFilter, hFilterInstance, pCurMsg, &pEchoMsgPart)) {
-        if (pEchoMsgPart)
-          delete (HubMsg *)pEchoMsgPart;
+  HubMsg *echoParts[ECHO_PARTS_MAX];
+  vector<HubMsg *> echoPartsVector;
+  HubMsg **pEchoParts = echoParts;
 
-        if (pEchoMsg)
-          delete pEchoMsg;
+  if (num > ECHO_PARTS_MAX) {
+    echoPartsVector.resize(num);
+    pEchoParts = &echoPartsVector[0];
+  }
 
-        return FALSE;
-      }
+  FilterMethodArray::size_type i;
+
+  for (i = 0 ; i < num ; i++) {
+    const FilterMethod &method = chain[i];
+    HubMsg *pEchoMsg = NULL;
+
+    if (method.pInMethod) {
+      HubMsg *pNextMsg = pInMsg;
+
+      for (HubMsg *pCurMsg = pNextMsg ; pCurMsg ; pCurMsg = pNextMsg) {
+        pNextMsg = pNextMsg->Next();
+
+        if (!IsMsgType(method.inMsgTypes, pCurMsg->type))
+          continue;
+
+        HUB_MSG *pEchoMsgPart = NULL;
+
+        if (!method.pInMethod(method.hFilter, method.hFilterInstance, pCurMsg, &pEchoMsgPart)) {
+          if (pEchoMsgPart)
+            delete (HubMsg *)pEchoMsgPart;
+
+          if (pEchoMsg)
+            delete pEchoMsg;
+
+          while (i--) {
+            if (pEchoParts[i])
+              delete pEchoParts[i];
+          }
 
-      if (pEchoMsgPart) {
-        if (pEchoMsg) {
-          pEchoMsg->Merge((HubMsg *)pEchoMsgPart);
-        } else {
-          pEchoMsg = (HubMsg *)pEchoMsgPart;
+          return FALSE;
+        }
+
+        if (pEchoMsgPart) {
+          if (pEchoMsg) {
+            pEchoMsg->Merge((HubMsg *)pEchoMsgPart);
+          } else {
+            pEchoMsg = (HubMsg *)pEchoMsgPart;
+          }
         }
       }
     }
+
+    pEchoParts[i] = pEchoMsg;
   }
 
-  const FilterInstanceArray::const_iterator iNext = i + 1;
+  while (i--) {
+    const FilterMethod &method = chain[i];
 
-  if (iNext != iEnd) {
-    if (!InMethod(pFromPort, iNext, iEnd, pInMsg, ppEchoMsg))
-      return FALSE;
-  }
+    if (method.pOutMethod) {
+      HubMsg *pNextMsg = *ppEchoMsg;
 
-  if ((*i)->pOutMethod) {
-    FILTER_OUT_METHOD *pOutMethod = (*i)->pOutMethod;
-    HubMsg *pNextMsg = *ppEchoMsg;
+      for (HubMsg *pCurMsg = pNextMsg ; pCurMsg ; pCurMsg = pNextMsg) {
+        pNextMsg = pNextMsg->Next();
 
-    for (HubMsg *pCurMsg = pNextMsg ; pCurMsg ; pCurMsg = pNextMsg) {
-      pNextMsg = pNextMsg->Next();
+        if (!IsMsgType(method.outMsgTypes, pCurMsg->type))
+          continue;
 
-      if (!pOutMethod(hFilter, hFilterInstance, (HMASTERPORT)pFromPort, pCurMsg)) {
-        if (pEchoMsg)
-          delete pEchoMsg;
+        if (!method.pOutMethod(method.hFilter, method.hFilterInstance, (HMASTERPORT)pFromPort, pCurMsg)) {
+          do {
+            if (pEchoParts[i])
+              delete pEchoParts[i];
+          } while (i--);
 
-        return FALSE;
+          return FALSE;
+        }
+
+        // the method can keep a state of the stream
+        pCurMsg->urgent = FALSE;
       }
     }
-  }
 
-  if (pEchoMsg) {
-    if (*ppEchoMsg)
-      pEchoMsg->Merge(*ppEchoMsg);
+    HubMsg *pEchoMsg = pEchoParts[i];
+
+    if (pEchoMsg) {
+      if (*ppEchoMsg)
+        pEchoMsg->Merge(*ppEchoMsg);
 
-    *ppEchoMsg = pEchoMsg;
+      *ppEchoMsg = pEchoMsg;
+    }
   }
 
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
-BOOL Filters::InMethod(
+BOOL Filters::OutMethod(
     Port *pFromPort,
-    HubMsg *pInMsg,
-    HubMsg **ppEchoMsg) const
+    Port *pToPort,
+    HubMsg *pOutMsg) const
 {
-  _ASSERTE(*ppEchoMsg == NULL);
+  if ((unsigned)pToPort->Num() >= pipelines.size())
+    return TRUE;
 
-  PortFiltersMap::const_iterator iPair = portFilters.find(pFromPort);
+  const FilterPipeline &pipeline = pipelines[pToPort->Num()];
 
-  if (iPair == portFilters.end())
+  if (!IsAnyMsgType(pipeline.outMsgTypes, pOutMsg))
     return TRUE;
 
-  FilterInstanceArray *pFilters = iPair->second;
+  const FilterMethodArray &chain = pipeline.outChain;
+  int fromNum = pFromPort->Num();
 
-  if (!pFilters)
-    return TRUE;
+  for (FilterMethodArray::const_iterator i = chain.begin() ; i != chain.end() ; i++) {
+    if (!i->IsSrcPort(fromNum))
+      continue;
 
-  const FilterInstanceArray::const_iterator i = pFilters->begin();
+    HubMsg *pNextMsg = pOutMsg;
 
-  if (i != pFilters->end()) {
-    if (!InMethod(pFromPort, i, pFilters->end(), pInMsg, ppEchoMsg))
-      return FALSE;
+    for (HubMsg *pCurMsg = pNextMsg ; pCurMsg ; pCurMsg = pNextMsg) {
+      pNextMsg = pNextMsg->Next();
+
+      if (!IsMsgType(i->outMsgTypes, pCurMsg->type))
+        continue;
+
+      if (!i->pOutMethod(i->hFilter, i->hFilterInstance, (HMASTERPORT)pFromPort, pCurMsg))
+        return FALSE;
+
+      // the method can keep a state of the stream (e.g. a cipher), so
+      // the data it passed can't be written ahead of the queued one
+      pCurMsg->urgent = FALSE;
+    }
   }
 
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
-BOOL Filters::OutMethod(
-    Port *pFromPort,
-    Port *pToPort,
-    HubMsg *pOutMsg) const
+void Filters::GetChain(const Port *pPort, vector<string> &chain) const
 {
-  PortFiltersMap::const_iterator iPair = portFilters.find(pToPort);
-
-  if (iPair == portFilters.end())
-    return TRUE;
+  chain.clear();
 
-  FilterInstanceArray *pFilters = iPair->second;
+  PortFiltersMap::const_iterator iPair = portFilters.find((Port *)pPort);
 
-  if (!pFilters)
-    return TRUE;
-
-  for (FilterInstanceArray::const_reverse_iterator i = pFilters->rbegin() ; i != pFilters->rend() ; i++) {
-    if ((*i)->pOutMethod && (!(*i)->pSrcPorts ||
-        (*i)->pSrcPorts->find(pFromPort) != (*i)->pSrcPorts->end()))
-    {
-      FILTER_OUT_METHOD *pOutMethod = (*i)->pOutMethod;
-      HFILTER hFilter = (*i)->filter.hFilter;
-      HFILTERINSTANCE hFilterInstance = (*i)->hFilterInstance;
+  if (iPair == portFilters.end() || !iPair->second)
+    return;
 
-      HubMsg *pNextMsg = pOutMsg;
+  for (FilterInstanceArray::const_iterator i = iPair->second->begin() ; i != iPair->second->end() ; i++) {
+    if ((*i)->pInMethod)
+      chain.push_back((*i)->filter.name + ".IN");
 
-      for (HubMsg *pCurMsg = pNextMsg ; pCurMsg ; pCurMsg = pNextMsg) {
-        pNextMsg = pNextMsg->Next();
+    if ((*i)->pOutMethod)
+      chain.push_back((*i)->filter.name + ".OUT");
+  }
+}
+///////////////////////////////////////////////////////////////
+void Filters::JoinPorts(PortMap &joinMap) const
+{
+  // the ports sharing a filter are joined to the first one
+  map<const Filter *, Port *> firstPorts;
 
-        if (!pOutMethod(hFilter, hFilterInstance, (HMASTERPORT)pFromPort, pCurMsg))
-          return FALSE;
-      }
+  for (PortFiltersMap::const_iterator iPort = portFilters.begin() ; iPort != portFilters.end() ; iPort++) {
+    if (!iPort->second)
+      continue;
+
+    for (FilterInstanceArray::const_iterator i = iPort->second->begin() ; i != iPort->second->end() ; i++) {
+      const Filter *pFilter = &(*i)->filter;
+      map<const Filter *, Port *>::const_iterator iFirst = firstPorts.find(pFilter);
+
+      if (iFirst == firstPorts.end())
+        firstPorts[pFilter] = iPort->first;
+      else
+      if (iFirst->second != iPort->first)
+        joinMap.insert(pair<Port *, Port *>(iFirst->second, iPort->first));
     }
   }
-
-  return TRUE;
 }
 ///////////////////////////////////////////////////////////////
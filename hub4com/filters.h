@@ -55,10 +55,78 @@ typedef vector<Filter*> FilterArray;
 typedef vector<FilterInstance*> FilterInstanceArray;
 typedef map<Port *, FilterInstanceArray*> PortFiltersMap;
 ///////////////////////////////////////////////////////////////
+inline BOOL IsMsgType(DWORD msgTypes, DWORD type)
+{
+  return HUB_MSG_T2N(type) >= 32 || (msgTypes & HUB_MSG_T2M(type)) != 0;
+}
+///////////////////////////////////////////////////////////////
+class FilterMethod
+{
+  public:
+    FilterMethod(const FilterInstance &filterInstance, BOOL withIn, BOOL withOut);
+
+    BOOL IsSrcPort(int num) const {
+      if (srcPorts.empty())
+        return TRUE;
+
+      return (unsigned)num/32 < srcPorts.size() &&
+             (srcPorts[(unsigned)num/32] & ((DWORD)1 << ((unsigned)num%32))) != 0;
+    }
+
+    FILTER_IN_METHOD *pInMethod;
+    FILTER_OUT_METHOD *pOutMethod;
+    DWORD inMsgTypes;
+    DWORD outMsgTypes;
+    HFILTER hFilter;
+    HFILTERINSTANCE hFilterInstance;
+
+    // the bitmask of source port numbers for OUT method (empty for any port)
+    vector<DWORD> srcPorts;
+};
+
+typedef vector<FilterMethod> FilterMethodArray;
+
+struct FilterPipeline
+{
+  FilterPipeline() : inMsgTypes(0), outMsgTypes(0) {}
+
+  FilterMethodArray inChain;    // IN and OUT methods in adding order
+  FilterMethodArray outChain;   // OUT methods in reverse order
+
+  DWORD inMsgTypes;             // message types handled by any IN method
+  DWORD outMsgTypes;            // message types handled by any OUT method
+};
+
+typedef vector<FilterPipeline> FilterPipelines;
+///////////////////////////////////////////////////////////////
+struct PendingFilterInstance
+{
+  PendingFilterInstance(
+      FilterInstance *_pInstance,
+      BOOL _created,
+      BOOL _addInMethod,
+      BOOL _addOutMethod,
+      const set<Port *> *_pSrcPorts)
+    : pInstance(_pInstance),
+      created(_created),
+      addInMethod(_addInMethod),
+      addOutMethod(_addOutMethod),
+      pSrcPorts(_pSrcPorts) {}
+
+  FilterInstance *pInstance;
+  BOOL created;                 // not attached to any port yet
+  BOOL addInMethod;
+  BOOL addOutMethod;
+  const set<Port *> *pSrcPorts;
+};
+
+typedef vector<PendingFilterInstance> PendingFilterInstanceArray;
+typedef map<Port *, PendingFilterInstanceArray> PendingPortFiltersMap;
+///////////////////////////////////////////////////////////////
 class Filters
 {
   public:
-    Filters(const ComHub &_hub) : hub(_hub) {}
+    Filters(const ComHub &_hub) : hub(_hub), updating(FALSE) {}
     ~Filters();
     BOOL CreateFilter(
         const FILTER_ROUTINES_A *pFltRoutines,
@@ -73,6 +141,14 @@ class Filters
         BOOL addOutMethod,
         const set<Port *> *pOutMethodSrcPorts);
     void Report() const;
+
+    // the filters added between BeginUpdate() and EndUpdate() replace
+    // the chains of their ports at once, the instances of the filters
+    // are reused for the same ports to keep their states (see --control)
+    void BeginUpdate();
+    void ClearFilters(Port *pPort);
+    void EndUpdate(BOOL commit);
+
     BOOL InMethod(
         Port *pFromPort,
         HubMsg *pInMsg,
@@ -81,18 +157,40 @@ class Filters
         Port *pFromPort,
         Port *pToPort,
         HubMsg *pOutMsg) const;
+    void JoinPorts(PortMap &joinMap) const;
+
+    // <name>.IN and <name>.OUT of the port's filters in chain order
+    void GetChain(const Port *pPort, vector<string> &chain) const;
 
   private:
-    static BOOL Filters::InMethod(
-        Port *pFromPort,
-        const FilterInstanceArray::const_iterator &i,
-        const FilterInstanceArray::const_iterator &iEnd,
-        HubMsg *pInMsg,
-        HubMsg **ppEchoMsg);
+    FilterInstance *CreateInstance(
+        Filter &filter,
+        Port &port,
+        BOOL addInMethod,
+        BOOL addOutMethod,
+        const set<Port *> *pSrcPorts) const;
+    FilterInstance *FindSpareInstance(
+        const Filter &filter,
+        Port *pPort,
+        const PendingFilterInstanceArray &pending) const;
+    static void AddToPipeline(
+        FilterPipelines &pipelines,
+        const Port &port,
+        const FilterInstance &filterInstance);
 
     const ComHub &hub;
     FilterArray allFilters;
     PortFiltersMap portFilters;
+
+    // the instances detached from their ports (the instances of the
+    // plugins are not deleted so they are kept for reusing)
+    FilterInstanceArray spareInstances;
+
+    BOOL updating;
+    PendingPortFiltersMap updates;
+
+    // the filter methods indexed by port number
+    FilterPipelines pipelines;
 };
 ///////////////////////////////////////////////////////////////
 
@@ -92,12 +92,22 @@
 #include "precomp.h"
 #include "plugins/plugins_api.h"
 
+#include "reactor.h"
+#include "stats.h"
 #include "comhub.h"
 #include "filters.h"
 #include "utils.h"
 #include "plugins.h"
 #include "route.h"
+#include "pool.h"
+#include "port.h"
+#include "capture.h"
+#include "control.h"
 
+///////////////////////////////////////////////////////////////
+static BOOL allocStats = FALSE;
+static BOOL portStats = FALSE;
+static string controlPath;
 ///////////////////////////////////////////////////////////////
 static void Usage(const char *pProgPath, Plugins &plugins)
 {
@@ -117,6 +127,45 @@ static void Usage(const char *pProgPath, Plugins &plugins)
   << "                             if <end> is empty. Ignore arguments begining with" << endl
   << "                             '#'. <file> will replace %%0%% in the arguments." << endl
   << "                             It is possible up to " << Args::RecursiveMax() << " recursive loads." << endl
+  << "  --alloc-stats            - periodically report the memory pools statistics." << endl
+  << "  --stats                  - periodically report the ports and data routes" << endl
+  << "                             statistics (bytes/messages in and out, write" << endl
+  << "                             queue, XOFF/XON sent and lost bytes, the delay" << endl
+  << "                             of the data routes with limited rate)." << endl
+  << "  --latency-stats          - add to the above the latency percentiles of" << endl
+  << "                             the IN and OUT filters, of the write queues of" << endl
+  << "                             the ports and from reading to writing the data." << endl
+  << "  --capture=<file>         - record the messages read from the ports with" << endl
+  << "                             their port numbers and times to the file <file>" << endl
+  << "                             (use the replay driver to replay it)." << endl
+  << "  --threads=<n>            - handle the independent groups of ports by up to" << endl
+  << "                             <n> threads (1 by default). The ports connected" << endl
+  << "                             by routes, sharing a filter or sharing the" << endl
+  << "                             driver's data are handled by the same thread." << endl
+  << "  --control=<path>         - accept the route and filter options (one option" << endl
+  << "                             per line) by the UNIX domain socket or by the" << endl
+  << "                             named pipe (\\\\.\\pipe\\<name>) <path> and apply" << endl
+  << "                             them at once by the line commit. The route" << endl
+  << "                             options replace all routes. The --add-filters" << endl
+  << "                             and --no-filters=<Lst> options replace the" << endl
+  << "                             filters of the listed ports (the filters should" << endl
+  << "                             be created on start). The filters attached to a" << endl
+  << "                             port again keep their states but the new ones" << endl
+  << "                             miss the previous messages (e.g. connect). Not" << endl
+  << "                             supported with more than one thread. The line" << endl
+  << "                             stats is answered by the JSON object with the" << endl
+  << "                             statistics (see --stats and --latency-stats)." << endl
+  << "                             An existing <path> is replaced only if it's a" << endl
+  << "                             socket. The clients sending too long lines or" << endl
+  << "                             not reading the answers are disconnected." << endl
+  << "  --virtual-clock          - simulation mode. Run the timers (the rate of the" << endl
+  << "                             drivers and data routes, the delays of filters," << endl
+  << "                             reconnecting etc.) on the virtual clock. It's" << endl
+  << "                             advanced to the nearest timer as soon as there" << endl
+  << "                             is nothing else to do, so the processing takes" << endl
+  << "                             no time and the latencies are reproducible. While" << endl
+  << "                             the real I/O is waited for (POSIX) the virtual" << endl
+  << "                             clock follows the real one. Implies --threads=1." << endl
   << "  --help                   - show this help." << endl
   << "  --help=*                 - show help for all modules." << endl
   << "  --help=<LstM>            - show help for modules listed in <LstM>." << endl
@@ -125,9 +174,17 @@ static void Usage(const char *pProgPath, Plugins &plugins)
   << "  name." << endl
   << endl
   << "Route options:" << endl
-  << "  --route=<LstR>:<LstL>    - send data received from any port listed in <LstR>" << endl
+  << "  --route=<LstR>:<LstL>[@<rate>]" << endl
+  << "                           - send data received from any port listed in <LstR>" << endl
   << "                             to all ports (except itself) listed in <LstL>." << endl
-  << "  --bi-route=<LstR>:<LstL> - send data received from any port listed in <LstR>" << endl
+  << "                             If <rate> is specified then limit each of these" << endl
+  << "                             routes to <rate> bytes per second (or bits if" << endl
+  << "                             <rate> is <n>bps). The data above the rate is" << endl
+  << "                             delayed and the source port is suspended by" << endl
+  << "                             XOFF/XON if the delayed data is above 2/3 of" << endl
+  << "                             the data for one second." << endl
+  << "  --bi-route=<LstR>:<LstL>[@<rate>]" << endl
+  << "                           - send data received from any port listed in <LstR>" << endl
   << "                             to all ports (except itself) listed in <LstL> and" << endl
   << "                             vice versa." << endl
   << "  --echo-route=<Lst>       - send data received from any port listed in <Lst>" << endl
@@ -142,6 +199,12 @@ static void Usage(const char *pProgPath, Plugins &plugins)
   << "                             (default flow control route enabled from P1 to P2" << endl
   << "                             if enabled data route from P1 to P2 and from P2 to" << endl
   << "                             P1)." << endl
+  << "  --credit-fc              - limit reading of the ports by the free space in" << endl
+  << "                             the write queues of the ports having flow" << endl
+  << "                             control route to them instead of XOFF/XON on the" << endl
+  << "                             queue thresholds (if supported by both ports)." << endl
+  << "                             Disable the flow control route from a slow port" << endl
+  << "                             to drop its data instead of slowing down others." << endl
   << endl
   << "  If no any route option specified, then the options --route=0:All --route=1:0" << endl
   << "  used by default (route data from first port to all ports and from second" << endl
@@ -186,6 +249,9 @@ static void Usage(const char *pProgPath, Plugins &plugins)
   << "      receive data from CNCB2 and send it to CNCB0 and CNCB1." << endl
   << "  " << pProgPath << " --echo-route=0 COM2" << endl
   << "    - receive data from COM2 and send it back to COM2." << endl
+  << "  " << pProgPath << " --bi-route=0:1 --route=0:2@115200bps COM1 COM2 --use-driver=tcp 2000" << endl
+  << "    - mirror data received from COM1 to TCP port 2000 w/o exceeding the rate of" << endl
+  << "      the 115200 bps serial line." << endl
   << "  " << pProgPath << " " << Args::LoadPrefix() << endl
   << "      --echo-route=0" << endl
   << "      COM2" << endl
@@ -254,24 +320,39 @@ static BOOL EchoRoute(ComHub &/*hub*/, Port *pPort, HPRM0 pMap, HPRM1 /*p1*/, HP
   return TRUE;
 }
 
-static void EchoRoute(ComHub &hub, const char *pList, PortMap &map)
+static BOOL EchoRoute(ComHub &hub, const char *pList, PortMap &map)
 {
   if (!EnumPortList(hub, pList, EchoRoute, (HPRM0)&map)) {
     cerr << "Invalid echo route " << pList << endl;
-    exit(1);
+    return FALSE;
   }
+
+  return TRUE;
 }
 ///////////////////////////////////////////////////////////////
 struct RouteParams {
-  RouteParams(BOOL _noRoute, BOOL _noEcho) : noRoute(_noRoute), noEcho(_noEcho) {}
+  RouteParams(BOOL _noRoute, BOOL _noEcho, RouteRates *_pRates, DWORD _rate)
+    : noRoute(_noRoute), noEcho(_noEcho), pRates(_pRates), rate(_rate) {}
 
   BOOL noRoute;
   BOOL noEcho;
+  RouteRates *pRates;
+  DWORD rate;
 };
 
 static BOOL Route(ComHub &/*hub*/, Port *pTo, HPRM0 pFrom, HPRM1 pParams, HPRM2 pMap)
 {
-  AddRoute(*(PortMap *)pMap, (Port *)pFrom, pTo, ((RouteParams *)pParams)->noRoute, ((RouteParams *)pParams)->noEcho);
+  const RouteParams &routeParams = *(const RouteParams *)pParams;
+
+  AddRoute(*(PortMap *)pMap, (Port *)pFrom, pTo, routeParams.noRoute, routeParams.noEcho);
+
+  if (routeParams.pRates) {
+    if (routeParams.rate)
+      (*routeParams.pRates)[pair<Port*, Port*>((Port *)pFrom, pTo)] = routeParams.rate;
+    else
+      routeParams.pRates->erase(pair<Port*, Port*>((Port *)pFrom, pTo));
+  }
+
   return TRUE;
 }
 
@@ -290,12 +371,33 @@ static BOOL Route(
   return EnumPortList(hub, pListFrom, RouteList, (HPRM0)pListTo, (HPRM1)pRouteParams, (HPRM2)&map);
 }
 ///////////////////////////////////////////////////////////////
-static void Route(
+static BOOL RouteRate(char *pParam, DWORD *pRate)
+{
+  size_t len = strlen(pParam);
+  BOOL bits = FALSE;
+
+  if (len > 3 && _stricmp(pParam + len - 3, "bps") == 0) {
+    pParam[len - 3] = 0;
+    bits = TRUE;
+  }
+
+  int num;
+
+  if (!StrToInt(pParam, &num) || num <= 0)
+    return FALSE;
+
+  *pRate = bits ? (DWORD)num/8 : (DWORD)num;
+
+  return *pRate != 0;
+}
+
+static BOOL Route(
     ComHub &hub,
     const char *pParam,
     BOOL biDirection,
     BOOL noRoute,
     BOOL noEcho,
+    RouteRates *pRates,
     PortMap &map)
 {
   char *pTmp = _strdup(pParam);
@@ -307,18 +409,86 @@ static void Route(
 
   char *pSave;
   const char *pListR = STRTOK_R(pTmp, ":", &pSave);
-  const char *pListL = STRTOK_R(NULL, ":", &pSave);
-  const RouteParams routeParams(noRoute, noEcho);
+  char *pListL = STRTOK_R(NULL, ":", &pSave);
+  char *pRate = pListL ? strchr(pListL, '@') : NULL;
+  DWORD rate = 0;
+
+  if (pRate) {
+    *pRate++ = 0;
+
+    if (!pRates || noRoute || !RouteRate(pRate, &rate)) {
+      cerr << "Invalid route rate in " << pParam << endl;
+      free(pTmp);
+      return FALSE;
+    }
+  }
+
+  const RouteParams routeParams(noRoute, noEcho, pRates, rate);
 
   if (!pListR || !pListL ||
       !Route(hub, pListR, pListL, &routeParams, map) ||
       (biDirection && !Route(hub, pListL, pListR, &routeParams, map)))
   {
     cerr << "Invalid route " << pParam << endl;
-    exit(1);
+    free(pTmp);
+    return FALSE;
   }
 
   free(pTmp);
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+struct RouteConfig {
+  RouteConfig() : defaultRouteData(TRUE) {}
+
+  BOOL defaultRouteData;    // no any route option
+  PortMap routeDataMap;
+  PortMap routeFlowControlMap;
+  PortMap noDefaultRouteFlowControlMap;
+  RouteRates routeRates;
+};
+
+// returns FALSE if pArg is not a route option
+static BOOL RouteOption(ComHub &hub, const char *pArg, RouteConfig &config, BOOL *pOk)
+{
+  const char *pParam;
+
+  if ((pParam = GetParam(pArg, "route=")) != NULL) {
+    *pOk = Route(hub, pParam, FALSE, FALSE, TRUE, &config.routeRates, config.routeDataMap);
+  } else
+  if ((pParam = GetParam(pArg, "bi-route=")) != NULL) {
+    *pOk = Route(hub, pParam, TRUE, FALSE, TRUE, &config.routeRates, config.routeDataMap);
+  } else
+  if ((pParam = GetParam(pArg, "no-route=")) != NULL) {
+    *pOk = Route(hub, pParam, FALSE, TRUE, TRUE, &config.routeRates, config.routeDataMap);
+  } else
+  if ((pParam = GetParam(pArg, "echo-route=")) != NULL) {
+    *pOk = EchoRoute(hub, pParam, config.routeDataMap);
+  } else
+  if ((pParam = GetParam(pArg, "fc-route=")) != NULL) {
+    *pOk = Route(hub, pParam, FALSE, FALSE, FALSE, NULL, config.routeFlowControlMap);
+  } else
+  if ((pParam = GetParam(pArg, "no-default-fc-route=")) != NULL) {
+    *pOk = Route(hub, pParam, FALSE, FALSE, FALSE, NULL, config.noDefaultRouteFlowControlMap);
+  } else {
+    return FALSE;
+  }
+
+  config.defaultRouteData = FALSE;
+
+  return TRUE;
+}
+
+static void SetRoutes(ComHub &hub, RouteConfig &config)
+{
+  PortMap defaultRouteFlowControlMap;
+
+  SetFlowControlRoute(defaultRouteFlowControlMap, config.routeDataMap, FALSE);
+  AddRoute(defaultRouteFlowControlMap, config.noDefaultRouteFlowControlMap, TRUE);
+  AddRoute(config.routeFlowControlMap, defaultRouteFlowControlMap, FALSE);
+
+  hub.SetFlowControlRoute(config.routeFlowControlMap);
+  hub.SetDataRoute(config.routeDataMap, config.routeRates);
 }
 ///////////////////////////////////////////////////////////////
 static BOOL CreateFilter(
@@ -430,30 +600,35 @@ static BOOL AddFilters(ComHub &hub, Port *pPort, HPRM0 pFilters, HPRM1 pListFlt,
         }
         else {
           cerr << "Invalid port " << p << endl;
-          exit(1);
+
+          if (pSrcPorts)
+            delete pSrcPorts;
+
+          free(pTmpList);
+          return FALSE;
         }
       }
     }
 
     string::size_type dot = filter.rfind('.');
     string method(dot != filter.npos ? filter.substr(dot) : "");
+    BOOL ok;
 
-    if (method == ".IN") {
-      if (!((Filters *)pFilters)->AddFilter(pPort, filter.substr(0, dot).c_str(), TRUE, FALSE, NULL))
-        exit(1);
-    }
+    if (method == ".IN")
+      ok = ((Filters *)pFilters)->AddFilter(pPort, filter.substr(0, dot).c_str(), TRUE, FALSE, NULL);
     else
-    if (method == ".OUT") {
-      if (!((Filters *)pFilters)->AddFilter(pPort, filter.substr(0, dot).c_str(), FALSE, TRUE, pSrcPorts))
-        exit(1);
-    }
-    else {
-      if (!((Filters *)pFilters)->AddFilter(pPort, filter.c_str(), TRUE, TRUE, pSrcPorts))
-        exit(1);
-    }
+    if (method == ".OUT")
+      ok = ((Filters *)pFilters)->AddFilter(pPort, filter.substr(0, dot).c_str(), FALSE, TRUE, pSrcPorts);
+    else
+      ok = ((Filters *)pFilters)->AddFilter(pPort, filter.c_str(), TRUE, TRUE, pSrcPorts);
 
     if (pSrcPorts)
       delete pSrcPorts;
+
+    if (!ok) {
+      free(pTmpList);
+      return FALSE;
+    }
   }
 
   free(pTmpList);
@@ -461,7 +636,7 @@ static BOOL AddFilters(ComHub &hub, Port *pPort, HPRM0 pFilters, HPRM1 pListFlt,
   return TRUE;
 }
 
-static void AddFilters(ComHub &hub, Filters &filters, const char *pParam)
+static BOOL AddFilters(ComHub &hub, Filters &filters, const char *pParam)
 {
   char *pTmp = _strdup(pParam);
 
@@ -476,15 +651,24 @@ static void AddFilters(ComHub &hub, Filters &filters, const char *pParam)
 
   if (!pList || !*pList || !pListFlt || !*pListFlt) {
     cerr << "Invalid filter parameters " << pParam << endl;
-    exit(1);
+    free(pTmp);
+    return FALSE;
   }
 
   if (!EnumPortList(hub, pList, AddFilters, (HPRM0)&filters, (HPRM1)pListFlt)) {
     cerr << "Can't add filters " << pListFlt << " to ports " << pList << endl;
-    exit(1);
+    free(pTmp);
+    return FALSE;
   }
 
   free(pTmp);
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static BOOL ClearFilters(ComHub &/*hub*/, Port *pPort, HPRM0 pFilters, HPRM1 /*p1*/, HPRM2 /*p2*/)
+{
+  ((Filters *)pFilters)->ClearFilters(pPort);
+  return TRUE;
 }
 ///////////////////////////////////////////////////////////////
 static void Init(ComHub &hub, int argc, const char *const argv[])
@@ -496,7 +680,6 @@ static void Init(ComHub &hub, int argc, const char *const argv[])
       hub.Add();
   }
 
-  BOOL defaultRouteData = TRUE;
   int plugged = 0;
   Plugins *pPlugins = new Plugins();
 
@@ -509,9 +692,7 @@ static void Init(ComHub &hub, int argc, const char *const argv[])
 
   Filters *pFilters = NULL;
 
-  PortMap routeDataMap;
-  PortMap routeFlowControlMap;
-  PortMap noDefaultRouteFlowControlMap;
+  RouteConfig routeConfig;
 
   const char *pUseDriver = "serial";
 
@@ -558,29 +739,58 @@ static void Init(ComHub &hub, int argc, const char *const argv[])
       free(pTmpList);
       exit(0);
     } else
-    if ((pParam = GetParam(pArg, "route=")) != NULL) {
-      defaultRouteData = FALSE;
-      Route(hub, pParam, FALSE, FALSE, TRUE, routeDataMap);
+    if ((pParam = GetParam(pArg, "alloc-stats")) != NULL && *pParam == 0) {
+      allocStats = TRUE;
     } else
-    if ((pParam = GetParam(pArg, "bi-route=")) != NULL) {
-      defaultRouteData = FALSE;
-      Route(hub, pParam, TRUE, FALSE, TRUE, routeDataMap);
+    if ((pParam = GetParam(pArg, "stats")) != NULL && *pParam == 0) {
+      portStats = TRUE;
     } else
-    if ((pParam = GetParam(pArg, "no-route=")) != NULL) {
-      defaultRouteData = FALSE;
-      Route(hub, pParam, FALSE, TRUE, TRUE, routeDataMap);
+    if ((pParam = GetParam(pArg, "latency-stats")) != NULL && *pParam == 0) {
+      portStats = TRUE;
+      latencyStats = TRUE;
     } else
-    if ((pParam = GetParam(pArg, "echo-route=")) != NULL) {
-      defaultRouteData = FALSE;
-      EchoRoute(hub, pParam, routeDataMap);
+    if ((pParam = GetParam(pArg, "capture=")) != NULL) {
+      if (hub.GetCapture()) {
+        cerr << "Duplicated capture option '" << i->c_str() << "'";
+        i->OutReference(cerr, " (", ")") << endl;
+        exit(1);
+      }
+
+      Capture *pCapture = new Capture;
+
+      if (!pCapture) {
+        cerr << "No enough memory." << endl;
+        exit(2);
+      }
+
+      if (!pCapture->Open(pParam))
+        exit(1);
+
+      hub.SetCapture(pCapture);
     } else
-    if ((pParam = GetParam(pArg, "fc-route=")) != NULL) {
-      defaultRouteData = FALSE;
-      Route(hub, pParam, FALSE, FALSE, FALSE, routeFlowControlMap);
+    if ((pParam = GetParam(pArg, "control=")) != NULL) {
+      controlPath = pParam;
     } else
-    if ((pParam = GetParam(pArg, "no-default-fc-route=")) != NULL) {
-      defaultRouteData = FALSE;
-      Route(hub, pParam, FALSE, FALSE, FALSE, noDefaultRouteFlowControlMap);
+    if ((pParam = GetParam(pArg, "virtual-clock")) != NULL && *pParam == 0) {
+      Reactor::SetVirtualClock();
+    } else
+    if ((pParam = GetParam(pArg, "threads=")) != NULL) {
+      int num;
+
+      if (!StrToInt(pParam, &num) || num < 1) {
+        cerr << "Invalid number of threads in '" << i->c_str() << "'";
+        i->OutReference(cerr, " (", ")") << endl;
+        exit(1);
+      }
+
+      hub.SetThreads((unsigned)num);
+    } else
+    if (RouteOption(hub, pArg, routeConfig, &ok)) {
+      if (!ok)
+        exit(1);
+    } else
+    if ((pParam = GetParam(pArg, "credit-fc")) != NULL && *pParam == 0) {
+      hub.SetCreditFc(TRUE);
     } else
     if ((pParam = GetParam(pArg, "create-filter=")) != NULL) {
       if (!pFilters)
@@ -604,7 +814,8 @@ static void Init(ComHub &hub, int argc, const char *const argv[])
         exit(1);
       }
 
-      AddFilters(hub, *pFilters, pParam);
+      if (!AddFilters(hub, *pFilters, pParam))
+        exit(1);
     } else
     if ((pParam = GetParam(pArg, "use-driver=")) != NULL) {
       pUseDriver = pParam;
@@ -625,33 +836,175 @@ static void Init(ComHub &hub, int argc, const char *const argv[])
   pPlugins->ConfigStop();
   delete pPlugins;
 
-  if (plugged > 1 && defaultRouteData) {
-    Route(hub, "0:All", FALSE, FALSE, TRUE, routeDataMap);
-    Route(hub, "1:0", FALSE, FALSE, TRUE, routeDataMap);
+  if (plugged > 1 && routeConfig.defaultRouteData) {
+    Route(hub, "0:All", FALSE, FALSE, TRUE, &routeConfig.routeRates, routeConfig.routeDataMap);
+    Route(hub, "1:0", FALSE, FALSE, TRUE, &routeConfig.routeRates, routeConfig.routeDataMap);
   }
 
-  PortMap defaultRouteFlowControlMap;
+  SetRoutes(hub, routeConfig);
 
-  SetFlowControlRoute(defaultRouteFlowControlMap, routeDataMap, FALSE);
-  AddRoute(defaultRouteFlowControlMap, noDefaultRouteFlowControlMap, TRUE);
-  AddRoute(routeFlowControlMap, defaultRouteFlowControlMap, FALSE);
+  hub.SetFilters(pFilters);
+  hub.RouteReport();
 
-  hub.SetFlowControlRoute(routeFlowControlMap);
-  hub.SetDataRoute(routeDataMap);
+  if (pFilters)
+    pFilters->Report();
+}
+///////////////////////////////////////////////////////////////
+static BOOL Reconfigure(void *pParam, const vector<string> &options)
+{
+  ComHub &hub = *(ComHub *)pParam;
+
+  // the route tables are not shared by the threads
+  if (hub.IsSharded()) {
+    cerr << "The ports handled by several threads can't be reconfigured" << endl;
+    return FALSE;
+  }
+
+  Filters *pFilters = hub.GetFilters();
+
+  if (pFilters)
+    pFilters->BeginUpdate();
+
+  RouteConfig routeConfig;
+  BOOL ok = TRUE;
+
+  for (vector<string>::const_iterator i = options.begin() ; ok && i != options.end() ; i++) {
+    const char *pArg = GetParam(i->c_str(), "--");
+    const char *pParam;
+
+    if (!pArg) {
+      cerr << "Invalid control option '" << *i << "'" << endl;
+      ok = FALSE;
+    } else
+    if (RouteOption(hub, pArg, routeConfig, &ok)) {
+      // ok is set by RouteOption()
+    } else
+    if ((pParam = GetParam(pArg, "add-filters=")) != NULL) {
+      if (!pFilters) {
+        cerr << "There is not any --create-filter option on start" << endl;
+        ok = FALSE;
+      } else {
+        ok = AddFilters(hub, *pFilters, pParam);
+      }
+    } else
+    if ((pParam = GetParam(pArg, "no-filters=")) != NULL) {
+      if (pFilters && !EnumPortList(hub, pParam, ClearFilters, (HPRM0)pFilters))
+        ok = FALSE;
+    } else {
+      cerr << "Unknown control option '" << *i << "'" << endl;
+      ok = FALSE;
+    }
+  }
+
+  // all options are parsed before applying any of them
+
+  if (pFilters)
+    pFilters->EndUpdate(ok);
+
+  if (!ok)
+    return FALSE;
+
+  if (!routeConfig.defaultRouteData)
+    SetRoutes(hub, routeConfig);
 
-  hub.SetFilters(pFilters);
   hub.RouteReport();
 
   if (pFilters)
     pFilters->Report();
+
+  return TRUE;
 }
 ///////////////////////////////////////////////////////////////
-static VOID CALLBACK TimerAPCProc(
-  LPVOID pArg,
-  DWORD /*dwTimerLowValue*/,
-  DWORD /*dwTimerHighValue*/)
+static StatsSnapshot statsSnapshot;
+
+static void ReportPortProc(Port *pPort, void * /*pParam*/)
+{
+  pPort->LostReport();
+
+  if (portStats)
+    pPort->hub.GetStats(pPort, statsSnapshot);
+}
+
+static void ReportDoneProc(void *pParam)
+{
+  if (portStats) {
+    ((ComHub *)pParam)->FinishStats(statsSnapshot);
+    statsSnapshot.Report(cout);
+
+    // prepare for the next report
+    ((ComHub *)pParam)->InitStats(statsSnapshot);
+  }
+
+  if (allocStats)
+    PoolReport(cout);
+}
+
+static void ReportProc(void *pArg)
 {
-  ((ComHub *)pArg)->LostReport();
+  // skipped if the previous report is not finished yet
+  ((ComHub *)pArg)->ForEachPort(ReportPortProc, NULL, ReportDoneProc, pArg);
+}
+///////////////////////////////////////////////////////////////
+static StatsSnapshot querySnapshot;
+static vector<ControlQuery *> statsQueries;
+static ReactorTimer *pStatsQueryTimer = NULL;
+
+static void StatsQueryPortProc(Port *pPort, void * /*pParam*/)
+{
+  pPort->hub.GetStats(pPort, querySnapshot);
+}
+
+static void StatsQueryDoneProc(void *pParam)
+{
+  ((ComHub *)pParam)->FinishStats(querySnapshot);
+
+  stringstream json;
+
+  querySnapshot.ReportJson(json);
+
+  // the queries came while filling the snapshot get the same answer
+  vector<ControlQuery *> queries;
+
+  queries.swap(statsQueries);
+
+  for (vector<ControlQuery *>::const_iterator i = queries.begin() ; i != queries.end() ; i++)
+    Control::Answer(*i, json.str());
+}
+
+static void StatsQueryProc(void *pParam)
+{
+  ComHub &hub = *(ComHub *)pParam;
+
+  hub.InitStats(querySnapshot);
+
+  // busy by the periodic report so try a bit later
+  if (!hub.ForEachPort(StatsQueryPortProc, NULL, StatsQueryDoneProc, pParam)) {
+    LARGE_INTEGER dueTime;
+
+    dueTime.QuadPart = -10000;
+
+    pStatsQueryTimer->Set(hub.reactor, &dueTime, 0);
+  }
+}
+
+static void StatsQuery(void *pParam, ControlQuery *pQuery)
+{
+  statsQueries.push_back(pQuery);
+
+  // the snapshot is filling already
+  if (statsQueries.size() > 1)
+    return;
+
+  if (!pStatsQueryTimer) {
+    pStatsQueryTimer = new ReactorTimer(StatsQueryProc, pParam);
+
+    if (!pStatsQueryTimer) {
+      cerr << "No enough memory." << endl;
+      exit(2);
+    }
+  }
+
+  StatsQueryProc(pParam);
 }
 ///////////////////////////////////////////////////////////////
 int main(int argc, char* argv[])
@@ -661,28 +1014,23 @@ int main(int argc, char* argv[])
   Init(hub, argc, argv);
 
   if (hub.StartAll()) {
-    HANDLE hTimer = ::CreateWaitableTimer(NULL, FALSE, NULL);
+    // the snapshot for the control queries is prepared by each query
+    if (portStats)
+      hub.InitStats(statsSnapshot);
 
-    if (hTimer) {
-      LARGE_INTEGER firstReportTime;
+    ReactorTimer reportTimer(ReportProc, &hub);
+    LARGE_INTEGER firstReportTime;
 
-      firstReportTime.QuadPart = -100000000;
+    firstReportTime.QuadPart = -100000000;
 
-      if (!::SetWaitableTimer(hTimer, &firstReportTime, 10000, TimerAPCProc, &hub, FALSE)) {
-        DWORD err = GetLastError();
+    reportTimer.Set(hub.reactor, &firstReportTime, 10000);
 
-        cerr << "WARNING: SetWaitableTimer() - error=" << err << endl;
+    Control control(hub.reactor, Reconfigure, StatsQuery, &hub);
 
-        ::CloseHandle(hTimer);
-      }
-    } else {
-      DWORD err = GetLastError();
-
-      cerr << "WARNING: CreateWaitableTimer() - error=" << err << endl;
-    }
+    if (!controlPath.empty() && !control.Open(controlPath.c_str()))
+      return 1;
 
-    for (;;)
-      ::SleepEx(INFINITE, TRUE);
+    hub.reactor.Run();
   }
 
   return 1;
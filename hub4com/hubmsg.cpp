@@ -31,11 +31,28 @@
 #include "plugins/plugins_api.h"
 
 #include "hubmsg.h"
+#include "pool.h"
 #include "bufutils.h"
 
+///////////////////////////////////////////////////////////////
+static MemPool msgPool("MSG", sizeof(HubMsg), 1024);
+///////////////////////////////////////////////////////////////
+void *HubMsg::operator new(size_t size) throw()
+{
+  _ASSERTE(size == msgPool.BlockSize());
+
+  return msgPool.Alloc();
+}
+
+void HubMsg::operator delete(void *p)
+{
+  msgPool.Free(p);
+}
 ///////////////////////////////////////////////////////////////
 HubMsg::HubMsg()
-  : pNext(NULL)
+  : time(0),
+    urgent(FALSE),
+    pNext(NULL)
 {
 #ifdef _DEBUG
   signature = MSG_SIGNATURE;
@@ -76,23 +93,62 @@ HubMsg *HubMsg::Clone() const
     }
   }
 
-  if ((type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_BUF) {
-    BufAppend(&pNewMsg->u.buf.pBuf, 0, u.buf.pBuf, u.buf.size);
+  *(HUB_MSG *)pNewMsg = *(const HUB_MSG *)this;
+  pNewMsg->time = time;
+  pNewMsg->urgent = urgent;
 
-    if (pNewMsg->u.buf.pBuf || !u.buf.size) {
-      pNewMsg->type = type;
-      pNewMsg->u.buf.size = u.buf.size;
-    } else {
-      delete pNewMsg;
-      return NULL;
-    }
-  } else {
-    *(HUB_MSG *)pNewMsg = *(const HUB_MSG *)this;
+  if ((type & HUB_MSG_UNION_TYPES_MASK) == HUB_MSG_UNION_TYPE_BUF) {
+    // share the data (it will be copied on write)
+    BufAddRef(pNewMsg->u.buf.pBuf);
   }
 
   return pNewMsg;
 }
 ///////////////////////////////////////////////////////////////
+HubMsg *HubMsg::Take()
+{
+  _ASSERTE(signature == MSG_SIGNATURE);
+
+  HubMsg *pNewMsg = new HubMsg();
+
+  if (!pNewMsg)
+    return NULL;
+
+  *(HUB_MSG *)pNewMsg = *(const HUB_MSG *)this;
+  pNewMsg->time = time;
+  pNewMsg->urgent = urgent;
+
+  ::memset((HUB_MSG *)this, 0, sizeof(HUB_MSG));
+  urgent = FALSE;
+
+  return pNewMsg;
+}
+///////////////////////////////////////////////////////////////
+BOOL HubMsg::IsUrgent() const
+{
+  _ASSERTE(signature == MSG_SIGNATURE);
+
+  switch (HUB_MSG_T2N(type)) {
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LINE_DATA):
+      return urgent;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_MODEM_STATUS):
+    case HUB_MSG_T2N(HUB_MSG_TYPE_RBR_STATUS):
+    case HUB_MSG_T2N(HUB_MSG_TYPE_RLC_STATUS):
+    case HUB_MSG_T2N(HUB_MSG_TYPE_SET_BR):
+    case HUB_MSG_T2N(HUB_MSG_TYPE_SET_LC):
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LBR_STATUS):
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LLC_STATUS):
+      return TRUE;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LINE_STATUS):
+      // the break and errors are the states of the received data
+      return (MASK2VAL(u.val) & (LINE_STATUS_BI|LINE_STATUS_FE|LINE_STATUS_PE)) == 0;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_SET_PIN_STATE):
+      return (MASK2VAL(u.val) & PIN_STATE_BREAK) == 0;
+  }
+
+  return FALSE;
+}
+///////////////////////////////////////////////////////////////
 void HubMsg::Clean()
 {
   _ASSERTE(signature == MSG_SIGNATURE);
@@ -101,6 +157,7 @@ void HubMsg::Clean()
     BufFree(u.buf.pBuf);
 
   ::memset((HUB_MSG *)this, 0, sizeof(HUB_MSG));
+  urgent = FALSE;
 }
 ///////////////////////////////////////////////////////////////
 void HubMsg::Merge(HubMsg *pMsg)
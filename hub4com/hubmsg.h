@@ -36,10 +36,29 @@ class HubMsg : public HUB_MSG
     HubMsg();
     ~HubMsg();
 
+    static void *operator new(size_t size) throw();
+    static void operator delete(void *p);
+
     void Clean();
     void Merge(HubMsg *pMsg);
     HubMsg *Clone() const;
 
+    // move the contents to a new message (this one becomes empty)
+    HubMsg *Take();
+
+    // the control message that can go ahead of the queued data (the
+    // breaks, the errors and the data itself are kept in order)
+    BOOL IsUrgent() const;
+
+    // unlink and return the rest of the chain
+    HubMsg *Cut() {
+      _ASSERTE(signature == MSG_SIGNATURE);
+
+      HubMsg *pRest = pNext;
+      pNext = NULL;
+      return pRest;
+    }
+
     void Insert(HubMsg *pPrevMsg) {
       _ASSERTE(signature == MSG_SIGNATURE);
       _ASSERTE(pPrevMsg->signature == MSG_SIGNATURE);
@@ -54,6 +73,14 @@ class HubMsg : public HUB_MSG
       return pNext;
     }
 
+  public:
+    // the reading time (see --latency-stats) or 0
+    ULONGLONG time;
+
+    // the line data can be written ahead of the queued one (see
+    // ROUTINE_MSG_INSERT_URGENT)
+    BOOL urgent;
+
   private:
     HubMsg *pNext;
 
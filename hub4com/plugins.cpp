@@ -39,14 +39,22 @@
 #include "precomp.h"
 #include "plugins/plugins_api.h"
 
+#include "stats.h"
 #include "port.h"
+#include "reactor.h"
 #include "comhub.h"
 #include "plugins.h"
+#include "pool.h"
 #include "bufutils.h"
 #include "hubmsg.h"
 #include "export.h"
 #include "static.h"
 
+#ifndef _WIN32
+  #include <dirent.h>
+  #include <link.h>
+#endif
+
 ///////////////////////////////////////////////////////////////
 class PluginEnt {
   public:
@@ -142,6 +150,7 @@ static string type2str(PLUGIN_TYPE type)
   return str.str();
 }
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 static string GetModulePath(HMODULE hDll, BOOL withName)
 {
   string path;
@@ -186,6 +195,34 @@ static string GetModulePath(HMODULE hDll, BOOL withName)
 
   return path;
 }
+#else  /* _WIN32 */
+static string GetModulePath(HMODULE hDll, BOOL withName)
+{
+  string path;
+
+  if (hDll) {
+    struct link_map *pLinkMap;
+
+    if (dlinfo(hDll, RTLD_DI_LINKMAP, &pLinkMap) == 0 && pLinkMap->l_name)
+      path = pLinkMap->l_name;
+  } else {
+    char buf[MAX_PATH];
+
+    ssize_t res = readlink("/proc/self/exe", buf, sizeof(buf));
+
+    if (res > 0 && res < (ssize_t)sizeof(buf))
+      path.assign(buf, res);
+  }
+
+  if (!withName) {
+    string::size_type pos = path.rfind('/');
+
+    path.erase(pos == string::npos ? 0 : pos + 1);
+  }
+
+  return path;
+}
+#endif  /* _WIN32 */
 ///////////////////////////////////////////////////////////////
 Plugins::Plugins()
 {
@@ -201,6 +238,7 @@ Plugins::Plugins()
     delete pDllPlugins;
   }
 
+#ifdef _WIN32
   string pluginsDir = GetModulePath(NULL, FALSE) + "plugins\\";
   string pathWildcard(pluginsDir);
 
@@ -223,6 +261,25 @@ Plugins::Plugins()
   } while (FindNextFile(hFind, &findFileData));
 
   FindClose(hFind);
+#else  /* _WIN32 */
+  string pluginsDir = GetModulePath(NULL, FALSE) + "plugins/";
+
+  DIR *pDir = opendir(pluginsDir.c_str());
+
+  if (!pDir)
+    return;
+
+  for (struct dirent *pEnt ; (pEnt = readdir(pDir)) != NULL ; ) {
+    size_t len = strlen(pEnt->d_name);
+
+    if (len <= 3 || strcmp(pEnt->d_name + len - 3, ".so") != 0)
+      continue;
+
+    LoadPlugin(pluginsDir + pEnt->d_name);
+  }
+
+  closedir(pDir);
+#endif  /* _WIN32 */
 }
 ///////////////////////////////////////////////////////////////
 Plugins::~Plugins()
@@ -72,6 +72,7 @@ static ROUTINE_MSG_REPLACE_VAL *pMsgReplaceVal;
 static ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
 static ROUTINE_MSG_INSERT_NONE *pMsgInsertNone;
 static ROUTINE_GET_FILTER *pGetFilter;
+static ROUTINE_BUF_UNSHARE *pBufUnshare;
 ///////////////////////////////////////////////////////////////
 const char *GetParam(const char *pArg, const char *pPattern)
 {
@@ -312,7 +313,12 @@ static BOOL CALLBACK InMethod(
         // insert CONNECT(TRUE) before rest of data
 
         if (pBuf != pInMsg->u.buf.pBuf) {
-          memmove(pInMsg->u.buf.pBuf, pBuf, size);
+          DWORD offset = DWORD(pBuf - pInMsg->u.buf.pBuf);
+
+          if (!pBufUnshare(&pInMsg->u.buf.pBuf, pInMsg->u.buf.size))
+            return FALSE;
+
+          memmove(pInMsg->u.buf.pBuf, pInMsg->u.buf.pBuf + offset, size);
           pBuf = pInMsg->u.buf.pBuf;
         }
 
@@ -394,6 +400,19 @@ static BOOL CALLBACK OutMethod(
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetInMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_LINE_DATA) |
+         HUB_MSG_T2M(HUB_MSG_TYPE_CONNECT);
+}
+///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetOutMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_CONNECT);
+}
+///////////////////////////////////////////////////////////////
 static const FILTER_ROUTINES_A routines = {
   sizeof(FILTER_ROUTINES_A),
   GetPluginType,
@@ -408,6 +427,8 @@ static const FILTER_ROUTINES_A routines = {
   DeleteInstance,
   InMethod,
   OutMethod,
+  GetInMsgTypes,
+  GetOutMsgTypes,
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -422,7 +443,8 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   if (!ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceVal) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceNone) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgInsertNone) ||
-      !ROUTINE_IS_VALID(pHubRoutines, pGetFilter))
+      !ROUTINE_IS_VALID(pHubRoutines, pGetFilter) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pBufUnshare))
   {
     return NULL;
   }
@@ -431,6 +453,7 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   pMsgReplaceNone = pHubRoutines->pMsgReplaceNone;
   pMsgInsertNone = pHubRoutines->pMsgInsertNone;
   pGetFilter = pHubRoutines->pGetFilter;
+  pBufUnshare = pHubRoutines->pBufUnshare;
 
   return plugins;
 }
@@ -0,0 +1,47 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+///////////////////////////////////////////////////////////////
+namespace PortBench {
+///////////////////////////////////////////////////////////////
+#include "comparams.h"
+///////////////////////////////////////////////////////////////
+BOOL ComParams::SetPattern(const char *pPattern)
+{
+  if (_stricmp(pPattern, "seq") == 0)
+    pattern = 's';
+  else
+  if (_stricmp(pPattern, "text") == 0)
+    pattern = 't';
+  else
+  if (_stricmp(pPattern, "zero") == 0)
+    pattern = 'z';
+  else
+    return FALSE;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
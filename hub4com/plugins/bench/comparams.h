@@ -0,0 +1,67 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _COMPARAMS_H
+#define _COMPARAMS_H
+
+///////////////////////////////////////////////////////////////
+class ComParams
+{
+  public:
+    ComParams()
+      : rate(0),
+        size(256),
+        burst(16),
+        duration(0),
+        pattern('s'),
+        writeLimit(4096) {}
+
+    void SetRate(DWORD _rate) { rate = _rate; }
+    DWORD Rate() const { return rate; }
+
+    void SetSize(DWORD _size) { size = _size; }
+    DWORD Size() const { return size; }
+
+    void SetBurst(DWORD _burst) { burst = _burst; }
+    DWORD Burst() const { return burst; }
+
+    void SetDuration(DWORD _duration) { duration = _duration; }
+    DWORD Duration() const { return duration; }
+
+    BOOL SetPattern(const char *pPattern);
+    char Pattern() const { return pattern; }
+
+    void SetWriteLimit(DWORD _writeLimit) { writeLimit = _writeLimit; }
+    DWORD WriteLimit() const { return writeLimit; }
+
+  private:
+    DWORD rate;       // bytes per second or 0 for max rate
+    DWORD size;       // bytes per message
+    DWORD burst;      // messages per loop iteration for max rate
+    DWORD duration;   // seconds or 0 for infinite
+    char pattern;     // 's'eq, 't'ext or 'z'ero
+    DWORD writeLimit; // bytes queued by the slow sink
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _COMPARAMS_H
@@ -0,0 +1,566 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "../plugins_api.h"
+///////////////////////////////////////////////////////////////
+namespace PortBench {
+///////////////////////////////////////////////////////////////
+#include "comport.h"
+#include "comparams.h"
+#include "import.h"
+///////////////////////////////////////////////////////////////
+//
+// The message header is
+//
+//   'h', '4', 'c', <pattern>, <source id>, <sequence number>
+//
+// where the numbers are 4 byte little-endian. The rest bytes of
+// the message are generated by the pattern from the sequence
+// number so the sink can check any message by itself.
+//
+///////////////////////////////////////////////////////////////
+#define HEADER_SIZE     12
+#define TIMER_PERIOD    10
+#define SETTLE_TIME     100
+///////////////////////////////////////////////////////////////
+static DWORD TickCount()
+{
+  // follow the virtual clock of the hub (if any)
+  return pTickCount ? pTickCount() : ::GetTickCount();
+}
+///////////////////////////////////////////////////////////////
+static void PutDword(BYTE *pBuf, DWORD val)
+{
+  pBuf[0] = (BYTE)val;
+  pBuf[1] = (BYTE)(val >> 8);
+  pBuf[2] = (BYTE)(val >> 16);
+  pBuf[3] = (BYTE)(val >> 24);
+}
+
+static DWORD GetDword(const BYTE *pBuf)
+{
+  return (DWORD)pBuf[0] |
+         ((DWORD)pBuf[1] << 8) |
+         ((DWORD)pBuf[2] << 16) |
+         ((DWORD)pBuf[3] << 24);
+}
+
+static BYTE PatternByte(char pattern, DWORD seq, DWORD i)
+{
+  switch (pattern) {
+    case 's':
+      return (BYTE)(seq + i);
+    case 't':
+      return (BYTE)(' ' + (seq + i) % 95);
+  }
+
+  return 0;
+}
+///////////////////////////////////////////////////////////////
+static DWORD lastId = 0;
+
+// the hub exits when all sources are stopped (see --duration)
+static LONG numRunning = 0;
+static LONG numEndless = 0;
+static vector<ComPort *> sinks;
+///////////////////////////////////////////////////////////////
+ComPort::ComPort(const ComParams &comParams, const char *pPath)
+  : mode(modeInvalid),
+    name("BENCH"),
+    hMasterPort(NULL),
+    rate(comParams.Rate()),
+    size(comParams.Size()),
+    burst(comParams.Burst()),
+    duration(comParams.Duration()),
+    pattern(comParams.Pattern()),
+    id(0),
+    seq(0),
+    countXoff(0),
+    deferred(FALSE),
+    stopped(FALSE),
+    hTimer(NULL),
+    lastTick(0),
+    credit(0),
+    startTick(0),
+    reportTick(0),
+    bytes(0),
+    msgs(0),
+    reportBytes(0),
+    reportMsgs(0),
+    lost(0),
+    errors(0),
+    checkTick(0),
+    maxGap(0),
+    writeLimit(comParams.WriteLimit()),
+    writeQueued(0),
+    writeSuspended(FALSE),
+    writeCreditExhausted(FALSE),
+    writeLost(0),
+    readCreditWait(FALSE),
+    hSettleTimer(NULL),
+    settleTick(0),
+    settleMsgs(0)
+{
+  if (_stricmp(pPath, "source") == 0) {
+    mode = modeSource;
+    id = ++lastId;
+
+    if (duration)
+      numRunning++;
+    else
+      numEndless++;
+  }
+  else
+  if (_stricmp(pPath, "sink") == 0) {
+    mode = modeSink;
+    sinks.push_back(this);
+  }
+}
+
+BOOL ComPort::Init(HMASTERPORT _hMasterPort)
+{
+  hMasterPort = _hMasterPort;
+
+  return TRUE;
+}
+
+BOOL ComPort::Start()
+{
+  _ASSERTE(hMasterPort != NULL);
+
+  startTick = reportTick = lastTick = TickCount();
+
+  if (rate) {
+    hTimer = pTimerCreate((HTIMEROWNER)this);
+
+    if (!hTimer) {
+      cerr << name << " Can't create timer" << endl;
+      return FALSE;
+    }
+
+    LARGE_INTEGER dueTime;
+
+    dueTime.QuadPart = -10000LL * TIMER_PERIOD;
+
+    if (!pTimerSet(hTimer, hMasterPort, &dueTime, TIMER_PERIOD, (HTIMERPARAM)hTimer)) {
+      cerr << name << " Can't set timer" << endl;
+      return FALSE;
+    }
+  }
+  else
+  if (mode == modeSource) {
+    Defer();
+  }
+
+  return TRUE;
+}
+
+void ComPort::Defer()
+{
+  if (deferred || stopped || countXoff > 0 || readCreditWait)
+    return;
+
+  if (pDefer(hMasterPort, OnDefer, (HDEFERPARAM)this))
+    deferred = TRUE;
+}
+
+void CALLBACK ComPort::OnDefer(HDEFERPARAM hDeferParam)
+{
+  ComPort *pPort = (ComPort *)hDeferParam;
+
+  _ASSERTE(pPort != NULL);
+
+  pPort->deferred = FALSE;
+  pPort->Generate();
+
+  if (!pPort->rate)
+    pPort->Defer();
+}
+
+void ComPort::Generate()
+{
+  if (stopped || countXoff > 0 || readCreditWait)
+    return;
+
+  DWORD tick = TickCount();
+
+  if (duration && tick - startTick >= duration * 1000) {
+    stopped = TRUE;
+
+    if (hTimer)
+      pTimerCancel(hTimer);
+
+    Report("Stopped", tick - startTick, bytes, msgs);
+
+    // the sources can be handled by several threads
+    if (InterlockedDecrement(&numRunning) == 0 && !numEndless)
+      Finish();
+
+    return;
+  }
+
+  DWORD num = burst;
+
+  if (rate) {
+    credit += (ULONGLONG)rate * (tick - lastTick) / 1000;
+
+    // do not accumulate more than for 100 ms
+    if (credit > rate/10 + size)
+      credit = rate/10 + size;
+
+    num = (DWORD)(credit / size);
+    credit -= (ULONGLONG)num * size;
+  }
+
+  lastTick = tick;
+
+  while (num-- && countXoff <= 0) {
+    // it can overrun the credit by one message
+    if (pGetReadCredit && !pGetReadCredit(hMasterPort)) {
+      readCreditWait = TRUE;
+      break;
+    }
+
+    if (!Send())
+      break;
+  }
+}
+
+void ComPort::Finish()
+{
+  settleTick = TickCount();
+
+  hSettleTimer = pTimerCreate((HTIMEROWNER)this);
+
+  if (!hSettleTimer) {
+    cerr << name << " Can't create timer" << endl;
+    return;
+  }
+
+  LARGE_INTEGER dueTime;
+
+  dueTime.QuadPart = -10000LL * TIMER_PERIOD;
+
+  if (!pTimerSet(hSettleTimer, hMasterPort, &dueTime, TIMER_PERIOD, (HTIMERPARAM)hSettleTimer))
+    cerr << name << " Can't set timer" << endl;
+}
+
+void ComPort::Settle()
+{
+  DWORD tick = TickCount();
+  ULONGLONG received = 0;
+
+  // the counters of the sinks handled by other threads are not
+  // changed any more if the data stopped coming
+  for (vector<ComPort *>::const_iterator i = sinks.begin() ; i != sinks.end() ; i++)
+    received += (*i)->msgs;
+
+  if (received != settleMsgs) {
+    settleMsgs = received;
+    settleTick = tick;
+    return;
+  }
+
+  if (tick - settleTick < SETTLE_TIME)
+    return;
+
+  for (vector<ComPort *>::const_iterator i = sinks.begin() ; i != sinks.end() ; i++)
+    (*i)->Report("Total", settleTick - (*i)->startTick, (*i)->bytes, (*i)->msgs);
+
+  cout << flush;
+
+  exit(0);
+}
+
+BOOL ComPort::Send()
+{
+  BYTE *pBuf = pBufAlloc(size);
+
+  if (!pBuf)
+    return FALSE;
+
+  pBuf[0] = 'h';
+  pBuf[1] = '4';
+  pBuf[2] = 'c';
+  pBuf[3] = (BYTE)pattern;
+  PutDword(pBuf + 4, id);
+  PutDword(pBuf + 8, seq);
+
+  for (DWORD i = HEADER_SIZE ; i < size ; i++)
+    pBuf[i] = PatternByte(pattern, seq, i);
+
+  seq++;
+  bytes += size;
+  msgs++;
+
+  HUB_MSG msg;
+
+  msg.type = HUB_MSG_TYPE_LINE_DATA;
+  msg.u.buf.pBuf = pBuf;
+  msg.u.buf.size = size;
+
+  pOnRead(hMasterPort, &msg);
+
+  return TRUE;
+}
+
+void ComPort::Drain()
+{
+  DWORD tick = TickCount();
+  ULONGLONG drained = (ULONGLONG)rate * (tick - lastTick) / 1000;
+
+  if (!drained)
+    return;
+
+  lastTick = tick;
+
+  if (drained < writeQueued)
+    writeQueued -= (DWORD)drained;
+  else
+    writeQueued = 0;
+
+  FlowControlUpdate();
+}
+
+void ComPort::FlowControlUpdate()
+{
+  if (writeSuspended) {
+    if (writeQueued <= writeLimit/3) {
+      writeSuspended = FALSE;
+
+      HUB_MSG msg;
+
+      msg.type = HUB_MSG_TYPE_ADD_XOFF_XON;
+      msg.u.val = FALSE;
+
+      pOnRead(hMasterPort, &msg);
+    }
+  } else {
+    if (writeQueued > (writeLimit*2)/3) {
+      writeSuspended = TRUE;
+
+      HUB_MSG msg;
+
+      msg.type = HUB_MSG_TYPE_ADD_XOFF_XON;
+      msg.u.val = TRUE;
+
+      pOnRead(hMasterPort, &msg);
+    }
+  }
+
+  if (writeCreditExhausted && writeQueued < writeLimit) {
+    writeCreditExhausted = FALSE;
+
+    HUB_MSG msg;
+
+    msg.type = HUB_MSG_TYPE_CREDIT;
+    msg.u.val = writeLimit - writeQueued;
+
+    pOnRead(hMasterPort, &msg);
+  }
+}
+
+DWORD ComPort::GetWriteCredit()
+{
+  // only the slow sink has the write queue
+  if (mode != modeSink || !rate)
+    return HUB_CREDIT_UNLIMITED;
+
+  if (writeQueued < writeLimit)
+    return writeLimit - writeQueued;
+
+  writeCreditExhausted = TRUE;
+
+  return 0;
+}
+
+void ComPort::Check(const BYTE *pBuf, DWORD len)
+{
+  bytes += len;
+  msgs++;
+
+  if (len < HEADER_SIZE || pBuf[0] != 'h' || pBuf[1] != '4' || pBuf[2] != 'c') {
+    errors++;
+    return;
+  }
+
+  char msgPattern = (char)pBuf[3];
+  DWORD msgId = GetDword(pBuf + 4);
+  DWORD msgSeq = GetDword(pBuf + 8);
+
+  SeqMap::iterator iPair = nextSeqs.find(msgId);
+
+  if (iPair == nextSeqs.end()) {
+    nextSeqs.insert(pair<DWORD, DWORD>(msgId, msgSeq + 1));
+  } else {
+    if ((LONG)(msgSeq - iPair->second) > 0)
+      lost += msgSeq - iPair->second;
+    else
+    if (msgSeq != iPair->second)
+      errors++;   // duplicated or reordered
+
+    iPair->second = msgSeq + 1;
+  }
+
+  for (DWORD i = HEADER_SIZE ; i < len ; i++) {
+    if (pBuf[i] != PatternByte(msgPattern, msgSeq, i)) {
+      errors++;
+      break;
+    }
+  }
+}
+
+BOOL ComPort::FakeReadFilter(HUB_MSG *pInMsg)
+{
+  _ASSERTE(pInMsg != NULL);
+
+  switch (HUB_MSG_T2N(pInMsg->type)) {
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LOOP_TEST):
+      pInMsg->u.hVal = (HANDLE)hMasterPort;
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_TICK):
+      if (pInMsg->u.hv2.hVal0 == (HANDLE)this && pInMsg->u.hv2.hVal1 == (HANDLE)hTimer) {
+        if (mode == modeSource)
+          Generate();
+        else
+          Drain();
+      }
+      else
+      if (pInMsg->u.hv2.hVal0 == (HANDLE)this && pInMsg->u.hv2.hVal1 == (HANDLE)hSettleTimer) {
+        Settle();
+      }
+      break;
+  }
+
+  return pInMsg != NULL;
+}
+
+BOOL ComPort::Write(HUB_MSG *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+
+  switch (HUB_MSG_T2N(pMsg->type)) {
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LINE_DATA):
+      if (mode != modeSink || !pMsg->u.buf.size)
+        break;
+
+      if (rate) {
+        // the slow sink drops the data above the limit
+        if (writeQueued >= writeLimit) {
+          writeLost += pMsg->u.buf.size;
+          break;
+        }
+
+        writeQueued += pMsg->u.buf.size;
+        FlowControlUpdate();
+      }
+
+      {
+        // the longest pause in the received data shows how smooth it is
+        DWORD tick = TickCount();
+
+        if (bytes && tick - checkTick > maxGap)
+          maxGap = tick - checkTick;
+
+        checkTick = tick;
+      }
+
+      Check(pMsg->u.buf.pBuf, pMsg->u.buf.size);
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_SET_OUT_OPTS):
+      if (pMsg->u.val) {
+        cerr << name << " WARNING: Requested output option(s) [0x"
+             << hex << pMsg->u.val << dec
+             << "] will be ignored by driver" << endl;
+      }
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_ADD_XOFF_XON):
+      if (pMsg->u.val) {
+        countXoff++;
+      } else {
+        if (--countXoff <= 0 && !rate)
+          Defer();
+      }
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_CREDIT):
+      if (readCreditWait) {
+        readCreditWait = FALSE;
+
+        if (!rate)
+          Defer();
+      }
+      break;
+  }
+
+  return TRUE;
+}
+
+void ComPort::LostReport()
+{
+  DWORD tick = TickCount();
+
+  if (!stopped)
+    Report(mode == modeSource ? "Sent" : "Received", tick - reportTick, bytes - reportBytes, msgs - reportMsgs);
+
+  reportTick = tick;
+  reportBytes = bytes;
+  reportMsgs = msgs;
+}
+
+void ComPort::GetStats(PORT_STATS *pStats) const
+{
+  if (ITEM_IS_VALID(pStats, writeQueued))
+    pStats->writeQueued = writeQueued;
+
+  if (ITEM_IS_VALID(pStats, writeLost))
+    pStats->writeLost = writeLost;
+}
+
+void ComPort::Report(const char *pTitle, DWORD interval, ULONGLONG _bytes, ULONGLONG _msgs) const
+{
+  if (!interval)
+    interval = 1;
+
+  // in hundredths of MB/s
+  ULONGLONG mbps = _bytes * 100000 / interval / (1024*1024);
+
+  cout << name << " " << pTitle << " " << _bytes << " bytes, " << _msgs << " msgs in "
+       << (interval / 1000) << "." << setfill('0') << setw(3) << (interval % 1000) << " s: "
+       << (mbps / 100) << "." << setw(2) << (mbps % 100) << setfill(' ') << " MB/s, "
+       << (_msgs * 1000 / interval) << " msgs/s";
+
+  if (mode == modeSink)
+    cout << ", lost " << lost << ", errors " << errors;
+
+  if (mode == modeSink && rate)
+    cout << ", dropped " << writeLost;
+
+  if (mode == modeSink)
+    cout << ", max gap " << maxGap << " ms";
+
+  cout << endl;
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,117 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _COMPORT_H
+#define _COMPORT_H
+
+///////////////////////////////////////////////////////////////
+class ComParams;
+///////////////////////////////////////////////////////////////
+class ComPort
+{
+  public:
+    ComPort(const ComParams &comParams, const char *pPath);
+
+    BOOL IsValid() const { return mode != modeInvalid; }
+    BOOL Init(HMASTERPORT _hMasterPort);
+    BOOL Start();
+    BOOL FakeReadFilter(HUB_MSG *pInMsg);
+    BOOL Write(HUB_MSG *pMsg);
+    void LostReport();
+    void GetStats(PORT_STATS *pStats) const;
+    DWORD GetWriteCredit();
+
+    const string &Name() const { return name; }
+    void Name(const char *pName) { name = pName; }
+
+  private:
+    static void CALLBACK OnDefer(HDEFERPARAM hDeferParam);
+
+    void Defer();
+    void Generate();
+    BOOL Send();
+    void Drain();
+    void FlowControlUpdate();
+    void Check(const BYTE *pBuf, DWORD len);
+    void Finish();
+    void Settle();
+    void Report(const char *pTitle, DWORD interval, ULONGLONG bytes, ULONGLONG msgs) const;
+
+    enum {
+      modeInvalid,
+      modeSource,
+      modeSink,
+    } mode;
+
+    string name;
+    HMASTERPORT hMasterPort;
+
+    DWORD rate;
+    DWORD size;
+    DWORD burst;
+    DWORD duration;
+    char pattern;
+
+    DWORD id;
+    DWORD seq;
+    int countXoff;
+    BOOL deferred;
+    BOOL stopped;
+    HMASTERTIMER hTimer;
+    DWORD lastTick;
+    ULONGLONG credit;
+
+    DWORD startTick;
+    DWORD reportTick;
+    ULONGLONG bytes;
+    ULONGLONG msgs;
+    ULONGLONG reportBytes;
+    ULONGLONG reportMsgs;
+
+    // the sink's data
+    typedef map<DWORD, DWORD> SeqMap;
+
+    SeqMap nextSeqs;
+    ULONGLONG lost;
+    ULONGLONG errors;
+    DWORD checkTick;
+    DWORD maxGap;
+
+    // the slow sink's data
+    DWORD writeLimit;
+    DWORD writeQueued;
+    BOOL writeSuspended;
+    BOOL writeCreditExhausted;
+    ULONGLONG writeLost;
+
+    // the source's data
+    BOOL readCreditWait;
+
+    // the last stopped source's data
+    HMASTERTIMER hSettleTimer;
+    DWORD settleTick;
+    ULONGLONG settleMsgs;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _COMPORT_H
@@ -0,0 +1,389 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "../plugins_api.h"
+///////////////////////////////////////////////////////////////
+namespace PortBench {
+///////////////////////////////////////////////////////////////
+#include "comport.h"
+#include "comparams.h"
+#include "import.h"
+///////////////////////////////////////////////////////////////
+static const char *GetParam(const char *pArg, const char *pPattern)
+{
+  size_t lenPattern = strlen(pPattern);
+
+  if (_strnicmp(pArg, pPattern, lenPattern) != 0)
+    return NULL;
+
+  return pArg + lenPattern;
+}
+
+static BOOL GetNumber(const char *pParam, DWORD *pNum)
+{
+  if (!isdigit((unsigned char)*pParam))
+    return FALSE;
+
+  char *pEnd;
+  unsigned long num = strtoul(pParam, &pEnd, 10);
+
+  if (*pEnd)
+    return FALSE;
+
+  *pNum = (DWORD)num;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static PLUGIN_TYPE CALLBACK GetPluginType()
+{
+  return PLUGIN_TYPE_DRIVER;
+}
+///////////////////////////////////////////////////////////////
+static const PLUGIN_ABOUT_A about = {
+  sizeof(PLUGIN_ABOUT_A),
+  "bench",
+  "Copyright (c) 2009 Vyacheslav Frolov",
+  "GNU General Public License",
+  "Load generating and checking port driver",
+};
+
+static const PLUGIN_ABOUT_A * CALLBACK GetPluginAbout()
+{
+  return &about;
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK Help(const char *pProgPath)
+{
+  cerr
+  << "Usage:" << endl
+  << "  " << pProgPath << " ... --use-driver=" << GetPluginAbout()->pName << " [options] source|sink ..." << endl
+  << endl
+  << "  The source port generates data, the sink port checks the received data and" << endl
+  << "  both periodically report the throughput. Each message has a header with the" << endl
+  << "  source and the sequence number so the sink counts lost and corrupted messages" << endl
+  << "  (the filters should not split or merge the data). The sink also reports the" << endl
+  << "  longest pause between the received messages (max gap)." << endl
+  << endl
+  << "Options:" << endl
+  << "  --rate=<n>               - generate (source) or write (sink) <n> bytes per" << endl
+  << "                             second (0 by default, it means as fast as" << endl
+  << "                             possible)." << endl
+  << "  --size=<n>               - generate <n> bytes per message (256 by default," << endl
+  << "                             at least 12)." << endl
+  << "  --burst=<n>              - generate <n> messages per loop iteration if <n>" << endl
+  << "                             is not limited (16 by default)." << endl
+  << "  --duration=<s>           - stop generating after <s> seconds and report" << endl
+  << "                             the total (0 by default, it means never). When" << endl
+  << "                             all sources are stopped and no data came for" << endl
+  << "                             0.1 second the sinks report the totals and the" << endl
+  << "                             hub exits." << endl
+  << "  --pattern=<p>            - fill messages by pattern <p> (seq by default)," << endl
+  << "                             where <p> is seq (all byte values), text" << endl
+  << "                             (printable chars) or zero." << endl
+  << "  --write-limit=<s>        - set the maximal size of the write queue of the" << endl
+  << "                             sink with not zero rate to <s> bytes (4096 by" << endl
+  << "                             default). The data above it is dropped." << endl
+  << endl
+  << "  The options above are applied to the following ports." << endl
+  << endl
+  << "Output data stream description:" << endl
+  << "  LINE_DATA(<data>)        - check <data> (sink only)." << endl
+  << "  ADD_XOFF_XON(<val>)      - suspend/resume generating (source only)." << endl
+  << "  CREDIT(<val>)            - resume generating limited by credit (source only)." << endl
+  << endl
+  << "Input data stream description:" << endl
+  << "  LINE_DATA(<data>)        - generated <data> (source only)." << endl
+  << "  ADD_XOFF_XON(<val>)      - the write queue is above 2/3 or below 1/3 of" << endl
+  << "                             the limit (sink with not zero rate only)." << endl
+  << "  CREDIT(<val>)            - the write queue is not full again (sink with" << endl
+  << "                             not zero rate only)." << endl
+  << endl
+  << "Examples:" << endl
+  << "  " << pProgPath << " --use-driver=bench --route=0:1 source sink" << endl
+  << "    - 1:1, send data as fast as possible from the source to the sink." << endl
+  << "  " << pProgPath << " --use-driver=bench --route=0:All --rate=1000000 source sink sink sink" << endl
+  << "    - 1:N fan-out, send 1000000 bytes per second to three sinks." << endl
+  << "  " << pProgPath << " --use-driver=bench --route=0,1,2:3 source source source sink" << endl
+  << "    - N:1 fan-in, send data from three sources to one sink." << endl
+  << "  " << pProgPath << " --create-filter=escparse,chain,p1 --create-filter=escparse,chain,p2" << endl
+  << "      --add-filters=0:chain --use-driver=bench --route=0:1 --pattern=text source sink" << endl
+  << "    - send data via the chain of two filters." << endl
+  << "  " << pProgPath << " --use-driver=bench --route=0:All --fc-route=All:0 --credit-fc" << endl
+  << "      source sink --rate=100000 sink" << endl
+  << "    - 1:N fan-out with the slow sink, the source generates data by credit." << endl
+  << "  " << pProgPath << " --use-driver=bench --route=0:All --fc-route=1:0 --credit-fc" << endl
+  << "      source sink --rate=100000 sink" << endl
+  << "    - the same as above but the slow sink drops the data it can't write." << endl
+  ;
+}
+///////////////////////////////////////////////////////////////
+static HCONFIG CALLBACK ConfigStart()
+{
+  ComParams *pComParams = new ComParams;
+
+  if (!pComParams) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
+  return (HCONFIG)pComParams;
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Config(
+    HCONFIG hConfig,
+    const char *pArg)
+{
+  _ASSERTE(hConfig != NULL);
+
+  ComParams &comParams = *(ComParams *)hConfig;
+
+  const char *pParam;
+  DWORD num;
+
+  if ((pParam = GetParam(pArg, "--rate=")) != NULL) {
+    if (!GetNumber(pParam, &num)) {
+      cerr << "Invalid rate value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetRate(num);
+  } else
+  if ((pParam = GetParam(pArg, "--size=")) != NULL) {
+    if (!GetNumber(pParam, &num) || num < 12) {
+      cerr << "Invalid size value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetSize(num);
+  } else
+  if ((pParam = GetParam(pArg, "--burst=")) != NULL) {
+    if (!GetNumber(pParam, &num) || num < 1) {
+      cerr << "Invalid burst value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetBurst(num);
+  } else
+  if ((pParam = GetParam(pArg, "--duration=")) != NULL) {
+    if (!GetNumber(pParam, &num)) {
+      cerr << "Invalid duration value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetDuration(num);
+  } else
+  if ((pParam = GetParam(pArg, "--pattern=")) != NULL) {
+    if (!comParams.SetPattern(pParam)) {
+      cerr << "Invalid pattern value in " << pArg << endl;
+      exit(1);
+    }
+  } else
+  if ((pParam = GetParam(pArg, "--write-limit=")) != NULL) {
+    if (!GetNumber(pParam, &num) || num < 1) {
+      cerr << "Invalid write limit value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetWriteLimit(num);
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK ConfigStop(
+    HCONFIG hConfig)
+{
+  _ASSERTE(hConfig != NULL);
+
+  delete (ComParams *)hConfig;
+}
+///////////////////////////////////////////////////////////////
+static HPORT CALLBACK Create(
+    HCONFIG hConfig,
+    const char *pPath)
+{
+  _ASSERTE(hConfig != NULL);
+
+  ComPort *pPort = new ComPort(*(const ComParams *)hConfig, pPath);
+
+  if (!pPort)
+    return NULL;
+
+  if (!pPort->IsValid()) {
+    cerr << "Invalid bench port " << pPath << " (should be source or sink)" << endl;
+    delete pPort;
+    return NULL;
+  }
+
+  return (HPORT)pPort;
+}
+///////////////////////////////////////////////////////////////
+static const char *CALLBACK GetPortName(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  return ((ComPort *)hPort)->Name().c_str();
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK SetPortName(
+    HPORT hPort,
+    const char *pName)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pName != NULL);
+
+  ((ComPort *)hPort)->Name(pName);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Init(
+    HPORT hPort,
+    HMASTERPORT hMasterPort)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(hMasterPort != NULL);
+
+  return ((ComPort *)hPort)->Init(hMasterPort);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Start(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  return ((ComPort *)hPort)->Start();
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK FakeReadFilter(
+    HPORT hPort,
+    HUB_MSG *pMsg)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pMsg != NULL);
+
+  return ((ComPort *)hPort)->FakeReadFilter(pMsg);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Write(
+    HPORT hPort,
+    HUB_MSG *pMsg)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pMsg != NULL);
+
+  return ((ComPort *)hPort)->Write(pMsg);
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK LostReport(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  ((ComPort *)hPort)->LostReport();
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK GetStats(
+    HPORT hPort,
+    PORT_STATS *pStats)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pStats != NULL);
+
+  ((ComPort *)hPort)->GetStats(pStats);
+}
+///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetWriteCredit(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  return ((ComPort *)hPort)->GetWriteCredit();
+}
+///////////////////////////////////////////////////////////////
+static const PORT_ROUTINES_A routines = {
+  sizeof(PORT_ROUTINES_A),
+  GetPluginType,
+  GetPluginAbout,
+  Help,
+  ConfigStart,
+  Config,
+  ConfigStop,
+  Create,
+  GetPortName,
+  SetPortName,
+  Init,
+  Start,
+  FakeReadFilter,
+  Write,
+  LostReport,
+  GetStats,
+  NULL,           // WriteV
+  GetWriteCredit,
+};
+
+static const PLUGIN_ROUTINES_A *const plugins[] = {
+  (const PLUGIN_ROUTINES_A *)&routines,
+  NULL
+};
+///////////////////////////////////////////////////////////////
+ROUTINE_BUF_ALLOC *pBufAlloc;
+ROUTINE_ON_READ *pOnRead;
+ROUTINE_TIMER_CREATE *pTimerCreate;
+ROUTINE_TIMER_SET *pTimerSet;
+ROUTINE_TIMER_CANCEL *pTimerCancel;
+ROUTINE_DEFER *pDefer;
+ROUTINE_GET_READ_CREDIT *pGetReadCredit;
+ROUTINE_TICK_COUNT *pTickCount;
+///////////////////////////////////////////////////////////////
+PLUGIN_INIT_A InitA;
+const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
+    const HUB_ROUTINES_A * pHubRoutines)
+{
+  if (!ROUTINE_IS_VALID(pHubRoutines, pBufAlloc) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pOnRead) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCreate) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerSet) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCancel) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pDefer))
+  {
+    return NULL;
+  }
+
+  pBufAlloc = pHubRoutines->pBufAlloc;
+  pOnRead = pHubRoutines->pOnRead;
+  pTimerCreate = pHubRoutines->pTimerCreate;
+  pTimerSet = pHubRoutines->pTimerSet;
+  pTimerCancel = pHubRoutines->pTimerCancel;
+  pDefer = pHubRoutines->pDefer;
+  pGetReadCredit = ROUTINE_GET(pHubRoutines, pGetReadCredit);
+  pTickCount = ROUTINE_GET(pHubRoutines, pTickCount);
+
+  return plugins;
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,40 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _PRECOMP_H_
+#define _PRECOMP_H_
+
+#include <windows.h>
+#include <crtdbg.h>
+
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+#pragma warning(disable:4512) // assignment operator could not be generated
+
+#endif /* _PRECOMP_H_ */
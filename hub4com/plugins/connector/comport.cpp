@@ -47,6 +47,26 @@ BOOL ComPort::Init(HMASTERPORT _hMasterPort)
   return TRUE;
 }
 
+void ComPort::ConnectDataPort(ComPort *pPort)
+{
+  connectedDataPorts.insert(pPort);
+  Join(pPort);
+}
+
+void ComPort::ConnectFlowControlPort(ComPort *pPort)
+{
+  connectedFlowControlPorts.insert(pPort);
+  Join(pPort);
+}
+
+void ComPort::Join(const ComPort *pPort) const
+{
+  // the connected ports call each other so they should be handled
+  // by the same thread
+  if (pJoinPorts && hMasterPort && pPort->hMasterPort && pPort != this)
+    pJoinPorts(hMasterPort, pPort->hMasterPort);
+}
+
 BOOL ComPort::FakeReadFilter(HUB_MSG *pInMsg)
 {
   _ASSERTE(pInMsg != NULL);
@@ -37,11 +37,13 @@ class ComPort
     BOOL FakeReadFilter(HUB_MSG *pInMsg);
     BOOL Write(HUB_MSG *pMsg);
 
-    void ConnectDataPort(ComPort *pPort) { connectedDataPorts.insert(pPort); }
-    void ConnectFlowControlPort(ComPort *pPort) { connectedFlowControlPorts.insert(pPort); }
+    void ConnectDataPort(ComPort *pPort);
+    void ConnectFlowControlPort(ComPort *pPort);
     const string &Name() const { return name; }
 
   private:
+    void Join(const ComPort *pPort) const;
+
     string name;
     HMASTERPORT hMasterPort;
 
@@ -27,6 +27,7 @@
 ///////////////////////////////////////////////////////////////
 extern ROUTINE_BUF_ALLOC *pBufAlloc;
 extern ROUTINE_ON_READ *pOnRead;
+extern ROUTINE_JOIN_PORTS *pJoinPorts;
 ///////////////////////////////////////////////////////////////
 
 #endif  // _IMPORT_H
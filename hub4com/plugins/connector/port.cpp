@@ -356,6 +356,7 @@ static const PLUGIN_ROUTINES_A *const plugins[] = {
 ///////////////////////////////////////////////////////////////
 ROUTINE_BUF_ALLOC *pBufAlloc;
 ROUTINE_ON_READ *pOnRead;
+ROUTINE_JOIN_PORTS *pJoinPorts;
 ///////////////////////////////////////////////////////////////
 PLUGIN_INIT_A InitA;
 const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
@@ -369,6 +370,7 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
 
   pBufAlloc = pHubRoutines->pBufAlloc;
   pOnRead = pHubRoutines->pOnRead;
+  pJoinPorts = ROUTINE_GET(pHubRoutines, pJoinPorts);
 
   return plugins;
 }
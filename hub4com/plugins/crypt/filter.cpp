@@ -39,6 +39,7 @@
 namespace FilterCrypt {
 ///////////////////////////////////////////////////////////////
 static ROUTINE_BUF_APPEND *pBufAppend;
+static ROUTINE_BUF_UNSHARE *pBufUnshare;
 static ROUTINE_MSG_REPLACE_BUF *pmsgreplacebuf;
 ///////////////////////////////////////////////////////////////
 #ifndef _DEBUG
@@ -330,6 +331,9 @@ static BOOL CALLBACK InMethod(
       if (len == 0)
         break;
 
+      if (!pBufUnshare(&pInMsg->u.buf.pBuf, len))
+        return FALSE;
+
       if (!CryptDecrypt(((State *)hFilterInstance)->hKeyIn, 0, FALSE, 0, pInMsg->u.buf.pBuf, &pInMsg->u.buf.size)) {
         DWORD err = GetLastError();
         cerr << "CryptDecrypt() - error=" << err << endl;
@@ -373,6 +377,11 @@ static BOOL CALLBACK OutMethod(
       if (len == 0)
         break;
 
+      // the buffer can be shared with other ports so get private copy
+
+      if (!pBufUnshare(&pOutMsg->u.buf.pBuf, len))
+        return FALSE;
+
       if (!CryptEncrypt(((State *)hFilterInstance)->hKeyOut, 0, FALSE, 0, pOutMsg->u.buf.pBuf, &pOutMsg->u.buf.size, len)) {
         DWORD err = GetLastError();
         cerr << "CryptEncrypt() - error=" << err << endl;
@@ -388,6 +397,19 @@ static BOOL CALLBACK OutMethod(
   return pOutMsg != NULL;
 }
 ///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetInMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_LINE_DATA) |
+         HUB_MSG_T2M(HUB_MSG_TYPE_CONNECT);
+}
+///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetOutMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_LINE_DATA);
+}
+///////////////////////////////////////////////////////////////
 static const FILTER_ROUTINES_A routines = {
   sizeof(FILTER_ROUTINES_A),
   GetPluginType,
@@ -402,6 +424,8 @@ static const FILTER_ROUTINES_A routines = {
   DeleteInstance,
   InMethod,
   OutMethod,
+  GetInMsgTypes,
+  GetOutMsgTypes,
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -413,10 +437,14 @@ PLUGIN_INIT_A InitA;
 const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
     const HUB_ROUTINES_A * pHubRoutines)
 {
-  if (!ROUTINE_IS_VALID(pHubRoutines, pBufAppend))
+  if (!ROUTINE_IS_VALID(pHubRoutines, pBufAppend) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pBufUnshare))
+  {
     return NULL;
+  }
 
   pBufAppend = pHubRoutines->pBufAppend;
+  pBufUnshare = pHubRoutines->pBufUnshare;
 
   return plugins;
 }
@@ -129,6 +129,12 @@ static BOOL CALLBACK InMethod(
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetInMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_LINE_DATA);
+}
+///////////////////////////////////////////////////////////////
 static const FILTER_ROUTINES_A routines = {
   sizeof(FILTER_ROUTINES_A),
   GetPluginType,
@@ -143,6 +149,8 @@ static const FILTER_ROUTINES_A routines = {
   NULL,           // DeleteInstance
   InMethod,
   NULL,           // OutMethod
+  GetInMsgTypes,
+  NULL,           // GetOutMsgTypes
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -52,7 +52,8 @@
 namespace FilterEscInsert {
 ///////////////////////////////////////////////////////////////
 static ROUTINE_MSG_INSERT_BUF *pMsgInsertBuf;
-static ROUTINE_MSG_REPLACE_BUF *pMsgReplaceBuf;
+static ROUTINE_MSG_BUF_RESERVE *pMsgBufReserve;
+static ROUTINE_MSG_BUF_COMMIT *pMsgBufCommit;
 static ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
 ///////////////////////////////////////////////////////////////
 #ifndef _DEBUG
@@ -467,23 +468,30 @@ static BOOL CALLBACK OutMethod(
       if (len == 0)
         return TRUE;
 
-      basic_string<BYTE> line_data;
-      const BYTE *pBuf = pOutMsg->u.buf.pBuf;
       BYTE escapeChar = ((Filter *)hFilter)->escapeChar;
 
+      // nothing to escape
+      if (!memchr(pOutMsg->u.buf.pBuf, escapeChar, len))
+        break;
+
+      BYTE *pOut = pMsgBufReserve(pOutMsg, len*2);
+
+      if (!pOut)
+        return FALSE;
+
+      BYTE *pOutEnd = pOut;
+      const BYTE *pBuf = pOutMsg->u.buf.pBuf;
+
       for (; len ; len--) {
         BYTE ch = *pBuf++;
 
-        line_data.append(&ch, 1);
+        *pOutEnd++ = ch;
 
-        if (ch == escapeChar) {
-          BYTE escape = SERIAL_LSRMST_ESCAPE;
-          line_data.append(&escape, 1);
-        }
+        if (ch == escapeChar)
+          *pOutEnd++ = SERIAL_LSRMST_ESCAPE;
       }
 
-      if (!pMsgReplaceBuf(pOutMsg, HUB_MSG_TYPE_LINE_DATA, line_data.data(), (DWORD)line_data.size()))
-        return FALSE;
+      pMsgBufCommit(pOutMsg, pOut, (DWORD)(pOutEnd - pOut));
 
       break;
     }
@@ -518,15 +526,17 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
     const HUB_ROUTINES_A * pHubRoutines)
 {
   if (!ROUTINE_IS_VALID(pHubRoutines, pMsgInsertBuf) ||
-      !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceBuf) ||
-      !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceNone))
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceNone) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufReserve) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufCommit))
   {
     return NULL;
   }
 
   pMsgInsertBuf = pHubRoutines->pMsgInsertBuf;
-  pMsgReplaceBuf = pHubRoutines->pMsgReplaceBuf;
   pMsgReplaceNone = pHubRoutines->pMsgReplaceNone;
+  pMsgBufReserve = pHubRoutines->pMsgBufReserve;
+  pMsgBufCommit = pHubRoutines->pMsgBufCommit;
 
   return plugins;
 }
@@ -73,7 +73,8 @@ static ROUTINE_MSG_INSERT_VAL *pMsgInsertVal;
 static ROUTINE_MSG_INSERT_NONE *pMsgInsertNone;
 static ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
 static ROUTINE_MSG_INSERT_BUF *pMsgInsertBuf;
-static ROUTINE_MSG_REPLACE_BUF *pMsgReplaceBuf;
+static ROUTINE_MSG_BUF_RESERVE *pMsgBufReserve;
+static ROUTINE_MSG_BUF_COMMIT *pMsgBufCommit;
 static ROUTINE_PORT_NAME_A *pPortName;
 static ROUTINE_FILTER_NAME_A *pFilterName;
 static ROUTINE_FILTERPORT *pFilterPort;
@@ -105,6 +106,8 @@ class State {
         intercepted_options(0),
         maskMst(0),
         maskLsr(0),
+        pOut(NULL),
+        outSize(0),
         _options(0)
     {
       Reset();
@@ -135,6 +138,7 @@ class State {
   private:
     void Reset() { state = subState = 0; }
     HUB_MSG *Flush(HUB_MSG *pMsg);
+    void Put(BYTE ch);
 
     BYTE maskMst;
     BYTE maskLsr;
@@ -142,6 +146,11 @@ class State {
     BYTE code;
     int subState;
     BYTE data[sizeof(ULONG)];
+
+    // the data before the first inserted message is parsed in place
+    BYTE *pOut;
+    DWORD outSize;
+
     basic_string<BYTE> line_data;
 
     DWORD _options;
@@ -149,6 +158,11 @@ class State {
 
 HUB_MSG *State::Flush(HUB_MSG *pMsg)
 {
+  if (pOut) {
+    pMsgBufCommit(pMsg, pOut, outSize);
+    pOut = NULL;
+  }
+  else
   if (!line_data.empty()) {
     pMsg = pMsgInsertBuf(pMsg,
                          HUB_MSG_TYPE_LINE_DATA,
@@ -161,6 +175,14 @@ HUB_MSG *State::Flush(HUB_MSG *pMsg)
   return pMsg;
 }
 
+void State::Put(BYTE ch)
+{
+  if (pOut)
+    pOut[outSize++] = ch;
+  else
+    line_data.append(&ch, 1);
+}
+
 HUB_MSG *State::Convert(BYTE escapeChar, HUB_MSG *pMsg)
 {
   _ASSERTE(pMsg->type == HUB_MSG_TYPE_LINE_DATA);
@@ -169,13 +191,20 @@ HUB_MSG *State::Convert(BYTE escapeChar, HUB_MSG *pMsg)
     return pMsg;
 
   DWORD len = pMsg->u.buf.size;
-  basic_string<BYTE> org(pMsg->u.buf.pBuf, len);
-  const BYTE *pBuf = org.data();
 
-  // discard original data from the stream
-  if (!pMsgReplaceBuf(pMsg, HUB_MSG_TYPE_LINE_DATA, NULL, 0))
+  if (!len)
+    return pMsg;
+
+  pOut = pMsgBufReserve(pMsg, len);
+
+  if (!pOut)
     return NULL;
 
+  outSize = 0;
+
+  // the buffer is not freed on committing since it's pOut
+  const BYTE *pBuf = pMsg->u.buf.pBuf;
+
   for (; len ; len--) {
     BYTE ch = *pBuf++;
 
@@ -188,7 +217,7 @@ HUB_MSG *State::Convert(BYTE escapeChar, HUB_MSG *pMsg)
       case 2:
         switch (code) {
           case SERIAL_LSRMST_ESCAPE:
-            line_data.append(&escapeChar, 1);
+            Put(escapeChar);
             Reset();
             break;
           case SERIAL_LSRMST_LSR_DATA:
@@ -224,7 +253,7 @@ HUB_MSG *State::Convert(BYTE escapeChar, HUB_MSG *pMsg)
                 }
                 if (subState == 2 && ((data[0] & LINE_STATUS_BI) == 0 || ch != 0)) {
                   // insert error character if it is not part of break
-                  line_data.append(&ch, 1);
+                  Put(ch);
                 }
                 Reset();
                 break;
@@ -323,7 +352,7 @@ HUB_MSG *State::Convert(BYTE escapeChar, HUB_MSG *pMsg)
       continue;
     }
 
-    line_data.append(&ch, 1);
+    Put(ch);
   }
 
   return Flush(pMsg);
@@ -666,7 +695,8 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
       !ROUTINE_IS_VALID(pHubRoutines, pMsgInsertNone) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceNone) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgInsertBuf) ||
-      !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceBuf) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufReserve) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufCommit) ||
       !ROUTINE_IS_VALID(pHubRoutines, pPortName) ||
       !ROUTINE_IS_VALID(pHubRoutines, pFilterName) ||
       !ROUTINE_IS_VALID(pHubRoutines, pFilterPort))
@@ -678,7 +708,8 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   pMsgInsertNone = pHubRoutines->pMsgInsertNone;
   pMsgReplaceNone = pHubRoutines->pMsgReplaceNone;
   pMsgInsertBuf = pHubRoutines->pMsgInsertBuf;
-  pMsgReplaceBuf = pHubRoutines->pMsgReplaceBuf;
+  pMsgBufReserve = pHubRoutines->pMsgBufReserve;
+  pMsgBufCommit = pHubRoutines->pMsgBufCommit;
   pPortName = pHubRoutines->pPortName;
   pFilterName = pHubRoutines->pFilterName;
   pFilterPort = pHubRoutines->pFilterPort;
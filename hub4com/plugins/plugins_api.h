@@ -56,6 +56,8 @@ extern "C" {
 #define HUB_MSG_ROUTE_FLOW_CONTROL ((DWORD)0x00008000)
 /*******************************************************************/
 #define HUB_MSG_T2N(t)             ((BYTE)((t) & 0xFF))
+#define HUB_MSG_T2M(t)             (HUB_MSG_T2N(t) < 32 ? ((DWORD)1 << HUB_MSG_T2N(t)) : 0)
+#define HUB_MSG_TYPES_ALL          ((DWORD)0xFFFFFFFF)
 /*******************************************************************/
 #define HUB_MSG_TYPE_EMPTY         (0   | HUB_MSG_UNION_TYPE_NONE)
 #define HUB_MSG_TYPE_LINE_DATA     (1   | HUB_MSG_UNION_TYPE_BUF)
@@ -180,6 +182,12 @@ extern "C" {
 #define HUB_MSG_TYPE_PURGE_TX_IN   (22  | HUB_MSG_UNION_TYPE_NONE)
 #define HUB_MSG_TYPE_PURGE_TX      (23  | HUB_MSG_UNION_TYPE_NONE)
 #define HUB_MSG_TYPE_TICK          (24  | HUB_MSG_UNION_TYPE_HVAL2)
+#define HUB_MSG_TYPE_CREDIT        (25  | HUB_MSG_ROUTE_FLOW_CONTROL | HUB_MSG_UNION_TYPE_VAL | HUB_MSG_VAL_TYPE_UINT)
+/*
+ *      HUB_MSG_TYPE_CREDIT is sent by the port, that returned 0 from
+ *      PORT_GET_WRITE_CREDIT, when the write credit (u.val) is available
+ *      again. The receiving port should recheck ROUTINE_GET_READ_CREDIT.
+ */
 /*******************************************************************/
 typedef struct _HUB_MSG {
   DWORD type;
@@ -208,6 +216,14 @@ DECLARE_HANDLE(HMASTERTIMER);
 DECLARE_HANDLE(HTIMEROWNER);
 DECLARE_HANDLE(HTIMERPARAM);
 DECLARE_HANDLE(HFILTER);
+DECLARE_HANDLE(HMASTERWATCH);
+DECLARE_HANDLE(HWATCHPARAM);
+DECLARE_HANDLE(HDEFERPARAM);
+/*******************************************************************/
+#define WATCH_EVENT_READ    0x01
+#define WATCH_EVENT_WRITE   0x02
+#define WATCH_EVENT_HANGUP  0x04
+#define WATCH_EVENT_ERROR   0x08
 /*******************************************************************/
 typedef struct _ARG_INFO_A {
   size_t size;
@@ -225,6 +241,16 @@ typedef VOID (CALLBACK ROUTINE_BUF_APPEND)(
         DWORD offset,
         const BYTE *pSrc,
         DWORD sizeSrc);
+typedef BOOL (CALLBACK ROUTINE_BUF_UNSHARE)(
+        BYTE **ppBuf,
+        DWORD size);
+/*
+ *      The buffer of HUB_MSG_UNION_TYPE_BUF message can be shared by
+ *      several messages (e.g. routed to several ports). Before modifying
+ *      the data in place call ROUTINE_BUF_UNSHARE to replace *ppBuf by
+ *      the private copy of its first size bytes (if it's shared).
+ *      Returns FALSE if no enough memory (*ppBuf is not changed).
+ */
 typedef BOOL (CALLBACK ROUTINE_MSG_REPLACE_BUF)(
         HUB_MSG *pMsg,
         DWORD type,
@@ -274,6 +300,109 @@ typedef HFILTER (CALLBACK ROUTINE_GET_FILTER)(
         HMASTERFILTERINSTANCE hMasterFilterInstance);
 typedef const ARG_INFO_A *(CALLBACK ROUTINE_GET_ARG_INFO_A)(
         const char *pArg);
+typedef void (CALLBACK WATCH_PROC)(
+        HWATCHPARAM hWatchParam,
+        DWORD events);
+typedef HMASTERWATCH (CALLBACK ROUTINE_WATCH_CREATE)(
+        HMASTERPORT hMasterPort,
+        int fd,
+        WATCH_PROC *pWatchProc,
+        HWATCHPARAM hWatchParam);
+typedef BOOL (CALLBACK ROUTINE_WATCH_SET)(
+        HMASTERWATCH hMasterWatch,
+        DWORD events);
+typedef void (CALLBACK ROUTINE_WATCH_DELETE)(
+        HMASTERWATCH hMasterWatch);
+/*
+ *      The readiness callbacks for the file descriptors (POSIX only,
+ *      ROUTINE_WATCH_CREATE returns NULL on Windows). The pWatchProc is
+ *      called from the loop of hMasterPort's hub with the mask of
+ *      WATCH_EVENT_* events selected by ROUTINE_WATCH_SET (level-
+ *      triggered). WATCH_EVENT_ERROR and the hang up of both directions
+ *      are reported to any watch with not empty events. Several watches
+ *      can be created for the same fd. Call ROUTINE_WATCH_DELETE before
+ *      closing fd.
+ */
+typedef void (CALLBACK DEFER_PROC)(
+        HDEFERPARAM hDeferParam);
+typedef BOOL (CALLBACK ROUTINE_DEFER)(
+        HMASTERPORT hMasterPort,
+        DEFER_PROC *pDeferProc,
+        HDEFERPARAM hDeferParam);
+/*
+ *      Calls pDeferProc(hDeferParam) from the loop of hMasterPort's hub
+ *      as soon as possible (but not from ROUTINE_DEFER itself).
+ */
+typedef void (CALLBACK ROUTINE_JOIN_PORTS)(
+        HMASTERPORT hMasterPort1,
+        HMASTERPORT hMasterPort2);
+/*
+ *      Tells the hub that the ports share the driver's data so they
+ *      should be handled by the same thread (see --threads option).
+ *      Should be called before starting the ports.
+ */
+typedef ULONGLONG (CALLBACK ROUTINE_LATENCY_NOW)();
+typedef void (CALLBACK ROUTINE_ADD_QUEUE_LATENCY)(
+        HMASTERPORT hMasterPort,
+        ULONGLONG start);
+/*
+ *      ROUTINE_LATENCY_NOW returns the current time in microseconds or
+ *      0 if the latency statistics are disabled (see --latency-stats),
+ *      it's enough to check it on starting the port. ROUTINE_ADD_QUEUE_LATENCY
+ *      adds the time elapsed since start (returned by ROUTINE_LATENCY_NOW
+ *      on queuing the data) to the write queue latencies of the port.
+ */
+typedef DWORD (CALLBACK ROUTINE_GET_READ_CREDIT)(
+        HMASTERPORT hMasterPort);
+/*
+ *      Returns the number of bytes the port can read now w/o overrunning
+ *      the write queues of the ports having the flow control route to it
+ *      or HUB_CREDIT_UNLIMITED if not limited (the credit based flow
+ *      control is not enabled, see --credit-fc). The port that returned
+ *      0 should wait for HUB_MSG_TYPE_CREDIT.
+ */
+#define HUB_CREDIT_UNLIMITED ((DWORD)-1)
+typedef BYTE *(CALLBACK ROUTINE_MSG_BUF_RESERVE)(
+        HUB_MSG *pMsg,
+        DWORD sizeMax);
+typedef void (CALLBACK ROUTINE_MSG_BUF_COMMIT)(
+        HUB_MSG *pMsg,
+        BYTE *pBuf,
+        DWORD size);
+/*
+ *      Transforming the data of HUB_MSG_UNION_TYPE_BUF message w/o
+ *      temporary copies. ROUTINE_MSG_BUF_RESERVE returns the buffer for
+ *      up to sizeMax (not 0) bytes of the transformed data, the filter
+ *      reads pMsg->u.buf (after the call) and writes the buffer. If
+ *      sizeMax is not above pMsg->u.buf.size it's the unshared buffer
+ *      of the message itself, so the writing should not overtake the
+ *      reading. Otherwise it's a new buffer from the hub's pool.
+ *      Returns NULL if no enough memory (pMsg is not changed).
+ *      ROUTINE_MSG_BUF_COMMIT replaces the data of pMsg by the first
+ *      size bytes of the buffer returned for it (and frees the old one).
+ *      Use ROUTINE_BUF_FREE to discard the new buffer w/o committing.
+ */
+typedef DWORD (CALLBACK ROUTINE_TICK_COUNT)();
+/*
+ *      Returns the time in ms like GetTickCount() but it's the virtual
+ *      time in the simulation mode (see --virtual-clock). Use it instead
+ *      of GetTickCount() for timing the things driven by the timers.
+ */
+typedef HUB_MSG *(CALLBACK ROUTINE_MSG_INSERT_URGENT)(
+        HUB_MSG *pPrevMsg,
+        const BYTE *pSrc,
+        DWORD sizeSrc);
+typedef BOOL (CALLBACK ROUTINE_MSG_IS_URGENT)(
+        const HUB_MSG *pMsg);
+/*
+ *      ROUTINE_MSG_INSERT_URGENT inserts HUB_MSG_TYPE_LINE_DATA message
+ *      marked as the urgent data (e.g. the protocol commands produced by
+ *      an OUT method), that can be written ahead of the queued data by
+ *      PORT_WRITE_URGENT. The mark is dropped by the hub as soon as the
+ *      message is handled by a next OUT method (it can keep a state of
+ *      the stream), so the data is never reordered after the filters
+ *      following the producer. ROUTINE_MSG_IS_URGENT tests the mark.
+ */
 /*******************************************************************/
 typedef struct _HUB_ROUTINES_A {
   size_t size;
@@ -296,6 +425,20 @@ typedef struct _HUB_ROUTINES_A {
   ROUTINE_FILTERPORT *pFilterPort;
   ROUTINE_GET_FILTER *pGetFilter;
   ROUTINE_GET_ARG_INFO_A *pGetArgInfo;
+  ROUTINE_BUF_UNSHARE *pBufUnshare;
+  ROUTINE_WATCH_CREATE *pWatchCreate;
+  ROUTINE_WATCH_SET *pWatchSet;
+  ROUTINE_WATCH_DELETE *pWatchDelete;
+  ROUTINE_DEFER *pDefer;
+  ROUTINE_JOIN_PORTS *pJoinPorts;
+  ROUTINE_LATENCY_NOW *pLatencyNow;
+  ROUTINE_ADD_QUEUE_LATENCY *pAddQueueLatency;
+  ROUTINE_GET_READ_CREDIT *pGetReadCredit;
+  ROUTINE_TICK_COUNT *pTickCount;
+  ROUTINE_MSG_BUF_RESERVE *pMsgBufReserve;
+  ROUTINE_MSG_BUF_COMMIT *pMsgBufCommit;
+  ROUTINE_MSG_INSERT_URGENT *pMsgInsertUrgent;
+  ROUTINE_MSG_IS_URGENT *pMsgIsUrgent;
 } HUB_ROUTINES_A;
 /*******************************************************************/
 typedef enum _PLUGIN_TYPE {
@@ -367,6 +510,17 @@ typedef BOOL (CALLBACK FILTER_OUT_METHOD)(
         HFILTERINSTANCE hFilterInstance,
         HMASTERPORT hFromPort,
         HUB_MSG *pOutMsg);
+typedef DWORD (CALLBACK FILTER_GET_IN_MSG_TYPES)(
+        HFILTER hFilter);
+typedef DWORD (CALLBACK FILTER_GET_OUT_MSG_TYPES)(
+        HFILTER hFilter);
+/*
+ *      Return the set of message types (combination of HUB_MSG_T2M(type))
+ *      handled by FILTER_IN_METHOD or FILTER_OUT_METHOD. The messages of
+ *      other types will not be passed to the method. The messages with
+ *      HUB_MSG_T2N(type) above 31 are passed always. If the routine is not
+ *      defined then all messages are passed (HUB_MSG_TYPES_ALL).
+ */
 /*******************************************************************/
 typedef struct _FILTER_ROUTINES_A {
   COMMON_PLUGIN_ROUTINES_A
@@ -376,6 +530,8 @@ typedef struct _FILTER_ROUTINES_A {
   FILTER_DELETE_INSTANCE *pDeleteInstance;
   FILTER_IN_METHOD *pInMethod;
   FILTER_OUT_METHOD *pOutMethod;
+  FILTER_GET_IN_MSG_TYPES *pGetInMsgTypes;
+  FILTER_GET_OUT_MSG_TYPES *pGetOutMsgTypes;
 } FILTER_ROUTINES_A;
 /*******************************************************************/
 DECLARE_HANDLE(HPORT);
@@ -401,6 +557,55 @@ typedef BOOL (CALLBACK PORT_WRITE)(
         HUB_MSG *pMsg);
 typedef void (CALLBACK PORT_LOST_REPORT)(
         HPORT hPort);
+typedef BOOL (CALLBACK PORT_WRITE_V)(
+        HPORT hPort,
+        HUB_MSG **ppMsgs,
+        DWORD count);
+/*
+ *      Optional. Write count HUB_MSG_TYPE_LINE_DATA messages in the given
+ *      order at once. As with PORT_WRITE the port can take the buffer of
+ *      any message by changing its type to HUB_MSG_TYPE_EMPTY. If not
+ *      defined then PORT_WRITE is called for each message.
+ */
+typedef DWORD (CALLBACK PORT_GET_WRITE_CREDIT)(
+        HPORT hPort);
+/*
+ *      Optional. Return the number of bytes the port can queue for
+ *      writing w/o overrunning or HUB_CREDIT_UNLIMITED. After returning
+ *      0 the port should send HUB_MSG_TYPE_CREDIT when the credit is
+ *      available again. The port defining this routine should limit
+ *      its reading by ROUTINE_GET_READ_CREDIT and handle the received
+ *      HUB_MSG_TYPE_CREDIT messages, so the hub does not route to it
+ *      HUB_MSG_TYPE_ADD_XOFF_XON from the ports defining this routine
+ *      too (if --credit-fc).
+ */
+typedef BOOL (CALLBACK PORT_WRITE_URGENT)(
+        HPORT hPort,
+        HUB_MSG *pMsg);
+/*
+ *      Optional. Write HUB_MSG_TYPE_LINE_DATA message marked as urgent
+ *      (see ROUTINE_MSG_INSERT_URGENT) ahead of the data queued but not
+ *      started writing yet (the urgent data is written in the given
+ *      order). If not defined then PORT_WRITE is called.
+ */
+/*******************************************************************/
+typedef struct _PORT_STATS {
+  size_t size;
+  DWORD writeQueued;        /* the number of bytes in the write queue  */
+  ULONGLONG writeLost;      /* the total number of lost bytes          */
+  ULONGLONG writeBytes;     /* the total number of bytes passed to the */
+                            /* started write operations                */
+  ULONGLONG writeOps;       /* the total number of the started write   */
+                            /* operations                              */
+} PORT_STATS;
+/*
+ *      The hub sets size and zeroes other items before calling
+ *      PORT_GET_STATS, the port should set only items that pass
+ *      ITEM_IS_VALID().
+ */
+typedef void (CALLBACK PORT_GET_STATS)(
+        HPORT hPort,
+        PORT_STATS *pStats);
 /*******************************************************************/
 typedef struct _PORT_ROUTINES_A {
   COMMON_PLUGIN_ROUTINES_A
@@ -412,6 +617,10 @@ typedef struct _PORT_ROUTINES_A {
   PORT_FAKE_READ_FILTER *pFakeReadFilter;
   PORT_WRITE *pWrite;
   PORT_LOST_REPORT *pLostReport;
+  PORT_GET_STATS *pGetStats;
+  PORT_WRITE_V *pWriteV;
+  PORT_GET_WRITE_CREDIT *pGetWriteCredit;
+  PORT_WRITE_URGENT *pWriteUrgent;
 } PORT_ROUTINES_A;
 /*******************************************************************/
 #define ITEM_IS_VALID(pStruct, item) \
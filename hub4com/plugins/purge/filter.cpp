@@ -252,6 +252,16 @@ static BOOL CALLBACK OutMethod(
   return pOutMsg != NULL;
 }
 ///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetOutMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_SET_OUT_OPTS) |
+         HUB_MSG_T2M(HUB_MSG_TYPE_GET_IN_OPTS) |
+         HUB_MSG_T2M(HUB_MSG_TYPE_FAIL_IN_OPTS) |
+         HUB_MSG_T2M(HUB_MSG_TYPE_PURGE_TX) |
+         HUB_MSG_T2M(HUB_MSG_TYPE_PURGE_TX_IN);
+}
+///////////////////////////////////////////////////////////////
 static const FILTER_ROUTINES_A routines = {
   sizeof(FILTER_ROUTINES_A),
   GetPluginType,
@@ -266,6 +276,8 @@ static const FILTER_ROUTINES_A routines = {
   DeleteInstance,
   NULL,           // InMethod
   OutMethod,
+  NULL,           // GetInMsgTypes
+  GetOutMsgTypes,
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -0,0 +1,57 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _COMPARAMS_H
+#define _COMPARAMS_H
+
+///////////////////////////////////////////////////////////////
+class ComParams
+{
+  public:
+    ComParams()
+      : fast(FALSE),
+        repeat(1),
+        port(-1),
+        burst(16) {}
+
+    void SetFast(BOOL _fast) { fast = _fast; }
+    BOOL Fast() const { return fast; }
+
+    void SetRepeat(DWORD _repeat) { repeat = _repeat; }
+    DWORD Repeat() const { return repeat; }
+
+    void SetPort(int _port) { port = _port; }
+    int Port() const { return port; }
+
+    void SetBurst(DWORD _burst) { burst = _burst; }
+    DWORD Burst() const { return burst; }
+
+  private:
+    BOOL fast;        // ignore the captured timing
+    DWORD repeat;     // passes or 0 for infinite
+    int port;         // the captured port or -1 for all
+    DWORD burst;      // messages per loop iteration if fast
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _COMPARAMS_H
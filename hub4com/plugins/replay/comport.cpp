@@ -0,0 +1,448 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "../plugins_api.h"
+///////////////////////////////////////////////////////////////
+namespace PortReplay {
+///////////////////////////////////////////////////////////////
+#include "comport.h"
+#include "comparams.h"
+#include "import.h"
+///////////////////////////////////////////////////////////////
+//
+// The capture file (see --capture option of the hub) is
+//
+//   'h', '4', 'c', 'C', <version>
+//
+// followed by the records
+//
+//   <port> <time> <type> [<size> <data> | <val>]
+//
+// where the numbers are unsigned LEB128 and <time> is
+// microseconds since the previous record.
+//
+///////////////////////////////////////////////////////////////
+#define HEADER_SIZE     5
+#define CAPTURE_VERSION 1
+///////////////////////////////////////////////////////////////
+static DWORD TickCount()
+{
+  // follow the virtual clock of the hub (if any)
+  return pTickCount ? pTickCount() : ::GetTickCount();
+}
+///////////////////////////////////////////////////////////////
+ComPort::ComPort(const ComParams &comParams, const char *pPath)
+  : valid(FALSE),
+    name("REPLAY"),
+    hMasterPort(NULL),
+    fast(comParams.Fast()),
+    repeat(comParams.Repeat()),
+    port(comParams.Port()),
+    burst(comParams.Burst()),
+    pos(HEADER_SIZE),
+    time(0),
+    pending(FALSE),
+    pass(0),
+    passMsgs(0),
+    countXoff(0),
+    deferred(FALSE),
+    stopped(FALSE),
+    hTimer(NULL),
+    passTime(0),
+    passTick(0),
+    xoffTick(0),
+    startTick(0),
+    reportTick(0),
+    bytes(0),
+    msgs(0),
+    reportBytes(0),
+    reportMsgs(0)
+{
+  valid = Load(pPath);
+}
+
+BOOL ComPort::Load(const char *pPath)
+{
+  ifstream file(pPath, ios::in | ios::binary);
+
+  if (!file.is_open()) {
+    cerr << "Can't open capture file " << pPath << endl;
+    return FALSE;
+  }
+
+  file.seekg(0, ios::end);
+  streamoff size = file.tellg();
+  file.seekg(0, ios::beg);
+
+  if (size < HEADER_SIZE) {
+    cerr << "Invalid capture file " << pPath << endl;
+    return FALSE;
+  }
+
+  data.resize((size_t)size);
+
+  if (!file.read((char *)&data[0], size)) {
+    cerr << "Can't read capture file " << pPath << endl;
+    return FALSE;
+  }
+
+  if (data[0] != 'h' || data[1] != '4' || data[2] != 'c' || data[3] != 'C' ||
+      data[4] != CAPTURE_VERSION)
+  {
+    cerr << "Invalid capture file " << pPath << " (unknown format)" << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+BOOL ComPort::Init(HMASTERPORT _hMasterPort)
+{
+  hMasterPort = _hMasterPort;
+
+  return TRUE;
+}
+
+BOOL ComPort::Start()
+{
+  _ASSERTE(hMasterPort != NULL);
+
+  startTick = reportTick = TickCount();
+
+  pending = ReadRecord();
+
+  if (!pending) {
+    if (!stopped)
+      cerr << name << " WARNING: No messages to replay" << endl;
+
+    Stop();
+    return TRUE;
+  }
+
+  passTime = rec.time;
+  passTick = startTick;
+
+  if (fast) {
+    Defer();
+    return TRUE;
+  }
+
+  hTimer = pTimerCreate((HTIMEROWNER)this);
+
+  if (!hTimer) {
+    cerr << name << " Can't create timer" << endl;
+    return FALSE;
+  }
+
+  ReplayTimed();
+
+  return TRUE;
+}
+
+BOOL ComPort::GetNumber(ULONGLONG *pNum)
+{
+  ULONGLONG num = 0;
+
+  for (int shift = 0 ; pos < data.size() && shift < 64 ; shift += 7) {
+    BYTE b = data[pos++];
+
+    num |= (ULONGLONG)(b & 0x7F) << shift;
+
+    if (!(b & 0x80)) {
+      *pNum = num;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+BOOL ComPort::ReadRecord()
+{
+  while (pos < data.size()) {
+    ULONGLONG recPort, recTime, recType, val = 0, size = 0;
+    const BYTE *pData = NULL;
+
+    BOOL ok = GetNumber(&recPort) && GetNumber(&recTime) && GetNumber(&recType);
+
+    if (ok) {
+      switch ((DWORD)recType & HUB_MSG_UNION_TYPES_MASK) {
+        case HUB_MSG_UNION_TYPE_BUF:
+          ok = GetNumber(&size) && size <= data.size() - pos;
+
+          if (ok) {
+            pData = &data[0] + pos;
+            pos += (size_t)size;
+          }
+          break;
+        case HUB_MSG_UNION_TYPE_VAL:
+          ok = GetNumber(&val);
+          break;
+      }
+    }
+
+    if (!ok) {
+      cerr << name << " Invalid capture record at offset " << pos << endl;
+      Stop();
+      return FALSE;
+    }
+
+    time += recTime;
+
+    if (port >= 0 && recPort != (ULONGLONG)port)
+      continue;
+
+    rec.port = (int)recPort;
+    rec.time = time;
+    rec.type = (DWORD)recType;
+    rec.val = (DWORD)val;
+    rec.pData = pData;
+    rec.size = (DWORD)size;
+
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+BOOL ComPort::NextPass()
+{
+  if (stopped || !passMsgs || (repeat && ++pass >= repeat)) {
+    Stop();
+    return FALSE;
+  }
+
+  pos = HEADER_SIZE;
+  time = 0;
+  passMsgs = 0;
+
+  pending = ReadRecord();
+  passTime = pending ? rec.time : 0;
+  passTick = TickCount();
+
+  return pending;
+}
+
+void ComPort::Stop()
+{
+  if (stopped)
+    return;
+
+  stopped = TRUE;
+  pending = FALSE;
+
+  if (hTimer)
+    pTimerCancel(hTimer);
+
+  Report("Stopped", TickCount() - startTick, bytes, msgs);
+}
+
+void ComPort::Defer()
+{
+  if (deferred || stopped || countXoff > 0)
+    return;
+
+  if (pDefer(hMasterPort, OnDefer, (HDEFERPARAM)this))
+    deferred = TRUE;
+}
+
+void CALLBACK ComPort::OnDefer(HDEFERPARAM hDeferParam)
+{
+  ComPort *pPort = (ComPort *)hDeferParam;
+
+  _ASSERTE(pPort != NULL);
+
+  pPort->deferred = FALSE;
+  pPort->ReplayFast();
+  pPort->Defer();
+}
+
+void ComPort::ReplayFast()
+{
+  for (DWORD num = burst ; num && countXoff <= 0 ; num--) {
+    if (!pending && !NextPass())
+      break;
+
+    Send();
+  }
+}
+
+void ComPort::ReplayTimed()
+{
+  if (stopped || countXoff > 0)
+    return;
+
+  while (countXoff <= 0) {
+    if (!pending && !NextPass())
+      break;
+
+    DWORD due = (DWORD)((rec.time - passTime) / 1000);
+    DWORD elapsed = TickCount() - passTick;
+
+    if (elapsed < due) {
+      LARGE_INTEGER dueTime;
+
+      dueTime.QuadPart = -10000LL * (due - elapsed);
+
+      if (!pTimerSet(hTimer, hMasterPort, &dueTime, 0, (HTIMERPARAM)hTimer)) {
+        cerr << name << " Can't set timer" << endl;
+        Stop();
+      }
+
+      break;
+    }
+
+    Send();
+  }
+}
+
+void ComPort::Send()
+{
+  _ASSERTE(pending);
+
+  HUB_MSG msg;
+
+  msg.type = rec.type;
+
+  switch (rec.type & HUB_MSG_UNION_TYPES_MASK) {
+    case HUB_MSG_UNION_TYPE_BUF:
+      msg.u.buf.pBuf = pBufAlloc(rec.size);
+
+      if (!msg.u.buf.pBuf) {
+        msg.u.buf.size = 0;
+        break;
+      }
+
+      if (rec.size)
+        memcpy(msg.u.buf.pBuf, rec.pData, rec.size);
+
+      msg.u.buf.size = rec.size;
+
+      if (rec.type == HUB_MSG_TYPE_LINE_DATA)
+        bytes += rec.size;
+      break;
+    case HUB_MSG_UNION_TYPE_VAL:
+      msg.u.val = rec.val;
+      break;
+    default:
+      msg.u.val = 0;
+  }
+
+  msgs++;
+  passMsgs++;
+
+  // read the next record before sending since the port can be
+  // suspended by the sending
+  pending = ReadRecord();
+
+  pOnRead(hMasterPort, &msg);
+}
+
+BOOL ComPort::FakeReadFilter(HUB_MSG *pInMsg)
+{
+  _ASSERTE(pInMsg != NULL);
+
+  switch (HUB_MSG_T2N(pInMsg->type)) {
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LOOP_TEST):
+      pInMsg->u.hVal = (HANDLE)hMasterPort;
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_TICK):
+      if (pInMsg->u.hv2.hVal0 == (HANDLE)this && pInMsg->u.hv2.hVal1 == (HANDLE)hTimer)
+        ReplayTimed();
+      break;
+  }
+
+  return pInMsg != NULL;
+}
+
+BOOL ComPort::Write(HUB_MSG *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+
+  switch (HUB_MSG_T2N(pMsg->type)) {
+    case HUB_MSG_T2N(HUB_MSG_TYPE_SET_OUT_OPTS):
+      if (pMsg->u.val) {
+        cerr << name << " WARNING: Requested output option(s) [0x"
+             << hex << pMsg->u.val << dec
+             << "] will be ignored by driver" << endl;
+      }
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_ADD_XOFF_XON):
+      if (pMsg->u.val) {
+        if (countXoff++ == 0)
+          xoffTick = TickCount();
+      } else {
+        if (--countXoff != 0)
+          break;
+
+        if (fast) {
+          Defer();
+        }
+        else
+        if (hTimer && !stopped) {
+          // shift the timing by the suspended time and resume by timer
+          passTick += TickCount() - xoffTick;
+
+          LARGE_INTEGER dueTime;
+
+          dueTime.QuadPart = 0;
+
+          pTimerSet(hTimer, hMasterPort, &dueTime, 0, (HTIMERPARAM)hTimer);
+        }
+      }
+      break;
+  }
+
+  return TRUE;
+}
+
+void ComPort::LostReport()
+{
+  DWORD tick = TickCount();
+
+  if (!stopped)
+    Report("Replayed", tick - reportTick, bytes - reportBytes, msgs - reportMsgs);
+
+  reportTick = tick;
+  reportBytes = bytes;
+  reportMsgs = msgs;
+}
+
+void ComPort::Report(const char *pTitle, DWORD interval, ULONGLONG _bytes, ULONGLONG _msgs) const
+{
+  if (!interval)
+    interval = 1;
+
+  // in hundredths of MB/s
+  ULONGLONG mbps = _bytes * 100000 / interval / (1024*1024);
+
+  cout << name << " " << pTitle << " " << _bytes << " bytes, " << _msgs << " msgs in "
+       << (interval / 1000) << "." << setfill('0') << setw(3) << (interval % 1000) << " s: "
+       << (mbps / 100) << "." << setw(2) << (mbps % 100) << setfill(' ') << " MB/s, "
+       << (_msgs * 1000 / interval) << " msgs/s"
+       << endl;
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
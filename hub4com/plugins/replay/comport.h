@@ -0,0 +1,103 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _COMPORT_H
+#define _COMPORT_H
+
+///////////////////////////////////////////////////////////////
+class ComParams;
+///////////////////////////////////////////////////////////////
+class ComPort
+{
+  public:
+    ComPort(const ComParams &comParams, const char *pPath);
+
+    BOOL IsValid() const { return valid; }
+    BOOL Init(HMASTERPORT _hMasterPort);
+    BOOL Start();
+    BOOL FakeReadFilter(HUB_MSG *pInMsg);
+    BOOL Write(HUB_MSG *pMsg);
+    void LostReport();
+
+    const string &Name() const { return name; }
+    void Name(const char *pName) { name = pName; }
+
+  private:
+    struct Record {
+      int port;
+      ULONGLONG time;     // microseconds since the capture start
+      DWORD type;
+      DWORD val;
+      const BYTE *pData;
+      DWORD size;
+    };
+
+    static void CALLBACK OnDefer(HDEFERPARAM hDeferParam);
+
+    BOOL Load(const char *pPath);
+    BOOL GetNumber(ULONGLONG *pNum);
+    BOOL ReadRecord();
+    BOOL NextPass();
+    void Stop();
+    void Defer();
+    void ReplayFast();
+    void ReplayTimed();
+    void Send();
+    void Report(const char *pTitle, DWORD interval, ULONGLONG bytes, ULONGLONG msgs) const;
+
+    BOOL valid;
+    string name;
+    HMASTERPORT hMasterPort;
+
+    BOOL fast;
+    DWORD repeat;
+    int port;
+    DWORD burst;
+
+    // the capture
+    vector<BYTE> data;
+    size_t pos;
+    ULONGLONG time;
+    Record rec;
+    BOOL pending;
+
+    DWORD pass;
+    ULONGLONG passMsgs;
+    int countXoff;
+    BOOL deferred;
+    BOOL stopped;
+    HMASTERTIMER hTimer;
+    ULONGLONG passTime;   // the capture time of the pass start
+    DWORD passTick;       // the tick count of the pass start
+    DWORD xoffTick;
+
+    DWORD startTick;
+    DWORD reportTick;
+    ULONGLONG bytes;
+    ULONGLONG msgs;
+    ULONGLONG reportBytes;
+    ULONGLONG reportMsgs;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _COMPORT_H
@@ -0,0 +1,325 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "../plugins_api.h"
+///////////////////////////////////////////////////////////////
+namespace PortReplay {
+///////////////////////////////////////////////////////////////
+#include "comport.h"
+#include "comparams.h"
+#include "import.h"
+///////////////////////////////////////////////////////////////
+static const char *GetParam(const char *pArg, const char *pPattern)
+{
+  size_t lenPattern = strlen(pPattern);
+
+  if (_strnicmp(pArg, pPattern, lenPattern) != 0)
+    return NULL;
+
+  return pArg + lenPattern;
+}
+
+static BOOL GetNumber(const char *pParam, DWORD *pNum)
+{
+  if (!isdigit((unsigned char)*pParam))
+    return FALSE;
+
+  char *pEnd;
+  unsigned long num = strtoul(pParam, &pEnd, 10);
+
+  if (*pEnd)
+    return FALSE;
+
+  *pNum = (DWORD)num;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static PLUGIN_TYPE CALLBACK GetPluginType()
+{
+  return PLUGIN_TYPE_DRIVER;
+}
+///////////////////////////////////////////////////////////////
+static const PLUGIN_ABOUT_A about = {
+  sizeof(PLUGIN_ABOUT_A),
+  "replay",
+  "Copyright (c) 2009 Vyacheslav Frolov",
+  "GNU General Public License",
+  "Capture replaying port driver",
+};
+
+static const PLUGIN_ABOUT_A * CALLBACK GetPluginAbout()
+{
+  return &about;
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK Help(const char *pProgPath)
+{
+  cerr
+  << "Usage:" << endl
+  << "  " << pProgPath << " ... --use-driver=" << GetPluginAbout()->pName << " [options] <file> ..." << endl
+  << endl
+  << "  The port reads the messages from the capture file <file> (see --capture" << endl
+  << "  option) in the original order and reports the throughput. It does not need" << endl
+  << "  any hardware." << endl
+  << endl
+  << "Options:" << endl
+  << "  --fast                   - replay as fast as possible (the captured timing" << endl
+  << "                             is used by default)." << endl
+  << "  --no-fast                - use the captured timing." << endl
+  << "  --repeat=<n>             - replay the capture <n> times (1 by default, 0" << endl
+  << "                             means forever)." << endl
+  << "  --port=<n>               - replay only the messages read from the port with" << endl
+  << "                             zero based position number <n> (all by default)." << endl
+  << "  --burst=<n>              - replay <n> messages per loop iteration if --fast" << endl
+  << "                             (16 by default)." << endl
+  << endl
+  << "  The options above are applied to the following ports." << endl
+  << endl
+  << "Output data stream description:" << endl
+  << "  ADD_XOFF_XON(<val>)      - suspend/resume replaying." << endl
+  << endl
+  << "Input data stream description:" << endl
+  << "  <msg>                    - the captured messages." << endl
+  << endl
+  << "Examples:" << endl
+  << "  " << pProgPath << " --capture=com1.cap --bi-route=0:1 COM1 --use-driver=tcp *remote.host:2000" << endl
+  << "  " << pProgPath << " --use-driver=replay --port=0 com1.cap --use-driver=tcp *remote.host:2000" << endl
+  << "    - capture the traffic between COM1 and TCP port once and replay the data" << endl
+  << "      received from COM1 with the original timing." << endl
+  << "  " << pProgPath << " --capture=bench.cap --use-driver=bench --route=0:1 --duration=10 source sink" << endl
+  << "  " << pProgPath << " --use-driver=replay --route=0:1 --fast --port=0 bench.cap --use-driver=bench sink" << endl
+  << "    - capture the data generated for 10 seconds and replay it as fast as" << endl
+  << "      possible." << endl
+  ;
+}
+///////////////////////////////////////////////////////////////
+static HCONFIG CALLBACK ConfigStart()
+{
+  ComParams *pComParams = new ComParams;
+
+  if (!pComParams) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
+  return (HCONFIG)pComParams;
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Config(
+    HCONFIG hConfig,
+    const char *pArg)
+{
+  _ASSERTE(hConfig != NULL);
+
+  ComParams &comParams = *(ComParams *)hConfig;
+
+  const char *pParam;
+  DWORD num;
+
+  if (_stricmp(pArg, "--fast") == 0) {
+    comParams.SetFast(TRUE);
+  } else
+  if (_stricmp(pArg, "--no-fast") == 0) {
+    comParams.SetFast(FALSE);
+  } else
+  if ((pParam = GetParam(pArg, "--repeat=")) != NULL) {
+    if (!GetNumber(pParam, &num)) {
+      cerr << "Invalid repeat value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetRepeat(num);
+  } else
+  if ((pParam = GetParam(pArg, "--port=")) != NULL) {
+    if (!GetNumber(pParam, &num) || (int)num < 0) {
+      cerr << "Invalid port value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetPort((int)num);
+  } else
+  if ((pParam = GetParam(pArg, "--burst=")) != NULL) {
+    if (!GetNumber(pParam, &num) || num < 1) {
+      cerr << "Invalid burst value in " << pArg << endl;
+      exit(1);
+    }
+
+    comParams.SetBurst(num);
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK ConfigStop(
+    HCONFIG hConfig)
+{
+  _ASSERTE(hConfig != NULL);
+
+  delete (ComParams *)hConfig;
+}
+///////////////////////////////////////////////////////////////
+static HPORT CALLBACK Create(
+    HCONFIG hConfig,
+    const char *pPath)
+{
+  _ASSERTE(hConfig != NULL);
+
+  ComPort *pPort = new ComPort(*(const ComParams *)hConfig, pPath);
+
+  if (!pPort)
+    return NULL;
+
+  if (!pPort->IsValid()) {
+    delete pPort;
+    return NULL;
+  }
+
+  return (HPORT)pPort;
+}
+///////////////////////////////////////////////////////////////
+static const char *CALLBACK GetPortName(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  return ((ComPort *)hPort)->Name().c_str();
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK SetPortName(
+    HPORT hPort,
+    const char *pName)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pName != NULL);
+
+  ((ComPort *)hPort)->Name(pName);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Init(
+    HPORT hPort,
+    HMASTERPORT hMasterPort)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(hMasterPort != NULL);
+
+  return ((ComPort *)hPort)->Init(hMasterPort);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Start(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  return ((ComPort *)hPort)->Start();
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK FakeReadFilter(
+    HPORT hPort,
+    HUB_MSG *pMsg)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pMsg != NULL);
+
+  return ((ComPort *)hPort)->FakeReadFilter(pMsg);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK Write(
+    HPORT hPort,
+    HUB_MSG *pMsg)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pMsg != NULL);
+
+  return ((ComPort *)hPort)->Write(pMsg);
+}
+///////////////////////////////////////////////////////////////
+static void CALLBACK LostReport(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  ((ComPort *)hPort)->LostReport();
+}
+///////////////////////////////////////////////////////////////
+static const PORT_ROUTINES_A routines = {
+  sizeof(PORT_ROUTINES_A),
+  GetPluginType,
+  GetPluginAbout,
+  Help,
+  ConfigStart,
+  Config,
+  ConfigStop,
+  Create,
+  GetPortName,
+  SetPortName,
+  Init,
+  Start,
+  FakeReadFilter,
+  Write,
+  LostReport,
+};
+
+static const PLUGIN_ROUTINES_A *const plugins[] = {
+  (const PLUGIN_ROUTINES_A *)&routines,
+  NULL
+};
+///////////////////////////////////////////////////////////////
+ROUTINE_BUF_ALLOC *pBufAlloc;
+ROUTINE_ON_READ *pOnRead;
+ROUTINE_TIMER_CREATE *pTimerCreate;
+ROUTINE_TIMER_SET *pTimerSet;
+ROUTINE_TIMER_CANCEL *pTimerCancel;
+ROUTINE_DEFER *pDefer;
+ROUTINE_TICK_COUNT *pTickCount;
+///////////////////////////////////////////////////////////////
+PLUGIN_INIT_A InitA;
+const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
+    const HUB_ROUTINES_A * pHubRoutines)
+{
+  if (!ROUTINE_IS_VALID(pHubRoutines, pBufAlloc) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pOnRead) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCreate) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerSet) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCancel) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pDefer))
+  {
+    return NULL;
+  }
+
+  pBufAlloc = pHubRoutines->pBufAlloc;
+  pOnRead = pHubRoutines->pOnRead;
+  pTimerCreate = pHubRoutines->pTimerCreate;
+  pTimerSet = pHubRoutines->pTimerSet;
+  pTimerCancel = pHubRoutines->pTimerCancel;
+  pDefer = pHubRoutines->pDefer;
+  pTickCount = ROUTINE_GET(pHubRoutines, pTickCount);
+
+  return plugins;
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
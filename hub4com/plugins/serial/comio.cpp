@@ -886,6 +886,19 @@ DWORD ComIo::SetEscMode(DWORD escOptions, BYTE **ppBuf, DWORD *pDone)
   return escOptions & ~ESC_OPTS_V2O_ESCCHAR(-1);
 }
 ///////////////////////////////////////////////////////////////
+#define IOCTL_SERIAL_GET_STATS          CTL_CODE(FILE_DEVICE_SERIAL_PORT,35,METHOD_BUFFERED,FILE_ANY_ACCESS)
+
+BOOL ComIo::GetPerfStats(SERIALPERF_STATS &stats)
+{
+  DWORD returned;
+
+  return DeviceIoControl(handle,
+                         IOCTL_SERIAL_GET_STATS,
+                         NULL, 0,
+                         &stats, sizeof(stats), &returned,
+                         NULL);
+}
+///////////////////////////////////////////////////////////////
 VOID CALLBACK WriteOverlapped::OnWrite(
     DWORD err,
     DWORD done,
@@ -911,14 +924,15 @@ void WriteOverlapped::BufFree()
 {
   _ASSERTE(pBuf != NULL);
 
-  pBufFree(pBuf);
+  if (owned)
+    pBufFree(pBuf);
 
 #ifdef _DEBUG
   pBuf = NULL;
 #endif
 }
 
-BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len)
+BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len, BOOL _owned)
 {
   _ASSERTE(pBuf == NULL);
 
@@ -937,13 +951,16 @@ BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len)
 
   pBuf = _pBuf;
   len = _len;
+  owned = _owned;
 
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
 ReadOverlapped::ReadOverlapped(ComIo &_comIo)
   : comIo(_comIo),
-    pBuf(NULL)
+    pBuf(NULL),
+    len(0),
+    seq(0)
 {
 }
 
@@ -973,21 +990,24 @@ VOID CALLBACK ReadOverlapped::OnRead(
   BYTE *pInBuf = pOver->pBuf;
   pOver->pBuf = NULL;
 
-  pOver->comIo.port.OnRead(pOver, pInBuf, done);
+  pOver->comIo.port.OnRead(pOver, pInBuf, pOver->len, done);
 }
 
-BOOL ReadOverlapped::StartRead()
+BOOL ReadOverlapped::StartRead(DWORD _len, DWORD _seq)
 {
   ::memset((OVERLAPPED *)this, 0, sizeof(OVERLAPPED));
 
-  #define readBufSize 64
+  _ASSERTE(_len > 0);
+
+  len = _len;
+  seq = _seq;
 
-  pBuf = pBufAlloc(readBufSize);
+  pBuf = pBufAlloc(len);
 
   if (!pBuf)
     return FALSE;
 
-  if (!::ReadFileEx(comIo.Handle(), pBuf, readBufSize, this, OnRead)) {
+  if (!::ReadFileEx(comIo.Handle(), pBuf, len, this, OnRead)) {
     TraceError(GetLastError(), "ReadOverlapped::StartRead(): ReadFileEx() %s", comIo.port.Name().c_str());
     return FALSE;
   }
@@ -998,22 +1018,15 @@ BOOL ReadOverlapped::StartRead()
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
-static HANDLE hThread = INVALID_HANDLE_VALUE;
-#ifdef _DEBUG
-static DWORD idThread;
-#endif  /* _DEBUG */
+static DWORD tlsThread = ::TlsAlloc();
 
-static BOOL SetThread()
+static HANDLE GetThread()
 {
-#ifdef _DEBUG
-  if (hThread == INVALID_HANDLE_VALUE) {
-    idThread = ::GetCurrentThreadId();
-  } else {
-    _ASSERTE(idThread == ::GetCurrentThreadId());
-  }
-#endif  /* _DEBUG */
+  // the ports of the hub can be handled by several threads so
+  // the events of each port are queued to the thread of the port
+  HANDLE hThread = (HANDLE)::TlsGetValue(tlsThread);
 
-  if (hThread == INVALID_HANDLE_VALUE) {
+  if (!hThread) {
     if (!::DuplicateHandle(::GetCurrentProcess(),
                            ::GetCurrentThread(),
                            ::GetCurrentProcess(),
@@ -1022,24 +1035,25 @@ static BOOL SetThread()
                            FALSE,
                            DUPLICATE_SAME_ACCESS))
     {
-      hThread = INVALID_HANDLE_VALUE;
-
       TraceError(
           GetLastError(),
-          "SetThread(): DuplicateHandle()");
+          "GetThread(): DuplicateHandle()");
 
-      return FALSE;
+      return NULL;
     }
+
+    ::TlsSetValue(tlsThread, hThread);
   }
 
-  return TRUE;
+  return hThread;
 }
 ///////////////////////////////////////////////////////////////
 WaitCommEventOverlapped::WaitCommEventOverlapped(ComIo &_comIo)
   : comIo(_comIo),
+    hThread(GetThread()),
     hWait(INVALID_HANDLE_VALUE)
 {
-  if (!SetThread())
+  if (!hThread)
       return;
 
   ::memset((OVERLAPPED *)this, 0, sizeof(OVERLAPPED));
@@ -1095,7 +1109,7 @@ VOID CALLBACK WaitCommEventOverlapped::OnCommEvent(
     BOOLEAN /*timerOrWaitFired*/)
 {
   ((WaitCommEventOverlapped *)pOverlapped)->LockDelete();
-  if (!::QueueUserAPC(OnCommEvent, hThread, (ULONG_PTR)pOverlapped))
+  if (!::QueueUserAPC(OnCommEvent, ((WaitCommEventOverlapped *)pOverlapped)->hThread, (ULONG_PTR)pOverlapped))
     ((WaitCommEventOverlapped *)pOverlapped)->UnockDelete();
 }
 
@@ -168,6 +168,19 @@ struct SERIAL_CHARS {
   UCHAR XoffChar;
 };
 ///////////////////////////////////////////////////////////////
+struct SERIALPERF_STATS {
+  ULONG ReceivedCount;
+  ULONG TransmittedCount;
+  ULONG FrameErrorCount;
+  ULONG SerialOverrunErrorCount;
+  ULONG BufferOverrunErrorCount;
+  ULONG ParityErrorCount;
+};
+///////////////////////////////////////////////////////////////
+class ReadOverlapped;
+class WriteOverlapped;
+class WaitCommEventOverlapped;
+///////////////////////////////////////////////////////////////
 class ComIo
 {
   public:
@@ -175,8 +188,28 @@ class ComIo
       : port(_port)
       , countStartedOverlaps(0)
       , path(pPath)
+#ifdef _WIN32
       , handle(INVALID_HANDLE_VALUE)
       , handleClosing(INVALID_HANDLE_VALUE)
+#else  /* _WIN32 */
+      , fd(-1)
+      , fdClosing(-1)
+      , broken(FALSE)
+      , hWatch(NULL)
+      , timerFd(-1)
+      , hTimerWatch(NULL)
+      , pWaitCommEvent(NULL)
+      , events(0)
+      , noModemStatus(FALSE)
+      , modemStatus(0)
+      , noModemWait(FALSE)
+      , modemWaitStarted(FALSE)
+      , modemWaitStop(FALSE)
+      , modemWaitExited(FALSE)
+      , modemWaitError(0)
+      , modemWaitFd(-1)
+      , hModemWaitWatch(NULL)
+#endif  /* _WIN32 */
       , notifyOnFree(FALSE)
       , hasExtendedModemControl(FALSE)
       , pinStateValue(0)
@@ -209,9 +242,26 @@ class ComIo
     DWORD SetBaudRate(DWORD baudRate);
     DWORD SetLineControl(DWORD lineControl);
     DWORD SetEscMode(DWORD escOptions, BYTE **ppBuf, DWORD *pDone);
+    BOOL GetPerfStats(SERIALPERF_STATS &stats);
+#ifdef _WIN32
     void PurgeWrite() { ::PurgeComm(handle, PURGE_TXABORT|PURGE_TXCLEAR); }
+    BOOL GetModemStatus(DWORD *pStat) { return ::GetCommModemStatus(handle, pStat); }
+    BOOL ClearErrors(DWORD *pErrors) { return ::ClearCommError(handle, pErrors, NULL); }
 
     HANDLE Handle() const { return handle; }
+#else  /* _WIN32 */
+    void PurgeWrite();
+    BOOL GetModemStatus(DWORD *pStat);
+    BOOL ClearErrors(DWORD *pErrors);
+
+    HANDLE Handle() const { return fd >= 0 ? (HANDLE)(ULONG_PTR)fd : INVALID_HANDLE_VALUE; }
+
+    // used by the overlapped objects (the completions are reported
+    // from the hub's loop and never from the Start*() routines)
+    BOOL StartRead(ReadOverlapped *pOverlapped);
+    BOOL StartWrite(WriteOverlapped *pOverlapped);
+    BOOL StartWaitCommEvent(WaitCommEventOverlapped *pOverlapped);
+#endif  /* _WIN32 */
     const string &Path() const { return path; }
     DWORD BaudRate() const { return serialBaudRate.BaudRate; }
     DWORD LineControl() const {
@@ -233,8 +283,56 @@ class ComIo
 
     string path;
 
+#ifdef _WIN32
     HANDLE handle;
     HANDLE handleClosing;
+#else  /* _WIN32 */
+    BOOL WatchUpdate();
+    void Abort();
+    BOOL GetCounters(SERIALPERF_STATS &stats, ULONG &breaks);
+    DWORD PollComEvents(DWORD polled);
+    BOOL WaitUpdate();
+    BOOL TimerSet(DWORD period);
+    void TimerStop();
+    BOOL ModemWaitStart();
+    void ModemWaitStop();
+    void ModemWaitKick();
+    void OnWatch(DWORD watchEvents);
+    void OnTimer();
+    void OnModemWait();
+    static void CALLBACK WatchProc(HWATCHPARAM hWatchParam, DWORD watchEvents);
+    static void CALLBACK TimerProc(HWATCHPARAM hWatchParam, DWORD watchEvents);
+    static void CALLBACK ModemWaitProc(HWATCHPARAM hWatchParam, DWORD watchEvents);
+    static void *ModemWaitThread(void *pParam);
+
+    int fd;
+    int fdClosing;
+    BOOL broken;                // the reading failed, do not restart it
+
+    HMASTERWATCH hWatch;
+    deque<ReadOverlapped *> reads;
+    deque<WriteOverlapped *> writes;
+
+    int timerFd;                // the modem status and errors polling
+    HMASTERWATCH hTimerWatch;
+    WaitCommEventOverlapped *pWaitCommEvent;
+    DWORD events;
+    BOOL noModemStatus;
+    DWORD modemStatus;
+    SERIALPERF_STATS statsPolled;
+    ULONG breaksPolled;
+    SERIALPERF_STATS statsCleared;
+    ULONG breaksCleared;
+
+    BOOL noModemWait;           // TIOCMIWAIT is not supported, poll
+    BOOL modemWaitStarted;      // modemWaitThread is not joined
+    volatile BOOL modemWaitStop;
+    volatile BOOL modemWaitExited;
+    volatile int modemWaitError;
+    pthread_t modemWaitThread;  // waits the modem status by TIOCMIWAIT
+    int modemWaitFd;            // eventfd signaled by modemWaitThread
+    HMASTERWATCH hModemWaitWatch;
+#endif  /* _WIN32 */
     BOOL notifyOnFree;
 
     BOOL hasExtendedModemControl;
@@ -246,7 +344,9 @@ class ComIo
     SERIAL_LINE_CONTROL serialLineControl;
     SERIAL_HANDFLOW serialHandFlow;
     SERIAL_CHARS serialChars;
+#ifdef _WIN32
     COMMTIMEOUTS timeouts;
+#endif  /* _WIN32 */
 
 #ifdef _DEBUG
   private:
@@ -256,27 +356,46 @@ class ComIo
 #endif  /* _DEBUG */
 };
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class ReadOverlapped : private OVERLAPPED
+#else  /* _WIN32 */
+class ReadOverlapped
+#endif  /* _WIN32 */
 {
   public:
     ReadOverlapped(ComIo &_comIo);
     ~ReadOverlapped();
-    BOOL StartRead();
+    BOOL StartRead(DWORD _len, DWORD _seq);
+    DWORD Seq() const { return seq; }
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnRead(
         DWORD err,
         DWORD done,
         LPOVERLAPPED pOverlapped);
+#else  /* _WIN32 */
+    static void CALLBACK OnRead(HDEFERPARAM hDeferParam);
+
+    DWORD done;
+
+    friend class ComIo;
+#endif  /* _WIN32 */
 
     ComIo &comIo;
     BYTE *pBuf;
+    DWORD len;
+    DWORD seq;      // the order of the read among the started ones
 };
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class WriteOverlapped : private OVERLAPPED
+#else  /* _WIN32 */
+class WriteOverlapped
+#endif  /* _WIN32 */
 {
   public:
-    WriteOverlapped(ComIo &_comIo) : comIo(_comIo) {
+    WriteOverlapped(ComIo &_comIo) : comIo(_comIo), owned(TRUE) {
 #ifdef _DEBUG
       pBuf = NULL;
 #endif
@@ -287,18 +406,31 @@ class WriteOverlapped : private OVERLAPPED
     }
 #endif
 
-    BOOL StartWrite(BYTE *_pBuf, DWORD _len);
+    // the buffer will be freed on completion if _owned
+    BOOL StartWrite(BYTE *_pBuf, DWORD _len, BOOL _owned = TRUE);
+
+    BOOL Owned() const { return owned; }
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnWrite(
       DWORD err,
       DWORD done,
       LPOVERLAPPED pOverlapped);
+#else  /* _WIN32 */
+    BOOL Send(int fd);
+    static void CALLBACK OnWrite(HDEFERPARAM hDeferParam);
+
+    DWORD done;
+
+    friend class ComIo;
+#endif  /* _WIN32 */
     void BufFree();
 
     ComIo &comIo;
     BYTE *pBuf;
     DWORD len;
+    BOOL owned;
 };
 ///////////////////////////////////////////////////////////////
 class SafeDelete
@@ -338,7 +470,11 @@ class SafeDelete
     int locked;
 };
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class WaitCommEventOverlapped : private OVERLAPPED, public SafeDelete
+#else  /* _WIN32 */
+class WaitCommEventOverlapped : public SafeDelete
+#endif  /* _WIN32 */
 {
   public:
     WaitCommEventOverlapped(ComIo &_comIo);
@@ -346,13 +482,22 @@ class WaitCommEventOverlapped : private OVERLAPPED, public SafeDelete
     BOOL StartWaitCommEvent();
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnCommEvent(
       PVOID pParameter,
       BOOLEAN timerOrWaitFired);
     static VOID CALLBACK OnCommEvent(ULONG_PTR pOverlapped);
 
     ComIo &comIo;
+    HANDLE hThread;
     HANDLE hWait;
+#else  /* _WIN32 */
+    static void CALLBACK OnCommEvent(HDEFERPARAM hDeferParam);
+
+    ComIo &comIo;
+
+    friend class ComIo;
+#endif  /* _WIN32 */
     DWORD eMask;
 
 #ifdef _DEBUG
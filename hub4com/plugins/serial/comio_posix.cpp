@@ -0,0 +1,1401 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+/*
+ * The POSIX (Linux) version of comio.cpp. The port is a termios device
+ * opened in non-blocking mode and the readiness of it is watched by the
+ * hub's loop. The started reads and writes are served in the started
+ * order (as the serial drivers do on Windows) and the completions are
+ * reported to ComPort never from the Start*() routines.
+ *
+ * The modem status lines are waited by TIOCMIWAIT in a helper thread
+ * per port that wakes the hub's loop by an eventfd. If the driver does
+ * not support TIOCMIWAIT (e.g. ptys) they are polled by TIOCMGET every
+ * 10 ms while WaitCommEvent is started. The line error counters are
+ * always polled by TIOCGICOUNT (TIOCMIWAIT does not wait them).
+ */
+
+#include "precomp.h"
+#include "../plugins_api.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#ifdef __linux__
+  #include <linux/serial.h>
+#endif
+///////////////////////////////////////////////////////////////
+namespace PortSerial {
+///////////////////////////////////////////////////////////////
+#include "comio.h"
+#include "comport.h"
+#include "comparams.h"
+#include "import.h"
+///////////////////////////////////////////////////////////////
+#define COMM_EVENTS_POLL_PERIOD 10    // ms
+#define EV_MODEM (EV_CTS|EV_DSR|EV_RLSD|EV_RING)
+#define SIG_MODEM_WAIT SIGRTMIN       // interrupts TIOCMIWAIT
+///////////////////////////////////////////////////////////////
+static void TraceError(DWORD err, const char *pFmt, ...)
+{
+  va_list va;
+  va_start(va, pFmt);
+  vfprintf(stderr, pFmt, va);
+  va_end(va);
+
+  fprintf(stderr, " ERROR %lu - %s\n", (unsigned long)err, strerror((int)err));
+
+  fflush(stderr);
+}
+///////////////////////////////////////////////////////////////
+static BOOL GetTermios(int fd, struct termios &tios)
+{
+  if (tcgetattr(fd, &tios) != 0) {
+    TraceError(GetLastError(), "tcgetattr()");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static BOOL SetTermios(int fd, struct termios &tios)
+{
+  if (tcsetattr(fd, TCSANOW, &tios) != 0) {
+    TraceError(GetLastError(), "tcsetattr()");
+    GetTermios(fd, tios);
+    return FALSE;
+  }
+
+  return GetTermios(fd, tios);
+}
+
+static void SetRaw(struct termios &tios)
+{
+  cfmakeraw(&tios);
+
+  // the reads return the available data at once
+  tios.c_cflag |= CLOCAL|CREAD;
+  tios.c_cc[VMIN] = 1;
+  tios.c_cc[VTIME] = 0;
+}
+///////////////////////////////////////////////////////////////
+static const struct {
+  DWORD baudRate;
+  speed_t speed;
+} speeds[] = {
+  {50, B50},
+  {75, B75},
+  {110, B110},
+  {134, B134},
+  {150, B150},
+  {200, B200},
+  {300, B300},
+  {600, B600},
+  {1200, B1200},
+  {1800, B1800},
+  {2400, B2400},
+  {4800, B4800},
+  {9600, B9600},
+  {19200, B19200},
+  {38400, B38400},
+#ifdef B57600
+  {57600, B57600},
+#endif
+#ifdef B115200
+  {115200, B115200},
+#endif
+#ifdef B230400
+  {230400, B230400},
+#endif
+#ifdef B460800
+  {460800, B460800},
+#endif
+#ifdef B500000
+  {500000, B500000},
+#endif
+#ifdef B576000
+  {576000, B576000},
+#endif
+#ifdef B921600
+  {921600, B921600},
+#endif
+#ifdef B1000000
+  {1000000, B1000000},
+#endif
+#ifdef B1152000
+  {1152000, B1152000},
+#endif
+#ifdef B1500000
+  {1500000, B1500000},
+#endif
+#ifdef B2000000
+  {2000000, B2000000},
+#endif
+#ifdef B2500000
+  {2500000, B2500000},
+#endif
+#ifdef B3000000
+  {3000000, B3000000},
+#endif
+#ifdef B3500000
+  {3500000, B3500000},
+#endif
+#ifdef B4000000
+  {4000000, B4000000},
+#endif
+};
+
+static void GetBaudRate(const struct termios &tios, SERIAL_BAUD_RATE &serialBaudRate)
+{
+  speed_t speed = cfgetospeed(&tios);
+
+  serialBaudRate.BaudRate = 0;
+
+  for (size_t i = 0 ; i < sizeof(speeds)/sizeof(speeds[0]) ; i++) {
+    if (speeds[i].speed == speed) {
+      serialBaudRate.BaudRate = speeds[i].baudRate;
+      break;
+    }
+  }
+}
+
+static BOOL PutBaudRate(struct termios &tios, const SERIAL_BAUD_RATE &serialBaudRate)
+{
+  for (size_t i = 0 ; i < sizeof(speeds)/sizeof(speeds[0]) ; i++) {
+    if (speeds[i].baudRate == serialBaudRate.BaudRate) {
+      cfsetospeed(&tios, speeds[i].speed);
+      cfsetispeed(&tios, speeds[i].speed);
+      return TRUE;
+    }
+  }
+
+  TraceError(EINVAL, "PutBaudRate(%lu)", (unsigned long)serialBaudRate.BaudRate);
+
+  return FALSE;
+}
+///////////////////////////////////////////////////////////////
+static void GetLineControl(const struct termios &tios, SERIAL_LINE_CONTROL &serialLineControl)
+{
+  switch (tios.c_cflag & CSIZE) {
+    case CS5: serialLineControl.WordLength = 5; break;
+    case CS6: serialLineControl.WordLength = 6; break;
+    case CS7: serialLineControl.WordLength = 7; break;
+    default:  serialLineControl.WordLength = 8; break;
+  }
+
+  if ((tios.c_cflag & PARENB) == 0)
+    serialLineControl.Parity = NOPARITY;
+#ifdef CMSPAR
+  else
+  if (tios.c_cflag & CMSPAR)
+    serialLineControl.Parity = (tios.c_cflag & PARODD) ? MARKPARITY : SPACEPARITY;
+#endif
+  else
+    serialLineControl.Parity = (tios.c_cflag & PARODD) ? ODDPARITY : EVENPARITY;
+
+  if ((tios.c_cflag & CSTOPB) == 0)
+    serialLineControl.StopBits = ONESTOPBIT;
+  else
+    serialLineControl.StopBits = (serialLineControl.WordLength == 5) ? ONE5STOPBITS : TWOSTOPBITS;
+}
+
+static BOOL PutLineControl(struct termios &tios, const SERIAL_LINE_CONTROL &serialLineControl)
+{
+  tcflag_t cflag = tios.c_cflag & ~(CSIZE|PARENB|PARODD|CSTOPB);
+
+#ifdef CMSPAR
+  cflag &= ~CMSPAR;
+#endif
+
+  switch (serialLineControl.WordLength) {
+    case 5: cflag |= CS5; break;
+    case 6: cflag |= CS6; break;
+    case 7: cflag |= CS7; break;
+    case 8: cflag |= CS8; break;
+    default:
+      TraceError(EINVAL, "PutLineControl(): byte size %u", (unsigned)serialLineControl.WordLength);
+      return FALSE;
+  }
+
+  switch (serialLineControl.Parity) {
+    case NOPARITY: break;
+    case ODDPARITY: cflag |= PARENB|PARODD; break;
+    case EVENPARITY: cflag |= PARENB; break;
+#ifdef CMSPAR
+    case MARKPARITY: cflag |= PARENB|CMSPAR|PARODD; break;
+    case SPACEPARITY: cflag |= PARENB|CMSPAR; break;
+#endif
+    default:
+      TraceError(EINVAL, "PutLineControl(): parity %u", (unsigned)serialLineControl.Parity);
+      return FALSE;
+  }
+
+  switch (serialLineControl.StopBits) {
+    case ONESTOPBIT: break;
+    case ONE5STOPBITS:
+    case TWOSTOPBITS: cflag |= CSTOPB; break;
+    default:
+      TraceError(EINVAL, "PutLineControl(): stop bits %u", (unsigned)serialLineControl.StopBits);
+      return FALSE;
+  }
+
+  tios.c_cflag = cflag;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static void GetHandFlow(const struct termios &tios, SERIAL_HANDFLOW &serialHandFlow)
+{
+  // RTS and CTS handshaking are not separable by termios
+  serialHandFlow.ControlHandShake = SERIAL_DTR_CONTROL;
+  serialHandFlow.FlowReplace = 0;
+  serialHandFlow.XonLimit = 0;
+  serialHandFlow.XoffLimit = 0;
+
+  if (tios.c_cflag & CRTSCTS) {
+    serialHandFlow.ControlHandShake |= SERIAL_CTS_HANDSHAKE;
+    serialHandFlow.FlowReplace |= SERIAL_RTS_HANDSHAKE;
+  } else {
+    serialHandFlow.FlowReplace |= SERIAL_RTS_CONTROL;
+  }
+
+  if (tios.c_iflag & IXON)
+    serialHandFlow.FlowReplace |= SERIAL_AUTO_TRANSMIT;
+
+  if (tios.c_iflag & IXOFF)
+    serialHandFlow.FlowReplace |= SERIAL_AUTO_RECEIVE;
+}
+
+static void PutHandFlow(struct termios &tios, const SERIAL_HANDFLOW &serialHandFlow)
+{
+  if (serialHandFlow.ControlHandShake & SERIAL_CTS_HANDSHAKE)
+    tios.c_cflag |= CRTSCTS;
+  else
+    tios.c_cflag &= ~CRTSCTS;
+
+  if (serialHandFlow.FlowReplace & SERIAL_AUTO_TRANSMIT)
+    tios.c_iflag |= IXON;
+  else
+    tios.c_iflag &= ~IXON;
+
+  if (serialHandFlow.FlowReplace & SERIAL_AUTO_RECEIVE)
+    tios.c_iflag |= IXOFF;
+  else
+    tios.c_iflag &= ~IXOFF;
+}
+///////////////////////////////////////////////////////////////
+static void GetChars(const struct termios &tios, SERIAL_CHARS &serialChars)
+{
+  memset(&serialChars, 0, sizeof(serialChars));
+
+  serialChars.XonChar = tios.c_cc[VSTART];
+  serialChars.XoffChar = tios.c_cc[VSTOP];
+}
+
+static void PutChars(struct termios &tios, const SERIAL_CHARS &serialChars)
+{
+  tios.c_cc[VSTART] = serialChars.XonChar;
+  tios.c_cc[VSTOP] = serialChars.XoffChar;
+}
+///////////////////////////////////////////////////////////////
+static BOOL ModemControl(int fd, int bits, BOOL on)
+{
+  if (ioctl(fd, on ? TIOCMBIS : TIOCMBIC, &bits) != 0) {
+    TraceError(GetLastError(), "ioctl(%s)", on ? "TIOCMBIS" : "TIOCMBIC");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::Open(const ComParams &comParams)
+{
+  if (!OpenPath())
+    return FALSE;
+
+  struct termios tios;
+
+  if (!GetTermios(fd, tios)) {
+    Close();
+    return FALSE;
+  }
+
+  SetRaw(tios);
+
+  GetBaudRate(tios, serialBaudRate);
+  GetLineControl(tios, serialLineControl);
+  GetHandFlow(tios, serialHandFlow);
+  GetChars(tios, serialChars);
+
+  if (comParams.BaudRate() >= 0)
+    serialBaudRate.BaudRate = (DWORD)comParams.BaudRate();
+
+  if (comParams.ByteSize() >= 0)
+    serialLineControl.WordLength = (UCHAR)comParams.ByteSize();
+
+  if (comParams.Parity() >= 0)
+    serialLineControl.Parity = (UCHAR)comParams.Parity();
+
+  if (comParams.StopBits() >= 0)
+    serialLineControl.StopBits = (UCHAR)comParams.StopBits();
+
+  if (comParams.OutCts() >= 0) {
+    if (comParams.OutCts())
+      serialHandFlow.ControlHandShake |= SERIAL_CTS_HANDSHAKE;
+    else
+      serialHandFlow.ControlHandShake &= ~SERIAL_CTS_HANDSHAKE;
+  }
+
+  if (comParams.OutX() >= 0) {
+    if (comParams.OutX())
+      serialHandFlow.FlowReplace |= SERIAL_AUTO_TRANSMIT;
+    else
+      serialHandFlow.FlowReplace &= ~SERIAL_AUTO_TRANSMIT;
+  }
+
+  if (comParams.InX() >= 0) {
+    if (comParams.InX())
+      serialHandFlow.FlowReplace |= SERIAL_AUTO_RECEIVE;
+    else
+      serialHandFlow.FlowReplace &= ~SERIAL_AUTO_RECEIVE;
+  }
+
+  if (comParams.OutDsr() > 0 || comParams.InDsr() > 0)
+    cerr << port.Name() << " WARNING: DSR flow control is not supported by termios" << endl;
+
+  if (comParams.IntervalTimeout() > 0)
+    cerr << port.Name() << " WARNING: read interval timeout is not supported by termios" << endl;
+
+  if (!PutBaudRate(tios, serialBaudRate) ||
+      !PutLineControl(tios, serialLineControl))
+  {
+    Close();
+    return FALSE;
+  }
+
+  PutHandFlow(tios, serialHandFlow);
+
+  if (!SetTermios(fd, tios)) {
+    Close();
+    return FALSE;
+  }
+
+  GetBaudRate(tios, serialBaudRate);
+  GetLineControl(tios, serialLineControl);
+  GetHandFlow(tios, serialHandFlow);
+  GetChars(tios, serialChars);
+
+  PrintParams("Open(", ") - OK");
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::Open()
+{
+  if (fd >= 0 || fdClosing >= 0) {
+    if (!notifyOnFree) {
+      cout << port.Name() << " The port is busy" << endl;
+      notifyOnFree = TRUE;
+    }
+
+    return FALSE;
+  }
+
+  if (!OpenPath())
+    return FALSE;
+
+  _ASSERTE(fd >= 0);
+
+  DWORD newBaudRate = BaudRate();
+  DWORD newLineControl = LineControl();
+
+  struct termios tios;
+
+  if (GetTermios(fd, tios)) {
+    SetRaw(tios);
+    PutHandFlow(tios, serialHandFlow);
+    PutChars(tios, serialChars);
+    SetTermios(fd, tios);
+
+    GetBaudRate(tios, serialBaudRate);
+    GetLineControl(tios, serialLineControl);
+    GetHandFlow(tios, serialHandFlow);
+    GetChars(tios, serialChars);
+  }
+
+  DWORD oldBaudRate = BaudRate();
+
+  if (SetBaudRate(newBaudRate) != newBaudRate) {
+    cerr << port.Name() << " WARNING: can't change"
+         << " baud rate " << oldBaudRate
+         << " to " << newBaudRate
+         << " (current=" << BaudRate() << ")"
+         << endl;
+  }
+
+  DWORD oldLineControl = LineControl();
+
+  if (SetLineControl(newLineControl) != newLineControl) {
+    cerr << port.Name() << " WARNING: can't change"
+         << hex
+         << " line control 0x" << oldLineControl
+         << " to 0x" << newLineControl
+         << " (current=0x" << LineControl() << ")"
+         << dec
+         << endl;
+  }
+
+  SetPinState(pinStateValue, pinStateMask);
+
+  PrintParams("Open(", ") - OK");
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+void ComIo::Close()
+{
+  _ASSERTE(fd < 0 || fdClosing < 0);
+
+  BOOL allowCallback = TRUE;
+
+  if (fd >= 0) {
+    allowCallback = FALSE;
+
+    if (hWatch) {
+      pWatchDelete(hWatch);
+      hWatch = NULL;
+    }
+
+    TimerStop();
+    ModemWaitStop();
+    Abort();
+
+    fdClosing = fd;
+    fd = -1;
+  }
+
+  if (fdClosing >= 0 && countStartedOverlaps <= 0) {
+    if (close(fdClosing) != 0)
+      TraceError(GetLastError(), "ComIo::Close(): close(%d) %s", fdClosing, port.Name().c_str());
+
+    fdClosing = -1;
+
+    PrintParams("Close(", ")");
+
+    if (notifyOnFree) {
+      cout << port.Name() << " The port is free" << endl;
+      notifyOnFree = FALSE;
+
+      if (allowCallback)
+        port.OnPortFree();
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::OpenPath()
+{
+  _ASSERTE(fd < 0 && fdClosing < 0);
+
+  if (fd >= 0 || fdClosing >= 0)
+    return FALSE;
+
+  fd = open(path.c_str(), O_RDWR|O_NOCTTY|O_NONBLOCK);
+
+  if (fd < 0) {
+    TraceError(GetLastError(), "ComIo::OpenPath(): open(\"%s\")", path.c_str());
+    return FALSE;
+  }
+
+  // the ports are opened exclusively on Windows
+  ioctl(fd, TIOCEXCL);
+
+  broken = FALSE;
+  hasExtendedModemControl = FALSE;
+  noModemWait = FALSE;
+
+  int bits;
+
+  noModemStatus = (ioctl(fd, TIOCMGET, &bits) != 0);
+  GetModemStatus(&modemStatus);
+
+  memset(&statsPolled, 0, sizeof(statsPolled));
+  breaksPolled = 0;
+  GetCounters(statsPolled, breaksPolled);
+
+  statsCleared = statsPolled;
+  breaksCleared = breaksPolled;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+void ComIo::PrintParams(const char *pPrefix, const char *pSuffix)
+{
+  cout
+      << port.Name() << " " << pPrefix
+      << "\"" << path << "\""
+      << ", baud=" << ComParams::BaudRateStr(serialBaudRate.BaudRate)
+      << ", data=" << ComParams::ByteSizeStr(serialLineControl.WordLength)
+      << ", parity=" << ComParams::ParityStr(serialLineControl.Parity)
+      << ", stop=" << ComParams::StopBitsStr(serialLineControl.StopBits)
+      << ", octs=" << ComParams::OutCtsStr((serialHandFlow.ControlHandShake & SERIAL_CTS_HANDSHAKE) != 0)
+      << ", ox=" << ComParams::OutXStr((serialHandFlow.FlowReplace & SERIAL_AUTO_TRANSMIT) != 0)
+      << ", ix=" << ComParams::InXStr((serialHandFlow.FlowReplace & SERIAL_AUTO_RECEIVE) != 0)
+      << pSuffix << endl;
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::SetComEvents(DWORD *pEvents)
+{
+  DWORD supported = 0;
+
+  if (!noModemStatus)
+    supported |= EV_MODEM;
+
+#ifdef TIOCGICOUNT
+  supported |= EV_BREAK|EV_ERR;
+#endif
+
+  events = *pEvents & supported;
+  *pEvents = events;
+
+  // report the changes since now
+  GetModemStatus(&modemStatus);
+  GetCounters(statsPolled, breaksPolled);
+
+  if (pWaitCommEvent)
+    return WaitUpdate();
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+void ComIo::SetPinState(WORD value, WORD mask)
+{
+  pinStateValue = (pinStateValue & ~mask) | (value & mask);
+  pinStateMask |= mask;
+
+  if (fd < 0)
+    return;
+
+  if (mask & PIN_STATE_RTS) {
+    if (!ModemControl(fd, TIOCM_RTS, (value & PIN_STATE_RTS) != 0))
+      cerr << port.Name() << " WARNING: can't change RTS state" << endl;
+  }
+
+  if (mask & PIN_STATE_DTR) {
+    if (!ModemControl(fd, TIOCM_DTR, (value & PIN_STATE_DTR) != 0))
+      cerr << port.Name() << " WARNING: can't change DTR state" << endl;
+  }
+
+  if (mask & PIN_STATE_BREAK) {
+    if (ioctl(fd, (value & PIN_STATE_BREAK) ? TIOCSBRK : TIOCCBRK) != 0) {
+      TraceError(GetLastError(), "ioctl(%s)", (value & PIN_STATE_BREAK) ? "TIOCSBRK" : "TIOCCBRK");
+      cerr << port.Name() << " WARNING: can't change BREAK state" << endl;
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+DWORD ComIo::SetBaudRate(DWORD baudRate)
+{
+  if (BaudRate() == baudRate)
+    return BaudRate();
+
+  SERIAL_BAUD_RATE newSerialBaudRate = serialBaudRate;
+
+  newSerialBaudRate.BaudRate = baudRate;
+
+  if (fd < 0) {
+    serialBaudRate = newSerialBaudRate;
+    return BaudRate();
+  }
+
+  struct termios tios;
+
+  if (!GetTermios(fd, tios))
+    return BaudRate();
+
+  if (PutBaudRate(tios, newSerialBaudRate))
+    SetTermios(fd, tios);
+
+  GetBaudRate(tios, serialBaudRate);
+
+  return BaudRate();
+}
+///////////////////////////////////////////////////////////////
+DWORD ComIo::SetLineControl(DWORD lineControl)
+{
+  _ASSERTE((lineControl & ~(VAL2LC_BYTESIZE(-1)|LC_MASK_BYTESIZE
+                           |VAL2LC_PARITY(-1)|LC_MASK_PARITY
+                           |VAL2LC_STOPBITS(-1)|LC_MASK_STOPBITS)) == 0);
+
+  if (LineControl() == lineControl)
+    return lineControl;
+
+  SERIAL_LINE_CONTROL newSerialLineControl = serialLineControl;
+
+  if (lineControl & LC_MASK_BYTESIZE)
+    newSerialLineControl.WordLength = LC2VAL_BYTESIZE(lineControl);
+
+  if (lineControl & LC_MASK_PARITY)
+    newSerialLineControl.Parity = LC2VAL_PARITY(lineControl);
+
+  if (lineControl & LC_MASK_STOPBITS)
+    newSerialLineControl.StopBits = LC2VAL_STOPBITS(lineControl);
+
+  if (fd < 0) {
+    serialLineControl = newSerialLineControl;
+    return LineControl();
+  }
+
+  struct termios tios;
+
+  if (!GetTermios(fd, tios))
+    return LineControl();
+
+  if (PutLineControl(tios, newSerialLineControl))
+    SetTermios(fd, tios);
+
+  GetLineControl(tios, serialLineControl);
+
+  return LineControl();
+}
+///////////////////////////////////////////////////////////////
+DWORD ComIo::SetEscMode(DWORD escOptions, BYTE **ppBuf, DWORD *pDone)
+{
+  _ASSERTE(ppBuf != NULL);
+  _ASSERTE(*ppBuf == NULL);
+  _ASSERTE(pDone != NULL);
+  _ASSERTE(*pDone == 0);
+
+  // termios can't insert the modem and line status into the data
+  // stream so fallback to non escape mode
+  return escOptions | ESC_OPTS_V2O_ESCCHAR(-1);
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::GetModemStatus(DWORD *pStat)
+{
+  int bits;
+
+  if (ioctl(fd, TIOCMGET, &bits) != 0)
+    return FALSE;
+
+  *pStat = ((bits & TIOCM_CTS) ? MS_CTS_ON : 0)
+         | ((bits & TIOCM_DSR) ? MS_DSR_ON : 0)
+         | ((bits & TIOCM_RNG) ? MS_RING_ON : 0)
+         | ((bits & TIOCM_CAR) ? MS_RLSD_ON : 0);
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::GetCounters(SERIALPERF_STATS &stats, ULONG &breaks)
+{
+#ifdef TIOCGICOUNT
+  struct serial_icounter_struct icount;
+
+  if (ioctl(fd, TIOCGICOUNT, &icount) != 0)
+    return FALSE;
+
+  stats.ReceivedCount = (ULONG)icount.rx;
+  stats.TransmittedCount = (ULONG)icount.tx;
+  stats.FrameErrorCount = (ULONG)icount.frame;
+  stats.SerialOverrunErrorCount = (ULONG)icount.overrun;
+  stats.BufferOverrunErrorCount = (ULONG)icount.buf_overrun;
+  stats.ParityErrorCount = (ULONG)icount.parity;
+  breaks = (ULONG)icount.brk;
+
+  return TRUE;
+#else  /* TIOCGICOUNT */
+  (void)stats;
+  (void)breaks;
+
+  return FALSE;
+#endif  /* TIOCGICOUNT */
+}
+
+BOOL ComIo::GetPerfStats(SERIALPERF_STATS &stats)
+{
+  ULONG breaks;
+
+  return GetCounters(stats, breaks);
+}
+
+BOOL ComIo::ClearErrors(DWORD *pErrors)
+{
+  SERIALPERF_STATS stats;
+  ULONG breaks;
+
+  if (!GetCounters(stats, breaks))
+    return FALSE;
+
+  *pErrors =
+      (stats.BufferOverrunErrorCount != statsCleared.BufferOverrunErrorCount ? CE_RXOVER : 0) |
+      (stats.SerialOverrunErrorCount != statsCleared.SerialOverrunErrorCount ? CE_OVERRUN : 0) |
+      (stats.ParityErrorCount != statsCleared.ParityErrorCount ? CE_RXPARITY : 0) |
+      (stats.FrameErrorCount != statsCleared.FrameErrorCount ? CE_FRAME : 0) |
+      (breaks != breaksCleared ? CE_BREAK : 0);
+
+  statsCleared = stats;
+  breaksCleared = breaks;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+DWORD ComIo::PollComEvents(DWORD polled)
+{
+  DWORD eMask = 0;
+
+  if (polled & EV_MODEM) {
+    DWORD stat;
+
+    if (GetModemStatus(&stat)) {
+      DWORD changed = (stat ^ modemStatus);
+
+      modemStatus = stat;
+
+      if (changed & MS_CTS_ON)
+        eMask |= EV_CTS;
+
+      if (changed & MS_DSR_ON)
+        eMask |= EV_DSR;
+
+      if (changed & MS_RLSD_ON)
+        eMask |= EV_RLSD;
+
+      if (changed & MS_RING_ON)
+        eMask |= EV_RING;
+    }
+  }
+
+  if (polled & (EV_BREAK|EV_ERR)) {
+    SERIALPERF_STATS stats;
+    ULONG breaks;
+
+    if (GetCounters(stats, breaks)) {
+      if (breaks != breaksPolled)
+        eMask |= EV_BREAK;
+
+      if (stats.BufferOverrunErrorCount != statsPolled.BufferOverrunErrorCount ||
+          stats.SerialOverrunErrorCount != statsPolled.SerialOverrunErrorCount ||
+          stats.ParityErrorCount != statsPolled.ParityErrorCount ||
+          stats.FrameErrorCount != statsPolled.FrameErrorCount)
+      {
+        eMask |= EV_ERR;
+      }
+
+      statsPolled = stats;
+      breaksPolled = breaks;
+    }
+  }
+
+  return eMask & events;
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::WaitUpdate()
+{
+  DWORD polled = events;
+
+  if ((polled & EV_MODEM) && !noModemWait && ModemWaitStart())
+    polled &= ~EV_MODEM;
+
+  return TimerSet(polled ? COMM_EVENTS_POLL_PERIOD : 0);
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::TimerSet(DWORD period)
+{
+  if (timerFd < 0) {
+    if (!period)
+      return TRUE;
+
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+
+    if (timerFd < 0) {
+      TraceError(GetLastError(), "ComIo::TimerSet(): timerfd_create() %s", port.Name().c_str());
+      return FALSE;
+    }
+
+    hTimerWatch = pWatchCreate(port.MasterPort(), timerFd, TimerProc, (HWATCHPARAM)this);
+
+    if (!hTimerWatch || !pWatchSet(hTimerWatch, WATCH_EVENT_READ)) {
+      cerr << "ComIo::TimerSet(): can't wait for " << port.Name() << endl;
+      TimerStop();
+      return FALSE;
+    }
+  }
+
+  struct itimerspec its;
+
+  its.it_interval.tv_sec = period/1000;
+  its.it_interval.tv_nsec = (period%1000)*1000000;
+  its.it_value = its.it_interval;
+
+  if (timerfd_settime(timerFd, 0, &its, NULL) != 0) {
+    TraceError(GetLastError(), "ComIo::TimerSet(): timerfd_settime() %s", port.Name().c_str());
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+void ComIo::TimerStop()
+{
+  if (hTimerWatch) {
+    pWatchDelete(hTimerWatch);
+    hTimerWatch = NULL;
+  }
+
+  if (timerFd >= 0) {
+    close(timerFd);
+    timerFd = -1;
+  }
+}
+
+void ComIo::OnTimer()
+{
+  ULONGLONG expirations;
+
+  if (read(timerFd, &expirations, sizeof(expirations)) < 0)
+    return;
+
+  if (pWaitCommEvent) {
+    // the modem status is checked by OnModemWait() if it's waited
+    DWORD eMask = PollComEvents(modemWaitStarted ? (events & ~EV_MODEM) : events);
+
+    if (eMask) {
+      WaitCommEventOverlapped *pOver = pWaitCommEvent;
+
+      pWaitCommEvent = NULL;
+      pOver->eMask = eMask;
+
+      WaitCommEventOverlapped::OnCommEvent((HDEFERPARAM)pOver);
+    }
+  }
+
+  // stop polling till the next StartWaitCommEvent()
+  if (fd >= 0 && !pWaitCommEvent)
+    TimerSet(0);
+}
+
+void CALLBACK ComIo::TimerProc(HWATCHPARAM hWatchParam, DWORD /*watchEvents*/)
+{
+  ((ComIo *)hWatchParam)->OnTimer();
+}
+///////////////////////////////////////////////////////////////
+static void OnSigModemWait(int /*sig*/)
+{
+}
+
+BOOL ComIo::ModemWaitStart()
+{
+  if (modemWaitStarted)
+    return TRUE;
+
+  static BOOL sigInstalled = FALSE;
+
+  if (!sigInstalled) {
+    struct sigaction sa;
+
+    // w/o SA_RESTART to interrupt TIOCMIWAIT
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = OnSigModemWait;
+    sigemptyset(&sa.sa_mask);
+
+    if (sigaction(SIG_MODEM_WAIT, &sa, NULL) != 0) {
+      TraceError(GetLastError(), "ComIo::ModemWaitStart(): sigaction()");
+      noModemWait = TRUE;
+      return FALSE;
+    }
+
+    sigInstalled = TRUE;
+  }
+
+  if (modemWaitFd < 0) {
+    modemWaitFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+
+    if (modemWaitFd < 0) {
+      TraceError(GetLastError(), "ComIo::ModemWaitStart(): eventfd() %s", port.Name().c_str());
+      noModemWait = TRUE;
+      return FALSE;
+    }
+
+    hModemWaitWatch = pWatchCreate(port.MasterPort(), modemWaitFd, ModemWaitProc, (HWATCHPARAM)this);
+
+    if (!hModemWaitWatch || !pWatchSet(hModemWaitWatch, WATCH_EVENT_READ)) {
+      cerr << "ComIo::ModemWaitStart(): can't wait for " << port.Name() << endl;
+      ModemWaitStop();
+      noModemWait = TRUE;
+      return FALSE;
+    }
+  }
+
+  modemWaitStop = FALSE;
+  modemWaitExited = FALSE;
+  modemWaitError = 0;
+
+  int err = pthread_create(&modemWaitThread, NULL, ModemWaitThread, this);
+
+  if (err != 0) {
+    TraceError(err, "ComIo::ModemWaitStart(): pthread_create() %s", port.Name().c_str());
+    noModemWait = TRUE;
+    return FALSE;
+  }
+
+  modemWaitStarted = TRUE;
+
+  return TRUE;
+}
+
+void ComIo::ModemWaitStop()
+{
+  if (modemWaitStarted) {
+    modemWaitStop = TRUE;
+
+    // the signal can come before TIOCMIWAIT is started so repeat it
+    while (!modemWaitExited) {
+      pthread_kill(modemWaitThread, SIG_MODEM_WAIT);
+      usleep(1000);
+    }
+
+    pthread_join(modemWaitThread, NULL);
+    modemWaitStarted = FALSE;
+  }
+
+  if (hModemWaitWatch) {
+    pWatchDelete(hModemWaitWatch);
+    hModemWaitWatch = NULL;
+  }
+
+  if (modemWaitFd >= 0) {
+    close(modemWaitFd);
+    modemWaitFd = -1;
+  }
+}
+
+void ComIo::ModemWaitKick()
+{
+  if (modemWaitFd >= 0)
+    eventfd_write(modemWaitFd, 1);
+}
+
+void ComIo::OnModemWait()
+{
+  eventfd_t count;
+
+  if (eventfd_read(modemWaitFd, &count) != 0)
+    return;
+
+  if (modemWaitStarted && modemWaitExited) {
+    pthread_join(modemWaitThread, NULL);
+    modemWaitStarted = FALSE;
+
+    if (modemWaitError != ENOTTY && modemWaitError != EINVAL)
+      TraceError(modemWaitError, "ComIo::OnModemWait(): ioctl(TIOCMIWAIT) %s", port.Name().c_str());
+
+    // fallback to polling
+    noModemWait = TRUE;
+
+    if (fd >= 0 && pWaitCommEvent)
+      WaitUpdate();
+  }
+
+  // the changes are checked while WaitCommEvent is started only
+  if (pWaitCommEvent) {
+    DWORD eMask = PollComEvents(events);
+
+    if (eMask) {
+      WaitCommEventOverlapped *pOver = pWaitCommEvent;
+
+      pWaitCommEvent = NULL;
+      pOver->eMask = eMask;
+
+      WaitCommEventOverlapped::OnCommEvent((HDEFERPARAM)pOver);
+    }
+  }
+}
+
+void CALLBACK ComIo::ModemWaitProc(HWATCHPARAM hWatchParam, DWORD /*watchEvents*/)
+{
+  ((ComIo *)hWatchParam)->OnModemWait();
+}
+
+void *ComIo::ModemWaitThread(void *pParam)
+{
+  ComIo *pComIo = (ComIo *)pParam;
+
+  while (!pComIo->modemWaitStop) {
+    if (ioctl(pComIo->fd, TIOCMIWAIT, TIOCM_CTS|TIOCM_DSR|TIOCM_CD|TIOCM_RNG) != 0) {
+      int err = errno;
+
+      if (err == EINTR)
+        continue;
+
+      pComIo->modemWaitError = err;
+      break;
+    }
+
+    eventfd_write(pComIo->modemWaitFd, 1);
+  }
+
+  pComIo->modemWaitExited = TRUE;
+
+  // wake the loop to join the failed thread
+  if (!pComIo->modemWaitStop)
+    eventfd_write(pComIo->modemWaitFd, 1);
+
+  return NULL;
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::WatchUpdate()
+{
+  DWORD watchEvents = (reads.empty() ? 0 : WATCH_EVENT_READ)
+                    | (writes.empty() ? 0 : WATCH_EVENT_WRITE);
+
+  if (!hWatch) {
+    if (!watchEvents)
+      return TRUE;
+
+    hWatch = pWatchCreate(port.MasterPort(), fd, WatchProc, (HWATCHPARAM)this);
+
+    if (!hWatch)
+      return FALSE;
+  }
+
+  return pWatchSet(hWatch, watchEvents);
+}
+
+void ComIo::OnWatch(DWORD watchEvents)
+{
+  if (watchEvents & (WATCH_EVENT_WRITE|WATCH_EVENT_HANGUP|WATCH_EVENT_ERROR)) {
+    while (fd >= 0 && !writes.empty()) {
+      WriteOverlapped *pOver = writes.front();
+
+      if (!pOver->Send(fd))
+        break;
+
+      writes.pop_front();
+
+      WriteOverlapped::OnWrite((HDEFERPARAM)pOver);
+    }
+  }
+
+  if (watchEvents & (WATCH_EVENT_READ|WATCH_EVENT_HANGUP|WATCH_EVENT_ERROR)) {
+    while (fd >= 0 && !reads.empty()) {
+      ReadOverlapped *pOver = reads.front();
+
+      if (!broken) {
+        ssize_t done = read(fd, pOver->pBuf, pOver->len);
+
+        if (done < 0) {
+          DWORD err = GetLastError();
+
+          if (err == EAGAIN || err == EINTR)
+            break;
+
+          TraceError(err, "ReadOverlapped::OnRead(): %s", port.Name().c_str());
+          broken = TRUE;
+        }
+        else
+        if (done == 0) {
+          cerr << "ReadOverlapped::OnRead(): " << port.Name() << " EOF" << endl;
+          broken = TRUE;
+        }
+        else {
+          pOver->done = (DWORD)done;
+        }
+      }
+
+      // the rest of started reads are failed too if broken
+      reads.pop_front();
+
+      ReadOverlapped::OnRead((HDEFERPARAM)pOver);
+    }
+  }
+
+  if (fd >= 0)
+    WatchUpdate();
+}
+
+void CALLBACK ComIo::WatchProc(HWATCHPARAM hWatchParam, DWORD watchEvents)
+{
+  ((ComIo *)hWatchParam)->OnWatch(watchEvents);
+}
+///////////////////////////////////////////////////////////////
+void ComIo::Abort()
+{
+  for (deque<ReadOverlapped *>::iterator i = reads.begin() ; i != reads.end() ; i++) {
+    (*i)->done = 0;
+    pDefer(port.MasterPort(), ReadOverlapped::OnRead, (HDEFERPARAM)*i);
+  }
+
+  reads.clear();
+
+  for (deque<WriteOverlapped *>::iterator i = writes.begin() ; i != writes.end() ; i++)
+    pDefer(port.MasterPort(), WriteOverlapped::OnWrite, (HDEFERPARAM)*i);
+
+  writes.clear();
+
+  if (pWaitCommEvent) {
+    pWaitCommEvent->eMask = 0;
+    pDefer(port.MasterPort(), WaitCommEventOverlapped::OnCommEvent, (HDEFERPARAM)pWaitCommEvent);
+    pWaitCommEvent = NULL;
+  }
+}
+
+void ComIo::PurgeWrite()
+{
+  if (fd < 0)
+    return;
+
+  for (deque<WriteOverlapped *>::iterator i = writes.begin() ; i != writes.end() ; i++)
+    pDefer(port.MasterPort(), WriteOverlapped::OnWrite, (HDEFERPARAM)*i);
+
+  writes.clear();
+  WatchUpdate();
+
+  if (tcflush(fd, TCOFLUSH) != 0)
+    TraceError(GetLastError(), "ComIo::PurgeWrite(): tcflush() %s", port.Name().c_str());
+}
+///////////////////////////////////////////////////////////////
+BOOL ComIo::StartRead(ReadOverlapped *pOverlapped)
+{
+  if (fd < 0 || broken)
+    return FALSE;
+
+  reads.push_back(pOverlapped);
+
+  if (!WatchUpdate()) {
+    reads.pop_back();
+    cerr << "ComIo::StartRead(): can't wait for " << port.Name() << endl;
+    return FALSE;
+  }
+
+  countStartedOverlaps++;
+  _ASSERTE(countStartedOverlaps > 0);
+
+  return TRUE;
+}
+
+BOOL ComIo::StartWrite(WriteOverlapped *pOverlapped)
+{
+  if (fd < 0)
+    return FALSE;
+
+  if (writes.empty() && pOverlapped->Send(fd)) {
+    if (!pDefer(port.MasterPort(), WriteOverlapped::OnWrite, (HDEFERPARAM)pOverlapped)) {
+      cerr << "ComIo::StartWrite(): can't complete for " << port.Name() << endl;
+      return FALSE;
+    }
+  } else {
+    writes.push_back(pOverlapped);
+
+    if (!WatchUpdate()) {
+      writes.pop_back();
+      cerr << "ComIo::StartWrite(): can't wait for " << port.Name() << endl;
+      return FALSE;
+    }
+  }
+
+  countStartedOverlaps++;
+  _ASSERTE(countStartedOverlaps > 0);
+
+  return TRUE;
+}
+
+BOOL ComIo::StartWaitCommEvent(WaitCommEventOverlapped *pOverlapped)
+{
+  if (fd < 0)
+    return FALSE;
+
+  if (pWaitCommEvent) {
+    TraceError(EBUSY, "ComIo::StartWaitCommEvent(): %s", port.Name().c_str());
+    return FALSE;
+  }
+
+  if (events && !WaitUpdate())
+    return FALSE;
+
+  pWaitCommEvent = pOverlapped;
+
+  // check the modem status changed while WaitCommEvent was not started
+  if (modemWaitStarted)
+    ModemWaitKick();
+
+  countStartedOverlaps++;
+  _ASSERTE(countStartedOverlaps > 0);
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+void CALLBACK WriteOverlapped::OnWrite(HDEFERPARAM hDeferParam)
+{
+  WriteOverlapped *pOver = (WriteOverlapped *)hDeferParam;
+
+  _ASSERTE(pOver->comIo.countStartedOverlaps > 0);
+  pOver->comIo.countStartedOverlaps--;
+
+  if (pOver->comIo.Handle() == INVALID_HANDLE_VALUE)
+    pOver->comIo.Close();
+
+  pOver->BufFree();
+  pOver->comIo.port.OnWrite(pOver, pOver->len, pOver->done);
+}
+
+void WriteOverlapped::BufFree()
+{
+  _ASSERTE(pBuf != NULL);
+
+  if (owned)
+    pBufFree(pBuf);
+
+#ifdef _DEBUG
+  pBuf = NULL;
+#endif
+}
+
+BOOL WriteOverlapped::Send(int fd)
+{
+  while (done < len) {
+    ssize_t res = write(fd, pBuf + done, len - done);
+
+    if (res < 0) {
+      DWORD err = GetLastError();
+
+      if (err == EINTR)
+        continue;
+
+      if (err == EAGAIN)
+        return FALSE;
+
+      TraceError(err, "WriteOverlapped::OnWrite: %s", comIo.port.Name().c_str());
+      break;
+    }
+
+    done += (DWORD)res;
+  }
+
+  return TRUE;
+}
+
+BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len, BOOL _owned)
+{
+  _ASSERTE(pBuf == NULL);
+
+  _ASSERTE(_pBuf != NULL);
+  _ASSERTE(_len != 0);
+
+  pBuf = _pBuf;
+  len = _len;
+  owned = _owned;
+  done = 0;
+
+  if (!comIo.StartWrite(this)) {
+    // the buffer is still owned by the caller
+    pBuf = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+ReadOverlapped::ReadOverlapped(ComIo &_comIo)
+  : done(0),
+    comIo(_comIo),
+    pBuf(NULL),
+    len(0),
+    seq(0)
+{
+}
+
+ReadOverlapped::~ReadOverlapped()
+{
+  pBufFree(pBuf);
+}
+
+void CALLBACK ReadOverlapped::OnRead(HDEFERPARAM hDeferParam)
+{
+  ReadOverlapped *pOver = (ReadOverlapped *)hDeferParam;
+
+  _ASSERTE(pOver->comIo.countStartedOverlaps > 0);
+  pOver->comIo.countStartedOverlaps--;
+
+  if (pOver->comIo.Handle() == INVALID_HANDLE_VALUE)
+    pOver->comIo.Close();
+
+  BYTE *pInBuf = pOver->pBuf;
+  pOver->pBuf = NULL;
+
+  pOver->comIo.port.OnRead(pOver, pInBuf, pOver->len, pOver->done);
+}
+
+BOOL ReadOverlapped::StartRead(DWORD _len, DWORD _seq)
+{
+  _ASSERTE(_len > 0);
+
+  len = _len;
+  seq = _seq;
+  done = 0;
+
+  pBuf = pBufAlloc(len);
+
+  if (!pBuf)
+    return FALSE;
+
+  return comIo.StartRead(this);
+}
+///////////////////////////////////////////////////////////////
+WaitCommEventOverlapped::WaitCommEventOverlapped(ComIo &_comIo)
+  : comIo(_comIo),
+    eMask(0)
+{
+}
+
+void WaitCommEventOverlapped::Delete()
+{
+  SafeDelete::Delete();
+}
+
+void CALLBACK WaitCommEventOverlapped::OnCommEvent(HDEFERPARAM hDeferParam)
+{
+  WaitCommEventOverlapped *pOver = (WaitCommEventOverlapped *)hDeferParam;
+
+  _ASSERTE(pOver->comIo.countStartedOverlaps > 0);
+  pOver->comIo.countStartedOverlaps--;
+
+  if (pOver->comIo.Handle() == INVALID_HANDLE_VALUE) {
+    pOver->comIo.Close();
+    pOver->comIo.port.OnCommEvent(pOver, 0);
+    return;
+  }
+
+  pOver->comIo.port.OnCommEvent(pOver, pOver->eMask);
+}
+
+BOOL WaitCommEventOverlapped::StartWaitCommEvent()
+{
+  eMask = 0;
+
+  return comIo.StartWaitCommEvent(this);
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
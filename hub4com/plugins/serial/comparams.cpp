@@ -76,6 +76,10 @@ ComParams::ComParams()
   , inDsr(0)
   , intervalTimeout(0)
   , writeQueueLimit(256)
+  , readBufSize(4096)
+  , readOverlaps(1)
+  , writeDelay(0)
+  , writeBatch(0)
   , shareMode(0)
 {
 }
@@ -160,6 +164,46 @@ BOOL ComParams::SetWriteQueueLimit(const char *pWriteQueueLimit)
   return FALSE;
 }
 
+BOOL ComParams::SetReadBufSize(const char *pReadBufSize)
+{
+  if (isdigit((unsigned char)*pReadBufSize)) {
+    readBufSize = atol(pReadBufSize);
+    return readBufSize > 0;
+  }
+
+  return FALSE;
+}
+
+BOOL ComParams::SetReadOverlaps(const char *pReadOverlaps)
+{
+  if (isdigit((unsigned char)*pReadOverlaps)) {
+    readOverlaps = atol(pReadOverlaps);
+    return readOverlaps > 0;
+  }
+
+  return FALSE;
+}
+
+BOOL ComParams::SetWriteDelay(const char *pWriteDelay)
+{
+  if (isdigit((unsigned char)*pWriteDelay)) {
+    writeDelay = atol(pWriteDelay);
+    return writeDelay >= 0;
+  }
+
+  return FALSE;
+}
+
+BOOL ComParams::SetWriteBatch(const char *pWriteBatch)
+{
+  if (isdigit((unsigned char)*pWriteBatch)) {
+    writeBatch = atol(pWriteBatch);
+    return writeBatch > 0;
+  }
+
+  return FALSE;
+}
+
 BOOL ComParams::SetFlag(const char *pFlagStr, int *pFlag, BOOL withCurrent)
 {
   if (_stricmp(pFlagStr, "on") == 0) {
@@ -247,6 +291,50 @@ string ComParams::WriteQueueLimitStr(long writeQueueLimit)
   return "?";
 }
 
+string ComParams::ReadBufSizeStr(long readBufSize)
+{
+  if (readBufSize > 0) {
+    stringstream buf;
+    buf << readBufSize;
+    return buf.str();
+  }
+
+  return "?";
+}
+
+string ComParams::ReadOverlapsStr(long readOverlaps)
+{
+  if (readOverlaps > 0) {
+    stringstream buf;
+    buf << readOverlaps;
+    return buf.str();
+  }
+
+  return "?";
+}
+
+string ComParams::WriteDelayStr(long writeDelay)
+{
+  if (writeDelay >= 0) {
+    stringstream buf;
+    buf << writeDelay;
+    return buf.str();
+  }
+
+  return "?";
+}
+
+string ComParams::WriteBatchStr(long writeBatch)
+{
+  if (writeBatch > 0) {
+    stringstream buf;
+    buf << writeBatch;
+    return buf.str();
+  }
+
+  return writeBatch == 0 ? "half of the write queue limit" : "?";
+}
+
 string ComParams::FlagStr(int flag, BOOL withCurrent)
 {
   switch (flag) {
@@ -287,6 +375,26 @@ const char *ComParams::WriteQueueLimitLst()
   return "a positive number or 0";
 }
 
+const char *ComParams::ReadBufSizeLst()
+{
+  return "a positive number";
+}
+
+const char *ComParams::ReadOverlapsLst()
+{
+  return "a positive number";
+}
+
+const char *ComParams::WriteDelayLst()
+{
+  return "a positive number or 0 microseconds";
+}
+
+const char *ComParams::WriteBatchLst()
+{
+  return "a positive number";
+}
+
 const char *ComParams::FlagLst(BOOL withCurrent)
 {
   return withCurrent ? "on, off or c[urrent]" : "on or off";
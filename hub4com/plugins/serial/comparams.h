@@ -63,6 +63,10 @@ class ComParams
     BOOL SetInDsr(const char *pInDsr) { return SetFlag(pInDsr, &inDsr); }
     BOOL SetIntervalTimeout(const char *pIntervalTimeout);
     BOOL SetWriteQueueLimit(const char *pWriteQueueLimit);
+    BOOL SetReadBufSize(const char *pReadBufSize);
+    BOOL SetReadOverlaps(const char *pReadOverlaps);
+    BOOL SetWriteDelay(const char *pWriteDelay);
+    BOOL SetWriteBatch(const char *pWriteBatch);
     BOOL SetShareMode(const char *pShareMode) { return SetFlag(pShareMode, &shareMode, FALSE); }
 
     static string BaudRateStr(long baudRate);
@@ -76,6 +80,10 @@ class ComParams
     static string InDsrStr(int inDsr) { return FlagStr(inDsr); }
     static string IntervalTimeoutStr(long intervalTimeout);
     static string WriteQueueLimitStr(long writeQueueLimit);
+    static string ReadBufSizeStr(long readBufSize);
+    static string ReadOverlapsStr(long readOverlaps);
+    static string WriteDelayStr(long writeDelay);
+    static string WriteBatchStr(long writeBatch);
     static string ShareModeStr(int shareMode) { return FlagStr(shareMode, FALSE); }
 
     string BaudRateStr() const { return BaudRateStr(baudRate); }
@@ -89,6 +97,10 @@ class ComParams
     string InDsrStr() const { return InDsrStr(inDsr); }
     string IntervalTimeoutStr() const { return IntervalTimeoutStr(intervalTimeout); }
     string WriteQueueLimitStr() const { return WriteQueueLimitStr(writeQueueLimit); }
+    string ReadBufSizeStr() const { return ReadBufSizeStr(readBufSize); }
+    string ReadOverlapsStr() const { return ReadOverlapsStr(readOverlaps); }
+    string WriteDelayStr() const { return WriteDelayStr(writeDelay); }
+    string WriteBatchStr() const { return WriteBatchStr(writeBatch); }
     string ShareModeStr() const { return ShareModeStr(shareMode); }
 
     static const char *BaudRateLst();
@@ -102,6 +114,10 @@ class ComParams
     static const char *InDsrLst() { return FlagLst(); }
     static const char *IntervalTimeoutLst();
     static const char *WriteQueueLimitLst();
+    static const char *ReadBufSizeLst();
+    static const char *ReadOverlapsLst();
+    static const char *WriteDelayLst();
+    static const char *WriteBatchLst();
     static const char *ShareModeLst() { return FlagLst(FALSE); }
 
     long BaudRate() const { return baudRate; }
@@ -115,6 +131,10 @@ class ComParams
     int InDsr() const { return inDsr; }
     long IntervalTimeout() const { return intervalTimeout; }
     long WriteQueueLimit() const { return writeQueueLimit; }
+    long ReadBufSize() const { return readBufSize; }
+    long ReadOverlaps() const { return readOverlaps; }
+    long WriteDelay() const { return writeDelay; }
+    long WriteBatch() const { return writeBatch; }
     int ShareMode() const { return shareMode; }
 
   private:
@@ -133,6 +153,10 @@ class ComParams
     int inDsr;
     long intervalTimeout;
     long writeQueueLimit;
+    long readBufSize;
+    long readOverlaps;
+    long writeDelay;
+    long writeBatch;
     int shareMode;
 };
 ///////////////////////////////////////////////////////////////
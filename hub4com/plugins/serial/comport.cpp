@@ -132,6 +132,8 @@
 
 #include "precomp.h"
 #include "../plugins_api.h"
+
+#include "filterx.h"
 ///////////////////////////////////////////////////////////////
 namespace PortSerial {
 ///////////////////////////////////////////////////////////////
@@ -304,11 +306,18 @@ static BOOL PrintEscOptions(
   return delimitNext;
 }
 ///////////////////////////////////////////////////////////////
+#define READ_BUF_SIZE_MIN 64
+///////////////////////////////////////////////////////////////
 ComPort::ComPort(
     const ComParams &comParams,
     const char *pPath)
   : hMasterPort(NULL)
   , countReadOverlapped(0)
+  , readOverlaps(comParams.ReadOverlaps())
+  , readBufSizeMin(READ_BUF_SIZE_MIN)
+  , readBufSizeMax(comParams.ReadBufSize())
+  , readSeqNext(0)
+  , readSeqDeliver(0)
   , countWaitCommEventOverlapped(0)
   , countXoff(0)
   , escapeOptions(0)
@@ -327,8 +336,14 @@ ComPort::ComPort(
   , writeLost(0)
   , writeLostTotal(0)
   , errors(0)
-  , pWriteBuf(NULL)
-  , lenWriteBuf(0)
+  , writeDelay(comParams.WriteDelay())
+  , writeBatch(comParams.WriteBatch())
+  , writeHold(FALSE)
+  , hWriteTimer(NULL)
+  , writeBytes(0)
+  , writeOps(0)
+  , latencyStats(FALSE)
+  , writeBufTime(0)
 {
   pComIo = new ComIo(*this, pPath);
 
@@ -339,6 +354,14 @@ ComPort::ComPort(
 
   name = pComIo->Path().substr(pComIo->Path().rfind('\\') + 1);
 
+  if (!writeBatch)
+    writeBatch = writeQueueLimit/2;
+
+  if (readBufSizeMin > readBufSizeMax)
+    readBufSizeMin = readBufSizeMax;
+
+  readBufSize = readBufSizeMin;
+
   for (int iO = 0 ; iO < 2 ; iO++) {
     intercepted_options[iO] = 0;
     inOptions[iO] = 0;
@@ -357,6 +380,11 @@ ComPort::ComPort(
     writeOverlappedBuf.push(pOverlapped);
   }
 
+  if (!writeRing.Alloc(writeQueueLimit*2)) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
   pComIo->Open(comParams);
 }
 
@@ -400,6 +428,8 @@ void ComPort::Update()
 
 BOOL ComPort::Start()
 {
+  latencyStats = (pLatencyNow && pAddQueueLatency && pLatencyNow());
+
   return Start(true);
 }
 
@@ -639,27 +669,38 @@ BOOL ComPort::Start(BOOL first)
 
 BOOL ComPort::StartRead()
 {
-  if (countReadOverlapped)
-    return TRUE;
-
   _ASSERTE(pComIo != NULL);
   _ASSERTE(pComIo->Handle() != INVALID_HANDLE_VALUE);
 
-  ReadOverlapped *pOverlapped;
+  while (countReadOverlapped < readOverlaps) {
+    ReadOverlapped *pOverlapped;
 
-  pOverlapped = new ReadOverlapped(*pComIo);
+    pOverlapped = new ReadOverlapped(*pComIo);
 
-  if (!pOverlapped)
-    return FALSE;
+    if (!pOverlapped)
+      return countReadOverlapped > 0;
 
-  if (!pOverlapped->StartRead()) {
-    delete pOverlapped;
-    return FALSE;
+    if (!RestartRead(pOverlapped)) {
+      delete pOverlapped;
+      return countReadOverlapped > 0;
+    }
+
+    countReadOverlapped++;
+
+    //cout << name << " Started Read " << countReadOverlapped << endl;
   }
 
-  countReadOverlapped++;
+  return TRUE;
+}
 
-  //cout << name << " Started Read " << countReadOverlapped << endl;
+BOOL ComPort::RestartRead(ReadOverlapped *pOverlapped)
+{
+  if (!pOverlapped->StartRead(readBufSize, readSeqNext))
+    return FALSE;
+
+  // the sequence number is consumed by the started reads only
+  // so the delivering will never wait for a not started one
+  readSeqNext++;
 
   return TRUE;
 }
@@ -700,6 +741,21 @@ BOOL ComPort::FakeReadFilter(HUB_MSG *pInMsg)
       }
       break;
     }
+    case HUB_MSG_T2N(HUB_MSG_TYPE_TICK): {
+      if (pInMsg->u.hv2.hVal0 != this)
+        break;
+
+      if (pInMsg->u.hv2.hVal1 == hWriteTimer) {
+        if (writeHold)
+          FlushWrites();
+      }
+
+      // discard owned tick
+      if (!pMsgReplaceNone(pInMsg, HUB_MSG_TYPE_EMPTY))
+        return FALSE;
+
+      break;
+    }
   }
 
   return pInMsg != NULL;
@@ -739,19 +795,13 @@ void ComPort::PurgeWrite(BOOL withLost)
   if (pComIo->Handle() != INVALID_HANDLE_VALUE)
     pComIo->PurgeWrite();
 
-  if (lenWriteBuf) {
-    _ASSERTE(pWriteBuf != NULL);
-
-    if (withLost)
-      writeLost += lenWriteBuf;
+  DWORD len = writeRing.Drop(writeRing.Queued());
 
-    _ASSERTE(writeQueued >= lenWriteBuf);
-    writeQueued -= lenWriteBuf;
+  if (withLost)
+    writeLost += len;
 
-    lenWriteBuf = 0;
-    pBufFree(pWriteBuf);
-    pWriteBuf = NULL;
-  }
+  _ASSERTE(writeQueued >= len);
+  writeQueued -= len;
 
   if (!withLost) {
     _ASSERTE(writeLost >= writeQueued);
@@ -759,29 +809,105 @@ void ComPort::PurgeWrite(BOOL withLost)
   }
 }
 
-void ComPort::FilterX(BYTE *pBuf, DWORD &len)
+void ComPort::StartQueuedWrites()
+{
+  _ASSERTE(pComIo != NULL);
+
+  while (pComIo->Handle() != INVALID_HANDLE_VALUE && writeRing.Queued() && !writeHold && writeOverlappedBuf.size()) {
+    WriteOverlapped *pOverlapped = writeOverlappedBuf.front();
+
+    _ASSERTE(pOverlapped != NULL);
+
+    // write the queued data directly from the ring
+    BYTE *pBuf;
+    DWORD len;
+
+    writeRing.Start(&pBuf, &len, 1);
+
+    if (pOverlapped->StartWrite(pBuf, len, FALSE)) {
+      writeOverlappedBuf.pop();
+
+      writeBytes += len;
+      writeOps++;
+
+      if (latencyStats)
+        pAddQueueLatency(hMasterPort, writeBufTime);
+    } else {
+      writeRing.Done(len);
+      writeLost += len;
+
+      _ASSERTE(writeQueued >= len);
+      writeQueued -= len;
+    }
+  }
+}
+
+void ComPort::HoldWrites()
+{
+  if (writeRing.Queued() >= writeBatch) {
+    FlushWrites();
+    return;
+  }
+
+  if (writeHold || !writeRing.Queued())
+    return;
+
+  if (!hWriteTimer)
+    hWriteTimer = pTimerCreate((HTIMEROWNER)this);
+
+  if (!hWriteTimer) {
+    FlushWrites();
+    return;
+  }
+
+  LARGE_INTEGER dueTime;
+
+  dueTime.QuadPart = -10LL * writeDelay;
+
+  if (!pTimerSet(hWriteTimer, hMasterPort, &dueTime, 0, (HTIMERPARAM)hWriteTimer)) {
+    FlushWrites();
+    return;
+  }
+
+  writeHold = TRUE;
+}
+
+void ComPort::FlushWrites()
+{
+  if (writeHold) {
+    writeHold = FALSE;
+    pTimerCancel(hWriteTimer);
+  }
+
+  StartQueuedWrites();
+}
+
+///////////////////////////////////////////////////////////////
+BOOL ComPort::FilterX(BYTE **ppBuf, DWORD &len)
 {
   _ASSERTE(pComIo != NULL);
-  _ASSERTE(pComIo->Handle() != INVALID_HANDLE_VALUE);
 
   BYTE xOn;
   BYTE xOff;
 
   if (pComIo->FilterX(xOn, xOff)) {
-    BYTE *pSrc = pBuf;
-    BYTE *pDst = pBuf;
-
-    for (DWORD i = 0 ; i < len ; i++) {
-      if (*pSrc == xOn || *pSrc == xOff) {
-        pSrc++;
-        writeLost++;
-      } else {
-        *pDst++ = *pSrc++;
-      }
-    }
+    DWORD i = FindX(*ppBuf, len, xOn, xOff);
+
+    if (i == len)
+      return TRUE;
+
+    // the buffer can be shared so get private copy before modifying
 
-    len = DWORD(pDst - pBuf);
+    if (!pBufUnshare(ppBuf, len))
+      return FALSE;
+
+    DWORD newLen = i + StripX(*ppBuf + i, len - i, xOn, xOff);
+
+    writeLost += len - newLen;
+    len = newLen;
   }
+
+  return TRUE;
 }
 
 void ComPort::UpdateOutOptions(DWORD options)
@@ -851,20 +977,31 @@ BOOL ComPort::Write(HUB_MSG *pMsg)
       return FALSE;
     }
 
-    if (writeQueued > writeQueueLimit)
-      PurgeWrite(TRUE);
+    if (writeQueued > writeQueueLimit) {
+      writeRing.Drop(writeQueued - writeQueueLimit, writeQueued, writeLost);
 
-    _ASSERTE(pComIo != NULL);
+      // the rest is queued by the driver
+      if (writeQueued > writeQueueLimit)
+        PurgeWrite(TRUE);
+    }
 
-    if (pComIo->Handle() != INVALID_HANDLE_VALUE && writeOverlappedBuf.size()) {
-      _ASSERTE(pWriteBuf == NULL);
-      _ASSERTE(lenWriteBuf == 0);
+    // the queued data is written from the ring as is so it's filtered
+    // here even if the port is closed (the settings are kept for
+    // reopening)
+    if (!FilterX(&pMsg->u.buf.pBuf, len)) {
+      writeLost += len;
+      return FALSE;
+    }
+
+    if (!len)
+      return TRUE;
 
-      FilterX(pBuf, len);
+    pBuf = pMsg->u.buf.pBuf;
 
-      if (!len)
-        return TRUE;
+    // the urgent data is not held
+    BOOL hold = (writeDelay && !(pMsgIsUrgent && pMsgIsUrgent(pMsg)));
 
+    if (pComIo->Handle() != INVALID_HANDLE_VALUE && writeOverlappedBuf.size() && !writeRing.Queued() && !hold) {
       WriteOverlapped *pOverlapped = writeOverlappedBuf.front();
 
       _ASSERTE(pOverlapped != NULL);
@@ -877,15 +1014,27 @@ BOOL ComPort::Write(HUB_MSG *pMsg)
 
       writeOverlappedBuf.pop();
 
+      writeBytes += len;
+      writeOps++;
+
+      if (latencyStats)
+        pAddQueueLatency(hMasterPort, pLatencyNow());
+
       pMsg->type = HUB_MSG_TYPE_EMPTY;  // detach pBuf
+
+      writeQueued += len;
     } else {
-      _ASSERTE((pWriteBuf == NULL && lenWriteBuf == 0) || (pWriteBuf != NULL && lenWriteBuf != 0));
+      if (latencyStats && !writeRing.Queued())
+        writeBufTime = pLatencyNow();
+
+      writeRing.Put(pBuf, len, writeQueued, writeLost);
 
-      pBufAppend(&pWriteBuf, lenWriteBuf, pBuf, len);
-      lenWriteBuf += len;
+      if (hold)
+        HoldWrites();
+      else
+        FlushWrites();
     }
 
-    writeQueued += len;
     FlowControlUpdate();
 
     //cout << name << " Started Write " << len << " " << writeQueued << endl;
@@ -1090,38 +1239,53 @@ void ComPort::OnWrite(WriteOverlapped *pOverlapped, DWORD len, DWORD done)
   _ASSERTE(writeQueued >= len);
   writeQueued -= len;
 
-  _ASSERTE(pComIo != NULL);
-  _ASSERTE(pWriteBuf != NULL || lenWriteBuf == 0);
-  _ASSERTE(pWriteBuf == NULL || lenWriteBuf != 0);
+  if (!pOverlapped->Owned())
+    writeRing.Done(len);
 
-  if (pComIo->Handle() != INVALID_HANDLE_VALUE && lenWriteBuf) {
-    _ASSERTE(writeQueued >= lenWriteBuf);
-    writeQueued -= lenWriteBuf;
+  writeOverlappedBuf.push(pOverlapped);
 
-    FilterX(pWriteBuf, lenWriteBuf);
+  StartQueuedWrites();
 
-    if (!lenWriteBuf || !pOverlapped->StartWrite(pWriteBuf, lenWriteBuf)) {
-      writeOverlappedBuf.push(pOverlapped);
+  FlowControlUpdate();
+}
 
-      writeLost += lenWriteBuf;
-      pBufFree(pWriteBuf);
-    } else {
-      writeQueued += lenWriteBuf;
-    }
+void ComPort::OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD len, DWORD done)
+{
+  //cout << name << " OnRead " << ::GetCurrentThreadId() << endl;
 
-    lenWriteBuf = 0;
-    pWriteBuf = NULL;
-  } else {
-    writeOverlappedBuf.push(pOverlapped);
+  AdaptReadSize(len, done);
+
+  if (pOverlapped->Seq() != readSeqDeliver) {
+    // an earlier started read is not completed yet
+    ReadCompleted &completed = readCompleted[pOverlapped->Seq()];
+
+    completed.pOverlapped = pOverlapped;
+    completed.pBuf = pBuf;
+    completed.done = done;
+
+    return;
   }
 
-  FlowControlUpdate();
+  for (;;) {
+    readSeqDeliver++;
+
+    DeliverRead(pOverlapped, pBuf, done);
+
+    ReadCompletedMap::iterator i = readCompleted.find(readSeqDeliver);
+
+    if (i == readCompleted.end())
+      break;
+
+    pOverlapped = i->second.pOverlapped;
+    pBuf = i->second.pBuf;
+    done = i->second.done;
+
+    readCompleted.erase(i);
+  }
 }
 
-void ComPort::OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done)
+void ComPort::DeliverRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done)
 {
-  //cout << name << " OnRead " << ::GetCurrentThreadId() << endl;
-
   HUB_MSG msg;
 
   msg.type = HUB_MSG_TYPE_LINE_DATA;
@@ -1130,7 +1294,7 @@ void ComPort::OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done)
 
   pOnRead(hMasterPort, &msg);
 
-  if (pComIo->Handle() == INVALID_HANDLE_VALUE || countXoff > 0 || !pOverlapped->StartRead()) {
+  if (pComIo->Handle() == INVALID_HANDLE_VALUE || countXoff > 0 || !RestartRead(pOverlapped)) {
     delete pOverlapped;
 
     countReadOverlapped--;
@@ -1141,6 +1305,23 @@ void ComPort::OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done)
   }
 }
 
+void ComPort::AdaptReadSize(DWORD len, DWORD done)
+{
+  if (!done)
+    return;   // failed or cancelled
+
+  if (done >= len) {
+    // full read, there is more data waiting in the driver
+    if (len >= readBufSize && readBufSize < readBufSizeMax)
+      readBufSize = (readBufSize <= readBufSizeMax/2) ? readBufSize*2 : readBufSizeMax;
+  }
+  else
+  if (done < readBufSize/2 && readBufSize > readBufSizeMin) {
+    // partial read, do not allocate more than needed
+    readBufSize = (readBufSize/2 >= readBufSizeMin) ? readBufSize/2 : readBufSizeMin;
+  }
+}
+
 void ComPort::OnCommEvent(WaitCommEventOverlapped *pOverlapped, DWORD eMask)
 {
   cout << name << " OnCommEvent " << ::GetCurrentThreadId() << " [";
@@ -1166,7 +1347,7 @@ void ComPort::CheckComEvents(DWORD eMask)
   if (GO1_O2V_MODEM_STATUS(inOptions[1]) && (eMask & (EV_CTS|EV_DSR|EV_RLSD|EV_RING)) != 0) {
     DWORD stat = 0;
 
-    if (pComIo->Handle() == INVALID_HANDLE_VALUE || ::GetCommModemStatus(pComIo->Handle(), &stat)) {
+    if (pComIo->Handle() == INVALID_HANDLE_VALUE || pComIo->GetModemStatus(&stat)) {
       HUB_MSG msg;
 
       msg.type = HUB_MSG_TYPE_MODEM_STATUS;
@@ -1179,7 +1360,7 @@ void ComPort::CheckComEvents(DWORD eMask)
   if (pComIo->Handle() != INVALID_HANDLE_VALUE && (eMask & (EV_BREAK|EV_ERR)) != 0) {
     DWORD errs;
 
-    if (::ClearCommError(pComIo->Handle(), &errs, NULL))
+    if (pComIo->ClearErrors(&errs))
       errors |= errs;
   }
 }
@@ -1202,21 +1383,9 @@ void ComPort::LostReport()
     _ASSERTE(pComIo != NULL);
 
     if (pComIo->Handle() != INVALID_HANDLE_VALUE) {
-      #define IOCTL_SERIAL_GET_STATS CTL_CODE(FILE_DEVICE_SERIAL_PORT,35,METHOD_BUFFERED,FILE_ANY_ACCESS)
-
-      typedef struct _SERIALPERF_STATS {
-        ULONG ReceivedCount;
-        ULONG TransmittedCount;
-        ULONG FrameErrorCount;
-        ULONG SerialOverrunErrorCount;
-        ULONG BufferOverrunErrorCount;
-        ULONG ParityErrorCount;
-      } SERIALPERF_STATS, *PSERIALPERF_STATS;
-
       SERIALPERF_STATS stats;
-      DWORD size;
 
-      if (DeviceIoControl(pComIo->Handle(), IOCTL_SERIAL_GET_STATS, NULL, 0, &stats, sizeof(stats), &size, NULL)) {
+      if (pComIo->GetPerfStats(stats)) {
         cout << ", total"
           << " RXOVER=" << stats.BufferOverrunErrorCount
           << " OVERRUN=" << stats.SerialOverrunErrorCount
@@ -1228,6 +1397,20 @@ void ComPort::LostReport()
     cout << endl;
   }
 }
+
+void ComPort::GetStats(PORT_STATS *pStats) const
+{
+  if (ITEM_IS_VALID(pStats, writeQueued))
+    pStats->writeQueued = writeQueued;
+
+  if (ITEM_IS_VALID(pStats, writeLost))
+    pStats->writeLost = (ULONGLONG)writeLostTotal + writeLost;
+
+  if (ITEM_IS_VALID(pStats, writeOps)) {
+    pStats->writeBytes = writeBytes;
+    pStats->writeOps = writeOps;
+  }
+}
 ///////////////////////////////////////////////////////////////
 } // end namespace
 ///////////////////////////////////////////////////////////////
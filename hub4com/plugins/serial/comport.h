@@ -106,6 +106,8 @@
 #ifndef _COMPORT_H
 #define _COMPORT_H
 
+#include "../writering.h"
+
 ///////////////////////////////////////////////////////////////
 class ComParams;
 class WriteOverlapped;
@@ -113,6 +115,15 @@ class ReadOverlapped;
 class WaitCommEventOverlapped;
 class ComIo;
 ///////////////////////////////////////////////////////////////
+struct ReadCompleted
+{
+  ReadOverlapped *pOverlapped;
+  BYTE *pBuf;
+  DWORD done;
+};
+
+typedef map<DWORD, ReadCompleted> ReadCompletedMap;
+///////////////////////////////////////////////////////////////
 class ComPort
 {
   public:
@@ -126,24 +137,32 @@ class ComPort
     BOOL Write(HUB_MSG *pMsg);
 
     void OnWrite(WriteOverlapped *pOverlapped, DWORD len, DWORD done);
-    void OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done);
+    void OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD len, DWORD done);
     void OnCommEvent(WaitCommEventOverlapped *pOverlapped, DWORD eMask);
     void OnPortFree() { Update(); }
 
     void LostReport();
+    void GetStats(PORT_STATS *pStats) const;
 
     const string &Name() const { return name; }
     void Name(const char *pName) { name = pName; }
+    HMASTERPORT MasterPort() const { return hMasterPort; }
 
   private:
     void FlowControlUpdate();
     void PurgeWrite(BOOL withLost);
-    void FilterX(BYTE *pBuf, DWORD &len);
+    void StartQueuedWrites();
+    void HoldWrites();
+    void FlushWrites();
+    BOOL FilterX(BYTE **ppBuf, DWORD &len);
     void UpdateOutOptions(DWORD options);
     void StartDisconnect();
     void Update();
     BOOL Start(BOOL first);
     BOOL StartRead();
+    BOOL RestartRead(ReadOverlapped *pOverlapped);
+    void DeliverRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done);
+    void AdaptReadSize(DWORD len, DWORD done);
     BOOL StartWaitCommEvent();
     void CheckComEvents(DWORD eMask);
 
@@ -152,6 +171,13 @@ class ComPort
     HMASTERPORT hMasterPort;
 
     int countReadOverlapped;
+    int readOverlaps;
+    DWORD readBufSizeMin;
+    DWORD readBufSizeMax;
+    DWORD readBufSize;          // the size of the next read
+    DWORD readSeqNext;          // the sequence number of the next read
+    DWORD readSeqDeliver;       // the sequence number of the read to deliver
+    ReadCompletedMap readCompleted;   // completed out of order
     int countWaitCommEventOverlapped;
     int countXoff;
 
@@ -177,8 +203,18 @@ class ComPort
     DWORD errors;
 
     queue<WriteOverlapped *> writeOverlappedBuf;
-    BYTE *pWriteBuf;
-    DWORD lenWriteBuf;
+    WriteRing writeRing;
+
+    DWORD writeDelay;           // us to hold writeRing (see --write-delay)
+    DWORD writeBatch;           // bytes to stop holding (see --write-batch)
+    BOOL writeHold;             // writeRing is held by hWriteTimer
+    HMASTERTIMER hWriteTimer;
+
+    ULONGLONG writeBytes;       // the data passed to the started writes
+    ULONGLONG writeOps;         // the number of the started writes
+
+    BOOL latencyStats;
+    ULONGLONG writeBufTime;     // the queuing time of writeRing
 
 #ifdef _DEBUG
   private:
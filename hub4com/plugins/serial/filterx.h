@@ -0,0 +1,139 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2006-2011 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _FILTERX_H
+#define _FILTERX_H
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+  #define FILTERX_SSE2
+  #include <emmintrin.h>
+#endif
+///////////////////////////////////////////////////////////////
+namespace PortSerial {
+///////////////////////////////////////////////////////////////
+//
+// The kernels of ComPort::FilterX(). The SSE2 ones test 16 bytes per
+// step and leave the tail to the scalar ones. FindX() and StripX()
+// are the SSE2 ones if SSE2 is available (x64, /arch:SSE2 or __SSE2__)
+// else the scalar ones.
+//
+///////////////////////////////////////////////////////////////
+// Returns the index of the first xOn or xOff byte from i or len if none
+inline DWORD FindXScalar(const BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff, DWORD i = 0)
+{
+  for ( ; i < len ; i++) {
+    if (pBuf[i] == xOn || pBuf[i] == xOff)
+      break;
+  }
+
+  return i;
+}
+///////////////////////////////////////////////////////////////
+// Copies the bytes except xOn and xOff from [pSrc, pEnd) to pDst
+// (pDst <= pSrc), returns the end of the copied bytes
+inline BYTE *CopyX(BYTE *pDst, const BYTE *pSrc, const BYTE *pEnd, BYTE xOn, BYTE xOff)
+{
+  for ( ; pSrc < pEnd ; pSrc++) {
+    if (*pSrc != xOn && *pSrc != xOff)
+      *pDst++ = *pSrc;
+  }
+
+  return pDst;
+}
+///////////////////////////////////////////////////////////////
+// Removes xOn and xOff bytes in place, returns the new length
+inline DWORD StripXScalar(BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff)
+{
+  return DWORD(CopyX(pBuf, pBuf, pBuf + len, xOn, xOff) - pBuf);
+}
+///////////////////////////////////////////////////////////////
+#ifdef FILTERX_SSE2
+inline DWORD FindXSse2(const BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff)
+{
+  const __m128i on = _mm_set1_epi8((char)xOn);
+  const __m128i off = _mm_set1_epi8((char)xOff);
+  DWORD i = 0;
+
+  for ( ; i + 16 <= len ; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(pBuf + i));
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, on), _mm_cmpeq_epi8(v, off)));
+
+    if (mask)
+      break;
+  }
+
+  return FindXScalar(pBuf, len, xOn, xOff, i);
+}
+
+inline DWORD StripXSse2(BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff)
+{
+  const __m128i on = _mm_set1_epi8((char)xOn);
+  const __m128i off = _mm_set1_epi8((char)xOff);
+  const BYTE *pSrc = pBuf;
+  const BYTE *pEnd = pBuf + len;
+  BYTE *pDst = pBuf;
+
+  while (pEnd - pSrc >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)pSrc);
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, on), _mm_cmpeq_epi8(v, off)));
+
+    if (!mask) {
+      // the block is loaded so the overlapping store is safe (pDst <= pSrc)
+      _mm_storeu_si128((__m128i *)pDst, v);
+      pDst += 16;
+    } else {
+      for (int j = 0 ; j < 16 ; j++, mask >>= 1) {
+        if (!(mask & 1))
+          *pDst++ = pSrc[j];
+      }
+    }
+
+    pSrc += 16;
+  }
+
+  return DWORD(CopyX(pDst, pSrc, pEnd, xOn, xOff) - pBuf);
+}
+#endif  /* FILTERX_SSE2 */
+///////////////////////////////////////////////////////////////
+inline DWORD FindX(const BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff)
+{
+#ifdef FILTERX_SSE2
+  return FindXSse2(pBuf, len, xOn, xOff);
+#else
+  return FindXScalar(pBuf, len, xOn, xOff);
+#endif
+}
+
+inline DWORD StripX(BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff)
+{
+#ifdef FILTERX_SSE2
+  return StripXSse2(pBuf, len, xOn, xOff);
+#else
+  return StripXScalar(pBuf, len, xOn, xOff);
+#endif
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
+
+#endif  // _FILTERX_H
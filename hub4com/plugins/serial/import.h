@@ -43,8 +43,22 @@
 extern ROUTINE_BUF_ALLOC *pBufAlloc;
 extern ROUTINE_BUF_FREE *pBufFree;
 extern ROUTINE_BUF_APPEND *pBufAppend;
+extern ROUTINE_BUF_UNSHARE *pBufUnshare;
 extern ROUTINE_MSG_INSERT_NONE *pMsgInsertNone;
+extern ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
+extern ROUTINE_MSG_IS_URGENT *pMsgIsUrgent;
 extern ROUTINE_ON_READ *pOnRead;
+extern ROUTINE_TIMER_CREATE *pTimerCreate;
+extern ROUTINE_TIMER_SET *pTimerSet;
+extern ROUTINE_TIMER_CANCEL *pTimerCancel;
+extern ROUTINE_LATENCY_NOW *pLatencyNow;
+extern ROUTINE_ADD_QUEUE_LATENCY *pAddQueueLatency;
+#ifndef _WIN32
+extern ROUTINE_WATCH_CREATE *pWatchCreate;
+extern ROUTINE_WATCH_SET *pWatchSet;
+extern ROUTINE_WATCH_DELETE *pWatchDelete;
+extern ROUTINE_DEFER *pDefer;
+#endif  /* _WIN32 */
 ///////////////////////////////////////////////////////////////
 
 #endif  // _IMPORT_H
@@ -172,8 +172,24 @@ static void CALLBACK Help(const char *pProgPath)
   << "                             where <t> is " << ComParams::IntervalTimeoutLst() << "." << endl
   << "  --write-limit=<s>        - set write queue limit to <s> (" << ComParams().WriteQueueLimitStr() << " by default)," << endl
   << "                             where <s> is " << ComParams::WriteQueueLimitLst() << ". The queue" << endl
-  << "                             will be purged with data lost on overruning." << endl
+  << "                             will lose the oldest data on overruning." << endl
   << "                             The value 0 will disable writing to the port." << endl
+  << "  --read-size=<s>          - set maximum read buffer size to <s> (" << ComParams().ReadBufSizeStr() << " by default)," << endl
+  << "                             where <s> is " << ComParams::ReadBufSizeLst() << ". The read" << endl
+  << "                             buffer size starts at 64 bytes, doubles while the" << endl
+  << "                             reads come back full and halves while they come" << endl
+  << "                             back less than half full." << endl
+  << "  --reads=<n>              - set number of outstanding reads to <n> (" << ComParams().ReadOverlapsStr() << " by" << endl
+  << "                             default), where <n> is " << ComParams::ReadOverlapsLst() << ". The" << endl
+  << "                             readed data is delivered in the order of reads." << endl
+  << "  --write-delay=<t>        - hold the written data up to <t> (" << ComParams().WriteDelayStr() << " by default)" << endl
+  << "                             to write it by one operation, where <t> is" << endl
+  << "                             " << ComParams::WriteDelayLst() << ". The hold timer" << endl
+  << "                             has 1 ms granularity so <t> is rounded up to" << endl
+  << "                             milliseconds. The value 0 will disable holding." << endl
+  << "  --write-batch=<s>        - write the held data as soon as <s> bytes are held" << endl
+  << "                             (" << ComParams().WriteBatchStr() << " by default)," << endl
+  << "                             where <s> is " << ComParams::WriteBatchLst() << "." << endl
   << "  --share-mode=<c>         - set share mode to <c> (" << ComParams().ShareModeStr() << " by default), where <c>" << endl
   << "                             is " << ComParams::ShareModeLst() << "." << endl
   << endl
@@ -296,6 +312,30 @@ static BOOL CALLBACK Config(
       exit(1);
     }
   } else
+  if ((pParam = GetParam(pArg, "--read-size=")) != NULL) {
+    if (!comParams.SetReadBufSize(pParam)) {
+      Diag("Invalid read size value in ", pArg);
+      exit(1);
+    }
+  } else
+  if ((pParam = GetParam(pArg, "--reads=")) != NULL) {
+    if (!comParams.SetReadOverlaps(pParam)) {
+      Diag("Invalid reads value in ", pArg);
+      exit(1);
+    }
+  } else
+  if ((pParam = GetParam(pArg, "--write-delay=")) != NULL) {
+    if (!comParams.SetWriteDelay(pParam)) {
+      Diag("Invalid write delay value in ", pArg);
+      exit(1);
+    }
+  } else
+  if ((pParam = GetParam(pArg, "--write-batch=")) != NULL) {
+    if (!comParams.SetWriteBatch(pParam)) {
+      Diag("Invalid write batch value in ", pArg);
+      exit(1);
+    }
+  } else
   if ((pParam = GetParam(pArg, "--share-mode=")) != NULL) {
     if (!comParams.SetShareMode(pParam)) {
       Diag("Invalid share mode value in ", pArg);
@@ -393,6 +433,16 @@ static void CALLBACK LostReport(
   ((ComPort *)hPort)->LostReport();
 }
 ///////////////////////////////////////////////////////////////
+static void CALLBACK GetStats(
+    HPORT hPort,
+    PORT_STATS *pStats)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pStats != NULL);
+
+  ((ComPort *)hPort)->GetStats(pStats);
+}
+///////////////////////////////////////////////////////////////
 static const PORT_ROUTINES_A routines = {
   sizeof(PORT_ROUTINES_A),
   GetPluginType,
@@ -409,6 +459,7 @@ static const PORT_ROUTINES_A routines = {
   FakeReadFilter,
   Write,
   LostReport,
+  GetStats,
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -419,8 +470,22 @@ static const PLUGIN_ROUTINES_A *const plugins[] = {
 ROUTINE_BUF_ALLOC *pBufAlloc;
 ROUTINE_BUF_FREE *pBufFree;
 ROUTINE_BUF_APPEND *pBufAppend;
+ROUTINE_BUF_UNSHARE *pBufUnshare;
 ROUTINE_MSG_INSERT_NONE *pMsgInsertNone;
+ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
+ROUTINE_MSG_IS_URGENT *pMsgIsUrgent;
 ROUTINE_ON_READ *pOnRead;
+ROUTINE_TIMER_CREATE *pTimerCreate;
+ROUTINE_TIMER_SET *pTimerSet;
+ROUTINE_TIMER_CANCEL *pTimerCancel;
+ROUTINE_LATENCY_NOW *pLatencyNow;
+ROUTINE_ADD_QUEUE_LATENCY *pAddQueueLatency;
+#ifndef _WIN32
+ROUTINE_WATCH_CREATE *pWatchCreate;
+ROUTINE_WATCH_SET *pWatchSet;
+ROUTINE_WATCH_DELETE *pWatchDelete;
+ROUTINE_DEFER *pDefer;
+#endif  /* _WIN32 */
 ///////////////////////////////////////////////////////////////
 PLUGIN_INIT_A InitA;
 const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
@@ -429,19 +494,49 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   if (!ROUTINE_IS_VALID(pHubRoutines, pBufAlloc) ||
       !ROUTINE_IS_VALID(pHubRoutines, pBufFree) ||
       !ROUTINE_IS_VALID(pHubRoutines, pBufAppend) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pBufUnshare) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgInsertNone) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceNone) ||
       !ROUTINE_IS_VALID(pHubRoutines, pOnRead) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCreate) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerSet) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCancel) ||
       !ROUTINE_IS_VALID(pHubRoutines, pGetArgInfo))
   {
     return NULL;
   }
 
+#ifndef _WIN32
+  if (!ROUTINE_IS_VALID(pHubRoutines, pWatchCreate) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pWatchSet) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pWatchDelete) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pDefer))
+  {
+    return NULL;
+  }
+#endif  /* _WIN32 */
+
   pBufAlloc = pHubRoutines->pBufAlloc;
   pBufFree = pHubRoutines->pBufFree;
   pBufAppend = pHubRoutines->pBufAppend;
+  pBufUnshare = pHubRoutines->pBufUnshare;
   pMsgInsertNone = pHubRoutines->pMsgInsertNone;
+  pMsgReplaceNone = pHubRoutines->pMsgReplaceNone;
+  pMsgIsUrgent = ROUTINE_GET(pHubRoutines, pMsgIsUrgent);
   pOnRead = pHubRoutines->pOnRead;
+  pTimerCreate = pHubRoutines->pTimerCreate;
+  pTimerSet = pHubRoutines->pTimerSet;
+  pTimerCancel = pHubRoutines->pTimerCancel;
   pGetArgInfo = pHubRoutines->pGetArgInfo;
+  pLatencyNow = ROUTINE_GET(pHubRoutines, pLatencyNow);
+  pAddQueueLatency = ROUTINE_GET(pHubRoutines, pAddQueueLatency);
+
+#ifndef _WIN32
+  pWatchCreate = pHubRoutines->pWatchCreate;
+  pWatchSet = pHubRoutines->pWatchSet;
+  pWatchDelete = pHubRoutines->pWatchDelete;
+  pDefer = pHubRoutines->pDefer;
+#endif  /* _WIN32 */
 
   return plugins;
 }
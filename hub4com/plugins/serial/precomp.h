@@ -33,6 +33,8 @@
 #include <crtdbg.h>
 
 #include <queue>
+#include <deque>
+#include <map>
 #include <iostream>
 #include <sstream>
 
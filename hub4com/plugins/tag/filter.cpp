@@ -38,7 +38,8 @@
 ///////////////////////////////////////////////////////////////
 namespace FilterTag {
 ///////////////////////////////////////////////////////////////
-static ROUTINE_MSG_REPLACE_BUF *pMsgReplaceBuf;
+static ROUTINE_MSG_BUF_RESERVE *pMsgBufReserve;
+static ROUTINE_MSG_BUF_COMMIT *pMsgBufCommit;
 ///////////////////////////////////////////////////////////////
 #ifndef _DEBUG
   #define DEBUG_PARAM(par)
@@ -475,15 +476,19 @@ static BOOL CALLBACK InMethod(
         break;
 
       BYTE tag = (BYTE)((Filter *)hFilter)->tagIn;
-      basic_string<BYTE> line_data;
+      BYTE *pOut = pMsgBufReserve(pInMsg, len*2);
+
+      if (!pOut)
+        return FALSE;
+
+      BYTE *pOutEnd = pOut;
 
       for (const BYTE *pBuf = pInMsg->u.buf.pBuf ; len ; len--) {
-        line_data.append(&tag, 1);
-        line_data.append(pBuf++, 1);
+        *pOutEnd++ = tag;
+        *pOutEnd++ = *pBuf++;
       }
 
-      if (!pMsgReplaceBuf(pInMsg, HUB_MSG_TYPE_LINE_DATA, line_data.data(), (DWORD)line_data.size()))
-        return FALSE;
+      pMsgBufCommit(pInMsg, pOut, (DWORD)(pOutEnd - pOut));
 
       break;
     }
@@ -515,14 +520,21 @@ static BOOL CALLBACK OutMethod(
       BYTE tag = (BYTE)((Filter *)hFilter)->tagOut;
       BOOL isValOut = ((State *)hFilterInstance)->isValOut;
       BOOL isMyValOut = ((State *)hFilterInstance)->isMyValOut;
-      basic_string<BYTE> line_data;
+
+      // discarding in place
+      BYTE *pOut = pMsgBufReserve(pOutMsg, len);
+
+      if (!pOut)
+        return FALSE;
+
+      BYTE *pOutEnd = pOut;
 
       for (const BYTE *pBuf = pOutMsg->u.buf.pBuf ; len ; len--) {
         BYTE ch = *pBuf++;
 
         if (isValOut) {
           if (isMyValOut)
-            line_data.append(&ch, 1);
+            *pOutEnd++ = ch;
 
           isValOut = FALSE;
         } else {
@@ -534,8 +546,7 @@ static BOOL CALLBACK OutMethod(
       ((State *)hFilterInstance)->isValOut = isValOut;
       ((State *)hFilterInstance)->isMyValOut = isMyValOut;
 
-      if (!pMsgReplaceBuf(pOutMsg, HUB_MSG_TYPE_LINE_DATA, line_data.data(), (DWORD)line_data.size()))
-        return FALSE;
+      pMsgBufCommit(pOutMsg, pOut, (DWORD)(pOutEnd - pOut));
 
       break;
     }
@@ -569,17 +580,22 @@ static BOOL CALLBACK InMethodSync(
 
       BYTE sync = (BYTE)((FilterSync *)hFilter)->syncIn;
       BOOL isValIn = ((StateSync *)hFilterInstance)->isValIn;
-      basic_string<BYTE> line_data;
+      BYTE *pOut = pMsgBufReserve(pInMsg, len);
+
+      if (!pOut)
+        return FALSE;
+
+      BYTE *pOutEnd = pOut;
 
       for (const BYTE *pBuf = pInMsg->u.buf.pBuf ; len ; len--) {
         BYTE ch = *pBuf++;
 
         if (isValIn) {
-          line_data.append(&ch, 1);
+          *pOutEnd++ = ch;
           isValIn = FALSE;
         } else {
           if (ch != sync) {
-            line_data.append(&ch, 1);
+            *pOutEnd++ = ch;
             isValIn = TRUE;
           }
         }
@@ -587,8 +603,7 @@ static BOOL CALLBACK InMethodSync(
 
       ((StateSync *)hFilterInstance)->isValIn = isValIn;
 
-      if (!pMsgReplaceBuf(pInMsg, HUB_MSG_TYPE_LINE_DATA, line_data.data(), (DWORD)line_data.size()))
-        return FALSE;
+      pMsgBufCommit(pInMsg, pOut, (DWORD)(pOutEnd - pOut));
 
       break;
     }
@@ -622,23 +637,30 @@ static BOOL CALLBACK OutMethodSync(
       BYTE sync = (BYTE)((FilterSync *)hFilter)->syncOut;
       BOOL isValOut = ((StateSync *)hFilterInstance)->isValOut;
       int periodOut = ((StateSync *)hFilterInstance)->periodOut;
-      basic_string<BYTE> line_data;
+
+      // up to one sync per value
+      BYTE *pOut = pMsgBufReserve(pOutMsg, len*2);
+
+      if (!pOut)
+        return FALSE;
+
+      BYTE *pOutEnd = pOut;
 
       for (const BYTE *pBuf = pOutMsg->u.buf.pBuf ; len ; len--) {
         BYTE ch = *pBuf++;
 
         if (isValOut) {
-          line_data.append(&ch, 1);
+          *pOutEnd++ = ch;
           isValOut = FALSE;
         } else {
           if (periodOut > 0) {
             if (periodOut-- == 1) {
-              line_data.append(&sync, 1);
+              *pOutEnd++ = sync;
               periodOut = ((FilterSync *)hFilter)->periodOut;
             }
           }
 
-          line_data.append(&ch, 1);
+          *pOutEnd++ = ch;
           isValOut = TRUE;
         }
       }
@@ -646,8 +668,7 @@ static BOOL CALLBACK OutMethodSync(
       ((StateSync *)hFilterInstance)->isValOut = isValOut;
       ((StateSync *)hFilterInstance)->periodOut = periodOut;
 
-      if (!pMsgReplaceBuf(pOutMsg, HUB_MSG_TYPE_LINE_DATA, line_data.data(), (DWORD)line_data.size()))
-        return FALSE;
+      pMsgBufCommit(pOutMsg, pOut, (DWORD)(pOutEnd - pOut));
 
       break;
     }
@@ -656,6 +677,18 @@ static BOOL CALLBACK OutMethodSync(
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetInMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_LINE_DATA);
+}
+///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetOutMsgTypes(
+    HFILTER /*hFilter*/)
+{
+  return HUB_MSG_T2M(HUB_MSG_TYPE_LINE_DATA);
+}
+///////////////////////////////////////////////////////////////
 static const FILTER_ROUTINES_A routines = {
   sizeof(FILTER_ROUTINES_A),
   GetPluginType,
@@ -670,6 +703,8 @@ static const FILTER_ROUTINES_A routines = {
   DeleteInstance,
   InMethod,
   OutMethod,
+  GetInMsgTypes,
+  GetOutMsgTypes,
 };
 
 static const FILTER_ROUTINES_A routinesSync = {
@@ -686,6 +721,8 @@ static const FILTER_ROUTINES_A routinesSync = {
   DeleteInstanceSync,
   InMethodSync,
   OutMethodSync,
+  GetInMsgTypes,
+  GetOutMsgTypes,
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -698,10 +735,14 @@ PLUGIN_INIT_A InitA;
 const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
     const HUB_ROUTINES_A * pHubRoutines)
 {
-  if (!ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceBuf))
+  if (!ROUTINE_IS_VALID(pHubRoutines, pMsgBufReserve) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufCommit))
+  {
     return NULL;
+  }
 
-  pMsgReplaceBuf = pHubRoutines->pMsgReplaceBuf;
+  pMsgBufReserve = pHubRoutines->pMsgBufReserve;
+  pMsgBufCommit = pHubRoutines->pMsgBufCommit;
 
   return plugins;
 }
@@ -311,20 +311,30 @@ VOID CALLBACK WriteOverlapped::OnWrite(
   pOver->port.OnWrite(pOver, pOver->len, done);
 }
 
+void CALLBACK WriteOverlapped::OnWriteV(
+    DWORD err,
+    DWORD done,
+    LPWSAOVERLAPPED pOverlapped,
+    DWORD /*flags*/)
+{
+  OnWrite(err, done, pOverlapped);
+}
+
 void WriteOverlapped::BufFree()
 {
-  _ASSERTE(pBuf != NULL);
+  _ASSERTE(count != 0);
 
-  pBufFree(pBuf);
+  if (owned) {
+    for (DWORD i = 0 ; i < count ; i++)
+      pBufFree(pBufs[i]);
+  }
 
-#ifdef _DEBUG
-  pBuf = NULL;
-#endif
+  count = 0;
 }
 
-BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len)
+BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len, BOOL _owned)
 {
-  _ASSERTE(pBuf == NULL);
+  _ASSERTE(count == 0);
 
   ::memset((OVERLAPPED *)this, 0, sizeof(OVERLAPPED));
 
@@ -336,15 +346,63 @@ BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len)
     return FALSE;
   }
 
-  pBuf = _pBuf;
+  pBufs[0] = _pBuf;
+  lens[0] = _len;
+  count = 1;
   len = _len;
+  owned = _owned;
+
+  return TRUE;
+}
+
+BOOL WriteOverlapped::StartWrite(BYTE **_pBufs, const DWORD *_lens, DWORD _count, BOOL _owned)
+{
+  _ASSERTE(count == 0);
+  _ASSERTE(_count != 0 && _count <= WRITE_BUFS_MAX);
+
+  if (_count == 1)
+    return StartWrite(_pBufs[0], _lens[0], _owned);
+
+  ::memset((OVERLAPPED *)this, 0, sizeof(OVERLAPPED));
+
+  WSABUF bufs[WRITE_BUFS_MAX];
+  DWORD _len = 0;
+
+  for (DWORD i = 0 ; i < _count ; i++) {
+    _ASSERTE(_pBufs[i] != NULL);
+    _ASSERTE(_lens[i] != 0);
+
+    bufs[i].buf = (char *)_pBufs[i];
+    bufs[i].len = _lens[i];
+    _len += _lens[i];
+  }
+
+  // the completion routine is queued even if the operation completed immediately
+  if (::WSASend(port.Sock(), bufs, _count, NULL, 0, this, OnWriteV) == SOCKET_ERROR) {
+    DWORD err = ::WSAGetLastError();
+
+    if (err != WSA_IO_PENDING) {
+      TraceError(err, "WriteOverlapped::StartWrite(): WSASend(%x) %s", port.Handle(), port.Name().c_str());
+      return FALSE;
+    }
+  }
+
+  for (DWORD i = 0 ; i < _count ; i++) {
+    pBufs[i] = _pBufs[i];
+    lens[i] = _lens[i];
+  }
+
+  count = _count;
+  len = _len;
+  owned = _owned;
 
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
 ReadOverlapped::ReadOverlapped(ComPort &_port)
   : port(_port),
-    pBuf(NULL)
+    pBuf(NULL),
+    len(0)
 {
 }
 
@@ -371,18 +429,22 @@ VOID CALLBACK ReadOverlapped::OnRead(
   pOver->port.OnRead(pOver, pInBuf, done);
 }
 
-BOOL ReadOverlapped::StartRead()
+BOOL ReadOverlapped::StartRead(DWORD maxLen)
 {
   ::memset((OVERLAPPED *)this, 0, sizeof(OVERLAPPED));
 
   #define readBufSize 64
 
-  pBuf = pBufAlloc(readBufSize);
+  _ASSERTE(maxLen != 0);
+
+  len = maxLen < readBufSize ? maxLen : readBufSize;
+
+  pBuf = pBufAlloc(len);
 
   if (!pBuf)
     return FALSE;
 
-  if (!::ReadFileEx(port.Handle(), pBuf, readBufSize, this, OnRead)) {
+  if (!::ReadFileEx(port.Handle(), pBuf, len, this, OnRead)) {
     TraceError(GetLastError(), "ReadOverlapped::StartRead(): ReadFileEx(%x) %s", port.Handle(), port.Name().c_str());
     return FALSE;
   }
@@ -390,22 +452,15 @@ BOOL ReadOverlapped::StartRead()
   return TRUE;
 }
 ///////////////////////////////////////////////////////////////
-static HANDLE hThread = INVALID_HANDLE_VALUE;
-#ifdef _DEBUG
-static DWORD idThread;
-#endif  /* _DEBUG */
+static DWORD tlsThread = ::TlsAlloc();
 
-static BOOL SetThread()
+static HANDLE GetThread()
 {
-#ifdef _DEBUG
-  if (hThread == INVALID_HANDLE_VALUE) {
-    idThread = ::GetCurrentThreadId();
-  } else {
-    _ASSERTE(idThread == ::GetCurrentThreadId());
-  }
-#endif  /* _DEBUG */
+  // the ports of the hub can be handled by several threads so
+  // the events of each port are queued to the thread of the port
+  HANDLE hThread = (HANDLE)::TlsGetValue(tlsThread);
 
-  if (hThread == INVALID_HANDLE_VALUE) {
+  if (!hThread) {
     if (!::DuplicateHandle(::GetCurrentProcess(),
                            ::GetCurrentThread(),
                            ::GetCurrentProcess(),
@@ -414,25 +469,26 @@ static BOOL SetThread()
                            FALSE,
                            DUPLICATE_SAME_ACCESS))
     {
-      hThread = INVALID_HANDLE_VALUE;
-
       TraceError(
           GetLastError(),
-          "SetThread(): DuplicateHandle()");
+          "GetThread(): DuplicateHandle()");
 
-      return FALSE;
+      return NULL;
     }
+
+    ::TlsSetValue(tlsThread, hThread);
   }
 
-  return TRUE;
+  return hThread;
 }
 ///////////////////////////////////////////////////////////////
 WaitEventOverlapped::WaitEventOverlapped(ComPort &_port, SOCKET hSockWait)
   : port(_port),
     hSock(hSockWait),
+    hThread(GetThread()),
     hWait(INVALID_HANDLE_VALUE)
 {
-  if (!SetThread())
+  if (!hThread)
       return;
 
   hEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
@@ -490,7 +546,7 @@ VOID CALLBACK WaitEventOverlapped::OnEvent(
     BOOLEAN /*timerOrWaitFired*/)
 {
   ((WaitEventOverlapped *)pOverlapped)->LockDelete();
-  if (!::QueueUserAPC(OnEvent, hThread, (ULONG_PTR)pOverlapped))
+  if (!::QueueUserAPC(OnEvent, ((WaitEventOverlapped *)pOverlapped)->hThread, (ULONG_PTR)pOverlapped))
     ((WaitEventOverlapped *)pOverlapped)->UnockDelete();
 }
 
@@ -551,9 +607,10 @@ BOOL WaitEventOverlapped::StartWaitEvent()
 ListenOverlapped::ListenOverlapped(Listener &_listener, SOCKET hSockWait)
   : listener(_listener),
     hSock(hSockWait),
+    hThread(GetThread()),
     hWait(INVALID_HANDLE_VALUE)
 {
-  if (!SetThread())
+  if (!hThread)
       return;
 
   hEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
@@ -618,7 +675,7 @@ VOID CALLBACK ListenOverlapped::OnEvent(
     BOOLEAN /*timerOrWaitFired*/)
 {
   ((ListenOverlapped *)pOverlapped)->LockDelete();
-  if (!::QueueUserAPC(OnEvent, hThread, (ULONG_PTR)pOverlapped))
+  if (!::QueueUserAPC(OnEvent, ((ListenOverlapped *)pOverlapped)->hThread, (ULONG_PTR)pOverlapped))
     ((ListenOverlapped *)pOverlapped)->UnockDelete();
 }
 
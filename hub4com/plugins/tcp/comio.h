@@ -43,6 +43,15 @@
 class ComPort;
 class Listener;
 ///////////////////////////////////////////////////////////////
+#define WRITE_BUFS_MAX 16
+
+#ifdef _WIN32
+  #define WRITE_OVERLAPPED_MAX 3
+#else  /* _WIN32 */
+  // a blocked send would be overtaken by the next one
+  #define WRITE_OVERLAPPED_MAX 1
+#endif  /* _WIN32 */
+///////////////////////////////////////////////////////////////
 extern BOOL SetAddr(struct sockaddr_in &sn, const char *pAddr, const char *pPort);
 extern SOCKET Socket(const struct sockaddr_in &sn);
 extern BOOL Connect(const char *pName, SOCKET hSock, const struct sockaddr_in &snRemote);
@@ -51,49 +60,110 @@ extern SOCKET Accept(const char *pName, SOCKET hSockListen, int cmd);
 extern void Disconnect(const char *pName, SOCKET hSock);
 extern void Close(const char *pName, SOCKET hSock);
 ///////////////////////////////////////////////////////////////
+#ifndef _WIN32
+class SockIo
+{
+  public:
+    // stops the watches of hSock and reports them OnClose()
+    static void CloseAll(SOCKET hSock);
+
+  protected:
+    SockIo() : hWatchSock(INVALID_SOCKET), hWatch(NULL) {}
+    virtual ~SockIo() { WatchStop(); }
+
+    BOOL WatchStart(HMASTERPORT hMasterPort, SOCKET hSock, DWORD events);
+    BOOL WatchSet(DWORD events);
+    void WatchStop();
+    BOOL IsWatching() const { return hWatch != NULL; }
+
+    virtual void OnWatch(DWORD events) = 0;
+    virtual void OnClose() = 0;
+
+  private:
+    static void CALLBACK WatchProc(HWATCHPARAM hWatchParam, DWORD events);
+
+    SOCKET hWatchSock;
+    HMASTERWATCH hWatch;
+};
+#endif  /* _WIN32 */
+///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class ReadOverlapped : private OVERLAPPED
+#else  /* _WIN32 */
+class ReadOverlapped : private SockIo
+#endif  /* _WIN32 */
 {
   public:
     ReadOverlapped(ComPort &_port);
     ~ReadOverlapped();
-    BOOL StartRead();
+    BOOL StartRead(DWORD maxLen);
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnRead(
         DWORD err,
         DWORD done,
         LPOVERLAPPED pOverlapped);
+#else  /* _WIN32 */
+    virtual void OnWatch(DWORD events);
+    virtual void OnClose();
+    static void CALLBACK OnRead(HDEFERPARAM hDeferParam);
+#endif  /* _WIN32 */
 
     ComPort &port;
     BYTE *pBuf;
+    DWORD len;
 };
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class WriteOverlapped : private OVERLAPPED
+#else  /* _WIN32 */
+class WriteOverlapped : private SockIo
+#endif  /* _WIN32 */
 {
   public:
-    WriteOverlapped(ComPort &_port) : port(_port) {
-#ifdef _DEBUG
-      pBuf = NULL;
-#endif
-    }
+    WriteOverlapped(ComPort &_port) : port(_port), count(0), owned(TRUE) {}
 #ifdef _DEBUG
     ~WriteOverlapped() {
-      _ASSERTE(pBuf == NULL);
+      _ASSERTE(count == 0);
     }
 #endif
 
-    BOOL StartWrite(BYTE *_pBuf, DWORD _len);
+    // the buffers will be freed on completion if _owned
+    BOOL StartWrite(BYTE *_pBuf, DWORD _len, BOOL _owned = TRUE);
+
+    // gathers up to WRITE_BUFS_MAX buffers into one send
+    BOOL StartWrite(BYTE **_pBufs, const DWORD *_lens, DWORD _count, BOOL _owned = TRUE);
+
+    BOOL Owned() const { return owned; }
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnWrite(
       DWORD err,
       DWORD done,
       LPOVERLAPPED pOverlapped);
+    static void CALLBACK OnWriteV(
+      DWORD err,
+      DWORD done,
+      LPWSAOVERLAPPED pOverlapped,
+      DWORD flags);
+#else  /* _WIN32 */
+    virtual void OnWatch(DWORD events);
+    virtual void OnClose();
+    static void CALLBACK OnWrite(HDEFERPARAM hDeferParam);
+    BOOL Send();
+
+    DWORD done;
+#endif  /* _WIN32 */
     void BufFree();
 
     ComPort &port;
-    BYTE *pBuf;
+    BYTE *pBufs[WRITE_BUFS_MAX];
+    DWORD lens[WRITE_BUFS_MAX];
+    DWORD count;
     DWORD len;
+    BOOL owned;
 };
 ///////////////////////////////////////////////////////////////
 class SafeDelete
@@ -133,7 +203,11 @@ class SafeDelete
     int locked;
 };
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class WaitEventOverlapped : public SafeDelete
+#else  /* _WIN32 */
+class WaitEventOverlapped : public SafeDelete, private SockIo
+#endif  /* _WIN32 */
 {
   public:
     WaitEventOverlapped(ComPort &_port, SOCKET hSockWait);
@@ -143,15 +217,25 @@ class WaitEventOverlapped : public SafeDelete
     SOCKET Sock() { return hSock; }
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnEvent(
       PVOID pParameter,
       BOOLEAN timerOrWaitFired);
     static VOID CALLBACK OnEvent(ULONG_PTR pOverlapped);
+#else  /* _WIN32 */
+    virtual void OnWatch(DWORD events);
+    virtual void OnClose() {}
+#endif  /* _WIN32 */
 
     ComPort &port;
     SOCKET hSock;
+#ifdef _WIN32
+    HANDLE hThread;
     HANDLE hWait;
     HANDLE hEvent;
+#else  /* _WIN32 */
+    BOOL connecting;
+#endif  /* _WIN32 */
 
 #ifdef _DEBUG
   private:
@@ -159,7 +243,11 @@ class WaitEventOverlapped : public SafeDelete
 #endif  /* _DEBUG */
 };
 ///////////////////////////////////////////////////////////////
+#ifdef _WIN32
 class ListenOverlapped : public SafeDelete
+#else  /* _WIN32 */
+class ListenOverlapped : public SafeDelete, private SockIo
+#endif  /* _WIN32 */
 {
   public:
     ListenOverlapped(Listener &_listener, SOCKET hSockWait);
@@ -169,15 +257,23 @@ class ListenOverlapped : public SafeDelete
     SOCKET Sock() { return hSock; }
 
   private:
+#ifdef _WIN32
     static VOID CALLBACK OnEvent(
       PVOID pParameter,
       BOOLEAN timerOrWaitFired);
     static VOID CALLBACK OnEvent(ULONG_PTR pOverlapped);
+#else  /* _WIN32 */
+    virtual void OnWatch(DWORD events);
+    virtual void OnClose() {}
+#endif  /* _WIN32 */
 
     Listener &listener;
     SOCKET hSock;
+#ifdef _WIN32
+    HANDLE hThread;
     HANDLE hWait;
     HANDLE hEvent;
+#endif  /* _WIN32 */
 
 #ifdef _DEBUG
   private:
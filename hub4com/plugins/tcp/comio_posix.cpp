@@ -0,0 +1,690 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+/*
+ * The POSIX version of comio.cpp. The sockets are non-blocking and
+ * the readiness of them is watched by the hub's loop. The completions
+ * are reported to ComPort and Listener in the same way as for the
+ * overlapped I/O on Windows (never from the Start*() routines).
+ */
+
+#include "precomp.h"
+#include "../plugins_api.h"
+///////////////////////////////////////////////////////////////
+namespace PortTcp {
+///////////////////////////////////////////////////////////////
+#include "comio.h"
+#include "comport.h"
+#include "import.h"
+///////////////////////////////////////////////////////////////
+static void TraceError(DWORD err, const char *pFmt, ...)
+{
+  va_list va;
+  va_start(va, pFmt);
+  vfprintf(stderr, pFmt, va);
+  va_end(va);
+
+  fprintf(stderr, " ERROR %lu - %s\n", (unsigned long)err, strerror((int)err));
+
+  fflush(stderr);
+}
+///////////////////////////////////////////////////////////////
+static ostream &OutAddr(ostream &out, const struct sockaddr_in &sn)
+{
+  u_long addr = ntohl(sn.sin_addr.s_addr);
+  u_short port  = ntohs(sn.sin_port);
+
+  return out
+       << ((addr >> 24) & 0xFF) << '.'
+       << ((addr >> 16) & 0xFF) << '.'
+       << ((addr >>  8) & 0xFF) << '.'
+       << ( addr        & 0xFF) << ':'
+       << port;
+}
+///////////////////////////////////////////////////////////////
+BOOL SetAddr(struct sockaddr_in &sn, const char *pAddr, const char *pPort)
+{
+  memset(&sn, 0, sizeof(sn));
+  sn.sin_family = AF_INET;
+
+  if (pPort) {
+    struct servent *pServEnt;
+
+    pServEnt = getservbyname(pPort, "tcp");
+
+    sn.sin_port = pServEnt ? pServEnt->s_port : htons((u_short)atoi(pPort));
+  }
+
+  sn.sin_addr.s_addr = pAddr ? inet_addr(pAddr) : INADDR_ANY;
+
+  if (sn.sin_addr.s_addr == INADDR_NONE) {
+    const struct hostent *pHostEnt = gethostbyname(pAddr);
+
+    if (!pHostEnt) {
+      cerr << "SetAddr(): gethostbyname(\"" << pAddr << "\") ERROR - " << hstrerror(h_errno) << endl;
+      return FALSE;
+    }
+
+    memcpy(&sn.sin_addr, pHostEnt->h_addr, pHostEnt->h_length);
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static BOOL SetNonBlocking(SOCKET hSock)
+{
+  int flags = fcntl(hSock, F_GETFL, 0);
+
+  if (flags < 0 || fcntl(hSock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    TraceError(GetLastError(), "SetNonBlocking(%x): fcntl()", hSock);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+SOCKET Socket(const struct sockaddr_in &sn)
+{
+  SOCKET hSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  if (hSock == INVALID_SOCKET) {
+    TraceError(GetLastError(), "Socket(): socket()");
+    return INVALID_SOCKET;
+  }
+
+  if (!SetNonBlocking(hSock)) {
+    closesocket(hSock);
+    return INVALID_SOCKET;
+  }
+
+  if (sn.sin_port) {
+    int on = 1;
+
+    // allow to restart the hub while the old connections are in TIME_WAIT
+    setsockopt(hSock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  }
+
+  if (bind(hSock, (struct sockaddr *)&sn, sizeof(sn)) == SOCKET_ERROR) {
+    TraceError(GetLastError(), "Socket(): bind()");
+    closesocket(hSock);
+    return INVALID_SOCKET;
+  }
+
+  cout << "Socket(";
+  OutAddr(cout, sn) << ") = " << hex << hSock << dec << endl;
+
+  return hSock;
+}
+///////////////////////////////////////////////////////////////
+BOOL Connect(const char *pName, SOCKET hSock, const struct sockaddr_in &snRemote)
+{
+  if (connect(hSock, (struct sockaddr *)&snRemote, sizeof(snRemote)) == SOCKET_ERROR) {
+    DWORD err = GetLastError();
+
+    if (err != EINPROGRESS) {
+      TraceError(err, "Connect(%x): connect() %s", hSock, pName);
+      return FALSE;
+    }
+  }
+
+  cout << pName << ": Connect(" << hex << hSock << dec << ", ";
+  OutAddr(cout, snRemote) << ") ..." << endl;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+BOOL Listen(SOCKET hSock)
+{
+  if (listen(hSock, SOMAXCONN) == SOCKET_ERROR) {
+    TraceError(GetLastError(), "Listen(%x): listen()", hSock);
+    closesocket(hSock);
+    return FALSE;
+  }
+
+  cout << "Listen(" << hex << hSock << dec << ") - OK" << endl;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+struct DeferedSock {
+  DeferedSock(SOCKET _hSock, const struct sockaddr_in &_sn) : hSock(_hSock), sn(_sn) {}
+
+  SOCKET hSock;
+  struct sockaddr_in sn;
+};
+
+typedef map<SOCKET, queue<DeferedSock> > DeferedSocks;
+
+// there is not a way to leave the connection in the backlog of the
+// level-triggered listening socket so the defered connections are
+// accepted and queued here till the next Accept()
+//
+// the sockets are handled by the threads of their ports so the
+// queues (and the registry of SockIo objects below) are per thread
+static __thread DeferedSocks *pDeferedSocks = NULL;
+
+static DeferedSocks &DeferedSocksOfThread()
+{
+  if (!pDeferedSocks)
+    pDeferedSocks = new DeferedSocks;
+
+  return *pDeferedSocks;
+}
+
+SOCKET Accept(const char *pName, SOCKET hSockListen, int cmd)
+{
+  DeferedSocks &deferedSocks = DeferedSocksOfThread();
+
+  for (;;) {
+    SOCKET hSock;
+    struct sockaddr_in sn;
+    BOOL defered = FALSE;
+
+    DeferedSocks::iterator iDefered = deferedSocks.find(hSockListen);
+
+    if (cmd != CF_DEFER && iDefered != deferedSocks.end() && !iDefered->second.empty()) {
+      hSock = iDefered->second.front().hSock;
+      sn = iDefered->second.front().sn;
+      iDefered->second.pop();
+    } else {
+      socklen_t len = sizeof(sn);
+
+      ::memset(&sn, 0, sizeof(sn));
+
+      hSock = accept(hSockListen, (struct sockaddr *)&sn, &len);
+
+      if (hSock == INVALID_SOCKET) {
+        DWORD err = GetLastError();
+
+        switch (err) {
+          case EAGAIN:
+          case EINTR:
+            return INVALID_SOCKET;
+          case ECONNABORTED:
+            continue;
+          default:
+            TraceError(err, "Accept(%x): accept() %s", hSockListen, pName);
+            return INVALID_SOCKET;
+        }
+      }
+
+      if (!SetNonBlocking(hSock)) {
+        closesocket(hSock);
+        continue;
+      }
+
+      if (cmd == CF_DEFER) {
+        deferedSocks[hSockListen].push(DeferedSock(hSock, sn));
+        defered = TRUE;
+      }
+    }
+
+    stringstream buf;
+
+    if (defered) {
+      buf << "defered";
+      hSock = INVALID_SOCKET;
+    }
+    else
+    if (cmd == CF_REJECT) {
+      buf << "rejected";
+      closesocket(hSock);
+      hSock = INVALID_SOCKET;
+    } else {
+      buf << hex << hSock << dec;
+    }
+
+    cout << pName << ": Accept(" << hex << hSockListen << dec << ") = " << buf.str() << " from ";
+    OutAddr(cout, sn) << endl;
+
+    if (hSock != INVALID_SOCKET || defered)
+      return hSock;
+  }
+}
+///////////////////////////////////////////////////////////////
+void Disconnect(const char *pName, SOCKET hSock)
+{
+  if (shutdown(hSock, SD_SEND) != 0)
+    TraceError(GetLastError(), "Disconnect(%x): shutdown() %s", hSock, pName);
+  else
+    cout << pName << ": Disconnect(" << hex << hSock << dec << ") - OK" << endl;
+}
+///////////////////////////////////////////////////////////////
+void Close(const char *pName, SOCKET hSock)
+{
+  if (hSock == INVALID_SOCKET)
+    return;
+
+  SockIo::CloseAll(hSock);
+
+  if (closesocket(hSock) != 0)
+    TraceError(GetLastError(), "Close(): closesocket(%x) %s", hSock, pName);
+  else
+    cout << pName << ": Close(" << hex << hSock << dec << ") - OK" << endl;
+}
+///////////////////////////////////////////////////////////////
+typedef multimap<SOCKET, SockIo *> SockIoMap;
+
+static __thread SockIoMap *pSockIos = NULL;
+
+static SockIoMap &SockIosOfThread()
+{
+  if (!pSockIos)
+    pSockIos = new SockIoMap;
+
+  return *pSockIos;
+}
+
+BOOL SockIo::WatchStart(HMASTERPORT hMasterPort, SOCKET hSock, DWORD events)
+{
+  _ASSERTE(hWatch == NULL);
+  _ASSERTE(hSock != INVALID_SOCKET);
+
+  hWatch = pWatchCreate(hMasterPort, hSock, WatchProc, (HWATCHPARAM)this);
+
+  if (!hWatch)
+    return FALSE;
+
+  if (!pWatchSet(hWatch, events)) {
+    pWatchDelete(hWatch);
+    hWatch = NULL;
+    return FALSE;
+  }
+
+  hWatchSock = hSock;
+  SockIosOfThread().insert(pair<SOCKET, SockIo *>(hSock, this));
+
+  return TRUE;
+}
+
+BOOL SockIo::WatchSet(DWORD events)
+{
+  _ASSERTE(hWatch != NULL);
+
+  return pWatchSet(hWatch, events);
+}
+
+void SockIo::WatchStop()
+{
+  if (!hWatch)
+    return;
+
+  pWatchDelete(hWatch);
+  hWatch = NULL;
+
+  SockIoMap &sockIos = SockIosOfThread();
+
+  for (SockIoMap::iterator i = sockIos.find(hWatchSock) ; i != sockIos.end() && i->first == hWatchSock ; i++) {
+    if (i->second == this) {
+      sockIos.erase(i);
+      break;
+    }
+  }
+
+  hWatchSock = INVALID_SOCKET;
+}
+
+void SockIo::CloseAll(SOCKET hSock)
+{
+  SockIoMap &sockIos = SockIosOfThread();
+  vector<SockIo *> closed;
+
+  for (SockIoMap::iterator i = sockIos.find(hSock) ; i != sockIos.end() && i->first == hSock ; i++)
+    closed.push_back(i->second);
+
+  for (vector<SockIo *>::iterator i = closed.begin() ; i != closed.end() ; i++) {
+    (*i)->WatchStop();
+    (*i)->OnClose();
+  }
+
+  DeferedSocks &deferedSocks = DeferedSocksOfThread();
+  DeferedSocks::iterator iDefered = deferedSocks.find(hSock);
+
+  if (iDefered != deferedSocks.end()) {
+    for ( ; !iDefered->second.empty() ; iDefered->second.pop())
+      closesocket(iDefered->second.front().hSock);
+
+    deferedSocks.erase(iDefered);
+  }
+}
+
+void CALLBACK SockIo::WatchProc(HWATCHPARAM hWatchParam, DWORD events)
+{
+  ((SockIo *)hWatchParam)->OnWatch(events);
+}
+///////////////////////////////////////////////////////////////
+void CALLBACK WriteOverlapped::OnWrite(HDEFERPARAM hDeferParam)
+{
+  WriteOverlapped *pOver = (WriteOverlapped *)hDeferParam;
+
+  pOver->BufFree();
+  pOver->port.OnWrite(pOver, pOver->len, pOver->done);
+}
+
+void WriteOverlapped::BufFree()
+{
+  _ASSERTE(count != 0);
+
+  if (owned) {
+    for (DWORD i = 0 ; i < count ; i++)
+      pBufFree(pBufs[i]);
+  }
+
+  count = 0;
+}
+
+BOOL WriteOverlapped::Send()
+{
+  while (done < len) {
+    struct iovec iov[WRITE_BUFS_MAX];
+    struct msghdr msg;
+    DWORD skip = done;
+    DWORD i = 0;
+
+    // skip the sent buffers
+    while (skip >= lens[i])
+      skip -= lens[i++];
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+
+    for (; i < count ; i++) {
+      iov[msg.msg_iovlen].iov_base = pBufs[i] + skip;
+      iov[msg.msg_iovlen].iov_len = lens[i] - skip;
+      msg.msg_iovlen++;
+      skip = 0;
+    }
+
+    ssize_t res = sendmsg(port.Sock(), &msg, MSG_NOSIGNAL);
+
+    if (res < 0) {
+      DWORD err = GetLastError();
+
+      if (err == EINTR)
+        continue;
+
+      if (err == EAGAIN)
+        return FALSE;
+
+      TraceError(err, "WriteOverlapped::OnWrite: %s", port.Name().c_str());
+      break;
+    }
+
+    done += (DWORD)res;
+  }
+
+  return TRUE;
+}
+
+void WriteOverlapped::OnWatch(DWORD /*events*/)
+{
+  if (!Send())
+    return;
+
+  WatchStop();
+  OnWrite((HDEFERPARAM)this);
+}
+
+void WriteOverlapped::OnClose()
+{
+  // aborted
+  pDefer(port.MasterPort(), OnWrite, (HDEFERPARAM)this);
+}
+
+BOOL WriteOverlapped::StartWrite(BYTE *_pBuf, DWORD _len, BOOL _owned)
+{
+  return StartWrite(&_pBuf, &_len, 1, _owned);
+}
+
+BOOL WriteOverlapped::StartWrite(BYTE **_pBufs, const DWORD *_lens, DWORD _count, BOOL _owned)
+{
+  _ASSERTE(count == 0);
+  _ASSERTE(_count != 0 && _count <= WRITE_BUFS_MAX);
+
+  len = 0;
+
+  for (DWORD i = 0 ; i < _count ; i++) {
+    _ASSERTE(_pBufs[i] != NULL);
+    _ASSERTE(_lens[i] != 0);
+
+    pBufs[i] = _pBufs[i];
+    lens[i] = _lens[i];
+    len += _lens[i];
+  }
+
+  count = _count;
+  owned = _owned;
+  done = 0;
+
+  if (Send()) {
+    if (pDefer(port.MasterPort(), OnWrite, (HDEFERPARAM)this))
+      return TRUE;
+  }
+  else
+  if (WatchStart(port.MasterPort(), port.Sock(), WATCH_EVENT_WRITE)) {
+    return TRUE;
+  }
+
+  cerr << "WriteOverlapped::StartWrite(): can't wait for " << port.Name() << endl;
+
+  // the buffers are still owned by the caller
+  count = 0;
+
+  return FALSE;
+}
+///////////////////////////////////////////////////////////////
+#define readBufSize 64
+///////////////////////////////////////////////////////////////
+ReadOverlapped::ReadOverlapped(ComPort &_port)
+  : port(_port),
+    pBuf(NULL),
+    len(0)
+{
+}
+
+ReadOverlapped::~ReadOverlapped()
+{
+  pBufFree(pBuf);
+}
+
+void CALLBACK ReadOverlapped::OnRead(HDEFERPARAM hDeferParam)
+{
+  ReadOverlapped *pOver = (ReadOverlapped *)hDeferParam;
+
+  BYTE *pInBuf = pOver->pBuf;
+  pOver->pBuf = NULL;
+
+  pOver->port.OnRead(pOver, pInBuf, 0);
+}
+
+void ReadOverlapped::OnWatch(DWORD /*events*/)
+{
+  _ASSERTE(pBuf != NULL);
+
+  ssize_t done = recv(port.Sock(), pBuf, len, 0);
+
+  if (done < 0) {
+    DWORD err = GetLastError();
+
+    if (err == EAGAIN || err == EINTR)
+      return;
+
+    TraceError(err, "ReadOverlapped::OnRead(): %s", port.Name().c_str());
+    done = 0;
+  }
+
+  BYTE *pInBuf = pBuf;
+  pBuf = NULL;
+
+  // the watch is left for the next StartRead() or deleted with this
+  port.OnRead(this, pInBuf, (DWORD)done);
+}
+
+void ReadOverlapped::OnClose()
+{
+  // the watch is kept between reads so abort only a pending one
+  if (pBuf)
+    pDefer(port.MasterPort(), OnRead, (HDEFERPARAM)this);
+}
+
+BOOL ReadOverlapped::StartRead(DWORD maxLen)
+{
+  _ASSERTE(maxLen != 0);
+
+  len = maxLen < readBufSize ? maxLen : readBufSize;
+
+  pBuf = pBufAlloc(len);
+
+  if (!pBuf)
+    return FALSE;
+
+  if (!IsWatching() && !WatchStart(port.MasterPort(), port.Sock(), WATCH_EVENT_READ)) {
+    cerr << "ReadOverlapped::StartRead(): can't wait for " << port.Name() << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+WaitEventOverlapped::WaitEventOverlapped(ComPort &_port, SOCKET hSockWait)
+  : port(_port),
+    hSock(hSockWait),
+    connecting(FALSE)
+{
+}
+
+void WaitEventOverlapped::Delete()
+{
+  WatchStop();
+
+  SafeDelete::Delete();
+}
+
+void WaitEventOverlapped::OnWatch(DWORD events)
+{
+  if (connecting) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(hSock, SOL_SOCKET, SO_ERROR, &err, &len) != 0)
+      err = (int)GetLastError();
+
+    if (err) {
+      connecting = FALSE;
+
+      TraceError(
+          err,
+          "Connect(%lx) %s",
+          (long)hSock,
+          port.Name().c_str());
+
+      port.OnEvent(this, FD_CLOSE);
+      return;
+    }
+
+    struct sockaddr_in sn;
+    socklen_t snLen = sizeof(sn);
+
+    if (getpeername(hSock, (struct sockaddr *)&sn, &snLen) != 0)
+      return;   // still in progress
+
+    connecting = FALSE;
+
+    WatchSet(WATCH_EVENT_HANGUP);
+
+    if (!port.OnEvent(this, FD_CONNECT))
+      return;
+  }
+
+  if ((events & (WATCH_EVENT_HANGUP|WATCH_EVENT_ERROR)) != 0) {
+    if (!port.OnEvent(this, FD_CLOSE))
+      return;
+  }
+}
+
+BOOL WaitEventOverlapped::StartWaitEvent()
+{
+  if (hSock == INVALID_SOCKET)
+    return FALSE;
+
+  struct sockaddr_in sn;
+  socklen_t len = sizeof(sn);
+
+  // not connected socket will be connected by Connect()
+  connecting = (getpeername(hSock, (struct sockaddr *)&sn, &len) != 0);
+
+  if (!WatchStart(port.MasterPort(), hSock, connecting ? (WATCH_EVENT_WRITE|WATCH_EVENT_HANGUP) : WATCH_EVENT_HANGUP)) {
+    cerr << "WaitEventOverlapped::StartWaitEvent(): can't wait for " << port.Name() << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+ListenOverlapped::ListenOverlapped(Listener &_listener, SOCKET hSockWait)
+  : listener(_listener),
+    hSock(hSockWait)
+{
+}
+
+void ListenOverlapped::Delete()
+{
+  WatchStop();
+
+  if (hSock != INVALID_SOCKET) {
+    SockIo::CloseAll(hSock);
+
+    if (closesocket(hSock) != 0) {
+      TraceError(
+          GetLastError(),
+          "ListenOverlapped::~ListenOverlapped(): closesocket(%x)",
+          hSock);
+    }
+    else
+      cout << "Close(" << hex << hSock << dec << ") - OK" << endl;
+  }
+
+  SafeDelete::Delete();
+}
+
+void ListenOverlapped::OnWatch(DWORD events)
+{
+  if ((events & WATCH_EVENT_READ) != 0)
+    listener.OnEvent(this, FD_ACCEPT, 0);
+}
+
+BOOL ListenOverlapped::StartWaitEvent()
+{
+  if (hSock == INVALID_SOCKET)
+    return FALSE;
+
+  if (!WatchStart(listener.MasterPort(), hSock, WATCH_EVENT_READ)) {
+    cerr << "ListenOverlapped::StartWaitEvent(): can't wait" << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+} // end namespace
+///////////////////////////////////////////////////////////////
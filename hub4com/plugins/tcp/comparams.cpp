@@ -45,7 +45,9 @@ namespace PortTcp {
 ComParams::ComParams()
   : pIF(NULL),
     reconnectTime(rtDefault),
-    writeQueueLimit(256)
+    writeQueueLimit(256),
+    writeDelay(0),
+    writeBatch(0)
 {
 }
 ///////////////////////////////////////////////////////////////
@@ -91,5 +93,57 @@ const char *ComParams::WriteQueueLimitLst()
   return "a positive number or 0";
 }
 ///////////////////////////////////////////////////////////////
+BOOL ComParams::SetWriteDelay(const char *pWriteDelay)
+{
+  if (isdigit((unsigned char)*pWriteDelay)) {
+    writeDelay = atol(pWriteDelay);
+    return writeDelay >= 0;
+  }
+
+  return FALSE;
+}
+
+string ComParams::WriteDelayStr(long writeDelay)
+{
+  if (writeDelay >= 0) {
+    stringstream buf;
+    buf << writeDelay;
+    return buf.str();
+  }
+
+  return "?";
+}
+
+const char *ComParams::WriteDelayLst()
+{
+  return "a positive number or 0 microseconds";
+}
+///////////////////////////////////////////////////////////////
+BOOL ComParams::SetWriteBatch(const char *pWriteBatch)
+{
+  if (isdigit((unsigned char)*pWriteBatch)) {
+    writeBatch = atol(pWriteBatch);
+    return writeBatch > 0;
+  }
+
+  return FALSE;
+}
+
+string ComParams::WriteBatchStr(long writeBatch)
+{
+  if (writeBatch > 0) {
+    stringstream buf;
+    buf << writeBatch;
+    return buf.str();
+  }
+
+  return writeBatch == 0 ? "half of the write queue limit" : "?";
+}
+
+const char *ComParams::WriteBatchLst()
+{
+  return "a positive number";
+}
+///////////////////////////////////////////////////////////////
 } // end namespace
 ///////////////////////////////////////////////////////////////
@@ -49,6 +49,18 @@ class ComParams
     static const char *WriteQueueLimitLst();
     long WriteQueueLimit() const { return writeQueueLimit; }
 
+    BOOL SetWriteDelay(const char *pWriteDelay);
+    static string WriteDelayStr(long writeDelay);
+    string WriteDelayStr() const { return WriteDelayStr(writeDelay); }
+    static const char *WriteDelayLst();
+    long WriteDelay() const { return writeDelay; }
+
+    BOOL SetWriteBatch(const char *pWriteBatch);
+    static string WriteBatchStr(long writeBatch);
+    string WriteBatchStr() const { return WriteBatchStr(writeBatch); }
+    static const char *WriteBatchLst();
+    long WriteBatch() const { return writeBatch; }
+
     enum {
       rtDefault = -1,
       rtDisable = -2,
@@ -58,6 +70,8 @@ class ComParams
     char *pIF;
     int reconnectTime;
     long writeQueueLimit;
+    long writeDelay;
+    long writeBatch;
 };
 ///////////////////////////////////////////////////////////////
 
@@ -99,7 +99,8 @@ namespace PortTcp {
 ///////////////////////////////////////////////////////////////
 Listener::Listener(const struct sockaddr_in &_snLocal)
   : snLocal(_snLocal),
-    hSockListen(INVALID_SOCKET)
+    hSockListen(INVALID_SOCKET),
+    hMasterPort(NULL)
 {
 }
 
@@ -110,11 +111,25 @@ void Listener::Push(ComPort *pPort)
   ports.push(pPort);
 }
 
-BOOL Listener::Start()
+void Listener::Join(HMASTERPORT _hMasterPort)
+{
+  _ASSERTE(_hMasterPort != NULL);
+
+  // the ports sharing the listener should be handled by the same thread
+  if (!hMasterPort)
+    hMasterPort = _hMasterPort;
+  else
+  if (pJoinPorts)
+    pJoinPorts(hMasterPort, _hMasterPort);
+}
+
+BOOL Listener::Start(HMASTERPORT _hMasterPort)
 {
   if (hSockListen != INVALID_SOCKET)
     return TRUE;
 
+  hMasterPort = _hMasterPort;
+
   hSockListen = Socket(snLocal);
 
   if (hSockListen == INVALID_SOCKET)
@@ -203,17 +218,30 @@ ComPort::ComPort(
     hMasterPort(NULL),
     countReadOverlapped(0),
     countXoff(0),
+    readCreditWait(FALSE),
     writeQueueLimit(comParams.WriteQueueLimit()),
     writeQueued(0),
     writeSuspended(FALSE),
     writeLost(0),
     writeLostTotal(0),
-    pWriteBuf(NULL),
-    lenWriteBuf(0)
+    writeCreditExhausted(FALSE),
+    pWriteBufUrgent(NULL),
+    lenWriteBufUrgent(0),
+    writeDelay(comParams.WriteDelay()),
+    writeBatch(comParams.WriteBatch()),
+    writeHold(FALSE),
+    hWriteTimer(NULL),
+    writeBytes(0),
+    writeOps(0),
+    latencyStats(FALSE),
+    writeBufTime(0)
 {
   writeQueueLimitSendXoff = (writeQueueLimit*2)/3;
   writeQueueLimitSendXon = writeQueueLimit/3;
 
+  if (!writeBatch)
+    writeBatch = writeQueueLimit/2;
+
   string path(pPath);
 
   for ( ;; path = path.substr(1)) {
@@ -302,7 +330,7 @@ ComPort::ComPort(
     pListener->Push(this);
   }
 
-  for (int i = 0 ; i < 3 ; i++) {
+  for (int i = 0 ; i < WRITE_OVERLAPPED_MAX ; i++) {
     WriteOverlapped *pOverlapped = new WriteOverlapped(*this);
 
     if (!pOverlapped) {
@@ -312,12 +340,20 @@ ComPort::ComPort(
 
     writeOverlappedBuf.push(pOverlapped);
   }
+
+  if (!writeRing.Alloc(writeQueueLimit*2)) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
 }
 
 BOOL ComPort::Init(HMASTERPORT _hMasterPort)
 {
   hMasterPort = _hMasterPort;
 
+  if (pListener)
+    pListener->Join(hMasterPort);
+
   return isValid;
 }
 
@@ -325,8 +361,10 @@ BOOL ComPort::Start()
 {
   _ASSERTE(hMasterPort != NULL);
 
+  latencyStats = (pLatencyNow && pAddQueueLatency && pLatencyNow());
+
   if (pListener) {
-    return pListener->Start();
+    return pListener->Start(hMasterPort);
   } else {
     if (CanConnect())
       StartConnect();
@@ -335,6 +373,15 @@ BOOL ComPort::Start()
   return TRUE;
 }
 
+DWORD ComPort::ReadCredit()
+{
+  DWORD credit = pGetReadCredit ? pGetReadCredit(hMasterPort) : HUB_CREDIT_UNLIMITED;
+
+  readCreditWait = (credit == 0);
+
+  return credit;
+}
+
 BOOL ComPort::StartRead()
 {
   if (countReadOverlapped)
@@ -343,6 +390,11 @@ BOOL ComPort::StartRead()
   if (hSock == INVALID_SOCKET)
     return FALSE;
 
+  DWORD credit = ReadCredit();
+
+  if (!credit)
+    return TRUE;
+
   ReadOverlapped *pOverlapped;
 
   pOverlapped = new ReadOverlapped(*this);
@@ -350,7 +402,7 @@ BOOL ComPort::StartRead()
   if (!pOverlapped)
     return FALSE;
 
-  if (!pOverlapped->StartRead()) {
+  if (!pOverlapped->StartRead(credit)) {
     delete pOverlapped;
     return FALSE;
   }
@@ -375,6 +427,11 @@ BOOL ComPort::FakeReadFilter(HUB_MSG *pInMsg)
         if (CanConnect())
           StartConnect();
       }
+      else
+      if (pInMsg->u.hv2.hVal1 == hWriteTimer) {
+        if (writeHold)
+          FlushWrites();
+      }
 
       // discard owned tick
       if (!pMsgReplaceNone(pInMsg, HUB_MSG_TYPE_EMPTY))
@@ -453,6 +510,30 @@ void ComPort::FlowControlUpdate()
       pOnRead(hMasterPort, &msg);
     }
   }
+
+  if (writeCreditExhausted && writeQueued < writeQueueLimit) {
+    writeCreditExhausted = FALSE;
+
+    HUB_MSG msg;
+
+    msg.type = HUB_MSG_TYPE_CREDIT;
+    msg.u.val = writeQueueLimit - writeQueued;
+
+    pOnRead(hMasterPort, &msg);
+  }
+}
+
+DWORD ComPort::GetWriteCredit()
+{
+  if (!writeQueueLimit)
+    return HUB_CREDIT_UNLIMITED;
+
+  if (writeQueued < writeQueueLimit)
+    return writeQueueLimit - writeQueued;
+
+  writeCreditExhausted = TRUE;
+
+  return 0;
 }
 
 BOOL ComPort::Write(HUB_MSG *pMsg)
@@ -481,21 +562,12 @@ BOOL ComPort::Write(HUB_MSG *pMsg)
       return FALSE;
     }
 
-    if (writeQueued > writeQueueLimit) {
-      if (lenWriteBuf) {
-        _ASSERTE(pWriteBuf != NULL);
-
-        writeLost += lenWriteBuf;
-        writeQueued -= lenWriteBuf;
-        lenWriteBuf = 0;
-        pBufFree(pWriteBuf);
-        pWriteBuf = NULL;
-      }
-    }
+    if (writeQueued > writeQueueLimit)
+      writeRing.Drop(writeQueued - writeQueueLimit, writeQueued, writeLost);
 
-    if (isConnected && writeOverlappedBuf.size()) {
-      _ASSERTE(pWriteBuf == NULL);
-      _ASSERTE(lenWriteBuf == 0);
+    if (isConnected && writeOverlappedBuf.size() && !writeDelay) {
+      _ASSERTE(writeRing.Queued() == 0);
+      _ASSERTE(lenWriteBufUrgent == 0);
 
       WriteOverlapped *pOverlapped = writeOverlappedBuf.front();
 
@@ -508,15 +580,26 @@ BOOL ComPort::Write(HUB_MSG *pMsg)
       }
 
       writeOverlappedBuf.pop();
+
+      writeBytes += len;
+      writeOps++;
+
+      if (latencyStats)
+        pAddQueueLatency(hMasterPort, pLatencyNow());
+
       pMsg->type = HUB_MSG_TYPE_EMPTY;  // detach pBuf
+
+      writeQueued += len;
     } else {
-      _ASSERTE((pWriteBuf == NULL && lenWriteBuf == 0) || (pWriteBuf != NULL && lenWriteBuf != 0));
+      if (latencyStats && !writeRing.Queued())
+        writeBufTime = pLatencyNow();
 
-      pBufAppend(&pWriteBuf, lenWriteBuf, pBuf, len);
-      lenWriteBuf += len;
+      writeRing.Put(pBuf, len, writeQueued, writeLost);
     }
 
-    writeQueued += len;
+    if (writeDelay)
+      HoldWrites();
+
     FlowControlUpdate();
 
     //cout << "Started Write " << name << " " << len << " " << writeQueued << endl;
@@ -530,7 +613,7 @@ BOOL ComPort::Write(HUB_MSG *pMsg)
 
       if (!pListener) {
         if (hReconnectTimer)
-          ::CancelWaitableTimer(hReconnectTimer);
+          pTimerCancel(hReconnectTimer);
 
         StartConnect();
       }
@@ -566,6 +649,10 @@ BOOL ComPort::Write(HUB_MSG *pMsg)
         StartRead();
     }
     break;
+  case HUB_MSG_T2N(HUB_MSG_TYPE_CREDIT):
+    if (readCreditWait && countXoff <= 0 && isConnected)
+      StartRead();
+    break;
   }
 
   return TRUE;
@@ -593,6 +680,217 @@ BOOL ComPort::StartWaitEvent(SOCKET hSockWait)
   return TRUE;
 }
 
+BOOL ComPort::WriteV(HUB_MSG **ppMsgs, DWORD count)
+{
+  _ASSERTE(ppMsgs != NULL);
+
+  BOOL res = TRUE;
+
+  while (count) {
+    // only the immediate write can take the buffers w/o copying them
+    if (!writeQueueLimit || hSock == INVALID_SOCKET || isDisconnected ||
+        !isConnected || !writeOverlappedBuf.size() || writeDelay)
+    {
+      if (!Write(*ppMsgs))
+        res = FALSE;
+
+      ppMsgs++;
+      count--;
+      continue;
+    }
+
+    _ASSERTE(writeRing.Queued() == 0);
+    _ASSERTE(lenWriteBufUrgent == 0);
+
+    HUB_MSG *pMsgs[WRITE_BUFS_MAX];
+    BYTE *pBufs[WRITE_BUFS_MAX];
+    DWORD lens[WRITE_BUFS_MAX];
+    DWORD num = 0;
+    DWORD len = 0;
+
+    for (; count && num < WRITE_BUFS_MAX ; ppMsgs++, count--) {
+      HUB_MSG *pMsg = *ppMsgs;
+
+      _ASSERTE(pMsg->type == HUB_MSG_TYPE_LINE_DATA);
+
+      if (!pMsg->u.buf.size)
+        continue;
+
+      if (!pMsg->u.buf.pBuf) {
+        writeLost += pMsg->u.buf.size;
+        res = FALSE;
+        continue;
+      }
+
+      pMsgs[num] = pMsg;
+      pBufs[num] = pMsg->u.buf.pBuf;
+      lens[num] = pMsg->u.buf.size;
+      len += lens[num];
+      num++;
+    }
+
+    if (!num)
+      continue;
+
+    WriteOverlapped *pOverlapped = writeOverlappedBuf.front();
+
+    _ASSERTE(pOverlapped != NULL);
+
+    if (!pOverlapped->StartWrite(pBufs, lens, num)) {
+      writeLost += len;
+      FlowControlUpdate();
+      res = FALSE;
+      continue;
+    }
+
+    writeOverlappedBuf.pop();
+
+    writeBytes += len;
+    writeOps++;
+
+    for (DWORD i = 0 ; i < num ; i++) {
+      if (latencyStats)
+        pAddQueueLatency(hMasterPort, pLatencyNow());
+
+      pMsgs[i]->type = HUB_MSG_TYPE_EMPTY;  // detach pBuf
+    }
+
+    writeQueued += len;
+    FlowControlUpdate();
+  }
+
+  return res;
+}
+
+BOOL ComPort::WriteUrgent(HUB_MSG *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+  _ASSERTE(pMsg->type == HUB_MSG_TYPE_LINE_DATA);
+
+  // nothing to bypass
+  if (!writeRing.Queued() && !lenWriteBufUrgent && !writeDelay)
+    return Write(pMsg);
+
+  if (!writeQueueLimit)
+    return TRUE;
+
+  DWORD len = pMsg->u.buf.size;
+
+  if (!len)
+    return TRUE;
+
+  if (!pMsg->u.buf.pBuf || hSock == INVALID_SOCKET || isDisconnected) {
+    writeLost += len;
+    return FALSE;
+  }
+
+  pBufAppend(&pWriteBufUrgent, lenWriteBufUrgent, pMsg->u.buf.pBuf, len);
+  lenWriteBufUrgent += len;
+
+  writeQueued += len;
+
+  // the held data does not hold the urgent one
+  if (isConnected && !isDisconnected)
+    StartQueuedWrites();
+
+  FlowControlUpdate();
+
+  return TRUE;
+}
+
+void ComPort::StartQueuedWrites()
+{
+  _ASSERTE(pWriteBufUrgent != NULL || lenWriteBufUrgent == 0);
+  _ASSERTE(pWriteBufUrgent == NULL || lenWriteBufUrgent != 0);
+
+  while ((lenWriteBufUrgent || (writeRing.Queued() && !writeHold)) && writeOverlappedBuf.size()) {
+    WriteOverlapped *pOverlapped = writeOverlappedBuf.front();
+
+    _ASSERTE(pOverlapped != NULL);
+
+    if (lenWriteBufUrgent) {
+      if (pOverlapped->StartWrite(pWriteBufUrgent, lenWriteBufUrgent)) {
+        writeOverlappedBuf.pop();
+
+        writeBytes += lenWriteBufUrgent;
+        writeOps++;
+      } else {
+        writeLost += lenWriteBufUrgent;
+        writeQueued -= lenWriteBufUrgent;
+        pBufFree(pWriteBufUrgent);
+      }
+
+      lenWriteBufUrgent = 0;
+      pWriteBufUrgent = NULL;
+      continue;
+    }
+
+    // send the queued data directly from the ring
+    BYTE *pBufs[2];
+    DWORD lens[2];
+    DWORD count = writeRing.Start(pBufs, lens, 2);
+    DWORD len = 0;
+
+    for (DWORD i = 0 ; i < count ; i++)
+      len += lens[i];
+
+    if (pOverlapped->StartWrite(pBufs, lens, count, FALSE)) {
+      writeOverlappedBuf.pop();
+
+      writeBytes += len;
+      writeOps++;
+
+      if (latencyStats)
+        pAddQueueLatency(hMasterPort, writeBufTime);
+    } else {
+      writeRing.Done(len);
+      writeLost += len;
+      writeQueued -= len;
+    }
+  }
+}
+
+void ComPort::HoldWrites()
+{
+  if (writeRing.Queued() >= writeBatch) {
+    FlushWrites();
+    return;
+  }
+
+  if (writeHold || !writeRing.Queued())
+    return;
+
+  if (!hWriteTimer)
+    hWriteTimer = pTimerCreate((HTIMEROWNER)this);
+
+  if (!hWriteTimer) {
+    FlushWrites();
+    return;
+  }
+
+  LARGE_INTEGER dueTime;
+
+  dueTime.QuadPart = -10LL * writeDelay;
+
+  if (!pTimerSet(hWriteTimer, hMasterPort, &dueTime, 0, (HTIMERPARAM)hWriteTimer)) {
+    FlushWrites();
+    return;
+  }
+
+  writeHold = TRUE;
+}
+
+void ComPort::FlushWrites()
+{
+  if (writeHold) {
+    writeHold = FALSE;
+    pTimerCancel(hWriteTimer);
+  }
+
+  if (isConnected && !isDisconnected && hSock != INVALID_SOCKET)
+    StartQueuedWrites();
+}
+
 void ComPort::OnWrite(WriteOverlapped *pOverlapped, DWORD len, DWORD done)
 {
   //cout << name << " OnWrite " << ::GetCurrentThreadId() << " len=" << len << " done=" << done << " queued=" << writeQueued << endl;
@@ -602,26 +900,16 @@ void ComPort::OnWrite(WriteOverlapped *pOverlapped, DWORD len, DWORD done)
 
   writeQueued -= len;
 
-  _ASSERTE(pWriteBuf != NULL || lenWriteBuf == 0);
-  _ASSERTE(pWriteBuf == NULL || lenWriteBuf != 0);
+  if (!pOverlapped->Owned())
+    writeRing.Done(len);
 
-  if (lenWriteBuf &&
-      isConnected &&
+  writeOverlappedBuf.push(pOverlapped);
+
+  if (isConnected &&
       !isDisconnected &&
       hSock != INVALID_SOCKET)
   {
-    if (!pOverlapped->StartWrite(pWriteBuf, lenWriteBuf)) {
-      writeOverlappedBuf.push(pOverlapped);
-
-      writeLost += lenWriteBuf;
-      writeQueued -= lenWriteBuf;
-      pBufFree(pWriteBuf);
-    }
-
-    lenWriteBuf = 0;
-    pWriteBuf = NULL;
-  } else {
-    writeOverlappedBuf.push(pOverlapped);
+    StartQueuedWrites();
   }
 
   FlowControlUpdate();
@@ -642,12 +930,17 @@ void ComPort::OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done)
     OnDisconnect();
   }
 
-  if (countXoff > 0 || !isConnected || !pOverlapped->StartRead()) {
-    _ASSERTE(countReadOverlapped > 0);
+  if (countXoff <= 0 && isConnected) {
+    DWORD credit = ReadCredit();
 
-    delete pOverlapped;
-    countReadOverlapped--;
+    if (credit && pOverlapped->StartRead(credit))
+      return;
   }
+
+  _ASSERTE(countReadOverlapped > 0);
+
+  delete pOverlapped;
+  countReadOverlapped--;
 }
 
 void ComPort::OnDisconnect()
@@ -655,14 +948,19 @@ void ComPort::OnDisconnect()
   Close(name.c_str(), hSock);
   hSock = INVALID_SOCKET;
 
-  if (lenWriteBuf) {
-    _ASSERTE(pWriteBuf != NULL);
+  if (writeHold) {
+    writeHold = FALSE;
+    pTimerCancel(hWriteTimer);
+  }
+
+  if (writeRing.Queued() || lenWriteBufUrgent) {
+    writeRing.Drop(writeRing.Queued(), writeQueued, writeLost);
 
-    writeLost += lenWriteBuf;
-    writeQueued -= lenWriteBuf;
-    lenWriteBuf = 0;
-    pBufFree(pWriteBuf);
-    pWriteBuf = NULL;
+    writeLost += lenWriteBufUrgent;
+    writeQueued -= lenWriteBufUrgent;
+    lenWriteBufUrgent = 0;
+    pBufFree(pWriteBufUrgent);
+    pWriteBufUrgent = NULL;
 
     FlowControlUpdate();
   }
@@ -747,24 +1045,8 @@ void ComPort::OnConnect()
   if (countXoff <= 0)
     StartRead();
 
-  if (lenWriteBuf && writeOverlappedBuf.size()) {
-    WriteOverlapped *pOverlapped = writeOverlappedBuf.front();
-
-    _ASSERTE(pOverlapped != NULL);
-
-    if (pOverlapped->StartWrite(pWriteBuf, lenWriteBuf)) {
-      writeOverlappedBuf.pop();
-    } else {
-      writeLost += lenWriteBuf;
-      writeQueued -= lenWriteBuf;
-      pBufFree(pWriteBuf);
-
-      FlowControlUpdate();
-    }
-
-    lenWriteBuf = 0;
-    pWriteBuf = NULL;
-  }
+  StartQueuedWrites();
+  FlowControlUpdate();
 
   HUB_MSG msg;
 
@@ -782,6 +1064,20 @@ void ComPort::LostReport()
     writeLost = 0;
   }
 }
+
+void ComPort::GetStats(PORT_STATS *pStats) const
+{
+  if (ITEM_IS_VALID(pStats, writeQueued))
+    pStats->writeQueued = writeQueued;
+
+  if (ITEM_IS_VALID(pStats, writeLost))
+    pStats->writeLost = (ULONGLONG)writeLostTotal + writeLost;
+
+  if (ITEM_IS_VALID(pStats, writeOps)) {
+    pStats->writeBytes = writeBytes;
+    pStats->writeOps = writeOps;
+  }
+}
 ///////////////////////////////////////////////////////////////
 } // end namespace
 ///////////////////////////////////////////////////////////////
@@ -54,6 +54,8 @@
 #ifndef _COMPORT_H
 #define _COMPORT_H
 
+#include "../writering.h"
+
 ///////////////////////////////////////////////////////////////
 class ComParams;
 class WriteOverlapped;
@@ -67,7 +69,7 @@ class ComPortPtr
   public:
     ComPortPtr(ComPort *_pPort = NULL) : pPort(_pPort) {}
     ComPort *Ptr() const { return pPort; }
-    bool ComPortPtr::operator<(const ComPortPtr &p) const;
+    bool operator<(const ComPortPtr &p) const;
 
   private:
     ComPort *pPort;
@@ -83,14 +85,17 @@ class Listener
     }
 
     void Push(ComPort *pPort);
-    BOOL Start();
+    void Join(HMASTERPORT _hMasterPort);
+    BOOL Start(HMASTERPORT _hMasterPort);
     BOOL OnEvent(ListenOverlapped *pOverlapped, long e, int err);
     void OnDisconnect(ComPort *pPort);
     SOCKET Accept(const ComPort &port, int cmd);
+    HMASTERPORT MasterPort() const { return hMasterPort; }
 
   private:
     struct sockaddr_in snLocal;
     SOCKET hSockListen;
+    HMASTERPORT hMasterPort;
     priority_queue<ComPortPtr> ports;
 };
 ///////////////////////////////////////////////////////////////
@@ -108,24 +113,34 @@ class ComPort
     BOOL Start();
     BOOL FakeReadFilter(HUB_MSG *pInMsg);
     BOOL Write(HUB_MSG *pMsg);
+    BOOL WriteV(HUB_MSG **ppMsgs, DWORD count);
+    BOOL WriteUrgent(HUB_MSG *pMsg);
     void OnWrite(WriteOverlapped *pOverlapped, DWORD len, DWORD done);
     void OnRead(ReadOverlapped *pOverlapped, BYTE *pBuf, DWORD done);
     BOOL OnEvent(WaitEventOverlapped *pOverlapped, long e);
     void LostReport();
+    void GetStats(PORT_STATS *pStats) const;
+    DWORD GetWriteCredit();
     BOOL Accept();
 
     const string &Name() const { return name; }
     void Name(const char *pName) { name = pName; }
-    HANDLE Handle() const { return (HANDLE)hSock; }
+    HANDLE Handle() const { return (HANDLE)(ULONG_PTR)hSock; }
+    SOCKET Sock() const { return hSock; }
+    HMASTERPORT MasterPort() const { return hMasterPort; }
 
   private:
     void FlowControlUpdate();
     BOOL CanConnect() const { return (permanent || connectionCounter > 0); }
     void StartConnect();
     BOOL StartRead();
+    DWORD ReadCredit();
     BOOL StartWaitEvent(SOCKET hSockWait);
     void OnConnect();
     void OnDisconnect();
+    void StartQueuedWrites();
+    void HoldWrites();
+    void FlushWrites();
 
     struct sockaddr_in snLocal;
     struct sockaddr_in snRemote;
@@ -151,6 +166,7 @@ class ComPort
 
     int countReadOverlapped;
     int countXoff;
+    BOOL readCreditWait;        // waiting for HUB_MSG_TYPE_CREDIT
 
     DWORD writeQueueLimit;
     DWORD writeQueueLimitSendXoff;
@@ -159,10 +175,23 @@ class ComPort
     BOOL writeSuspended;
     DWORD writeLost;
     DWORD writeLostTotal;
+    BOOL writeCreditExhausted;  // should send HUB_MSG_TYPE_CREDIT
 
     queue<WriteOverlapped *> writeOverlappedBuf;
-    BYTE *pWriteBuf;
-    DWORD lenWriteBuf;
+    WriteRing writeRing;
+    BYTE *pWriteBufUrgent;      // started before writeRing
+    DWORD lenWriteBufUrgent;
+
+    DWORD writeDelay;           // us to hold writeRing (see --write-delay)
+    DWORD writeBatch;           // bytes to stop holding (see --write-batch)
+    BOOL writeHold;             // writeRing is held by hWriteTimer
+    HMASTERTIMER hWriteTimer;
+
+    ULONGLONG writeBytes;       // the data passed to the started writes
+    ULONGLONG writeOps;         // the number of the started writes
+
+    BOOL latencyStats;
+    ULONGLONG writeBufTime;     // the queuing time of writeRing
 };
 ///////////////////////////////////////////////////////////////
 inline bool ComPortPtr::operator<(const ComPortPtr &p) const
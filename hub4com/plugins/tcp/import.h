@@ -50,6 +50,17 @@ extern ROUTINE_BUF_APPEND *pBufAppend;
 extern ROUTINE_ON_READ *pOnRead;
 extern ROUTINE_TIMER_CREATE *pTimerCreate;
 extern ROUTINE_TIMER_SET *pTimerSet;
+extern ROUTINE_TIMER_CANCEL *pTimerCancel;
+extern ROUTINE_JOIN_PORTS *pJoinPorts;
+extern ROUTINE_LATENCY_NOW *pLatencyNow;
+extern ROUTINE_ADD_QUEUE_LATENCY *pAddQueueLatency;
+extern ROUTINE_GET_READ_CREDIT *pGetReadCredit;
+#ifndef _WIN32
+extern ROUTINE_WATCH_CREATE *pWatchCreate;
+extern ROUTINE_WATCH_SET *pWatchSet;
+extern ROUTINE_WATCH_DELETE *pWatchDelete;
+extern ROUTINE_DEFER *pDefer;
+#endif  /* _WIN32 */
 ///////////////////////////////////////////////////////////////
 
 #endif  // _IMPORT_H
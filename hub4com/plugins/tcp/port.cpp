@@ -132,8 +132,16 @@ static void CALLBACK Help(const char *pProgPath)
   << "                             means n[o] else d[efault] means 0." << endl
   << "  --write-limit=<s>        - set write queue limit to <s> (" << ComParams().WriteQueueLimitStr() << " by default)," << endl
   << "                             where <s> is " << ComParams::WriteQueueLimitLst() << ". The queue" << endl
-  << "                             will be purged with data lost on overruning." << endl
+  << "                             will lose the oldest data on overruning." << endl
   << "                             The value 0 will disable writing to the port." << endl
+  << "  --write-delay=<t>        - hold the written data up to <t> (" << ComParams().WriteDelayStr() << " by default)" << endl
+  << "                             to send it by one operation, where <t> is" << endl
+  << "                             " << ComParams::WriteDelayLst() << ". The hold timer" << endl
+  << "                             has 1 ms granularity so <t> is rounded up to" << endl
+  << "                             milliseconds. The value 0 will disable holding." << endl
+  << "  --write-batch=<s>        - send the held data as soon as <s> bytes are held" << endl
+  << "                             (" << ComParams().WriteBatchStr() << " by default)," << endl
+  << "                             where <s> is " << ComParams::WriteBatchLst() << "." << endl
   << endl
   << "Output data stream description:" << endl
   << "  LINE_DATA(<data>) - send <data> to remote host." << endl
@@ -246,6 +254,18 @@ static BOOL CALLBACK Config(
       cerr << "Invalid write limit value in " << pArg << endl;
       exit(1);
     }
+  } else
+  if ((pParam = GetParam(pArg, "--write-delay=")) != NULL) {
+    if (!comParams.SetWriteDelay(pParam)) {
+      cerr << "Invalid write delay value in " << pArg << endl;
+      exit(1);
+    }
+  } else
+  if ((pParam = GetParam(pArg, "--write-batch=")) != NULL) {
+    if (!comParams.SetWriteBatch(pParam)) {
+      cerr << "Invalid write batch value in " << pArg << endl;
+      exit(1);
+    }
   } else {
     return FALSE;
   }
@@ -346,6 +366,45 @@ static void CALLBACK LostReport(
   ((ComPort *)hPort)->LostReport();
 }
 ///////////////////////////////////////////////////////////////
+static void CALLBACK GetStats(
+    HPORT hPort,
+    PORT_STATS *pStats)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pStats != NULL);
+
+  ((ComPort *)hPort)->GetStats(pStats);
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK WriteV(
+    HPORT hPort,
+    HUB_MSG **ppMsgs,
+    DWORD count)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(ppMsgs != NULL);
+
+  return ((ComPort *)hPort)->WriteV(ppMsgs, count);
+}
+///////////////////////////////////////////////////////////////
+static DWORD CALLBACK GetWriteCredit(
+    HPORT hPort)
+{
+  _ASSERTE(hPort != NULL);
+
+  return ((ComPort *)hPort)->GetWriteCredit();
+}
+///////////////////////////////////////////////////////////////
+static BOOL CALLBACK WriteUrgent(
+    HPORT hPort,
+    HUB_MSG *pMsg)
+{
+  _ASSERTE(hPort != NULL);
+  _ASSERTE(pMsg != NULL);
+
+  return ((ComPort *)hPort)->WriteUrgent(pMsg);
+}
+///////////////////////////////////////////////////////////////
 static const PORT_ROUTINES_A routines = {
   sizeof(PORT_ROUTINES_A),
   GetPluginType,
@@ -362,6 +421,10 @@ static const PORT_ROUTINES_A routines = {
   FakeReadFilter,
   Write,
   LostReport,
+  GetStats,
+  WriteV,
+  GetWriteCredit,
+  WriteUrgent,
 };
 
 static const PLUGIN_ROUTINES_A *const plugins[] = {
@@ -376,6 +439,17 @@ ROUTINE_BUF_APPEND *pBufAppend;
 ROUTINE_ON_READ *pOnRead;
 ROUTINE_TIMER_CREATE *pTimerCreate;
 ROUTINE_TIMER_SET *pTimerSet;
+ROUTINE_TIMER_CANCEL *pTimerCancel;
+ROUTINE_JOIN_PORTS *pJoinPorts;
+ROUTINE_LATENCY_NOW *pLatencyNow;
+ROUTINE_ADD_QUEUE_LATENCY *pAddQueueLatency;
+ROUTINE_GET_READ_CREDIT *pGetReadCredit;
+#ifndef _WIN32
+ROUTINE_WATCH_CREATE *pWatchCreate;
+ROUTINE_WATCH_SET *pWatchSet;
+ROUTINE_WATCH_DELETE *pWatchDelete;
+ROUTINE_DEFER *pDefer;
+#endif  /* _WIN32 */
 ///////////////////////////////////////////////////////////////
 PLUGIN_INIT_A InitA;
 const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
@@ -387,10 +461,21 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
       !ROUTINE_IS_VALID(pHubRoutines, pBufAppend) ||
       !ROUTINE_IS_VALID(pHubRoutines, pOnRead) ||
       !ROUTINE_IS_VALID(pHubRoutines, pTimerCreate) ||
-      !ROUTINE_IS_VALID(pHubRoutines, pTimerSet))
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerSet) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pTimerCancel))
+  {
+    return NULL;
+  }
+
+#ifndef _WIN32
+  if (!ROUTINE_IS_VALID(pHubRoutines, pWatchCreate) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pWatchSet) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pWatchDelete) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pDefer))
   {
     return NULL;
   }
+#endif  /* _WIN32 */
 
   pMsgReplaceNone = pHubRoutines->pMsgReplaceNone;
   pBufAlloc = pHubRoutines->pBufAlloc;
@@ -399,10 +484,22 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   pOnRead = pHubRoutines->pOnRead;
   pTimerCreate = pHubRoutines->pTimerCreate;
   pTimerSet = pHubRoutines->pTimerSet;
+  pTimerCancel = pHubRoutines->pTimerCancel;
+  pJoinPorts = ROUTINE_GET(pHubRoutines, pJoinPorts);
+  pLatencyNow = ROUTINE_GET(pHubRoutines, pLatencyNow);
+  pAddQueueLatency = ROUTINE_GET(pHubRoutines, pAddQueueLatency);
+  pGetReadCredit = ROUTINE_GET(pHubRoutines, pGetReadCredit);
 
+#ifdef _WIN32
   WSADATA wsaData;
 
   WSAStartup(MAKEWORD(1, 1), &wsaData);
+#else  /* _WIN32 */
+  pWatchCreate = pHubRoutines->pWatchCreate;
+  pWatchSet = pHubRoutines->pWatchSet;
+  pWatchDelete = pHubRoutines->pWatchDelete;
+  pDefer = pHubRoutines->pDefer;
+#endif  /* _WIN32 */
 
   return plugins;
 }
@@ -34,6 +34,7 @@
 #include <crtdbg.h>
 
 #include <queue>
+#include <map>
 #include <iostream>
 #include <sstream>
 
@@ -786,7 +786,7 @@ static BOOL CALLBACK OutMethod(
           if (((State *)hFilterInstance)->pComPort) {
             ((State *)hFilterInstance)->pComPort->SetBR(((State *)hFilterInstance)->br);
             _ASSERTE(((State *)hFilterInstance)->pTelnetProtocol != NULL);
-            ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+            ((State *)hFilterInstance)->pTelnetProtocol->FlushUrgentStream(&pOutMsg);
           }
         }
       }
@@ -828,7 +828,7 @@ static BOOL CALLBACK OutMethod(
           if (((State *)hFilterInstance)->pComPort) {
             ((State *)hFilterInstance)->pComPort->SetLC(((State *)hFilterInstance)->lc);
             _ASSERTE(((State *)hFilterInstance)->pTelnetProtocol != NULL);
-            ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+            ((State *)hFilterInstance)->pTelnetProtocol->FlushUrgentStream(&pOutMsg);
           }
         }
       }
@@ -863,7 +863,12 @@ static BOOL CALLBACK OutMethod(
             ((State *)hFilterInstance)->pComPort->SetBreak((pinState & PIN_STATE_BREAK) != 0);
 
           _ASSERTE(((State *)hFilterInstance)->pTelnetProtocol != NULL);
-          ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+
+          // the break is ordered with the data
+          if (mask & PIN_STATE_BREAK)
+            ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+          else
+            ((State *)hFilterInstance)->pTelnetProtocol->FlushUrgentStream(&pOutMsg);
         }
 
         ((State *)hFilterInstance)->pinState = pinState;
@@ -887,7 +892,12 @@ static BOOL CALLBACK OutMethod(
       if (((State *)hFilterInstance)->pComPort) {
         ((State *)hFilterInstance)->pComPort->NotifyLSR(lsr);
         _ASSERTE(((State *)hFilterInstance)->pTelnetProtocol != NULL);
-        ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+
+        // the errors are ordered with the data
+        if (lsr & (LINE_STATUS_BI|LINE_STATUS_FE|LINE_STATUS_PE))
+          ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+        else
+          ((State *)hFilterInstance)->pTelnetProtocol->FlushUrgentStream(&pOutMsg);
       }
 
       break;
@@ -915,7 +925,7 @@ static BOOL CALLBACK OutMethod(
       if (((State *)hFilterInstance)->pComPort) {
         ((State *)hFilterInstance)->pComPort->AddXoffXon(pOutMsg->u.val);
         _ASSERTE(((State *)hFilterInstance)->pTelnetProtocol != NULL);
-        ((State *)hFilterInstance)->pTelnetProtocol->FlushEncodedStream(&pOutMsg);
+        ((State *)hFilterInstance)->pTelnetProtocol->FlushUrgentStream(&pOutMsg);
       }
 
       break;
@@ -968,20 +978,23 @@ static const PLUGIN_ROUTINES_A *const plugins[] = {
 };
 ///////////////////////////////////////////////////////////////
 ROUTINE_MSG_INSERT_VAL *pMsgInsertVal;
-ROUTINE_MSG_REPLACE_BUF *pMsgReplaceBuf;
 ROUTINE_MSG_INSERT_BUF *pMsgInsertBuf;
 ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
 ROUTINE_MSG_INSERT_NONE *pMsgInsertNone;
+ROUTINE_MSG_BUF_RESERVE *pMsgBufReserve;
+ROUTINE_MSG_BUF_COMMIT *pMsgBufCommit;
+ROUTINE_MSG_INSERT_URGENT *pMsgInsertUrgent;
 ///////////////////////////////////////////////////////////////
 PLUGIN_INIT_A InitA;
 const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
     const HUB_ROUTINES_A * pHubRoutines)
 {
   if (!ROUTINE_IS_VALID(pHubRoutines, pMsgInsertVal) ||
-      !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceBuf) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgInsertBuf) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgReplaceNone) ||
       !ROUTINE_IS_VALID(pHubRoutines, pMsgInsertNone) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufReserve) ||
+      !ROUTINE_IS_VALID(pHubRoutines, pMsgBufCommit) ||
       !ROUTINE_IS_VALID(pHubRoutines, pPortName) ||
       !ROUTINE_IS_VALID(pHubRoutines, pFilterName) ||
       !ROUTINE_IS_VALID(pHubRoutines, pTimerCreate) ||
@@ -994,10 +1007,12 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   }
 
   pMsgInsertVal = pHubRoutines->pMsgInsertVal;
-  pMsgReplaceBuf = pHubRoutines->pMsgReplaceBuf;
   pMsgInsertBuf = pHubRoutines->pMsgInsertBuf;
   pMsgReplaceNone = pHubRoutines->pMsgReplaceNone;
   pMsgInsertNone = pHubRoutines->pMsgInsertNone;
+  pMsgBufReserve = pHubRoutines->pMsgBufReserve;
+  pMsgBufCommit = pHubRoutines->pMsgBufCommit;
+  pMsgInsertUrgent = ROUTINE_GET(pHubRoutines, pMsgInsertUrgent);
   pPortName = pHubRoutines->pPortName;
   pFilterName = pHubRoutines->pFilterName;
   pTimerCreate = pHubRoutines->pTimerCreate;
@@ -35,10 +35,12 @@
 
 ///////////////////////////////////////////////////////////////
 extern ROUTINE_MSG_INSERT_VAL *pMsgInsertVal;
-extern ROUTINE_MSG_REPLACE_BUF *pMsgReplaceBuf;
 extern ROUTINE_MSG_INSERT_BUF *pMsgInsertBuf;
 extern ROUTINE_MSG_REPLACE_NONE *pMsgReplaceNone;
 extern ROUTINE_MSG_INSERT_NONE *pMsgInsertNone;
+extern ROUTINE_MSG_BUF_RESERVE *pMsgBufReserve;
+extern ROUTINE_MSG_BUF_COMMIT *pMsgBufCommit;
+extern ROUTINE_MSG_INSERT_URGENT *pMsgInsertUrgent;
 ///////////////////////////////////////////////////////////////
 
 #endif  // _IMPORT_H
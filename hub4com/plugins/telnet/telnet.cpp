@@ -84,7 +84,9 @@ enum {
 };
 ///////////////////////////////////////////////////////////////
 TelnetProtocol::TelnetProtocol(const char *pName)
-  : name(pName ? pName : "NONAME")
+  : name(pName ? pName : "NONAME"),
+    pDecoded(NULL),
+    decodedSize(0)
 {
   cout << name << " START" << endl;
 
@@ -125,11 +127,11 @@ void TelnetProtocol::SetOption(TelnetOption &telnetOption)
   options[telnetOption.option] = &telnetOption;
 }
 
-HUB_MSG *TelnetProtocol::Flush(HUB_MSG *pMsg, BYTE_string &stream)
+HUB_MSG *TelnetProtocol::Flush(HUB_MSG *pMsg, BYTE_string &stream, DWORD type)
 {
   if (!stream.empty()) {
     pMsg = pMsgInsertBuf(pMsg,
-                         HUB_MSG_TYPE_LINE_DATA,
+                         type,
                          stream.data(),
                          (DWORD)stream.size());
 
@@ -139,34 +141,74 @@ HUB_MSG *TelnetProtocol::Flush(HUB_MSG *pMsg, BYTE_string &stream)
   return pMsg;
 }
 
+HUB_MSG *TelnetProtocol::FlushDecodedStream(HUB_MSG *pMsg)
+{
+  if (pDecoded) {
+    // pMsg is the message decoded in place
+    pMsgBufCommit(pMsg, pDecoded, decodedSize);
+    pDecoded = NULL;
+
+    return pMsg;
+  }
+
+  return Flush(pMsg, streamDecoded);
+}
+
+void TelnetProtocol::PutDecoded(BYTE ch)
+{
+  if (pDecoded)
+    pDecoded[decodedSize++] = ch;
+  else
+    streamDecoded += ch;
+}
+
 HUB_MSG *TelnetProtocol::Encode(HUB_MSG *pMsg)
 {
   _ASSERTE(started == TRUE);
   _ASSERTE(pMsg->type == HUB_MSG_TYPE_LINE_DATA);
 
   DWORD len = pMsg->u.buf.size;
-  BYTE_string org(pMsg->u.buf.pBuf, len);
-  const BYTE *pBuf = org.data();
 
-  // discard original data from the stream
-  if (!pMsgReplaceBuf(pMsg, HUB_MSG_TYPE_LINE_DATA, NULL, 0))
+  if (!len)
+    return FlushEncodedStream(pMsg);
+
+  DWORD padding = 0;
+
+  if (options[0 /*TRANSMIT-BINARY*/] == NULL || options[0 /*TRANSMIT-BINARY*/]->stateLocal != TelnetOption::osYes)
+    padding = (DWORD)ascii_cr_padding.size();
+
+  // the pending commands go first, then each char can be doubled or padded
+  DWORD pending = (DWORD)streamEncoded.size();
+  BYTE *pOut = pMsgBufReserve(pMsg, pending + len*(1 + (padding > 1 ? padding : 1)));
+
+  if (!pOut)
     return NULL;
 
-  for (; len ; len--) {
+  BYTE *pOutEnd = pOut;
+
+  if (pending) {
+    memcpy(pOutEnd, streamEncoded.data(), pending);
+    pOutEnd += pending;
+    streamEncoded.clear();
+  }
+
+  for (const BYTE *pBuf = pMsg->u.buf.pBuf ; len ; len--) {
     BYTE ch = *pBuf++;
 
     if (ch == cdIAC)
-      streamEncoded += ch;
+      *pOutEnd++ = ch;
 
-    streamEncoded += ch;
+    *pOutEnd++ = ch;
 
-    if (ch == 13 /*CR*/ && ascii_cr_padding.size()) {
-      if (options[0 /*TRANSMIT-BINARY*/] == NULL || options[0 /*TRANSMIT-BINARY*/]->stateLocal != TelnetOption::osYes)
-        streamEncoded += ascii_cr_padding;
+    if (ch == 13 /*CR*/ && padding) {
+      memcpy(pOutEnd, ascii_cr_padding.data(), padding);
+      pOutEnd += padding;
     }
   }
 
-  return FlushEncodedStream(pMsg);
+  pMsgBufCommit(pMsg, pOut, (DWORD)(pOutEnd - pOut));
+
+  return pMsg;
 }
 
 void TelnetProtocol::KeepActive()
@@ -183,13 +225,22 @@ HUB_MSG *TelnetProtocol::Decode(HUB_MSG *pMsg)
   _ASSERTE(pMsg->type == HUB_MSG_TYPE_LINE_DATA);
 
   DWORD len = pMsg->u.buf.size;
-  BYTE_string org(pMsg->u.buf.pBuf, len);
-  const BYTE *pBuf = org.data();
 
-  // discard original data from the stream
-  if (!pMsgReplaceBuf(pMsg, HUB_MSG_TYPE_LINE_DATA, NULL, 0))
+  if (!len)
+    return FlushDecodedStream(pMsg);
+
+  _ASSERTE(streamDecoded.empty());
+
+  pDecoded = pMsgBufReserve(pMsg, len);
+
+  if (!pDecoded)
     return NULL;
 
+  decodedSize = 0;
+
+  // the buffer is not freed on committing since it's pDecoded
+  const BYTE *pBuf = pMsg->u.buf.pBuf;
+
   for (; len ; len--) {
     BYTE ch = *pBuf++;
 
@@ -198,12 +249,12 @@ HUB_MSG *TelnetProtocol::Decode(HUB_MSG *pMsg)
         if (ch == cdIAC)
           state = stCode;
         else
-          streamDecoded += ch;
+          PutDecoded(ch);
         break;
       case stCode:
         switch (ch) {
           case cdIAC:
-            streamDecoded += ch;
+            PutDecoded(ch);
             state = stData;
             break;
           case cdNOP:
@@ -289,6 +340,9 @@ HUB_MSG *TelnetProtocol::Decode(HUB_MSG *pMsg)
             }
             cout << "SE" << endl;
 
+            // the option can insert messages after pMsg
+            pMsg = FlushDecodedStream(pMsg);
+
             if (!options[option] || !options[option]->OnSubNegotiation(params, &pMsg))
               cout << "  ignored" << endl;
 
@@ -318,6 +372,30 @@ void TelnetProtocol::FlushEncodedStream(HUB_MSG **ppEchoMsg)
     *ppEchoMsg = FlushEncodedStream((HUB_MSG *)NULL);
 }
 
+void TelnetProtocol::FlushUrgentStream(HUB_MSG **ppEchoMsg)
+{
+  _ASSERTE(started == TRUE);
+
+  if (streamEncoded.empty())
+    return;
+
+  // w/o the hub's support the commands are ordered with the data
+  if (!pMsgInsertUrgent) {
+    FlushEncodedStream(ppEchoMsg);
+    return;
+  }
+
+  // the commands can be sent before the queued data
+  HUB_MSG *pMsg = pMsgInsertUrgent(*ppEchoMsg,
+                                   streamEncoded.data(),
+                                   (DWORD)streamEncoded.size());
+
+  streamEncoded.clear();
+
+  if (!*ppEchoMsg)
+    *ppEchoMsg = pMsg;
+}
+
 void TelnetProtocol::SendOption(BYTE code, BYTE option)
 {
   cout << name << " SEND: " << code2name(code) << " " << (unsigned)option << endl;
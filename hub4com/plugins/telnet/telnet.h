@@ -56,6 +56,7 @@ class TelnetProtocol
 
     HUB_MSG *Decode(HUB_MSG *pMsg);
     void FlushEncodedStream(HUB_MSG **ppEchoMsg);
+    void FlushUrgentStream(HUB_MSG **ppEchoMsg);
     HUB_MSG *Encode(HUB_MSG *pMsg);
     void KeepActive();
 
@@ -79,10 +80,11 @@ class TelnetProtocol
     void SendOption(BYTE code, BYTE option);
     void SendSubNegotiation(BYTE option, const BYTE_vector &params);
 
-    static HUB_MSG *Flush(HUB_MSG *pMsg, BYTE_string &stream);
+    static HUB_MSG *Flush(HUB_MSG *pMsg, BYTE_string &stream, DWORD type = HUB_MSG_TYPE_LINE_DATA);
 
     HUB_MSG *FlushEncodedStream(HUB_MSG *pMsg) { return Flush(pMsg, streamEncoded); }
-    HUB_MSG *FlushDecodedStream(HUB_MSG *pMsg) { return Flush(pMsg, streamDecoded); }
+    HUB_MSG *FlushDecodedStream(HUB_MSG *pMsg);
+    void PutDecoded(BYTE ch);
 
     string name;
 
@@ -98,6 +100,10 @@ class TelnetProtocol
     BYTE_string streamEncoded;
     BYTE_string streamDecoded;
 
+    // the data before the first inserted message is decoded in place
+    BYTE *pDecoded;
+    DWORD decodedSize;
+
 #ifdef _DEBUG
   private:
     BOOL started;
@@ -90,6 +90,7 @@ namespace FilterTrace {
 static ROUTINE_PORT_NAME_A *pPortName = NULL;
 static ROUTINE_FILTER_NAME_A *pFilterName = NULL;
 static ROUTINE_FILTERPORT *pFilterPort;
+static ROUTINE_MSG_IS_URGENT *pMsgIsUrgent = NULL;
 ///////////////////////////////////////////////////////////////
 static void PrintTime(ostream &tout);
 ///////////////////////////////////////////////////////////////
@@ -475,6 +476,7 @@ static const CODE2NAME codeNameTableHubMsg[] = {
   TOCODE2NAME(HUB_MSG_TYPE_, PURGE_TX_IN),
   TOCODE2NAME(HUB_MSG_TYPE_, PURGE_TX),
   TOCODE2NAME(HUB_MSG_TYPE_, TICK),
+  TOCODE2NAME(HUB_MSG_TYPE_, CREDIT),
   {0, NULL}
 };
 ///////////////////////////////////////////////////////////////
@@ -712,7 +714,11 @@ static void PrintMsgBody(ostream &tout, HUB_MSG *pMsg)
 ///////////////////////////////////////////////////////////////
 static void PrintMsg(ostream &tout, HUB_MSG *pMsg)
 {
-  PrintMsgType(tout, pMsg->type);
+  // the urgent data is the line data marked by the hub
+  if (pMsgIsUrgent && pMsgIsUrgent(pMsg))
+    tout << "MSG_URGENT_DATA";
+  else
+    PrintMsgType(tout, pMsg->type);
 
   tout  << " {";
 
@@ -856,6 +862,7 @@ const PLUGIN_ROUTINES_A *const * CALLBACK InitA(
   pPortName = pHubRoutines->pPortName;
   pFilterName = pHubRoutines->pFilterName;
   pFilterPort = pHubRoutines->pFilterPort;
+  pMsgIsUrgent = ROUTINE_GET(pHubRoutines, pMsgIsUrgent);
 
   return plugins;
 }
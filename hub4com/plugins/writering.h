@@ -0,0 +1,240 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _WRITERING_H
+#define _WRITERING_H
+
+///////////////////////////////////////////////////////////////
+//
+// The ring of the data queued for writing:
+//
+//   [released] [started] [dropped] [queued] [free]
+//
+// The queued data is copied in by Put() and is written directly
+// from the ring by the regions returned by Start() (no more than
+// 2 contiguous regions if the data wraps around the end of the
+// ring). The started data is released by Done() in the order of
+// starting. The oldest queued data can be dropped at byte
+// granularity by Drop(). The ring is reallocated by Grow() if a
+// message does not fit, the old one is freed when all the data
+// started from it is done.
+//
+///////////////////////////////////////////////////////////////
+class WriteRing
+{
+  public:
+    WriteRing() : pRing(NULL), size(0), posPut(0), posStart(0), posDone(0), started(0) {}
+    ~WriteRing() {
+      delete [] pRing;
+      FreeRetired();
+    }
+
+    BOOL Alloc(DWORD _size) {
+      _ASSERTE(pRing == NULL);
+
+      if (!_size)
+        return TRUE;
+
+      pRing = new BYTE[_size];
+
+      if (!pRing)
+        return FALSE;
+
+      size = _size;
+
+      return TRUE;
+    }
+
+    // the queued and not started data length
+    DWORD Queued() const { return DWORD(posPut - posStart); }
+
+    // the free space
+    DWORD Room() const { return size - DWORD(posPut - posDone); }
+
+    // reallocates the ring to get the room for len bytes
+    BOOL Grow(DWORD len) {
+      ULONGLONG need = (posPut - posDone) + len;
+      ULONGLONG newSize = size ? size : 1;
+
+      while (newSize < need)
+        newSize *= 2;
+
+      if (newSize > 0x80000000UL)
+        return FALSE;
+
+      BYTE *pNewRing = new BYTE[DWORD(newSize)];
+
+      if (!pNewRing)
+        return FALSE;
+
+      // the queued data keeps its positions in the stream
+      for (ULONGLONG pos = posStart ; pos < posPut ;) {
+        DWORD i = DWORD(pos % size);
+        DWORD j = DWORD(pos % newSize);
+        DWORD l = Contiguous(i, DWORD(posPut - pos));
+
+        if (l > newSize - j)
+          l = DWORD(newSize - j);
+
+        memcpy(pNewRing + j, pRing + i, l);
+        pos += l;
+      }
+
+      // the started data is written from the old ring till it's done
+      if (started)
+        retired.push(pRing);
+      else
+        delete [] pRing;
+
+      pRing = pNewRing;
+      size = DWORD(newSize);
+
+      return TRUE;
+    }
+
+    // copies the data, returns the copied length
+    DWORD Put(const BYTE *pBuf, DWORD len) {
+      if (len > Room())
+        len = Room();
+
+      DWORD done = 0;
+
+      while (done < len) {
+        DWORD i = DWORD(posPut % size);
+        DWORD l = Contiguous(i, len - done);
+
+        memcpy(pRing + i, pBuf + done, l);
+        done += l;
+        posPut += l;
+      }
+
+      return len;
+    }
+
+    // drops the oldest queued data, returns the dropped length
+    DWORD Drop(DWORD len) {
+      if (len > Queued())
+        len = Queued();
+
+      posStart += len;
+
+      // nothing started so the dropped data can be released now
+      if (!started)
+        posDone = posStart;
+
+      return len;
+    }
+
+    // the same as above but for the write queue of a port where queued
+    // is the length of all the data being written and lost is the length
+    // of the data lost for writing
+
+    // copies the data and adds the copied length to queued, the oldest
+    // data is dropped to get room only if the ring can't grow
+    DWORD Put(const BYTE *pBuf, DWORD len, DWORD &queued, DWORD &lost) {
+      DWORD room = Room();
+
+      if (len > room && !Grow(len)) {
+        Drop(len - room, queued, lost);
+        room = Room();
+
+        if (len > room) {
+          lost += len - room;
+          pBuf += len - room;
+          len = room;
+        }
+      }
+
+      len = Put(pBuf, len);
+      queued += len;
+
+      return len;
+    }
+
+    // drops the oldest queued data and moves its length from queued to lost
+    void Drop(DWORD len, DWORD &queued, DWORD &lost) {
+      len = Drop(len);
+
+      _ASSERTE(queued >= len);
+
+      queued -= len;
+      lost += len;
+    }
+
+    // fills up to maxCount regions by the queued data and marks it as
+    // started, returns the number of regions
+    DWORD Start(BYTE **ppBufs, DWORD *pLens, DWORD maxCount) {
+      DWORD count;
+
+      for (count = 0 ; count < maxCount && Queued() ; count++) {
+        DWORD i = DWORD(posStart % size);
+
+        ppBufs[count] = pRing + i;
+        pLens[count] = Contiguous(i, Queued());
+        posStart += pLens[count];
+      }
+
+      if (count)
+        started++;
+
+      return count;
+    }
+
+    // releases the started data of the oldest not done Start()
+    void Done(DWORD len) {
+      _ASSERTE(started > 0);
+      _ASSERTE(posStart - posDone >= len);
+
+      // the dropped data (if any) behind the released one is
+      // released with the last started data
+      if (--started) {
+        posDone += len;
+      } else {
+        posDone = posStart;
+        FreeRetired();
+      }
+    }
+
+  private:
+    void FreeRetired() {
+      while (!retired.empty()) {
+        delete [] retired.front();
+        retired.pop();
+      }
+    }
+
+    DWORD Contiguous(DWORD i, DWORD len) const {
+      return (len < size - i) ? len : size - i;
+    }
+
+    BYTE *pRing;
+    DWORD size;
+    ULONGLONG posPut;   // the positions in the stream of the queued data
+    ULONGLONG posStart;
+    ULONGLONG posDone;
+    int started;        // the number of not done Start()
+    queue<BYTE *> retired;  // the old rings with the started data
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _WRITERING_H
@@ -0,0 +1,326 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+
+#include "pool.h"
+
+///////////////////////////////////////////////////////////////
+#ifdef _WIN32
+  #define THREAD_LOCAL __declspec(thread)
+#else
+  #define THREAD_LOCAL __thread
+#endif
+///////////////////////////////////////////////////////////////
+static vector<MemPool *> *pPools = NULL;
+static unsigned numThreads = 1;
+static THREAD_LOCAL unsigned curThread = 0;
+///////////////////////////////////////////////////////////////
+MemPool::MemPool(const char *_pName, size_t _blockSize, size_t _maxFree)
+  : pName(_pName),
+    blockSize(_blockSize < sizeof(Block) ? sizeof(Block) : _blockSize),
+    maxFree(_maxFree),
+    pCaches(NULL),
+    numCaches(0),
+    pCachesMem(NULL)
+{
+  SetThreads(numThreads);
+
+  if (!pPools)
+    pPools = new vector<MemPool *>;
+
+  if (pPools)
+    pPools->push_back(this);
+}
+
+MemPool::~MemPool()
+{
+  for (Cache *i = pCaches ; i != pCaches + numCaches ; i++) {
+    while (i->pFree) {
+      Block *pBlock = i->pFree;
+
+      i->pFree = pBlock->pNext;
+      free(pBlock);
+    }
+
+    i->numFree = 0;
+  }
+
+  // the blocks released after destroying will not be cached (the
+  // caches are kept for their counters)
+  maxFree = 0;
+
+  if (pPools) {
+    for (vector<MemPool *>::iterator i = pPools->begin() ; i != pPools->end() ; i++) {
+      if (*i == this) {
+        pPools->erase(i);
+        break;
+      }
+    }
+
+    if (pPools->empty()) {
+      delete pPools;
+      pPools = NULL;
+    }
+  }
+}
+
+void MemPool::SetThreads(unsigned num)
+{
+  if (numCaches >= num)
+    return;
+
+  void *pMem = malloc(num * sizeof(Cache) + POOL_CACHE_LINE_SIZE - 1);
+
+  if (!pMem) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
+  Cache *pNewCaches = (Cache *)(((ULONG_PTR)pMem + POOL_CACHE_LINE_SIZE - 1) & ~(ULONG_PTR)(POOL_CACHE_LINE_SIZE - 1));
+
+  memset(pNewCaches, 0, num * sizeof(Cache));
+
+  if (numCaches)
+    memcpy(pNewCaches, pCaches, numCaches * sizeof(Cache));
+
+  free(pCachesMem);
+
+  pCachesMem = pMem;
+  pCaches = pNewCaches;
+  numCaches = num;
+}
+
+void *MemPool::Alloc()
+{
+  _ASSERTE(curThread < numCaches);
+
+  Cache &cache = pCaches[curThread];
+
+  cache.numAllocs++;
+
+  if (cache.pFree) {
+    Block *pBlock = cache.pFree;
+
+    cache.pFree = pBlock->pNext;
+    cache.numFree--;
+    cache.numHits++;
+
+    return pBlock;
+  }
+
+  return malloc(blockSize);
+}
+
+void MemPool::Free(void *pBlock)
+{
+  if (!pBlock)
+    return;
+
+  _ASSERTE(curThread < numCaches);
+
+  // the block allocated by other thread goes to the cache of this one
+  Cache &cache = pCaches[curThread];
+
+  cache.numFrees++;
+
+  if (cache.numFree >= maxFree) {
+    cache.numReleases++;
+    free(pBlock);
+    return;
+  }
+
+  ((Block *)pBlock)->pNext = cache.pFree;
+  cache.pFree = (Block *)pBlock;
+  cache.numFree++;
+}
+
+void MemPool::Report(ostream &out) const
+{
+  // the counters of other threads are read w/o locking
+  Cache total;
+
+  memset(&total, 0, sizeof(total));
+
+  for (const Cache *i = pCaches ; i != pCaches + numCaches ; i++) {
+    total.numFree += i->numFree;
+    total.numAllocs += i->numAllocs;
+    total.numHits += i->numHits;
+    total.numFrees += i->numFrees;
+    total.numReleases += i->numReleases;
+  }
+
+  out << "Pool " << pName << "(" << blockSize << "):"
+      << " allocs " << total.numAllocs
+      << ", hits " << total.numHits;
+
+  if (total.numAllocs)
+    out << " (" << (unsigned)((total.numHits * 100)/total.numAllocs) << "%)";
+
+  out << ", frees " << total.numFrees
+      << ", released " << total.numReleases
+      << ", cached " << total.numFree
+      << endl;
+}
+///////////////////////////////////////////////////////////////
+//
+// The buffers are allocated from the pools with block sizes
+// 64, 128, ..., 8192 bytes plus POOL_BUF_EXTRA bytes. The
+// larger buffers are allocated from the heap directly. Each
+// pool caches up to 256K bytes per thread.
+//
+///////////////////////////////////////////////////////////////
+#define BUF_POOL_MIN_SHIFT  6
+#define BUF_POOL_NUM        8
+#define BUF_POOL_CACHE_SIZE (256*1024)
+
+#define BUF_POOL_BLOCK_SIZE(i) (((DWORD)1 << (BUF_POOL_MIN_SHIFT + (i))) + POOL_BUF_EXTRA)
+#define BUF_POOL_MAX_SIZE      BUF_POOL_BLOCK_SIZE(BUF_POOL_NUM - 1)
+
+static MemPool *bufPools[BUF_POOL_NUM];
+///////////////////////////////////////////////////////////////
+// padded like MemPool::Cache so the counters of different threads
+// are not in the same cache line
+struct BufHeapCounter {
+  ULONGLONG numAllocs;
+
+  BYTE pad[POOL_CACHE_LINE_SIZE - sizeof(ULONGLONG)];
+};
+
+static vector<BufHeapCounter> &BufHeapAllocs()
+{
+  static vector<BufHeapCounter> numBufHeapAllocs(numThreads, BufHeapCounter());
+
+  return numBufHeapAllocs;
+}
+
+static void CountBufHeapAlloc()
+{
+  _ASSERTE(curThread < BufHeapAllocs().size());
+
+  BufHeapAllocs()[curThread].numAllocs++;
+}
+///////////////////////////////////////////////////////////////
+static int BufPoolIndex(DWORD size)
+{
+  if (size > BUF_POOL_MAX_SIZE)
+    return -1;
+
+  int i = 0;
+
+  while (BUF_POOL_BLOCK_SIZE(i) < size)
+    i++;
+
+  return i;
+}
+
+static MemPool *BufPool(int i)
+{
+  // created by the main thread (see PoolSetThreads())
+  if (!bufPools[i]) {
+    bufPools[i] = new MemPool("BUF",
+                              BUF_POOL_BLOCK_SIZE(i),
+                              BUF_POOL_CACHE_SIZE/BUF_POOL_BLOCK_SIZE(i));
+  }
+
+  return bufPools[i];
+}
+
+void *PoolBufAlloc(DWORD *pSize)
+{
+  int i = BufPoolIndex(*pSize);
+
+  if (i < 0) {
+    CountBufHeapAlloc();
+    return malloc(*pSize);
+  }
+
+  *pSize = BUF_POOL_BLOCK_SIZE(i);
+
+  MemPool *pPool = BufPool(i);
+
+  if (!pPool) {
+    CountBufHeapAlloc();
+    return malloc(*pSize);
+  }
+
+  return pPool->Alloc();
+}
+
+void PoolBufFree(void *pBlock, DWORD size)
+{
+  int i = BufPoolIndex(size);
+
+  if (i < 0 || !bufPools[i]) {
+    free(pBlock);
+    return;
+  }
+
+  _ASSERTE(BUF_POOL_BLOCK_SIZE(i) == size);
+
+  bufPools[i]->Free(pBlock);
+}
+///////////////////////////////////////////////////////////////
+void PoolReport(ostream &out)
+{
+  if (pPools) {
+    for (vector<MemPool *>::const_iterator i = pPools->begin() ; i != pPools->end() ; i++)
+      (*i)->Report(out);
+  }
+
+  ULONGLONG numBufHeapAllocs = 0;
+
+  for (vector<BufHeapCounter>::const_iterator i = BufHeapAllocs().begin() ; i != BufHeapAllocs().end() ; i++)
+    numBufHeapAllocs += i->numAllocs;
+
+  out << "Pool BUF(heap): allocs " << numBufHeapAllocs << endl;
+}
+///////////////////////////////////////////////////////////////
+void PoolSetThreads(unsigned num)
+{
+  _ASSERTE(curThread == 0);
+
+  if (num <= numThreads)
+    return;
+
+  numThreads = num;
+
+  // create all pools now to not create them by several threads later
+  for (int i = 0 ; i < BUF_POOL_NUM ; i++)
+    BufPool(i);
+
+  if (pPools) {
+    for (vector<MemPool *>::iterator i = pPools->begin() ; i != pPools->end() ; i++)
+      (*i)->SetThreads(numThreads);
+  }
+
+  BufHeapAllocs().resize(numThreads, BufHeapCounter());
+}
+
+void PoolSetThread(unsigned n)
+{
+  _ASSERTE(n < numThreads);
+
+  curThread = n;
+}
+///////////////////////////////////////////////////////////////
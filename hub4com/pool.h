@@ -0,0 +1,104 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+///////////////////////////////////////////////////////////////
+//
+// The pool of fixed size blocks. The released blocks are kept
+// in the free list (up to maxFree blocks) and reused by the
+// following allocations.
+//
+// Each thread has its own free list (see PoolSetThreads()) so
+// the pool is used w/o locking. The free lists of the threads
+// are aligned to the cache lines so they are not shared.
+//
+///////////////////////////////////////////////////////////////
+#define POOL_CACHE_LINE_SIZE 64
+///////////////////////////////////////////////////////////////
+class MemPool
+{
+  public:
+    MemPool(const char *_pName, size_t _blockSize, size_t _maxFree);
+    ~MemPool();
+
+    void *Alloc();
+    void Free(void *pBlock);
+
+    size_t BlockSize() const { return blockSize; }
+    void Report(ostream &out) const;
+
+    void SetThreads(unsigned num);
+
+  private:
+    struct Block {
+      Block *pNext;
+    };
+
+    struct Cache {
+      Block *pFree;
+      size_t numFree;
+
+      ULONGLONG numAllocs;
+      ULONGLONG numHits;
+      ULONGLONG numFrees;
+      ULONGLONG numReleases;
+
+      BYTE pad[POOL_CACHE_LINE_SIZE - sizeof(Block *) - sizeof(size_t) - 4*sizeof(ULONGLONG)];
+    };
+
+    const char *pName;
+    size_t blockSize;
+    size_t maxFree;
+
+    // numCaches items aligned to POOL_CACHE_LINE_SIZE in pCachesMem
+    Cache *pCaches;
+    unsigned numCaches;
+    void *pCachesMem;
+};
+///////////////////////////////////////////////////////////////
+//
+// The block sizes of the buffer pools are 2^n bytes plus
+// POOL_BUF_EXTRA bytes for the header and the slack added by
+// BufAlloc() so a 2^n bytes buffer stays in the 2^n class.
+//
+///////////////////////////////////////////////////////////////
+#define POOL_BUF_EXTRA 32
+///////////////////////////////////////////////////////////////
+void *PoolBufAlloc(DWORD *pSize);
+void PoolBufFree(void *pBlock, DWORD size);
+///////////////////////////////////////////////////////////////
+void PoolReport(ostream &out);
+///////////////////////////////////////////////////////////////
+//
+// PoolSetThreads() should be called before starting the threads.
+// PoolSetThread() should be called by each thread (the thread 0
+// is the main thread).
+//
+///////////////////////////////////////////////////////////////
+void PoolSetThreads(unsigned num);
+void PoolSetThread(unsigned n);
+///////////////////////////////////////////////////////////////
+
+#endif  // _POOL_H
@@ -33,12 +33,16 @@
 #include "precomp.h"
 #include "plugins/plugins_api.h"
 
+#include "stats.h"
 #include "port.h"
+#include "reactor.h"
 #include "comhub.h"
+#include "hubmsg.h"
 
 ///////////////////////////////////////////////////////////////
 Port::Port(ComHub &_hub, int _num)
   : hub(_hub),
+    pReactor(&_hub.reactor),
     num(_num),
     hPort(NULL)
 {
@@ -74,6 +78,10 @@ BOOL Port::Init(
   pFakeReadFilter = ROUTINE_GET(pPortRoutines, pFakeReadFilter);
   pWrite = ROUTINE_GET(pPortRoutines, pWrite);
   pLostReport = ROUTINE_GET(pPortRoutines, pLostReport);
+  pGetStats = ROUTINE_GET(pPortRoutines, pGetStats);
+  pWriteV = ROUTINE_GET(pPortRoutines, pWriteV);
+  pGetWriteCredit = ROUTINE_GET(pPortRoutines, pGetWriteCredit);
+  pWriteUrgent = ROUTINE_GET(pPortRoutines, pWriteUrgent);
 
   const char *pName = ROUTINE_IS_VALID(pPortRoutines, pGetPortName)
                      ? pPortRoutines->pGetPortName(hPort)
@@ -134,12 +142,91 @@ BOOL Port::Write(HubMsg *pMsg)
   if (!pWrite)
     return TRUE;
 
+  if (pMsg->type == HUB_MSG_TYPE_LINE_DATA) {
+    stats.bytesOut += pMsg->u.buf.size;
+    stats.msgsOut++;
+
+    if (pMsg->urgent && pWriteUrgent)
+      return pWriteUrgent(hPort, (HUB_MSG *)pMsg);
+  }
+
   return pWrite(hPort, (HUB_MSG *)pMsg);
 }
 
+BOOL Port::WriteV(HubMsg **ppMsgs, DWORD count)
+{
+  _ASSERTE(ppMsgs != NULL);
+
+  if (!pWriteV || count < 2) {
+    BOOL res = TRUE;
+
+    for (DWORD i = 0 ; i < count ; i++) {
+      if (!Write(ppMsgs[i]))
+        res = FALSE;
+    }
+
+    return res;
+  }
+
+  for (DWORD i = 0 ; i < count ; i++) {
+    _ASSERTE(ppMsgs[i]->type == HUB_MSG_TYPE_LINE_DATA);
+
+    stats.bytesOut += ppMsgs[i]->u.buf.size;
+    stats.msgsOut++;
+  }
+
+  return pWriteV(hPort, (HUB_MSG **)ppMsgs, count);
+}
+
+DWORD Port::GetWriteCredit()
+{
+  if (!pGetWriteCredit)
+    return HUB_CREDIT_UNLIMITED;
+
+  return pGetWriteCredit(hPort);
+}
+
 void Port::LostReport()
 {
   if (pLostReport)
     pLostReport(hPort);
 }
+
+void Port::CountRead(const HubMsg *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+
+  switch (HUB_MSG_T2N(pMsg->type)) {
+    case HUB_MSG_T2N(HUB_MSG_TYPE_LINE_DATA):
+      stats.bytesIn += pMsg->u.buf.size;
+      stats.msgsIn++;
+      break;
+    case HUB_MSG_T2N(HUB_MSG_TYPE_ADD_XOFF_XON):
+      if (pMsg->u.val)
+        stats.xoffs++;
+      else
+        stats.xons++;
+      break;
+  }
+}
+
+void Port::GetStats(PortStats &_stats) const
+{
+  _stats = stats;
+
+  if (!pGetStats)
+    return;
+
+  PORT_STATS portStats;
+
+  memset(&portStats, 0, sizeof(portStats));
+  portStats.size = sizeof(portStats);
+
+  pGetStats(hPort, &portStats);
+
+  _stats.writeQueued = portStats.writeQueued;
+  _stats.writeLost = portStats.writeLost;
+  _stats.writeBytes = portStats.writeBytes;
+  _stats.writeOps = portStats.writeOps;
+}
 ///////////////////////////////////////////////////////////////
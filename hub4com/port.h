@@ -36,6 +36,7 @@
 ///////////////////////////////////////////////////////////////
 class ComHub;
 class HubMsg;
+class Reactor;
 ///////////////////////////////////////////////////////////////
 #define PORT_SIGNATURE 'h4cP'
 ///////////////////////////////////////////////////////////////
@@ -58,14 +59,27 @@ class Port
     BOOL Start();
     BOOL FakeReadFilter(HubMsg *pMsg);
     BOOL Write(HubMsg *pMsg);
+    BOOL WriteV(HubMsg **ppMsgs, DWORD count);
+    BOOL HasWriteCredit() const { return pGetWriteCredit != NULL; }
+    DWORD GetWriteCredit();
     const string &Name() const { return name; }
     int Num() const { return num; }
     void LostReport();
 
+    void CountRead(const HubMsg *pMsg);
+    void AddInLatency(ULONGLONG start) { stats.inLatency.AddSince(start); }
+    void AddQueueLatency(ULONGLONG start) { stats.queueLatency.AddSince(start); }
+    void GetStats(PortStats &_stats) const;
+
+    // the loop of the thread handling the port
+    Reactor &GetReactor() const { return *pReactor; }
+    void SetReactor(Reactor &reactor) { pReactor = &reactor; }
+
   public:
     ComHub &hub;
 
   private:
+    Reactor *pReactor;
     int num;
     string name;
     HPORT hPort;
@@ -74,6 +88,12 @@ class Port
     PORT_FAKE_READ_FILTER *pFakeReadFilter;
     PORT_WRITE *pWrite;
     PORT_LOST_REPORT *pLostReport;
+    PORT_GET_STATS *pGetStats;
+    PORT_WRITE_V *pWriteV;
+    PORT_GET_WRITE_CREDIT *pGetWriteCredit;
+    PORT_WRITE_URGENT *pWriteUrgent;
+
+    PortStats stats;
 
 #ifdef _DEBUG
     DWORD signature;
@@ -0,0 +1,37 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _POSIX_CRTDBG_H
+#define _POSIX_CRTDBG_H
+
+#include <assert.h>
+
+///////////////////////////////////////////////////////////////
+#ifdef _DEBUG
+  #define _ASSERTE(expr) assert(expr)
+#else
+  #define _ASSERTE(expr) ((void)0)
+#endif
+///////////////////////////////////////////////////////////////
+
+#endif  // _POSIX_CRTDBG_H
@@ -0,0 +1,220 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+/*
+ * The subset of the Win32 API used by the hub4com core and by the
+ * portable plugins. Used for POSIX builds only (see CMakeLists.txt).
+ */
+
+#ifndef _POSIX_WINDOWS_H
+#define _POSIX_WINDOWS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+///////////////////////////////////////////////////////////////
+typedef unsigned char BYTE;
+typedef unsigned char UCHAR;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef int LONG;
+typedef unsigned int ULONG;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef char CHAR;
+typedef void VOID;
+typedef void *PVOID;
+typedef void *LPVOID;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned long ULONG_PTR;
+typedef unsigned long DWORD_PTR;
+typedef void *HANDLE;
+typedef void *HMODULE;
+
+typedef union _LARGE_INTEGER {
+  struct {
+    DWORD LowPart;
+    LONG HighPart;
+  } u;
+  LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _SYSTEMTIME {
+  WORD wYear;
+  WORD wMonth;
+  WORD wDayOfWeek;
+  WORD wDay;
+  WORD wHour;
+  WORD wMinute;
+  WORD wSecond;
+  WORD wMilliseconds;
+} SYSTEMTIME;
+///////////////////////////////////////////////////////////////
+#ifndef TRUE
+  #define TRUE 1
+#endif
+#ifndef FALSE
+  #define FALSE 0
+#endif
+
+#define CALLBACK
+#define WINAPI
+
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+
+#define DECLARE_HANDLE(name) struct name##__ { int unused; }; typedef struct name##__ *name
+
+#define NOPARITY            0
+#define ODDPARITY           1
+#define EVENPARITY          2
+#define MARKPARITY          3
+#define SPACEPARITY         4
+
+#define ONESTOPBIT          0
+#define ONE5STOPBITS        1
+#define TWOSTOPBITS         2
+
+#define SERIAL_LSRMST_ESCAPE      ((BYTE)0x00)
+#define SERIAL_LSRMST_LSR_DATA    ((BYTE)0x01)
+#define SERIAL_LSRMST_LSR_NODATA  ((BYTE)0x02)
+#define SERIAL_LSRMST_MST         ((BYTE)0x03)
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(ULONG_PTR)-1)
+
+#define CBR_110             110
+#define CBR_300             300
+#define CBR_600             600
+#define CBR_1200            1200
+#define CBR_2400            2400
+#define CBR_4800            4800
+#define CBR_9600            9600
+#define CBR_14400           14400
+#define CBR_19200           19200
+#define CBR_38400           38400
+#define CBR_56000           56000
+#define CBR_57600           57600
+#define CBR_115200          115200
+#define CBR_128000          128000
+#define CBR_256000          256000
+
+#define EV_RXCHAR           0x0001
+#define EV_RXFLAG           0x0002
+#define EV_TXEMPTY          0x0004
+#define EV_CTS              0x0008
+#define EV_DSR              0x0010
+#define EV_RLSD             0x0020
+#define EV_BREAK            0x0040
+#define EV_ERR              0x0080
+#define EV_RING             0x0100
+
+#define CE_RXOVER           0x0001
+#define CE_OVERRUN          0x0002
+#define CE_RXPARITY         0x0004
+#define CE_FRAME            0x0008
+#define CE_BREAK            0x0010
+#define CE_TXFULL           0x0100
+
+#define MS_CTS_ON           ((DWORD)0x0010)
+#define MS_DSR_ON           ((DWORD)0x0020)
+#define MS_RING_ON          ((DWORD)0x0040)
+#define MS_RLSD_ON          ((DWORD)0x0080)
+///////////////////////////////////////////////////////////////
+#define _strdup strdup
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+///////////////////////////////////////////////////////////////
+inline DWORD GetLastError() { return (DWORD)errno; }
+inline void SetLastError(DWORD err) { errno = (int)err; }
+
+inline DWORD GetCurrentThreadId() { return (DWORD)(ULONG_PTR)pthread_self(); }
+
+inline LONG InterlockedIncrement(LONG volatile *pVal) { return __sync_add_and_fetch(pVal, 1); }
+inline LONG InterlockedDecrement(LONG volatile *pVal) { return __sync_sub_and_fetch(pVal, 1); }
+
+inline DWORD GetTickCount()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (DWORD)((ULONGLONG)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+inline HMODULE LoadLibrary(const char *pPath) { return dlopen(pPath, RTLD_NOW); }
+inline void *GetProcAddress(HMODULE hDll, const char *pName) { return dlsym(hDll, pName); }
+inline BOOL FreeLibrary(HMODULE hDll) { return dlclose(hDll) == 0; }
+
+inline const char *GetCommandLine()
+{
+  static char cmdLine[4096];
+
+  if (!*cmdLine) {
+    FILE *pFile = fopen("/proc/self/cmdline", "rb");
+
+    if (pFile) {
+      size_t len = fread(cmdLine, 1, sizeof(cmdLine) - 1, pFile);
+
+      fclose(pFile);
+
+      for (size_t i = 0 ; i + 1 < len ; i++) {
+        if (!cmdLine[i])
+          cmdLine[i] = ' ';
+      }
+    }
+  }
+
+  return cmdLine;
+}
+
+inline void GetLocalTime(SYSTEMTIME *pTime)
+{
+  struct timeval tv;
+  struct tm tm;
+
+  gettimeofday(&tv, NULL);
+  localtime_r(&tv.tv_sec, &tm);
+
+  pTime->wYear = (WORD)(tm.tm_year + 1900);
+  pTime->wMonth = (WORD)(tm.tm_mon + 1);
+  pTime->wDayOfWeek = (WORD)tm.tm_wday;
+  pTime->wDay = (WORD)tm.tm_mday;
+  pTime->wHour = (WORD)tm.tm_hour;
+  pTime->wMinute = (WORD)tm.tm_min;
+  pTime->wSecond = (WORD)tm.tm_sec;
+  pTime->wMilliseconds = (WORD)(tv.tv_usec / 1000);
+}
+///////////////////////////////////////////////////////////////
+
+#endif  // _POSIX_WINDOWS_H
@@ -0,0 +1,68 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+/*
+ * The subset of the Windows Sockets API used by the tcp plugin.
+ * Used for POSIX builds only (see CMakeLists.txt).
+ */
+
+#ifndef _POSIX_WINSOCK2_H
+#define _POSIX_WINSOCK2_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////
+typedef int SOCKET;
+
+#define INVALID_SOCKET  (-1)
+#define SOCKET_ERROR    (-1)
+
+#define SD_RECEIVE      SHUT_RD
+#define SD_SEND         SHUT_WR
+#define SD_BOTH         SHUT_RDWR
+
+#define FD_READ         0x01
+#define FD_WRITE        0x02
+#define FD_OOB          0x04
+#define FD_ACCEPT       0x08
+#define FD_CONNECT      0x10
+#define FD_CLOSE        0x20
+
+#define CF_ACCEPT       0x0000
+#define CF_REJECT       0x0001
+#define CF_DEFER        0x0002
+
+#define FAR
+
+#define closesocket close
+///////////////////////////////////////////////////////////////
+
+#endif  // _POSIX_WINSOCK2_H
@@ -45,6 +45,7 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -0,0 +1,868 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include "reactor.h"
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+#ifndef _WIN32
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+#endif
+
+///////////////////////////////////////////////////////////////
+#define EPOLL_EVENTS_MAX 64
+///////////////////////////////////////////////////////////////
+static int LowestBit(DWORD bits)
+{
+  _ASSERTE(bits != 0);
+
+#ifdef _MSC_VER
+  unsigned long i;
+
+  _BitScanForward(&i, bits);
+
+  return (int)i;
+#else
+  return __builtin_ctz(bits);
+#endif
+}
+///////////////////////////////////////////////////////////////
+static LONGLONG SystemTime()
+{
+#ifdef _WIN32
+  LARGE_INTEGER t;
+
+  ::GetSystemTimeAsFileTime((FILETIME *)&t);
+
+  return t.QuadPart;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  // 100-nanosecond intervals since January 1, 1601 (UTC)
+  return (LONGLONG)tv.tv_sec * 10000000 + (LONGLONG)tv.tv_usec * 10 + 116444736000000000LL;
+#endif
+}
+///////////////////////////////////////////////////////////////
+static ULONGLONG DueTime(const LARGE_INTEGER *pDueTime)
+{
+  ULONGLONG now = Reactor::Now();
+  LONGLONG delta;
+
+  if (pDueTime->QuadPart < 0)
+    delta = -pDueTime->QuadPart;
+  else
+    delta = pDueTime->QuadPart - SystemTime();
+
+  if (delta <= 0)
+    return now;
+
+  return now + (ULONGLONG)((delta + 9999) / 10000);
+}
+///////////////////////////////////////////////////////////////
+BOOL ReactorTimer::Set(Reactor &reactor, const LARGE_INTEGER *pDueTime, LONG _period)
+{
+  _ASSERTE(pDueTime != NULL);
+
+  Cancel();
+
+  period = _period > 0 ? (DWORD)_period : 0;
+
+  reactor.AddTimer(this, DueTime(pDueTime));
+
+  return TRUE;
+}
+
+void ReactorTimer::Cancel()
+{
+  if (pReactor)
+    pReactor->DelTimer(this);
+}
+///////////////////////////////////////////////////////////////
+void ReactorTimerLink::Link(ReactorTimerLink *pHead)
+{
+  pNext = pHead;
+  pPrev = pHead->pPrev;
+  pPrev->pNext = this;
+  pHead->pPrev = this;
+}
+
+void ReactorTimerLink::Unlink()
+{
+  pPrev->pNext = pNext;
+  pNext->pPrev = pPrev;
+  pNext = pPrev = this;
+}
+
+void ReactorTimerLink::MoveTo(ReactorTimerLink *pHead)
+{
+  _ASSERTE(pHead->IsEmpty());
+
+  if (IsEmpty())
+    return;
+
+  pHead->pNext = pNext;
+  pHead->pPrev = pPrev;
+  pNext->pPrev = pHead;
+  pPrev->pNext = pHead;
+  pNext = pPrev = this;
+}
+///////////////////////////////////////////////////////////////
+Reactor::Reactor()
+{
+  for (int level = 0 ; level < TIMER_WHEEL_LEVELS ; level++) {
+    wheelCount[level] = 0;
+
+    for (int i = 0 ; i < TIMER_WHEEL_WORDS ; i++)
+      wheelBits[level][i] = 0;
+  }
+
+  wheelTime = Now();
+  armedFds = 0;
+
+#ifdef _WIN32
+  ::InitializeCriticalSection(&postedLock);
+  hThread = NULL;
+#else
+  pthread_mutex_init(&postedLock, NULL);
+
+  epfd = epoll_create(EPOLL_EVENTS_MAX);
+
+  if (epfd < 0) {
+    DWORD err = GetLastError();
+
+    cerr << "WARNING: epoll_create() - error=" << err << endl;
+  }
+
+  wakefd = eventfd(0, EFD_NONBLOCK);
+
+  if (wakefd < 0) {
+    DWORD err = GetLastError();
+
+    cerr << "WARNING: eventfd() - error=" << err << endl;
+  }
+  else
+  if (epfd >= 0) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev) < 0) {
+      DWORD err = GetLastError();
+
+      cerr << "WARNING: epoll_ctl(" << wakefd << ") - error=" << err << endl;
+    }
+  }
+#endif
+}
+
+Reactor::~Reactor()
+{
+  for (int level = 0 ; level < TIMER_WHEEL_LEVELS ; level++) {
+    for (int slot = 0 ; slot < TIMER_WHEEL_SLOTS ; slot++) {
+      while (!wheel[level][slot].IsEmpty())
+        DelTimer(static_cast<ReactorTimer *>(wheel[level][slot].pNext));
+    }
+  }
+
+  FreeWatches();
+
+  for (ReactorFdMap::iterator iFd = fds.begin() ; iFd != fds.end() ; iFd++) {
+    for (ReactorWatchArray::iterator i = iFd->second->watches.begin() ; i != iFd->second->watches.end() ; i++)
+      delete *i;
+
+    delete iFd->second;
+  }
+
+#ifdef _WIN32
+  if (hThread)
+    ::CloseHandle(hThread);
+
+  ::DeleteCriticalSection(&postedLock);
+#else
+  if (wakefd >= 0)
+    close(wakefd);
+
+  if (epfd >= 0)
+    close(epfd);
+
+  pthread_mutex_destroy(&postedLock);
+#endif
+}
+///////////////////////////////////////////////////////////////
+BOOL Reactor::virtualClock = FALSE;
+ULONGLONG Reactor::virtualTime = 0;
+
+void Reactor::SetVirtualClock()
+{
+  // continue the real time to keep the timers already set
+  virtualTime = RealNow();
+  virtualClock = TRUE;
+}
+
+ULONGLONG Reactor::Now()
+{
+  if (virtualClock)
+    return virtualTime;
+
+  return RealNow();
+}
+
+ULONGLONG Reactor::RealNow()
+{
+#ifdef _WIN32
+  // the reactors of different threads do not share the timers
+  static __declspec(thread) DWORD lastTick = 0;
+  static __declspec(thread) ULONGLONG highTick = 0;
+
+  DWORD tick = ::GetTickCount();
+
+  if (tick < lastTick)
+    highTick += 0x100000000ULL;
+
+  lastTick = tick;
+
+  return highTick + tick;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ULONGLONG)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+///////////////////////////////////////////////////////////////
+unsigned Reactor::NumTimers() const
+{
+  unsigned num = 0;
+
+  for (int level = 0 ; level < TIMER_WHEEL_LEVELS ; level++)
+    num += wheelCount[level];
+
+  return num;
+}
+
+void Reactor::AddTimer(ReactorTimer *pTimer, ULONGLONG due)
+{
+  _ASSERTE(pTimer->pReactor == NULL);
+
+  pTimer->due = due;
+  pTimer->pReactor = this;
+
+  PlaceTimer(pTimer);
+}
+
+void Reactor::DelTimer(ReactorTimer *pTimer)
+{
+  _ASSERTE(pTimer->pReactor == this);
+
+  pTimer->Unlink();
+  wheelCount[pTimer->level]--;
+  pTimer->pReactor = NULL;
+
+  if (wheel[pTimer->level][pTimer->slot].IsEmpty())
+    wheelBits[pTimer->level][pTimer->slot >> 5] &= ~(1UL << (pTimer->slot & 31));
+}
+
+void Reactor::PlaceTimer(ReactorTimer *pTimer)
+{
+  // the expired ticks will not be visited again
+  ULONGLONG due = pTimer->due < wheelTime ? wheelTime : pTimer->due;
+  ULONGLONG delta = due - wheelTime;
+  int level = 0;
+
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= ((ULONGLONG)1 << ((level + 1)*TIMER_WHEEL_BITS)))
+    level++;
+
+  // too far, it will be placed again on cascading
+  if (delta >= ((ULONGLONG)1 << (TIMER_WHEEL_LEVELS*TIMER_WHEEL_BITS)))
+    due = wheelTime + ((ULONGLONG)1 << (TIMER_WHEEL_LEVELS*TIMER_WHEEL_BITS)) - 1;
+
+  int slot = (int)((due >> (level*TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+
+  pTimer->level = level;
+  pTimer->slot = slot;
+  pTimer->Link(&wheel[level][slot]);
+  wheelCount[level]++;
+  wheelBits[level][slot >> 5] |= 1UL << (slot & 31);
+}
+
+void Reactor::EmptySlot(int level, int slot, ReactorTimerLink *pList)
+{
+  wheel[level][slot].MoveTo(pList);
+  wheelBits[level][slot >> 5] &= ~(1UL << (slot & 31));
+}
+
+int Reactor::NextSlot(int level, int slot) const
+{
+  // the nearest not empty slot starting from slot (it's checked last
+  // for the bits before slot)
+  int first = slot >> 5;
+  DWORD bits = wheelBits[level][first] & (~0UL << (slot & 31));
+
+  for (int i = 0 ; i <= TIMER_WHEEL_WORDS ; i++) {
+    int word = (first + i) % TIMER_WHEEL_WORDS;
+
+    if (i == TIMER_WHEEL_WORDS)
+      bits = wheelBits[level][word] & ~(~0UL << (slot & 31));
+    else
+    if (i)
+      bits = wheelBits[level][word];
+
+    if (bits)
+      return (word << 5) + LowestBit(bits);
+  }
+
+  return -1;
+}
+
+void Reactor::CascadeTimers(int level)
+{
+  ReactorTimerLink list;
+
+  EmptySlot(level, (int)((wheelTime >> (level*TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK), &list);
+
+  while (!list.IsEmpty()) {
+    ReactorTimer *pTimer = static_cast<ReactorTimer *>(list.pNext);
+
+    pTimer->Unlink();
+    wheelCount[level]--;
+
+    PlaceTimer(pTimer);
+  }
+}
+
+void Reactor::RunTimers()
+{
+  ULONGLONG now = Now();
+
+  while (wheelTime <= now) {
+    int slot = (int)(wheelTime & TIMER_WHEEL_MASK);
+
+    if (slot == 0) {
+      for (int level = 1 ; level < TIMER_WHEEL_LEVELS ; level++) {
+        CascadeTimers(level);
+
+        if ((wheelTime >> (level*TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK)
+          break;
+      }
+    }
+    else
+    if (!wheelCount[0]) {
+      // nothing to expire up to the next cascading
+      ULONGLONG next = (wheelTime | TIMER_WHEEL_MASK) + 1;
+
+      wheelTime = (next <= now) ? next : now + 1;
+      continue;
+    }
+
+    ReactorTimerLink list;
+
+    EmptySlot(0, slot, &list);
+    wheelTime++;
+
+    while (!list.IsEmpty()) {
+      ReactorTimer *pTimer = static_cast<ReactorTimer *>(list.pNext);
+      ULONGLONG due = pTimer->due;
+
+      DelTimer(pTimer);
+
+      // rearm before calling since the proc can delete the timer
+      if (pTimer->period) {
+        due += pTimer->period;
+
+        if (due <= now)
+          due = now + pTimer->period;
+
+        AddTimer(pTimer, due);
+      }
+
+      pTimer->pProc(pTimer->pParam);
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+BOOL Reactor::Defer(DEFER_PROC *pProc, HDEFERPARAM hParam)
+{
+  _ASSERTE(pProc != NULL);
+
+  deferred.push_back(ReactorDeferred(pProc, hParam));
+
+  return TRUE;
+}
+
+void Reactor::RunDeferred()
+{
+  if (deferred.empty())
+    return;
+
+  vector<ReactorDeferred> calls;
+
+  calls.swap(deferred);
+
+  for (vector<ReactorDeferred>::const_iterator i = calls.begin() ; i != calls.end() ; i++)
+    i->first(i->second);
+}
+///////////////////////////////////////////////////////////////
+#ifdef _WIN32
+static VOID CALLBACK WakeUpAPC(ULONG_PTR /*param*/)
+{
+}
+#endif
+
+void Reactor::Post(ReactorProc *pProc, void *pParam)
+{
+  _ASSERTE(pProc != NULL);
+
+#ifdef _WIN32
+  ::EnterCriticalSection(&postedLock);
+
+  posted.push_back(ReactorPosted(pProc, pParam));
+
+  // not set till Run() (the posted calls will wait for it)
+  if (hThread)
+    ::QueueUserAPC(WakeUpAPC, hThread, 0);
+
+  ::LeaveCriticalSection(&postedLock);
+#else
+  pthread_mutex_lock(&postedLock);
+  posted.push_back(ReactorPosted(pProc, pParam));
+  pthread_mutex_unlock(&postedLock);
+
+  if (wakefd >= 0) {
+    uint64_t one = 1;
+
+    if (write(wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+      DWORD err = GetLastError();
+
+      cerr << "WARNING: write(" << wakefd << ") - error=" << err << endl;
+    }
+  }
+#endif
+}
+
+void Reactor::RunPosted()
+{
+  vector<ReactorPosted> calls;
+
+#ifdef _WIN32
+  ::EnterCriticalSection(&postedLock);
+  calls.swap(posted);
+  ::LeaveCriticalSection(&postedLock);
+#else
+  pthread_mutex_lock(&postedLock);
+  calls.swap(posted);
+  pthread_mutex_unlock(&postedLock);
+#endif
+
+  for (vector<ReactorPosted>::const_iterator i = calls.begin() ; i != calls.end() ; i++)
+    i->first(i->second);
+}
+///////////////////////////////////////////////////////////////
+ReactorWatch *Reactor::WatchCreate(int fd, WATCH_PROC *pProc, HWATCHPARAM hParam)
+{
+  _ASSERTE(pProc != NULL);
+
+#ifdef _WIN32
+  UNREFERENCED_PARAMETER(fd);
+  UNREFERENCED_PARAMETER(hParam);
+
+  cerr << "WARNING: Watching file descriptors is not supported" << endl;
+
+  return NULL;
+#else
+  if (fd < 0 || epfd < 0)
+    return NULL;
+
+  ReactorFd *pFd;
+  ReactorFdMap::iterator iFd = fds.find(fd);
+
+  if (iFd == fds.end()) {
+    pFd = new ReactorFd(fd);
+
+    if (!pFd) {
+      cerr << "No enough memory." << endl;
+      return NULL;
+    }
+
+    fds[fd] = pFd;
+  } else {
+    pFd = iFd->second;
+  }
+
+  ReactorWatch *pWatch = new ReactorWatch(*this, pFd, pProc, hParam);
+
+  if (!pWatch) {
+    cerr << "No enough memory." << endl;
+    return NULL;
+  }
+
+  pFd->watches.push_back(pWatch);
+  pFd->live++;
+
+  return pWatch;
+#endif
+}
+
+BOOL Reactor::WatchSet(ReactorWatch *pWatch, DWORD events)
+{
+  _ASSERTE(pWatch != NULL);
+  _ASSERTE(!pWatch->deleted);
+
+  if (pWatch->events == events)
+    return TRUE;
+
+  pWatch->events = events;
+
+  return UpdateWatches(pWatch->pFd);
+}
+
+void Reactor::WatchDelete(ReactorWatch *pWatch)
+{
+  _ASSERTE(pWatch != NULL);
+  _ASSERTE(!pWatch->deleted);
+
+  ReactorFd *pFd = pWatch->pFd;
+
+  // the watch can be in the middle of dispatching so free it later
+  pWatch->deleted = TRUE;
+  deletedWatches.push_back(pWatch);
+
+  if (pWatch->events) {
+    pWatch->events = 0;
+    UpdateWatches(pFd);
+  }
+
+  _ASSERTE(pFd->live > 0);
+
+  if (--pFd->live == 0) {
+    // the fd can be closed and reopened before the pending events of
+    // the old one will be dispatched so the new watches will go to a new
+    // ReactorFd object
+    fds.erase(pFd->fd);
+    deletedFds.push_back(pFd);
+  }
+}
+
+void Reactor::FreeWatches()
+{
+  for (ReactorWatchArray::iterator i = deletedWatches.begin() ; i != deletedWatches.end() ; i++) {
+    ReactorWatchArray &fdWatches = (*i)->pFd->watches;
+
+    for (ReactorWatchArray::iterator j = fdWatches.begin() ; j != fdWatches.end() ; j++) {
+      if (*j == *i) {
+        fdWatches.erase(j);
+        break;
+      }
+    }
+
+    delete *i;
+  }
+
+  deletedWatches.clear();
+
+  for (ReactorFdArray::iterator i = deletedFds.begin() ; i != deletedFds.end() ; i++) {
+    _ASSERTE((*i)->watches.empty());
+
+    delete *i;
+  }
+
+  deletedFds.clear();
+}
+///////////////////////////////////////////////////////////////
+#ifdef _WIN32
+BOOL Reactor::UpdateWatches(ReactorFd * /*pFd*/)
+{
+  return FALSE;
+}
+
+void Reactor::Wait(DWORD timeout)
+{
+  // alertable to allow completion routines of the overlapped I/O
+  ::SleepEx(timeout, TRUE);
+}
+#else  /* _WIN32 */
+static DWORD Epoll2Watch(uint32_t ev)
+{
+  DWORD events = 0;
+
+  if (ev & EPOLLIN)
+    events |= WATCH_EVENT_READ;
+  if (ev & EPOLLOUT)
+    events |= WATCH_EVENT_WRITE;
+  if (ev & (EPOLLRDHUP|EPOLLHUP))
+    events |= WATCH_EVENT_HANGUP;
+  if (ev & EPOLLERR)
+    events |= WATCH_EVENT_ERROR;
+
+  return events;
+}
+
+static uint32_t Watch2Epoll(DWORD events)
+{
+  uint32_t ev = 0;
+
+  if (events & WATCH_EVENT_READ)
+    ev |= EPOLLIN;
+  if (events & WATCH_EVENT_WRITE)
+    ev |= EPOLLOUT;
+  if (events & WATCH_EVENT_HANGUP)
+    ev |= EPOLLRDHUP;
+
+  return ev;
+}
+
+BOOL Reactor::UpdateWatches(ReactorFd *pFd)
+{
+  DWORD events = 0;
+
+  for (ReactorWatchArray::const_iterator i = pFd->watches.begin() ; i != pFd->watches.end() ; i++)
+    events |= (*i)->events;
+
+  if (events == pFd->events)
+    return TRUE;
+
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = Watch2Epoll(events);
+  ev.data.ptr = pFd;
+
+  int res;
+
+  if (!events) {
+    // the fd can be already closed (so removed from epoll)
+    epoll_ctl(epfd, EPOLL_CTL_DEL, pFd->fd, &ev);
+    res = 0;
+  }
+  else
+  if (!pFd->events) {
+    res = epoll_ctl(epfd, EPOLL_CTL_ADD, pFd->fd, &ev);
+
+    // the fd was not deleted from epoll
+    if (res < 0 && errno == EEXIST)
+      res = epoll_ctl(epfd, EPOLL_CTL_MOD, pFd->fd, &ev);
+  }
+  else {
+    res = epoll_ctl(epfd, EPOLL_CTL_MOD, pFd->fd, &ev);
+
+    // the fd was closed and reopened
+    if (res < 0 && errno == ENOENT)
+      res = epoll_ctl(epfd, EPOLL_CTL_ADD, pFd->fd, &ev);
+  }
+
+  if (res < 0) {
+    DWORD err = GetLastError();
+
+    cerr << "WARNING: epoll_ctl(" << pFd->fd << ") - error=" << err << endl;
+
+    return FALSE;
+  }
+
+  if (!pFd->events)
+    armedFds++;
+  else
+  if (!events)
+    armedFds--;
+
+  pFd->events = events;
+
+  return TRUE;
+}
+
+void Reactor::Dispatch(ReactorFd *pFd, DWORD events)
+{
+  DWORD always = events & (WATCH_EVENT_ERROR|WATCH_EVENT_HANGUP);
+
+  // the procs can add new watches to the end of array (they
+  // should not get the events) and delete watches (they are
+  // removed from the array later)
+  ReactorWatchArray::size_type num = pFd->watches.size();
+
+  for (ReactorWatchArray::size_type i = 0 ; i < num ; i++) {
+    ReactorWatch *pWatch = pFd->watches[i];
+
+    if (pWatch->deleted || !pWatch->events)
+      continue;
+
+    DWORD watchEvents = (events & pWatch->events) | always;
+
+    if (watchEvents)
+      pWatch->pProc(pWatch->hParam, watchEvents);
+  }
+}
+
+void Reactor::Wait(DWORD timeout)
+{
+  struct epoll_event evs[EPOLL_EVENTS_MAX];
+
+  int num = epoll_wait(epfd, evs, EPOLL_EVENTS_MAX, timeout == INFINITE ? -1 : (int)timeout);
+
+  if (num < 0) {
+    if (errno != EINTR) {
+      DWORD err = GetLastError();
+
+      cerr << "WARNING: epoll_wait() - error=" << err << endl;
+    }
+
+    return;
+  }
+
+  // the ReactorFd objects are not freed till FreeWatches()
+  for (int i = 0 ; i < num ; i++) {
+    if (!evs[i].data.ptr) {
+      // woken up by Post()
+      uint64_t count;
+
+      while (read(wakefd, &count, sizeof(count)) < 0 && errno == EINTR)
+        ;
+
+      continue;
+    }
+
+    Dispatch((ReactorFd *)evs[i].data.ptr, Epoll2Watch(evs[i].events));
+  }
+}
+#endif  /* _WIN32 */
+///////////////////////////////////////////////////////////////
+DWORD Reactor::Timeout(DWORD timeout) const
+{
+  if (!deferred.empty())
+    return 0;
+
+  // the nearest expiration (level 0) or cascading (other levels)
+  ULONGLONG due = 0;
+
+  for (int level = 0 ; level < TIMER_WHEEL_LEVELS ; level++) {
+    if (!wheelCount[level])
+      continue;
+
+    int shift = level*TIMER_WHEEL_BITS;
+    ULONGLONG base = wheelTime >> shift;
+    int slot = NextSlot(level, (int)(base & TIMER_WHEEL_MASK));
+
+    _ASSERTE(slot >= 0);
+
+    // the current slot of upper levels is not empty only if it's not
+    // cascaded yet (wheelTime is on the boundary)
+    int i = (slot - (int)base) & TIMER_WHEEL_MASK;
+    ULONGLONG t = i ? ((base + i) << shift) : wheelTime;
+
+    if (!due || t < due)
+      due = t;
+  }
+
+  if (!due)
+    return timeout;
+
+  ULONGLONG now = Now();
+
+  if (due <= now)
+    return 0;
+
+  if (due - now < timeout)
+    return (DWORD)(due - now);
+
+  return timeout;
+}
+
+void Reactor::RunVirtual(DWORD timeout)
+{
+  if (armedFds) {
+    // the real events are expected so the virtual clock can't run ahead
+    // of them, let it follow the real one till they are disarmed
+    ULONGLONG start = RealNow();
+
+    Wait(Timeout(timeout));
+
+    virtualTime += RealNow() - start;
+    return;
+  }
+
+  // the deferred procs and the posted calls are handled in the same
+  // virtual ms
+  Wait(0);
+
+  timeout = Timeout(timeout);
+
+  if (timeout == INFINITE) {
+    // only the posted calls can wake up
+    Wait(INFINITE);
+    return;
+  }
+
+  virtualTime += timeout;
+}
+
+void Reactor::RunOnce(DWORD timeout)
+{
+  RunPosted();
+  RunDeferred();
+
+  if (virtualClock)
+    RunVirtual(timeout);
+  else
+    Wait(Timeout(timeout));
+
+  RunTimers();
+  FreeWatches();
+}
+
+void Reactor::Run()
+{
+#ifdef _WIN32
+  ::EnterCriticalSection(&postedLock);
+
+  if (!hThread) {
+    if (!::DuplicateHandle(::GetCurrentProcess(),
+                           ::GetCurrentThread(),
+                           ::GetCurrentProcess(),
+                           &hThread,
+                           0,
+                           FALSE,
+                           DUPLICATE_SAME_ACCESS))
+    {
+      DWORD err = GetLastError();
+
+      cerr << "WARNING: DuplicateHandle() - error=" << err << endl;
+
+      hThread = NULL;
+    }
+  }
+
+  ::LeaveCriticalSection(&postedLock);
+#endif
+
+  for (;;)
+    RunOnce(INFINITE);
+}
+///////////////////////////////////////////////////////////////
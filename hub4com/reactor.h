@@ -0,0 +1,206 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _REACTOR_H
+#define _REACTOR_H
+
+///////////////////////////////////////////////////////////////
+class Reactor;
+///////////////////////////////////////////////////////////////
+typedef void ReactorProc(void *pParam);
+///////////////////////////////////////////////////////////////
+// hierarchical timer wheel: TIMER_WHEEL_LEVELS levels of
+// TIMER_WHEEL_SLOTS slots, a level 0 slot is 1 ms wide
+#define TIMER_WHEEL_BITS    8
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS  4
+#define TIMER_WHEEL_WORDS   (TIMER_WHEEL_SLOTS / 32)
+///////////////////////////////////////////////////////////////
+class ReactorTimerLink
+{
+  protected:
+    ReactorTimerLink() { pNext = pPrev = this; }
+
+    void Link(ReactorTimerLink *pHead);
+    void Unlink();
+    BOOL IsEmpty() const { return pNext == this; }
+    void MoveTo(ReactorTimerLink *pHead);
+
+    ReactorTimerLink *pNext;
+    ReactorTimerLink *pPrev;
+
+    friend class Reactor;
+};
+///////////////////////////////////////////////////////////////
+class ReactorTimer : private ReactorTimerLink
+{
+  public:
+    ReactorTimer(ReactorProc *_pProc, void *_pParam)
+      : pProc(_pProc), pParam(_pParam), pReactor(NULL), period(0), due(0), level(0), slot(0) {}
+    ~ReactorTimer() { Cancel(); }
+
+    // pDueTime is in the SetWaitableTimer() format, period is in ms
+    BOOL Set(Reactor &reactor, const LARGE_INTEGER *pDueTime, LONG period);
+    void Cancel();
+    BOOL IsSet() const { return pReactor != NULL; }
+
+  private:
+    ReactorProc *pProc;
+    void *pParam;
+
+    Reactor *pReactor;
+    DWORD period;
+    ULONGLONG due;
+    int level;
+    int slot;
+
+    friend class Reactor;
+};
+///////////////////////////////////////////////////////////////
+class ReactorFd;
+///////////////////////////////////////////////////////////////
+class ReactorWatch
+{
+  public:
+    Reactor &reactor;
+
+  private:
+    ReactorWatch(Reactor &_reactor, ReactorFd *_pFd, WATCH_PROC *_pProc, HWATCHPARAM _hParam)
+      : reactor(_reactor), pFd(_pFd), pProc(_pProc), hParam(_hParam), events(0), deleted(FALSE) {}
+
+    ReactorFd *pFd;
+    WATCH_PROC *pProc;
+    HWATCHPARAM hParam;
+    DWORD events;
+    BOOL deleted;
+
+    friend class Reactor;
+};
+///////////////////////////////////////////////////////////////
+typedef vector<ReactorWatch *> ReactorWatchArray;
+///////////////////////////////////////////////////////////////
+class ReactorFd
+{
+  private:
+    ReactorFd(int _fd) : fd(_fd), events(0), live(0) {}
+
+    int fd;
+    ReactorWatchArray watches;
+    DWORD events;       // registered in the backend
+    int live;           // number of not deleted watches
+
+    friend class Reactor;
+};
+///////////////////////////////////////////////////////////////
+typedef map<int, ReactorFd *> ReactorFdMap;
+typedef vector<ReactorFd *> ReactorFdArray;
+typedef pair<DEFER_PROC *, HDEFERPARAM> ReactorDeferred;
+typedef pair<ReactorProc *, void *> ReactorPosted;
+///////////////////////////////////////////////////////////////
+class Reactor
+{
+  public:
+    Reactor();
+    ~Reactor();
+
+    // readiness callbacks for file descriptors (POSIX only), the events
+    // are the WATCH_EVENT_* masks, WATCH_EVENT_ERROR and the hang up of
+    // both directions are reported to any watch with not empty events
+    ReactorWatch *WatchCreate(int fd, WATCH_PROC *pProc, HWATCHPARAM hParam);
+    BOOL WatchSet(ReactorWatch *pWatch, DWORD events);
+    void WatchDelete(ReactorWatch *pWatch);
+
+    // call pProc(hParam) from the loop as soon as possible
+    BOOL Defer(DEFER_PROC *pProc, HDEFERPARAM hParam);
+
+    // the same as above but can be called by any thread
+    void Post(ReactorProc *pProc, void *pParam);
+
+    void Run();
+    void RunOnce(DWORD timeout);
+
+    // the number of the set timers
+    unsigned NumTimers() const;
+
+    // monotonic time in ms
+    static ULONGLONG Now();
+
+    // simulation mode: the loops do not wait for the timers but advance
+    // the virtual clock to the nearest due time if there is nothing else
+    // to do, while any file descriptor is watched the virtual clock
+    // follows the real one, should be enabled before starting the loops,
+    // the only loop is expected
+    static void SetVirtualClock();
+    static BOOL IsVirtualClock() { return virtualClock; }
+
+    // the virtual time in us (it's advanced by whole ms)
+    static ULONGLONG VirtualNow() { return virtualTime*1000; }
+
+  private:
+    static ULONGLONG RealNow();
+    void AddTimer(ReactorTimer *pTimer, ULONGLONG due);
+    void DelTimer(ReactorTimer *pTimer);
+    void PlaceTimer(ReactorTimer *pTimer);
+    void CascadeTimers(int level);
+    void EmptySlot(int level, int slot, ReactorTimerLink *pList);
+    int NextSlot(int level, int slot) const;
+    DWORD Timeout(DWORD timeout) const;
+    void Wait(DWORD timeout);
+    void Dispatch(ReactorFd *pFd, DWORD events);
+    void RunTimers();
+    void RunDeferred();
+    void RunPosted();
+    void RunVirtual(DWORD timeout);
+    BOOL UpdateWatches(ReactorFd *pFd);
+    void FreeWatches();
+
+    ReactorTimerLink wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    int wheelCount[TIMER_WHEEL_LEVELS];
+    DWORD wheelBits[TIMER_WHEEL_LEVELS][TIMER_WHEEL_WORDS];  // not empty slots
+    ULONGLONG wheelTime;    // the ticks before it are expired
+    vector<ReactorDeferred> deferred;
+    ReactorFdMap fds;
+    ReactorWatchArray deletedWatches;
+    ReactorFdArray deletedFds;
+    int armedFds;           // the number of fds registered in the backend
+
+    vector<ReactorPosted> posted;
+
+    static BOOL virtualClock;
+    static ULONGLONG virtualTime;    // in ms
+
+#ifdef _WIN32
+    CRITICAL_SECTION postedLock;
+    HANDLE hThread;     // the thread running the loop (to wake it up)
+#else
+    pthread_mutex_t postedLock;
+    int epfd;
+    int wakefd;         // eventfd to wake up the loop
+#endif
+
+    friend class ReactorTimer;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _REACTOR_H
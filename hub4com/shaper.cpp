@@ -0,0 +1,251 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include "reactor.h"
+#include "stats.h"
+#include "shaper.h"
+#include "comhub.h"
+#include "port.h"
+#include "hubmsg.h"
+
+///////////////////////////////////////////////////////////////
+RouteShaper::RouteShaper(Port &_fromPort, Port &_toPort, DWORD _rate)
+  : fromPort(_fromPort),
+    toPort(_toPort),
+    rate(_rate),
+    lastTime(Reactor::Now()),
+    pHead(NULL),
+    pTail(NULL),
+    queued(0),
+    queueLimit(_rate),
+    suspended(FALSE),
+    timer(TimerProc, this),
+    written(0),
+    delayedMsgs(0)
+{
+  _ASSERTE(rate > 0);
+
+  // up to 100 ms of data at once
+  burst = (LONGLONG)rate * 100;
+  tokens = burst;
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::SetRate(DWORD _rate)
+{
+  _ASSERTE(_rate > 0);
+
+  Refill();
+
+  rate = _rate;
+  queueLimit = _rate;
+  burst = (LONGLONG)rate * 100;
+
+  if (tokens > burst)
+    tokens = burst;
+
+  // the wait for the tokens is changed
+  timer.Cancel();
+
+  FlowControl();
+  Schedule();
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::Flush()
+{
+  timer.Cancel();
+
+  while (pHead) {
+    if (pHead->type == HUB_MSG_TYPE_LINE_DATA) {
+      queued -= pHead->u.buf.size;
+      written += pHead->u.buf.size;
+      delayedMsgs++;
+      delay.AddSince(pHead->time);
+    }
+
+    HubMsg *pMsg = pHead;
+
+    pHead = pMsg->Cut();
+
+    toPort.Write(pMsg);
+    delete pMsg;
+  }
+
+  pTail = NULL;
+
+  FlowControl();
+}
+///////////////////////////////////////////////////////////////
+RouteShaper::~RouteShaper()
+{
+  timer.Cancel();
+
+  if (pHead)
+    delete pHead;
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::TimerProc(void *pParam)
+{
+  ((RouteShaper *)pParam)->Release();
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::Refill()
+{
+  ULONGLONG now = Reactor::Now();
+
+  if (now == lastTime)
+    return;
+
+  // rate bytes per second is rate/1000 bytes per ms
+  tokens += (LONGLONG)(now - lastTime) * rate;
+
+  if (tokens > burst)
+    tokens = burst;
+
+  lastTime = now;
+}
+///////////////////////////////////////////////////////////////
+BOOL RouteShaper::Write(HubMsg *pMsg)
+{
+  _ASSERTE(pMsg != NULL);
+
+  Refill();
+
+  // the other messages are not delayed if the queue is empty and the
+  // urgent ones are not delayed at all
+  if ((!pHead && (pMsg->type != HUB_MSG_TYPE_LINE_DATA || tokens > 0)) || pMsg->IsUrgent()) {
+    if (pMsg->type == HUB_MSG_TYPE_LINE_DATA) {
+      tokens -= (LONGLONG)pMsg->u.buf.size * 1000;
+      written += pMsg->u.buf.size;
+    }
+
+    toPort.Write(pMsg);
+
+    return TRUE;
+  }
+
+  HubMsg *pQueuedMsg = pMsg->Take();
+
+  if (!pQueuedMsg) {
+    cerr << "No enough memory." << endl;
+    exit(2);
+  }
+
+  pQueuedMsg->time = LatencyNow();
+
+  if (pTail)
+    pQueuedMsg->Insert(pTail);
+  else
+    pHead = pQueuedMsg;
+
+  pTail = pQueuedMsg;
+
+  if (pQueuedMsg->type == HUB_MSG_TYPE_LINE_DATA)
+    queued += pQueuedMsg->u.buf.size;
+
+  FlowControl();
+  Schedule();
+
+  return FALSE;
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::Release()
+{
+  Refill();
+
+  while (pHead) {
+    if (pHead->type == HUB_MSG_TYPE_LINE_DATA) {
+      // a message is not split so the tokens can be borrowed
+      if (tokens <= 0)
+        break;
+
+      tokens -= (LONGLONG)pHead->u.buf.size * 1000;
+      queued -= pHead->u.buf.size;
+      written += pHead->u.buf.size;
+      delayedMsgs++;
+      delay.AddSince(pHead->time);
+    }
+
+    HubMsg *pMsg = pHead;
+
+    pHead = pMsg->Cut();
+
+    if (!pHead)
+      pTail = NULL;
+
+    toPort.Write(pMsg);
+    delete pMsg;
+  }
+
+  FlowControl();
+  Schedule();
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::Schedule()
+{
+  if (!pHead || timer.IsSet())
+    return;
+
+  // wait for the tokens for the first byte
+  LONGLONG wait = tokens > 0 ? 0 : (-tokens)/rate + 1;
+
+  LARGE_INTEGER dueTime;
+
+  dueTime.QuadPart = -10000LL * wait;
+
+  timer.Set(fromPort.GetReactor(), &dueTime, 0);
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::FlowControl()
+{
+  if (suspended) {
+    if (queued > queueLimit/3)
+      return;
+
+    suspended = FALSE;
+  } else {
+    if (queued <= (queueLimit*2)/3)
+      return;
+
+    suspended = TRUE;
+  }
+
+  HubMsg msg;
+
+  msg.type = HUB_MSG_TYPE_ADD_XOFF_XON;
+  msg.u.val = suspended;
+
+  fromPort.Write(&msg);
+}
+///////////////////////////////////////////////////////////////
+void RouteShaper::GetStats(RouteStats &stats) const
+{
+  stats.rate = rate;
+  stats.queued = queued;
+  stats.written = written;
+  stats.delayedMsgs = delayedMsgs;
+  stats.delay = delay;
+}
+///////////////////////////////////////////////////////////////
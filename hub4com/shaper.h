@@ -0,0 +1,90 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _SHAPER_H
+#define _SHAPER_H
+
+///////////////////////////////////////////////////////////////
+class Port;
+class HubMsg;
+struct RouteStats;
+///////////////////////////////////////////////////////////////
+//
+// The token bucket limiting the data rate of a route (see
+// --route=<LstR>:<LstL>@<rate>). The data above the rate is
+// queued and released by the timer of the loop handling the
+// ports. The source port is suspended by XOFF/XON while the
+// queue is above 2/3 of the data for one second.
+//
+///////////////////////////////////////////////////////////////
+class RouteShaper
+{
+  public:
+    RouteShaper(Port &_fromPort, Port &_toPort, DWORD _rate);
+    ~RouteShaper();
+
+    DWORD Rate() const { return rate; }
+    void SetRate(DWORD _rate);
+
+    // write the queued messages at once and resume the source port
+    // (the route is removed or not limited any more)
+    void Flush();
+
+    // write the message to the port or move it to the queue,
+    // returns FALSE if queued
+    BOOL Write(HubMsg *pMsg);
+
+    void GetStats(RouteStats &stats) const;
+
+  private:
+    static void TimerProc(void *pParam);
+
+    void Refill();
+    void Release();
+    void Schedule();
+    void FlowControl();
+
+    Port &fromPort;
+    Port &toPort;
+
+    DWORD rate;             // bytes per second
+    LONGLONG burst;         // the bucket size in 1/1000 bytes
+    LONGLONG tokens;        // in 1/1000 bytes (< 0 if borrowed)
+    ULONGLONG lastTime;     // Reactor::Now() of the last refill
+
+    // the queued messages, their time is the queuing time
+    HubMsg *pHead;
+    HubMsg *pTail;
+    DWORD queued;           // bytes of LINE_DATA in the queue
+    DWORD queueLimit;
+    BOOL suspended;
+
+    ReactorTimer timer;
+
+    ULONGLONG written;      // LINE_DATA written by the shaper
+    ULONGLONG delayedMsgs;  // LINE_DATA passed the queue
+    LatencyHistogram delay;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _SHAPER_H
@@ -0,0 +1,112 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#ifdef _WIN32
+  #include <process.h>
+#endif
+
+#include "reactor.h"
+#include "stats.h"
+#include "comhub.h"
+#include "shard.h"
+#include "port.h"
+#include "pool.h"
+
+///////////////////////////////////////////////////////////////
+void Shard::Add(Port *pPort)
+{
+  _ASSERTE(pPort != NULL);
+
+  pPort->SetReactor(reactor);
+  ports.push_back(pPort);
+}
+
+BOOL Shard::Start()
+{
+#ifdef _WIN32
+  HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, this, 0, NULL);
+
+  if (!hThread) {
+    cerr << "Can't create thread " << num << endl;
+    return FALSE;
+  }
+
+  ::CloseHandle(hThread);
+#else
+  pthread_t thread;
+
+  if (pthread_create(&thread, NULL, ThreadProc, this) != 0) {
+    cerr << "Can't create thread " << num << endl;
+    return FALSE;
+  }
+
+  pthread_detach(thread);
+#endif
+
+  return TRUE;
+}
+
+#ifdef _WIN32
+unsigned __stdcall Shard::ThreadProc(void *pArg)
+#else
+void *Shard::ThreadProc(void *pArg)
+#endif
+{
+  ((Shard *)pArg)->Run();
+
+  return 0;
+}
+
+void Shard::Run()
+{
+  // the thread 0 is the main thread
+  PoolSetThread(num + 1);
+
+  // started by this thread to get the completion routines here
+  for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++) {
+    if (!(*i)->Start())
+      exit(1);
+  }
+
+  reactor.Run();
+}
+
+void Shard::ForEachPort(PortProc *pPortProc, void *pParam) const
+{
+  for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++)
+    pPortProc(*i, pParam);
+}
+
+void Shard::Report() const
+{
+  cout << "Thread " << num << ":";
+
+  for (Ports::const_iterator i = ports.begin() ; i != ports.end() ; i++)
+    cout << " " << (*i)->Name();
+
+  cout << endl;
+}
+///////////////////////////////////////////////////////////////
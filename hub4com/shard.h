@@ -0,0 +1,67 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _SHARD_H
+#define _SHARD_H
+
+///////////////////////////////////////////////////////////////
+//
+// The group of ports handled by a separate thread with its own
+// loop (see --threads option). The ports of a shard are not
+// connected by routes, shared filters or shared driver's data
+// with the ports of other shards so the threads do not need to
+// be synchronized.
+//
+///////////////////////////////////////////////////////////////
+class Shard
+{
+  public:
+    Shard(ComHub &_hub, unsigned _num) : hub(_hub), num(_num) {}
+
+    void Add(Port *pPort);
+    BOOL Start();
+    void ForEachPort(PortProc *pPortProc, void *pParam) const;
+    void Report() const;
+
+    unsigned Num() const { return num; }
+    unsigned NumPorts() const { return (unsigned)ports.size(); }
+
+  public:
+    ComHub &hub;
+    Reactor reactor;
+
+  private:
+    void Run();
+
+#ifdef _WIN32
+    static unsigned __stdcall ThreadProc(void *pArg);
+#else
+    static void *ThreadProc(void *pArg);
+#endif
+
+    unsigned num;
+    Ports ports;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _SHARD_H
@@ -41,23 +41,31 @@
   #define INIT_INSERT(ns)
 #endif
 ///////////////////////////////////////////////////////////////
-#define NAMESPACES(pattern)     \
-  pattern(FilterAwakSeq)        \
-  pattern(FilterCrypt)          \
-  pattern(FilterEcho)           \
-  pattern(FilterEscInsert)      \
-  pattern(FilterEscParse)       \
-  pattern(FilterLineCtl)        \
-  pattern(FilterLsrMap)         \
-  pattern(FilterPin2Con)        \
-  pattern(FilterPinMap)         \
-  pattern(FilterPurge)          \
-  pattern(FilterTag)            \
-  pattern(FilterTelnet)         \
-  pattern(FilterTrace)          \
-  pattern(PortConnector)        \
-  pattern(PortSerial)           \
-  pattern(PortTcp)              \
+#ifdef _WIN32
+  #define WIN32_ONLY(pattern, ns) pattern(ns)
+#else
+  #define WIN32_ONLY(pattern, ns)
+#endif
+///////////////////////////////////////////////////////////////
+#define NAMESPACES(pattern)        \
+  pattern(FilterAwakSeq)           \
+  WIN32_ONLY(pattern, FilterCrypt) \
+  pattern(FilterEcho)              \
+  pattern(FilterEscInsert)         \
+  pattern(FilterEscParse)          \
+  pattern(FilterLineCtl)           \
+  pattern(FilterLsrMap)            \
+  pattern(FilterPin2Con)           \
+  pattern(FilterPinMap)            \
+  pattern(FilterPurge)             \
+  pattern(FilterTag)               \
+  pattern(FilterTelnet)            \
+  pattern(FilterTrace)             \
+  pattern(PortBench)               \
+  pattern(PortConnector)           \
+  pattern(PortReplay)              \
+  pattern(PortSerial)              \
+  pattern(PortTcp)                 \
 ///////////////////////////////////////////////////////////////
 NAMESPACES(INIT_DECLARE)
 ///////////////////////////////////////////////////////////////
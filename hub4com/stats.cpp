@@ -0,0 +1,361 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include "reactor.h"
+#include "stats.h"
+
+#ifndef _WIN32
+  #include <time.h>
+#endif
+
+///////////////////////////////////////////////////////////////
+BOOL latencyStats = FALSE;
+///////////////////////////////////////////////////////////////
+ULONGLONG LatencyNow()
+{
+  if (Reactor::IsVirtualClock())
+    return Reactor::VirtualNow();
+
+#ifdef _WIN32
+  static LONGLONG freq = 0;
+
+  if (!freq) {
+    LARGE_INTEGER f;
+
+    ::QueryPerformanceFrequency(&f);
+    freq = f.QuadPart;
+  }
+
+  LARGE_INTEGER counter;
+
+  ::QueryPerformanceCounter(&counter);
+
+  return (ULONGLONG)(counter.QuadPart / freq) * 1000000
+       + (ULONGLONG)(counter.QuadPart % freq) * 1000000 / freq;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ULONGLONG)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+///////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram(const LatencyHistogram &histogram)
+  : count(0), max(0), pBuckets(NULL)
+{
+  *this = histogram;
+}
+
+LatencyHistogram &LatencyHistogram::operator=(const LatencyHistogram &histogram)
+{
+  if (this == &histogram)
+    return *this;
+
+  if (!histogram.pBuckets) {
+    Clear();
+    return *this;
+  }
+
+  if (!pBuckets) {
+    pBuckets = new ULONGLONG[LATENCY_BUCKETS];
+
+    if (!pBuckets) {
+      cerr << "No enough memory." << endl;
+      exit(2);
+    }
+  }
+
+  count = histogram.count;
+  max = histogram.max;
+  memcpy(pBuckets, histogram.pBuckets, LATENCY_BUCKETS * sizeof(pBuckets[0]));
+
+  return *this;
+}
+
+void LatencyHistogram::Clear()
+{
+  count = 0;
+  max = 0;
+
+  delete [] pBuckets;
+  pBuckets = NULL;
+}
+
+unsigned LatencyHistogram::Index(ULONGLONG value)
+{
+  if (value >= ((ULONGLONG)1 << LATENCY_MAX_BITS))
+    value = ((ULONGLONG)1 << LATENCY_MAX_BITS) - 1;
+
+  if (value < (2 << LATENCY_SUB_BITS))
+    return (unsigned)value;
+
+  unsigned bits = LATENCY_SUB_BITS + 1;
+
+  while ((value >> bits) > 1)
+    bits++;
+
+  unsigned shift = bits - LATENCY_SUB_BITS;
+
+  return ((bits - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+       + (unsigned)((value >> shift) & ((1 << LATENCY_SUB_BITS) - 1));
+}
+
+ULONGLONG LatencyHistogram::HighestValue(unsigned index)
+{
+  if (index < (2 << LATENCY_SUB_BITS))
+    return index;
+
+  unsigned shift = (index >> LATENCY_SUB_BITS) - 1;
+  ULONGLONG low = (ULONGLONG)((1 << LATENCY_SUB_BITS) + (index & ((1 << LATENCY_SUB_BITS) - 1))) << shift;
+
+  return low + ((ULONGLONG)1 << shift) - 1;
+}
+
+void LatencyHistogram::Add(ULONGLONG value)
+{
+  if (!pBuckets) {
+    pBuckets = new ULONGLONG[LATENCY_BUCKETS];
+
+    if (!pBuckets) {
+      cerr << "No enough memory." << endl;
+      exit(2);
+    }
+
+    memset(pBuckets, 0, LATENCY_BUCKETS * sizeof(pBuckets[0]));
+  }
+
+  pBuckets[Index(value)]++;
+  count++;
+
+  if (max < value)
+    max = value;
+}
+
+ULONGLONG LatencyHistogram::Percentile(double percent) const
+{
+  if (!count)
+    return 0;
+
+  ULONGLONG limit = (ULONGLONG)(count * percent / 100);
+
+  if (limit < 1)
+    limit = 1;
+
+  ULONGLONG sum = 0;
+
+  for (unsigned i = 0 ; i < LATENCY_BUCKETS ; i++) {
+    sum += pBuckets[i];
+
+    if (sum >= limit)
+      return HighestValue(i) < max ? HighestValue(i) : max;
+  }
+
+  return max;
+}
+
+void LatencyHistogram::Report(ostream &out) const
+{
+  out << "n " << count
+      << ", p50 " << Percentile(50)
+      << ", p90 " << Percentile(90)
+      << ", p99 " << Percentile(99)
+      << ", p99.9 " << Percentile(99.9)
+      << ", max " << max
+      << " us";
+}
+
+void LatencyHistogram::ReportJson(ostream &out) const
+{
+  out << "{\"n\":" << count
+      << ",\"p50\":" << Percentile(50)
+      << ",\"p90\":" << Percentile(90)
+      << ",\"p99\":" << Percentile(99)
+      << ",\"p99.9\":" << Percentile(99.9)
+      << ",\"max\":" << max
+      << "}";
+}
+///////////////////////////////////////////////////////////////
+void StatsSnapshot::Report(ostream &out) const
+{
+  for (size_t n = 0 ; n < ports.size() ; n++) {
+    const PortStats &stats = ports[n];
+
+    out << "Stats " << names[n] << ":"
+        << " in " << stats.bytesIn << "/" << stats.msgsIn
+        << ", out " << stats.bytesOut << "/" << stats.msgsOut
+        << ", queued " << stats.writeQueued
+        << ", xoff/xon " << stats.xoffs << "/" << stats.xons
+        << ", lost " << stats.writeLost;
+
+    if (stats.writeOps) {
+      // the average write size before and after coalescing
+      out << ", writes " << stats.writeBytes << "/" << stats.writeOps
+          << " (avg " << (stats.msgsOut ? stats.bytesOut/stats.msgsOut : 0)
+          << " -> " << stats.writeBytes/stats.writeOps << ")";
+    }
+
+    out << endl;
+
+    if (stats.inLatency.Count()) {
+      out << "Latency " << names[n] << " IN: ";
+      stats.inLatency.Report(out);
+      out << endl;
+    }
+
+    if (stats.queueLatency.Count()) {
+      out << "Latency " << names[n] << " queue: ";
+      stats.queueLatency.Report(out);
+      out << endl;
+    }
+  }
+
+  for (vector<RouteStats>::const_iterator i = routes.begin() ; i != routes.end() ; i++) {
+    out << "Stats " << names[i->from] << " --> " << names[i->to] << ":"
+        << " " << i->bytes << "/" << i->msgs;
+
+    if (i->rate) {
+      out << ", limit " << i->rate << " B/s"
+          << ", written " << i->written
+          << ", queued " << i->queued
+          << ", delayed " << i->delayedMsgs;
+    }
+
+    out << endl;
+
+    if (i->delay.Count()) {
+      out << "Delay " << names[i->from] << " --> " << names[i->to] << ": ";
+      i->delay.Report(out);
+      out << endl;
+    }
+
+    if (i->outLatency.Count()) {
+      out << "Latency " << names[i->from] << " --> " << names[i->to] << " OUT: ";
+      i->outLatency.Report(out);
+      out << endl;
+    }
+
+    if (i->latency.Count()) {
+      out << "Latency " << names[i->from] << " --> " << names[i->to] << ": ";
+      i->latency.Report(out);
+      out << endl;
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+static void JsonString(ostream &out, const string &str)
+{
+  out << '"';
+
+  for (string::const_iterator i = str.begin() ; i != str.end() ; i++) {
+    if (*i == '"' || *i == '\\') {
+      out << '\\' << *i;
+    }
+    else
+    if ((unsigned char)*i < 0x20) {
+      static const char digits[] = "0123456789abcdef";
+
+      out << "\\u00" << digits[(*i >> 4) & 0xF] << digits[*i & 0xF];
+    }
+    else {
+      out << *i;
+    }
+  }
+
+  out << '"';
+}
+
+void StatsSnapshot::ReportJson(ostream &out) const
+{
+  out << "{\"time\":" << time;
+
+  out << ",\"timers\":[";
+
+  for (size_t n = 0 ; n < timers.size() ; n++)
+    out << (n ? "," : "") << timers[n];
+
+  out << "],\"ports\":[";
+
+  for (size_t n = 0 ; n < ports.size() ; n++) {
+    const PortStats &stats = ports[n];
+
+    out << (n ? "," : "") << "{\"num\":" << n << ",\"name\":";
+    JsonString(out, names[n]);
+
+    out << ",\"bytesIn\":" << stats.bytesIn
+        << ",\"msgsIn\":" << stats.msgsIn
+        << ",\"bytesOut\":" << stats.bytesOut
+        << ",\"msgsOut\":" << stats.msgsOut
+        << ",\"queued\":" << stats.writeQueued
+        << ",\"xoffs\":" << stats.xoffs
+        << ",\"xons\":" << stats.xons
+        << ",\"lost\":" << stats.writeLost
+        << ",\"bytesWritten\":" << stats.writeBytes
+        << ",\"writes\":" << stats.writeOps;
+
+    out << ",\"filters\":[";
+
+    if (n < filters.size()) {
+      for (size_t i = 0 ; i < filters[n].size() ; i++) {
+        if (i)
+          out << ",";
+
+        JsonString(out, filters[n][i]);
+      }
+    }
+
+    out << "],\"inLatency\":";
+    stats.inLatency.ReportJson(out);
+    out << ",\"queueLatency\":";
+    stats.queueLatency.ReportJson(out);
+    out << "}";
+  }
+
+  out << "],\"routes\":[";
+
+  for (vector<RouteStats>::const_iterator i = routes.begin() ; i != routes.end() ; i++) {
+    out << (i != routes.begin() ? "," : "")
+        << "{\"from\":" << i->from
+        << ",\"to\":" << i->to
+        << ",\"bytes\":" << i->bytes
+        << ",\"msgs\":" << i->msgs
+        << ",\"rate\":" << i->rate
+        << ",\"written\":" << i->written
+        << ",\"queued\":" << i->queued
+        << ",\"delayed\":" << i->delayedMsgs;
+
+    out << ",\"delay\":";
+    i->delay.ReportJson(out);
+    out << ",\"outLatency\":";
+    i->outLatency.ReportJson(out);
+    out << ",\"latency\":";
+    i->latency.ReportJson(out);
+    out << "}";
+  }
+
+  out << "]}";
+}
+///////////////////////////////////////////////////////////////
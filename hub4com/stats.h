@@ -0,0 +1,172 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+///////////////////////////////////////////////////////////////
+//
+// The latency instrumentation is enabled by --latency-stats
+// option. If it's disabled the messages are not timestamped
+// and the histograms are not updated.
+//
+///////////////////////////////////////////////////////////////
+extern BOOL latencyStats;
+
+// monotonic time in microseconds
+ULONGLONG LatencyNow();
+///////////////////////////////////////////////////////////////
+//
+// The HDR-style histogram of latencies in microseconds. The
+// values below 32 have own buckets, the greater values are put
+// to 16 buckets per power of 2 (the precision is about 6%).
+// The buckets are allocated by the first Add() so the empty
+// histograms (the instrumentation is disabled) are small.
+//
+///////////////////////////////////////////////////////////////
+#define LATENCY_SUB_BITS    4
+#define LATENCY_MAX_BITS    40
+#define LATENCY_BUCKETS     ((2 + LATENCY_MAX_BITS - LATENCY_SUB_BITS - 1) << LATENCY_SUB_BITS)
+///////////////////////////////////////////////////////////////
+class LatencyHistogram
+{
+  public:
+    LatencyHistogram() : count(0), max(0), pBuckets(NULL) {}
+    LatencyHistogram(const LatencyHistogram &histogram);
+    ~LatencyHistogram() { delete [] pBuckets; }
+
+    LatencyHistogram &operator=(const LatencyHistogram &histogram);
+
+    void Clear();
+    void Add(ULONGLONG value);
+    void AddSince(ULONGLONG start) {
+      ULONGLONG now = LatencyNow();
+      Add(now > start ? now - start : 0);
+    }
+
+    ULONGLONG Count() const { return count; }
+    ULONGLONG Max() const { return max; }
+
+    // the highest value of the bucket containing the percentile
+    ULONGLONG Percentile(double percent) const;
+
+    void Report(ostream &out) const;
+    void ReportJson(ostream &out) const;
+
+  private:
+    static unsigned Index(ULONGLONG value);
+    static ULONGLONG HighestValue(unsigned index);
+
+    ULONGLONG count;
+    ULONGLONG max;
+    ULONGLONG *pBuckets;    // LATENCY_BUCKETS or NULL if empty
+};
+///////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////
+//
+// The counters of a port. They are updated only by the thread
+// handling the port (see --threads option) so they do not need
+// any locking and a snapshot of them is taken by that thread.
+//
+///////////////////////////////////////////////////////////////
+struct PortStats
+{
+  PortStats()
+    : bytesIn(0), msgsIn(0),
+      bytesOut(0), msgsOut(0),
+      xoffs(0), xons(0),
+      writeQueued(0), writeLost(0),
+      writeBytes(0), writeOps(0) {}
+
+  ULONGLONG bytesIn;        // LINE_DATA read from the port
+  ULONGLONG msgsIn;
+  ULONGLONG bytesOut;       // LINE_DATA written to the port
+  ULONGLONG msgsOut;
+  ULONGLONG xoffs;          // ADD_XOFF_XON(TRUE) sent by the port
+  ULONGLONG xons;           // ADD_XOFF_XON(FALSE) sent by the port
+
+  // from the driver (see PORT_GET_STATS)
+  DWORD writeQueued;
+  ULONGLONG writeLost;
+  ULONGLONG writeBytes;     // passed to the write operations
+  ULONGLONG writeOps;
+
+  // see --latency-stats
+  LatencyHistogram inLatency;     // in the IN filters
+  LatencyHistogram queueLatency;  // in the write queue of the driver
+};
+///////////////////////////////////////////////////////////////
+struct RouteStats
+{
+  RouteStats(int _from, int _to)
+    : from(_from), to(_to), bytes(0), msgs(0),
+      rate(0), queued(0), written(0), delayedMsgs(0) {}
+
+  int from;                 // the port numbers
+  int to;
+  ULONGLONG bytes;          // LINE_DATA routed after the filters
+  ULONGLONG msgs;
+
+  // see --latency-stats
+  LatencyHistogram outLatency;    // in the OUT filters
+  LatencyHistogram latency;       // from reading to writing to the port
+
+  // the shaping (see --route=<LstR>:<LstL>@<rate>)
+  DWORD rate;               // bytes per second or 0
+  DWORD queued;             // bytes delayed now
+  ULONGLONG written;        // bytes written to the port
+  ULONGLONG delayedMsgs;    // messages passed the queue
+  LatencyHistogram delay;         // in the queue
+};
+///////////////////////////////////////////////////////////////
+class StatsSnapshot
+{
+  public:
+    StatsSnapshot() : time(0) {}
+
+    void Report(ostream &out) const;
+
+    // one line (see --control)
+    void ReportJson(ostream &out) const;
+
+  public:
+    ULONGLONG time;         // Reactor::Now() of the finishing
+
+    // indexed by the port number
+    vector<string> names;
+    vector<PortStats> ports;
+    vector< vector<string> > filters;   // <name>.IN and <name>.OUT in chain order
+
+    // the timers set in the loops (0 is the main one, see --threads)
+    vector<unsigned> timers;
+
+    // the data routes ordered by the source port
+    vector<RouteStats> routes;
+
+    // the index of the first route of the port in routes (indexed by
+    // the port number, the last item is the number of routes)
+    vector<size_t> portRoutes;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _STATS_H
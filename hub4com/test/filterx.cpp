@@ -0,0 +1,161 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include "plugins/serial/filterx.h"
+
+using namespace PortSerial;
+
+///////////////////////////////////////////////////////////////
+//
+// Checks the XON/XOFF stripping kernels of the serial port (see
+// plugins/serial/filterx.h) against the simple loop for the buffers
+// with unaligned heads and the tails shorter than the SSE2 block.
+//
+///////////////////////////////////////////////////////////////
+#define XON         0x11
+#define XOFF        0x13
+#define MAX_OFFSET  32
+#define MAX_LEN     200
+///////////////////////////////////////////////////////////////
+static int failures = 0;
+
+static void Fail(const char *pWhat, const char *pKernel, DWORD offset, DWORD len, int density)
+{
+  if (failures++ < 10) {
+    cerr << "FAILED " << pWhat << " " << pKernel
+         << " offset " << offset << " len " << len << " density " << density << endl;
+  }
+}
+///////////////////////////////////////////////////////////////
+static void Check(const vector<BYTE> &data, DWORD offset, DWORD len, int density)
+{
+  const BYTE *pData = &data[offset];
+
+  DWORD found = len;
+  vector<BYTE> stripped;
+
+  for (DWORD i = 0 ; i < len ; i++) {
+    if (pData[i] == XON || pData[i] == XOFF) {
+      if (found == len)
+        found = i;
+    } else {
+      stripped.push_back(pData[i]);
+    }
+  }
+
+  const struct {
+    const char *pName;
+    DWORD (*pFindX)(const BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff);
+    DWORD (*pStripX)(BYTE *pBuf, DWORD len, BYTE xOn, BYTE xOff);
+  } kernels[] = {
+    { "FindX/StripX", FindX, StripX },
+#ifdef FILTERX_SSE2
+    { "FindXSse2/StripXSse2", FindXSse2, StripXSse2 },
+#endif  /* FILTERX_SSE2 */
+  };
+
+  for (size_t k = 0 ; k < sizeof(kernels)/sizeof(kernels[0]) ; k++) {
+    if (kernels[k].pFindX(pData, len, XON, XOFF) != found)
+      Fail("find", kernels[k].pName, offset, len, density);
+
+    // strip in the copy with the same alignment and the guard bytes after it
+    vector<BYTE> buf(data);
+    BYTE *pBuf = &buf[offset];
+
+    DWORD newLen = kernels[k].pStripX(pBuf, len, XON, XOFF);
+
+    if (newLen != stripped.size() ||
+        (newLen && memcmp(pBuf, &stripped[0], newLen) != 0) ||
+        memcmp(pBuf + len, pData + len, data.size() - offset - len) != 0)
+    {
+      Fail("strip", kernels[k].pName, offset, len, density);
+    }
+  }
+
+  if (FindXScalar(pData, len, XON, XOFF) != found)
+    Fail("find", "FindXScalar", offset, len, density);
+
+  vector<BYTE> buf(data);
+  DWORD newLen = StripXScalar(&buf[offset], len, XON, XOFF);
+
+  if (newLen != stripped.size() || (newLen && memcmp(&buf[offset], &stripped[0], newLen) != 0))
+    Fail("strip", "StripXScalar", offset, len, density);
+}
+///////////////////////////////////////////////////////////////
+int main(int /*argc*/, char* /*argv*/[])
+{
+  srand(1);
+
+  // every 1/density byte is XON or XOFF, 0 means none
+  static const int densities[] = { 0, 64, 16, 4, 1 };
+
+  for (size_t d = 0 ; d < sizeof(densities)/sizeof(densities[0]) ; d++) {
+    int density = densities[d];
+    vector<BYTE> data(MAX_OFFSET + MAX_LEN + 16);
+
+    for (size_t i = 0 ; i < data.size() ; i++) {
+      BYTE b;
+
+      do {
+        b = (BYTE)rand();
+      } while (b == XON || b == XOFF);
+
+      if (density && rand() % density == 0)
+        b = (rand() & 1) ? XON : XOFF;
+
+      data[i] = b;
+    }
+
+    for (DWORD offset = 0 ; offset < MAX_OFFSET ; offset++) {
+      for (DWORD len = 0 ; len <= MAX_LEN ; len++)
+        Check(data, offset, len, density);
+    }
+  }
+
+  // the only XON at each position of the unaligned buffer
+  for (DWORD offset = 0 ; offset < 16 ; offset++) {
+    for (DWORD pos = 0 ; pos < 64 ; pos++) {
+      vector<BYTE> data(16 + 64 + 16, 'x');
+
+      data[offset + pos] = XON;
+
+      Check(data, offset, 64, -1);
+    }
+  }
+
+  if (failures) {
+    cerr << failures << " failure(s)" << endl;
+    return 1;
+  }
+
+#ifdef FILTERX_SSE2
+  cout << "SSE2 and scalar kernels are OK" << endl;
+#else
+  cout << "scalar kernels are OK (no SSE2)" << endl;
+#endif  /* FILTERX_SSE2 */
+
+  return 0;
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,442 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 Vyacheslav Frolov
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * $Log$
+ */
+#include "precomp.h"
+#include "plugins/plugins_api.h"
+
+#include <pty.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+///////////////////////////////////////////////////////////////
+//
+// Runs the hub with the serial ports on the slaves of two pty pairs
+// A and B wired by
+//
+//   --create-filter=pinmap:--rts=cts --dtr=dsr --break=dcd
+//   --add-filters=0,1:pinmap
+//
+// and checks the data, pins and break through the termios backend
+// (see plugins/serial/comio_posix.cpp).
+//
+// The ptys have no modem lines so ioctl() is interposed here to
+// emulate them for the slaves: the test sets CTS, DSR and DCD of A and
+// checks RTS, DTR and break of B set by the hub. The emulated
+// TIOCMIWAIT waits the changes of CTS, DSR, DCD and RI. With
+// --no-miwait it fails with ENOTTY (as a real pty does) so the hub
+// should poll the lines by TIOCMGET.
+//
+///////////////////////////////////////////////////////////////
+#define WAIT_TIME     2000
+#define IDLE_TIME     300
+#define DATA_SIZE     65536
+#define OUT_BREAK     0x10000   // GetOut() bit for break
+///////////////////////////////////////////////////////////////
+int Hub4comMain(int argc, char *argv[]);
+///////////////////////////////////////////////////////////////
+struct Line {
+  dev_t dev;
+  int in;           // TIOCM_CTS, TIOCM_DSR, TIOCM_CD and TIOCM_RNG set by test
+  int out;          // TIOCM_RTS and TIOCM_DTR set by hub
+  BOOL brk;         // set by hub
+  int gets;         // TIOCMGET calls
+  int waits;        // TIOCMIWAIT calls
+  int wake[2];      // wakes TIOCMIWAIT
+};
+
+static Line lines[2];
+static pthread_mutex_t linesLock = PTHREAD_MUTEX_INITIALIZER;
+static BOOL noMiWait = FALSE;
+///////////////////////////////////////////////////////////////
+static Line *FindLine(int fd)
+{
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || !S_ISCHR(st.st_mode))
+    return NULL;
+
+  for (int i = 0 ; i < 2 ; i++) {
+    if (lines[i].dev && lines[i].dev == st.st_rdev)
+      return &lines[i];
+  }
+
+  return NULL;
+}
+
+static int WaitLine(Line *pLine)
+{
+  struct pollfd pfd;
+
+  pfd.fd = pLine->wake[0];
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  // EINTR by the signal of ComIo::ModemWaitStop()
+  if (poll(&pfd, 1, -1) < 0)
+    return -1;
+
+  char buf[16];
+
+  while (read(pLine->wake[0], buf, sizeof(buf)) > 0)
+    ;
+
+  return 0;
+}
+
+extern "C" int ioctl(int fd, unsigned long request, ...) __THROW
+{
+  va_list va;
+
+  va_start(va, request);
+  void *arg = va_arg(va, void *);
+  va_end(va);
+
+  Line *pLine = FindLine(fd);
+
+  if (pLine) {
+    int res = 0;
+
+    pthread_mutex_lock(&linesLock);
+
+    switch (request) {
+      case TIOCMGET:
+        *(int *)arg = pLine->in | pLine->out;
+        pLine->gets++;
+        break;
+      case TIOCMSET:
+        pLine->out = *(int *)arg & (TIOCM_RTS|TIOCM_DTR);
+        break;
+      case TIOCMBIS:
+        pLine->out |= *(int *)arg & (TIOCM_RTS|TIOCM_DTR);
+        break;
+      case TIOCMBIC:
+        pLine->out &= ~*(int *)arg;
+        break;
+      case TIOCSBRK:
+        pLine->brk = TRUE;
+        break;
+      case TIOCCBRK:
+        pLine->brk = FALSE;
+        break;
+      case TIOCMIWAIT:
+        pLine->waits++;
+        res = 1;
+        break;
+      default:
+        res = -1;
+    }
+
+    pthread_mutex_unlock(&linesLock);
+
+    if (res == 0)
+      return 0;
+
+    if (res == 1) {
+      if (noMiWait) {
+        errno = ENOTTY;
+        return -1;
+      }
+
+      return WaitLine(pLine);
+    }
+  }
+
+  return (int)syscall(SYS_ioctl, fd, request, arg);
+}
+///////////////////////////////////////////////////////////////
+static int failures = 0;
+
+static void Fail(const char *pWhat)
+{
+  failures++;
+  cerr << "FAILED " << pWhat << endl;
+}
+
+static void SetIn(Line &line, int set, int clr)
+{
+  pthread_mutex_lock(&linesLock);
+  line.in = (line.in | set) & ~clr;
+  pthread_mutex_unlock(&linesLock);
+
+  if (write(line.wake[1], "", 1) < 0)
+    perror("write()");
+}
+
+static int GetOut(Line &line)
+{
+  pthread_mutex_lock(&linesLock);
+  int out = line.out | (line.brk ? OUT_BREAK : 0);
+  pthread_mutex_unlock(&linesLock);
+
+  return out;
+}
+
+static void WaitOut(Line &line, int mask, int expected, const char *pWhat)
+{
+  for (int t = 0 ; t < WAIT_TIME ; t++) {
+    if ((GetOut(line) & mask) == expected)
+      return;
+
+    usleep(1000);
+  }
+
+  Fail(pWhat);
+}
+///////////////////////////////////////////////////////////////
+static BOOL OpenPair(int &master, Line &line, string &path)
+{
+  int slave;
+  char name[256];
+
+  if (openpty(&master, &slave, name, NULL, NULL) < 0) {
+    perror("openpty()");
+    return FALSE;
+  }
+
+  struct termios tios;
+
+  // the slave is not closed so the master does not get EIO
+  if (tcgetattr(slave, &tios) == 0) {
+    cfmakeraw(&tios);
+    tcsetattr(slave, TCSANOW, &tios);
+  }
+
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+  if (pipe(line.wake) < 0) {
+    perror("pipe()");
+    return FALSE;
+  }
+
+  fcntl(line.wake[0], F_SETFL, fcntl(line.wake[0], F_GETFL) | O_NONBLOCK);
+
+  struct stat st;
+
+  if (fstat(slave, &st) < 0) {
+    perror("fstat()");
+    return FALSE;
+  }
+
+  line.dev = st.st_rdev;
+  path = name;
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+static void *HubThread(void *pParam)
+{
+  vector<string> &args = *(vector<string> *)pParam;
+  vector<char *> argv;
+
+  for (vector<string>::iterator i = args.begin() ; i != args.end() ; i++)
+    argv.push_back((char *)i->c_str());
+
+  argv.push_back(NULL);
+
+  Hub4comMain((int)args.size(), &argv[0]);
+
+  return NULL;
+}
+///////////////////////////////////////////////////////////////
+static BOOL Transfer(int from, int to, const char *pWhat)
+{
+  vector<BYTE> data(DATA_SIZE);
+
+  for (size_t i = 0 ; i < data.size() ; i++)
+    data[i] = (BYTE)(i * 7 + i / 251);
+
+  size_t written = 0;
+  size_t done = 0;
+
+  for (int idle = 0 ; done < data.size() && idle < WAIT_TIME ; ) {
+    struct pollfd pfds[2];
+
+    pfds[0].fd = to;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = from;
+    pfds[1].events = (written < data.size()) ? POLLOUT : 0;
+
+    if (poll(pfds, 2, 1) <= 0) {
+      idle++;
+      continue;
+    }
+
+    idle = 0;
+
+    if (pfds[1].revents & POLLOUT) {
+      ssize_t len = write(from, &data[written], data.size() - written);
+
+      if (len > 0)
+        written += len;
+    }
+
+    if (pfds[0].revents & POLLIN) {
+      BYTE buf[4096];
+      ssize_t len = read(to, buf, sizeof(buf));
+
+      for (ssize_t i = 0 ; i < len ; i++) {
+        if (done >= data.size() || buf[i] != data[done]) {
+          Fail(pWhat);
+          return FALSE;
+        }
+
+        done++;
+      }
+    }
+  }
+
+  if (done != data.size()) {
+    Fail(pWhat);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "--no-miwait") == 0)
+    noMiWait = TRUE;
+
+  // the hub's thread never returns
+  alarm(30);
+
+  int masters[2];
+  string paths[2];
+
+  for (int i = 0 ; i < 2 ; i++) {
+    if (!OpenPair(masters[i], lines[i], paths[i]))
+      return 1;
+  }
+
+  Line &lineA = lines[0];
+  Line &lineB = lines[1];
+
+  vector<string> args;
+
+  args.push_back("hub4com");
+  args.push_back("--octs=off");
+  args.push_back("--create-filter=pinmap:--rts=cts --dtr=dsr --break=dcd");
+  args.push_back("--add-filters=0,1:pinmap");
+  args.push_back(paths[0]);
+  args.push_back(paths[1]);
+
+  pthread_t hub;
+
+  if (pthread_create(&hub, NULL, HubThread, &args) != 0) {
+    cerr << "Can't start the hub" << endl;
+    return 1;
+  }
+
+  // repeat the token till the hub opens the ports
+  BOOL ready = FALSE;
+
+  for (int t = 0 ; t < WAIT_TIME / 10 && !ready ; t++) {
+    char buf[64];
+
+    if (write(masters[0], "ping", 4) < 0)
+      perror("write()");
+
+    usleep(10000);
+
+    while (read(masters[1], buf, sizeof(buf)) > 0)
+      ready = TRUE;
+  }
+
+  if (!ready) {
+    Fail("start");
+    _exit(1);
+  }
+
+  // drain the late tokens
+  usleep(100000);
+
+  for (int i = 0 ; i < 2 ; i++) {
+    char buf[64];
+
+    while (read(masters[i], buf, sizeof(buf)) > 0)
+      ;
+  }
+
+  Transfer(masters[0], masters[1], "data A -> B");
+  Transfer(masters[1], masters[0], "data B -> A");
+
+  SetIn(lineA, TIOCM_CTS, 0);
+  WaitOut(lineB, TIOCM_RTS, TIOCM_RTS, "CTS(A) -> RTS(B) on");
+  SetIn(lineA, 0, TIOCM_CTS);
+  WaitOut(lineB, TIOCM_RTS, 0, "CTS(A) -> RTS(B) off");
+
+  SetIn(lineA, TIOCM_DSR, 0);
+  WaitOut(lineB, TIOCM_DTR, TIOCM_DTR, "DSR(A) -> DTR(B) on");
+  SetIn(lineA, 0, TIOCM_DSR);
+  WaitOut(lineB, TIOCM_DTR, 0, "DSR(A) -> DTR(B) off");
+
+  SetIn(lineA, TIOCM_CD, 0);
+  WaitOut(lineB, OUT_BREAK, OUT_BREAK, "DCD(A) -> BREAK(B) on");
+  SetIn(lineA, 0, TIOCM_CD);
+  WaitOut(lineB, OUT_BREAK, 0, "DCD(A) -> BREAK(B) off");
+
+  SetIn(lineB, TIOCM_CTS, 0);
+  WaitOut(lineA, TIOCM_RTS, TIOCM_RTS, "CTS(B) -> RTS(A) on");
+
+  // the idle lines should not be polled if they are waited
+  pthread_mutex_lock(&linesLock);
+  lineA.gets = 0;
+  pthread_mutex_unlock(&linesLock);
+
+  usleep(IDLE_TIME * 1000);
+
+  pthread_mutex_lock(&linesLock);
+  int gets = lineA.gets;
+  int waits = lineA.waits;
+  pthread_mutex_unlock(&linesLock);
+
+  cout << "TIOCMGET " << gets << " in " << IDLE_TIME << " ms, TIOCMIWAIT " << waits << endl;
+
+  if (noMiWait) {
+    if (gets < IDLE_TIME / 10 / 3)
+      Fail("polling");
+  } else {
+    if (gets > 5)
+      Fail("waiting (polled)");
+
+    if (!waits)
+      Fail("waiting (no TIOCMIWAIT)");
+  }
+
+  if (failures) {
+    cerr << failures << " failure(s)" << endl;
+    _exit(1);
+  }
+
+  cout << "data, pins and break are OK" << (noMiWait ? " (polled)" : " (waited)") << endl;
+
+  // the hub's thread never returns
+  _exit(0);
+}
+///////////////////////////////////////////////////////////////
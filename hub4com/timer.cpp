@@ -30,45 +30,36 @@
 #include "precomp.h"
 #include "plugins/plugins_api.h"
 
+#include "reactor.h"
+#include "stats.h"
 #include "timer.h"
 #include "comhub.h"
 #include "port.h"
 #include "hubmsg.h"
 ///////////////////////////////////////////////////////////////
 Timer::Timer(HTIMEROWNER _hTimerOwner)
-  : hTimerOwner(_hTimerOwner)
+  : hTimerOwner(_hTimerOwner),
+    pPort(NULL),
+    hTimerParam(NULL),
+    timer(TimerProc, this)
 {
 #ifdef _DEBUG
   signature = TIMER_SIGNATURE;
 #endif
-
-  hTimer = ::CreateWaitableTimer(NULL, FALSE, NULL);
-
-  if (!hTimer) {
-    DWORD err = GetLastError();
-
-    cerr << "WARNING: CreateWaitableTimer() - error=" << err << endl;
-  }
 }
 ///////////////////////////////////////////////////////////////
 Timer::~Timer()
 {
   _ASSERTE(signature == TIMER_SIGNATURE);
 
-  if (hTimer) {
-    Cancel();
-    CloseHandle(hTimer);
-  }
+  Cancel();
 
 #ifdef _DEBUG
   signature = 0;
 #endif
 }
 ///////////////////////////////////////////////////////////////
-VOID CALLBACK Timer::TimerAPCProc(
-  LPVOID pArg,
-  DWORD /*dwTimerLowValue*/,
-  DWORD /*dwTimerHighValue*/)
+void Timer::TimerProc(void *pArg)
 {
   _ASSERTE(((Timer *)pArg)->signature == TIMER_SIGNATURE);
 
@@ -90,25 +81,13 @@ BOOL Timer::Set(Port *_pPort, const LARGE_INTEGER *pDueTime, LONG period, HTIMER
 
   _ASSERTE(pPort != NULL);
 
-  if (!::SetWaitableTimer(hTimer, pDueTime, period, TimerAPCProc, this, FALSE)) {
-    DWORD err = GetLastError();
-
-    cerr << "WARNING: SetWaitableTimer() - error=" << err << endl;
-
-    return FALSE;
-  }
-
-  return TRUE;
+  return timer.Set(pPort->GetReactor(), pDueTime, period);
 }
 ///////////////////////////////////////////////////////////////
 void Timer::Cancel()
 {
   _ASSERTE(signature == TIMER_SIGNATURE);
 
-  if (!::CancelWaitableTimer(hTimer)) {
-    DWORD err = GetLastError();
-
-    cerr << "WARNING: CancelWaitableTimer() - error=" << err << endl;
-  }
+  timer.Cancel();
 }
 ///////////////////////////////////////////////////////////////
@@ -45,16 +45,13 @@ class Timer
     void Cancel();
 
   private:
-    static VOID CALLBACK TimerAPCProc(
-      LPVOID pArg,
-      DWORD dwTimerLowValue,
-      DWORD dwTimerHighValue);
+    static void TimerProc(void *pArg);
 
     HTIMEROWNER hTimerOwner;
     Port *pPort;
     HTIMERPARAM hTimerParam;
 
-    HANDLE hTimer;
+    ReactorTimer timer;
 
 #ifdef _DEBUG
   private:
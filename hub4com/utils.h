@@ -62,13 +62,13 @@ class Arg : protected ARG_INFO_A
       Init(arg.c_str(), arg.pFile, arg.iLine, arg.pReference);
     }
 
-    Arg::~Arg();
+    ~Arg();
 
     const char *c_str() const { return (const char *)pBuf; }
-    ostream &Arg::OutReference(ostream &out, const string &prefix, const string &suffix) const;
+    ostream &OutReference(ostream &out, const string &prefix, const string &suffix) const;
 
-    static Arg *Arg::GetArg(const char *_pArg);
-    static const ARG_INFO_A *Arg::GetArgInfo(const char *_pArg) { return GetArg(_pArg); }
+    static Arg *GetArg(const char *_pArg);
+    static const ARG_INFO_A *GetArgInfo(const char *_pArg) { return GetArg(_pArg); }
 
   protected:
     void Init(